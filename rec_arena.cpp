@@ -0,0 +1,115 @@
+/*
+**************************************************************************
+
+rec_arena.cpp
+
+**************************************************************************
+
+Block arena for the per block working buffers, see rec_arena.h
+
+**************************************************************************
+*/
+
+#include <string.h>
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+#endif
+
+#include "rec_mem.h"
+#include "rec_arena.h"
+
+
+
+/*
+**************************************************************************
+bArenaInit
+**************************************************************************
+*/
+
+bool bArenaInit(ST_ARENA* pstArena, size_t dwSize)
+{
+	memset(pstArena, 0, sizeof(*pstArena));
+	pstArena->dwSize = (dwSize + REC_MEM_ALIGNMENT - 1) & ~(size_t)(REC_MEM_ALIGNMENT - 1);
+	pstArena->pbyBase = (uint8_t*)pvRecAlignedAlloc(pstArena->dwSize);
+	if (!pstArena->pbyBase)
+	{
+		pstArena->dwSize = 0;
+		return false;
+	}
+
+	// all pages are mapped now and not during the recording
+	memset(pstArena->pbyBase, 0, pstArena->dwSize);
+
+	// locking may fail without the rights, the arena works anyway
+#if defined(_WIN32)
+	pstArena->bLocked = VirtualLock(pstArena->pbyBase, pstArena->dwSize) != 0;
+#else
+	pstArena->bLocked = mlock(pstArena->pbyBase, pstArena->dwSize) == 0;
+#endif
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+pvArenaAlloc
+**************************************************************************
+*/
+
+void* pvArenaAlloc(ST_ARENA* pstArena, size_t dwLen, size_t dwAlignment)
+{
+	size_t dwStart = (pstArena->dwUsed + dwAlignment - 1) & ~(dwAlignment - 1);
+	if (dwStart + dwLen > pstArena->dwSize)
+	{
+		pstArena->qwOverflows++;
+		return NULL;
+	}
+
+	pstArena->dwUsed = dwStart + dwLen;
+	if (pstArena->dwUsed > pstArena->dwHighWater)
+		pstArena->dwHighWater = pstArena->dwUsed;
+	return pstArena->pbyBase + dwStart;
+}
+
+
+
+/*
+**************************************************************************
+vArenaReset
+**************************************************************************
+*/
+
+void vArenaReset(ST_ARENA* pstArena)
+{
+	pstArena->dwUsed = 0;
+}
+
+
+
+/*
+**************************************************************************
+vArenaFree
+**************************************************************************
+*/
+
+void vArenaFree(ST_ARENA* pstArena)
+{
+	if (pstArena->pbyBase)
+	{
+#if defined(_WIN32)
+		if (pstArena->bLocked)
+			VirtualUnlock(pstArena->pbyBase, pstArena->dwSize);
+#else
+		if (pstArena->bLocked)
+			munlock(pstArena->pbyBase, pstArena->dwSize);
+#endif
+		vRecAlignedFree(pstArena->pbyBase);
+	}
+	pstArena->pbyBase = NULL;
+	pstArena->dwSize = pstArena->dwUsed = 0;
+	pstArena->bLocked = false;
+}
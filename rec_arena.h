@@ -0,0 +1,44 @@
+/*
+**************************************************************************
+
+rec_arena.h
+
+**************************************************************************
+
+Block arena for the per block working buffers. The arena is allocated,
+touched and page locked once when the work starts. During a block the
+buffers are handed out one after the other and the whole arena is reset
+for the next block, so the hot path does no heap allocation at all.
+**************************************************************************
+*/
+
+#ifndef REC_ARENA_H
+#define REC_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ST_ARENA
+{
+	uint8_t*    pbyBase;
+	size_t      dwSize;
+	size_t      dwUsed;
+	size_t      dwHighWater;
+	bool        bLocked;            // pages locked in RAM
+	uint64_t    qwOverflows;        // requests that didn't fit
+};
+
+
+// ----- allocates and locks dwSize bytes, false if there is no memory -----
+bool bArenaInit(ST_ARENA* pstArena, size_t dwSize);
+
+// ----- dwLen bytes aligned to dwAlignment (power of two), NULL if the arena is full -----
+void* pvArenaAlloc(ST_ARENA* pstArena, size_t dwLen, size_t dwAlignment = 64);
+
+// ----- all buffers of the last block are free again -----
+void vArenaReset(ST_ARENA* pstArena);
+
+// ----- unlocks and frees the arena -----
+void vArenaFree(ST_ARENA* pstArena);
+
+#endif
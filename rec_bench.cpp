@@ -0,0 +1,565 @@
+/*
+**************************************************************************
+
+rec_bench.cpp
+
+**************************************************************************
+
+Benchmark of the decoding kernels on a synthetic signal (rec_siggen).
+The signal is generated to memory first, then every kernel runs alone
+over all blocks, followed by the whole chain as in the FIFO loop:
+
+	average     average() of the raw block
+	sums        symbol sums (boxcar of REC_DOWN_SAMPLING_RATE samples)
+	slicer      sums, threshold window and decision, packed output
+	track       sums and decision against the tracked threshold
+	timing      symbol sums with the recovered symbol clock
+	preamble    search over a block without a preamble (full scan)
+	demux       packed bits to the 16 streams
+	writer      stream writer append and flush to bench_ratX_chY.bin
+	codec       stream container codec (rec_codec) on 16 neural like
+	            streams of a block's length each
+	decoder     bDecoderDo, slicer to demux with the block carry over
+	chain       decoder and stream writer
+
+Each kernel is run for the given repeats, the best and the median run
+are reported in ns per ADC sample and GB/s of int16 input. The signal
+only depends on the seed, so runs with the same options can be compared
+between kernel versions and machines. The chain checks the decoded
+streams against the generator, the benchmark fails if they differ.
+The generator streams are random bytes that can't be compressed, so the
+codec runs on streams of a slow random walk with small noise instead,
+its ratio and a decode check are printed at the end. The decisions of
+the slicer kernel are checked against the original double precision
+slicer (vSlicerReference) on every block, any difference fails the
+benchmark.
+
+With -sync the signal has a sync word after every that many frames and
+the decoder checks its frame lock (rec_lock), -slip leaves out a symbol
+of the line after every that many symbols. Frames between a slip and
+the sync word that catches it can't be right, they are reported but
+don't fail the benchmark.
+
+With -sps the signal has that many samples per symbol and the decoder
+recovers the symbol clock (rec_timing), -ppm offsets the symbol clock of
+the signal. The kernels before the decoder always cut
+REC_DOWN_SAMPLING_RATE samples per symbol, only their timing counts then.
+
+usage: rec_bench [-n block samples] [-b blocks] [-r repeats] [-noise rms] [-drift counts] [-sps samples per symbol] [-ppm clock offset] [-sync frames] [-slip symbols] [-seed n] [-cpu core] [-k kernel] [-nowrite]
+**************************************************************************
+*/
+
+
+
+// ----- standard c include files -----
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// ----- decoding chain -----
+#include "rec_bits.h"
+#include "rec_codec.h"
+#include "rec_cpu.h"
+#include "rec_mem.h"
+#include "rec_decoder.h"
+#include "rec_slicer.h"
+#include "rec_simd.h"
+#include "rec_siggen.h"
+#include "rec_writer.h"
+
+
+// ----- global setup for the run -----
+uint32_t    g_dwBlockSamples = 1024 * 1024;
+uint32_t    g_dwBlocks = 16;
+int32_t     g_lRepeats = 5;
+int32_t     g_lCpu = -1;
+double      g_dSamplesPerSymbol = 0;
+uint32_t    g_dwSyncInterval = 0;
+bool        g_bWriteFiles = true;
+const char* g_szKernel = NULL;
+
+#define BENCH_PREFIX "bench_"
+
+
+
+/*
+**************************************************************************
+Benchmark data: the signal and the intermediate results of all blocks
+**************************************************************************
+*/
+
+struct ST_BENCHDATA
+{
+	ST_SIGGEN       stGen;
+	int16_t*        pnSamples;          // g_dwBlocks * g_dwBlockSamples
+	uint32_t        dwSymbols;          // per block
+	uint32_t        dwWords;            // packed words per block
+	uint64_t*       pqwBits;            // packed symbols of all blocks
+	int32_t*        plSums;
+	uint8_t*        pbyStreams;
+	uint32_t        dwStreamCap;
+	uint8_t*        apbyStream[REC_STREAM_NUM];
+	uint32_t        dwStreamLen;        // of block 1, input of the writer
+	uint8_t*        pbyNeural;          // REC_STREAM_NUM streams of dwStreamLen, input of the codec
+	uint8_t*        pbyCoded;
+	uint64_t        qwCodedLen;         // of the last codec run
+	volatile double dSink;              // keeps results alive
+};
+
+static double dGetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+/*
+**************************************************************************
+Kernels: each runs over all blocks and returns false on error
+**************************************************************************
+*/
+
+static bool bKernelAverage(ST_BENCHDATA* pstBench)
+{
+	double dSum = 0;
+	for (uint32_t b = 0; b < g_dwBlocks; b++)
+		dSum += average(pstBench->pnSamples + (size_t)b * g_dwBlockSamples, (int)g_dwBlockSamples);
+	pstBench->dSink = dSum;
+	return true;
+}
+
+static bool bKernelSums(ST_BENCHDATA* pstBench)
+{
+	for (uint32_t b = 0; b < g_dwBlocks; b++)
+		vSlicerSymbolSums(pstBench->pnSamples + (size_t)b * g_dwBlockSamples, pstBench->plSums, pstBench->dwSymbols);
+	pstBench->dSink = pstBench->plSums[pstBench->dwSymbols - 1];
+	return true;
+}
+
+static bool bKernelSlicer(ST_BENCHDATA* pstBench)
+{
+	for (uint32_t b = 0; b < g_dwBlocks; b++)
+	{
+		ST_SLICERINPUT stInput;
+		stInput.pnStitch = NULL;
+		stInput.dwStitchSymbols = 0;
+		stInput.pnBody = pstBench->pnSamples + (size_t)b * g_dwBlockSamples;
+		stInput.plSums = NULL;
+		vSlicerDo(&stInput, pstBench->dwSymbols, g_dwBlockSamples, pstBench->pqwBits + (size_t)b * pstBench->dwWords);
+	}
+	return true;
+}
+
+static bool bKernelTrack(ST_BENCHDATA* pstBench)
+{
+	ST_THRESHOLD stThreshold;
+	bThresholdInit(&stThreshold, REC_THRESHOLD_TRACK);
+	for (uint32_t b = 0; b < g_dwBlocks; b++)
+	{
+		ST_SLICERINPUT stInput;
+		stInput.pnStitch = NULL;
+		stInput.dwStitchSymbols = 0;
+		stInput.pnBody = pstBench->pnSamples + (size_t)b * g_dwBlockSamples;
+		stInput.plSums = NULL;
+		vSlicerTrack(&stInput, pstBench->dwSymbols, &stThreshold, pstBench->pqwBits + (size_t)b * pstBench->dwWords);
+	}
+	return true;
+}
+
+static bool bKernelTiming(ST_BENCHDATA* pstBench)
+{
+	ST_TIMING stTiming;
+	uint32_t dwSymbols = 0;
+	bTimingInit(&stTiming, REC_TIMING_TRACK, pstBench->stGen.stSetup.dSamplesPerSymbol);
+	for (uint32_t b = 0; b < g_dwBlocks; b++)
+		dwSymbols += dwTimingDo(&stTiming, pstBench->pnSamples + (size_t)b * g_dwBlockSamples, g_dwBlockSamples, pstBench->plSums);
+	pstBench->dSink = dwSymbols;
+	return true;
+}
+
+static bool bKernelPreamble(ST_BENCHDATA* pstBench)
+{
+	ST_PREAMBLE stPreamble;
+	int64_t llFound = 0;
+	if (!bPreambleInit(&stPreamble, REC_PREAMBLE_DEFAULT, 0))
+		return false;
+
+	// block 0 holds the preamble, the others are scanned to the end
+	for (uint32_t b = 1; b < g_dwBlocks; b++)
+	{
+		vPreambleReset(&stPreamble);
+		llFound += llPreambleSearch(&stPreamble, pstBench->pqwBits + (size_t)b * pstBench->dwWords, pstBench->dwSymbols);
+	}
+	pstBench->dSink = (double)llFound;
+	return true;
+}
+
+static bool bKernelDemux(ST_BENCHDATA* pstBench)
+{
+	ST_DEMUX stDemux;
+	vDemuxReset(&stDemux);
+	for (uint32_t b = 1; b < g_dwBlocks; b++)
+		pstBench->dwStreamLen = dwDemuxDo(&stDemux, pstBench->pqwBits + (size_t)b * pstBench->dwWords, 0, pstBench->dwSymbols, pstBench->pbyStreams, pstBench->dwStreamCap);
+	return true;
+}
+
+static bool bKernelWriter(ST_BENCHDATA* pstBench)
+{
+	ST_STREAMWRITER stWriter;
+	if (!bStreamWriterOpen(&stWriter, false, BENCH_PREFIX))
+		return false;
+
+	bool bOk = true;
+	for (uint32_t b = 0; bOk && b < g_dwBlocks; b++)
+		bOk = bStreamWriterAppend(&stWriter, pstBench->apbyStream, pstBench->dwStreamLen, 0);
+	bOk = bOk && bStreamWriterFlush(&stWriter);
+	vStreamWriterClose(&stWriter);
+	return bOk;
+}
+
+// ----- stream bytes of a decoded frame that differ from generator frame qwFrame -----
+static uint32_t dwFrameErrors(const ST_BENCHDATA* pstBench, const ST_DECODER* pstDecoder, uint32_t dwIdx, uint64_t qwFrame)
+{
+	uint32_t dwErrors = 0;
+	for (int32_t s = 0; s < REC_STREAM_NUM; s++)
+		if (pstDecoder->apbyStream[s][dwIdx] != bySigGenStreamByte(pstBench->stGen.stSetup.qwSeed, qwFrame, s))
+			dwErrors++;
+	return dwErrors;
+}
+
+// ----- decoder over all blocks, checks the streams against the generator if pqwFrames is set;
+// ----- after a resync the generator frames left out by the lock count as dropped
+static bool bRunDecoder(ST_BENCHDATA* pstBench, bool bWrite, uint64_t* pqwFrames, uint64_t* pqwErrors, uint64_t* pqwDropped = NULL, ST_LOCK* pstLock = NULL)
+{
+	ST_DECODER stDecoder;
+	ST_STREAMWRITER stWriter;
+	const uint64_t qwMaxDrop = 4 * (uint64_t)(g_dwSyncInterval + 1) * (REC_LOCK_MAX_MISSES + 2);
+	uint64_t qwNext = 0;
+	bool bOk = bDecoderInit(&stDecoder, g_dwBlockSamples);
+
+	if (bOk && g_dSamplesPerSymbol > 0)
+		bOk = bDecoderSetTiming(&stDecoder, REC_TIMING_TRACK, g_dSamplesPerSymbol);
+	if (bOk && g_dwSyncInterval)
+		bOk = bDecoderSetLock(&stDecoder, g_dwSyncInterval);
+
+	if (bOk && bWrite)
+		bOk = bStreamWriterOpen(&stWriter, false, BENCH_PREFIX);
+	for (uint32_t b = 0; bOk && b < g_dwBlocks; b++)
+	{
+		bOk = bDecoderDo(&stDecoder, pstBench->pnSamples + (size_t)b * g_dwBlockSamples, g_dwBlockSamples);
+		if (bOk && bWrite && stDecoder.dwStreamLen)
+			bOk = bStreamWriterAppend(&stWriter, stDecoder.apbyStream, stDecoder.dwStreamLen, 0);
+
+		if (pqwFrames)
+		{
+			for (uint32_t f = 0; f < stDecoder.dwStreamLen; f++, qwNext++)
+			{
+				uint32_t dwErrors = dwFrameErrors(pstBench, &stDecoder, f, qwNext);
+				for (uint64_t d = 1; dwErrors && pqwDropped && d <= qwMaxDrop; d++)
+					if (dwFrameErrors(pstBench, &stDecoder, f, qwNext + d) == 0)
+					{
+						*pqwDropped += d;
+						qwNext += d;
+						dwErrors = 0;
+					}
+				*pqwErrors += dwErrors;
+			}
+			*pqwFrames += stDecoder.dwStreamLen;
+		}
+	}
+	if (pstLock)
+		*pstLock = stDecoder.stLock;
+	if (bWrite)
+	{
+		bOk = bOk && bStreamWriterFlush(&stWriter);
+		vStreamWriterClose(&stWriter);
+	}
+	vDecoderClose(&stDecoder);
+	return bOk;
+}
+
+static bool bKernelCodec(ST_BENCHDATA* pstBench)
+{
+	uint64_t qwCoded = 0;
+	for (uint32_t b = 1; b < g_dwBlocks; b++)
+		for (uint32_t s = 0; s < REC_STREAM_NUM; s++)
+			qwCoded += dwCodecEncode(pstBench->pbyNeural + (size_t)s * pstBench->dwStreamLen, pstBench->dwStreamLen, pstBench->pbyCoded);
+	pstBench->qwCodedLen = qwCoded;
+	return true;
+}
+
+static bool bKernelDecoder(ST_BENCHDATA* pstBench)
+{
+	return bRunDecoder(pstBench, false, NULL, NULL);
+}
+
+static bool bKernelChain(ST_BENCHDATA* pstBench)
+{
+	return bRunDecoder(pstBench, g_bWriteFiles, NULL, NULL);
+}
+
+
+struct ST_KERNEL
+{
+	const char* szName;
+	bool        (*bRun) (ST_BENCHDATA*);
+	bool        bAllBlocks;     // false: block 0 is skipped
+	bool        bWrites;
+};
+
+static const ST_KERNEL s_astKernel[] =
+{
+	{ "average",    bKernelAverage,     true,   false },
+	{ "sums",       bKernelSums,        true,   false },
+	{ "slicer",     bKernelSlicer,      true,   false },
+	{ "track",      bKernelTrack,       true,   false },
+	{ "timing",     bKernelTiming,      true,   false },
+	{ "preamble",   bKernelPreamble,    false,  false },
+	{ "demux",      bKernelDemux,       false,  false },
+	{ "writer",     bKernelWriter,      true,   true },
+	{ "codec",      bKernelCodec,       false,  false },
+	{ "decoder",    bKernelDecoder,     true,   false },
+	{ "chain",      bKernelChain,       true,   false },
+};
+
+
+
+/*
+**************************************************************************
+bBenchKernel: best and median of g_lRepeats runs
+**************************************************************************
+*/
+
+static bool bBenchKernel(ST_BENCHDATA* pstBench, const ST_KERNEL* pstKernel)
+{
+	std::vector<double> adTime;
+	double dSamples = (double)g_dwBlockSamples * (pstKernel->bAllBlocks ? g_dwBlocks : g_dwBlocks - 1);
+
+	// one run to warm up the caches and the page tables
+	if (!pstKernel->bRun(pstBench))
+	{
+		printf("%-10s failed\n", pstKernel->szName);
+		return false;
+	}
+	for (int32_t r = 0; r < g_lRepeats; r++)
+	{
+		double dStart = dGetTime();
+		pstKernel->bRun(pstBench);
+		adTime.push_back(dGetTime() - dStart);
+	}
+	std::sort(adTime.begin(), adTime.end());
+
+	double dBest = adTime.front();
+	double dMedian = adTime[adTime.size() / 2];
+	printf("%-10s %9.3lf %9.3lf   %8.2lf %8.2lf   %9.1lf\n", pstKernel->szName,
+		dBest / dSamples * 1.0e9, dMedian / dSamples * 1.0e9,
+		dSamples * sizeof(int16_t) / dBest / 1.0e9, dSamples * sizeof(int16_t) / dMedian / 1.0e9,
+		dSamples / dBest / 1.0e6);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+main
+**************************************************************************
+*/
+
+int main(int argc, char** argv)
+{
+	ST_SIGGENSETUP  stSetup;
+	ST_BENCHDATA    stBench;
+
+	vSigGenDefaultSetup(&stSetup);
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			g_dwBlockSamples = (uint32_t)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-b") && (i + 1 < argc))
+			g_dwBlocks = (uint32_t)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+			g_lRepeats = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-noise") && (i + 1 < argc))
+			stSetup.dNoise = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-drift") && (i + 1 < argc))
+			stSetup.dDriftAmplitude = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-sps") && (i + 1 < argc))
+			g_dSamplesPerSymbol = stSetup.dSamplesPerSymbol = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-ppm") && (i + 1 < argc))
+			stSetup.dClockPpm = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-sync") && (i + 1 < argc))
+			g_dwSyncInterval = stSetup.dwSyncInterval = (uint32_t)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-slip") && (i + 1 < argc))
+			stSetup.dwSlipPeriod = (uint32_t)atof(argv[++i]);
+		else if (!strcmp(argv[i], "-seed") && (i + 1 < argc))
+			stSetup.qwSeed = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-cpu") && (i + 1 < argc))
+			g_lCpu = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-k") && (i + 1 < argc))
+			g_szKernel = argv[++i];
+		else if (!strcmp(argv[i], "-nowrite"))
+			g_bWriteFiles = false;
+		else
+		{
+			printf("usage: %s [-n block samples] [-b blocks] [-r repeats] [-noise rms] [-drift counts] [-sps samples per symbol] [-ppm clock offset] [-sync frames] [-slip symbols] [-seed n] [-cpu core] [-k kernel] [-nowrite]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// the preamble has to be in block 0, the other blocks have frames only
+	uint32_t dwPreambleEnd = (uint32_t)((stSetup.dwLeadSymbols + strlen(stSetup.szPreamble)) * stSetup.dSamplesPerSymbol);
+	if (g_dwBlocks < 2 || g_lRepeats < 1 || g_dwBlockSamples <= dwPreambleEnd + REC_LOOKING_WINDOW_SIZE * REC_DOWN_SAMPLING_RATE)
+	{
+		printf("Need 2 or more blocks of more than %u samples and 1 or more repeats\n", dwPreambleEnd + REC_LOOKING_WINDOW_SIZE * REC_DOWN_SAMPLING_RATE);
+		return 1;
+	}
+	if (g_lCpu >= 0)
+	{
+		ST_CPUSET stCpus = { g_lCpu, 1, REC_NODE_ANY, false, false };
+		if (!bRecPinThread(&stCpus, 0))
+			printf("Can't pin to core %d\n", g_lCpu);
+	}
+
+	// signal and buffers, none of it is timed
+	memset(&stBench, 0, sizeof(stBench));
+	size_t dwTotal = (size_t)g_dwBlocks * g_dwBlockSamples;
+	stBench.dwSymbols = g_dwBlockSamples / REC_DOWN_SAMPLING_RATE;
+	stBench.dwWords = REC_BITS_WORDS(stBench.dwSymbols);
+	stBench.dwStreamCap = dwDecoderMaxStreamLen(g_dwBlockSamples);
+	stBench.pnSamples = (int16_t*)pvRecAlignedAlloc(dwTotal * sizeof(int16_t));
+	stBench.pqwBits = (uint64_t*)pvRecAlignedAlloc((size_t)g_dwBlocks * stBench.dwWords * sizeof(uint64_t));
+	ST_TIMING stTiming;
+	uint32_t dwMaxSums = bTimingInit(&stTiming, REC_TIMING_TRACK, stSetup.dSamplesPerSymbol) ? dwTimingMaxSymbols(&stTiming, g_dwBlockSamples) : 0;
+	stBench.plSums = (int32_t*)pvRecAlignedAlloc((size_t)((dwMaxSums > stBench.dwSymbols) ? dwMaxSums : stBench.dwSymbols) * sizeof(int32_t));
+	stBench.pbyStreams = (uint8_t*)pvRecAlignedAlloc((size_t)REC_STREAM_NUM * stBench.dwStreamCap);
+	if (!stBench.pnSamples || !stBench.pqwBits || !stBench.plSums || !stBench.pbyStreams || !bSigGenInit(&stBench.stGen, &stSetup))
+	{
+		printf("Can't allocate %.1lf MByte for the signal or invalid setup\n", (double)dwTotal * sizeof(int16_t) / (1024 * 1024));
+		return 1;
+	}
+	for (int32_t s = 0; s < REC_STREAM_NUM; s++)
+		stBench.apbyStream[s] = stBench.pbyStreams + (size_t)s * stBench.dwStreamCap;
+	for (uint32_t b = 0; b < g_dwBlocks; b++)
+		vSigGenDo(&stBench.stGen, stBench.pnSamples + (size_t)b * g_dwBlockSamples, g_dwBlockSamples);
+
+	// inputs of preamble, demux and writer
+	bKernelSlicer(&stBench);
+	bKernelDemux(&stBench);
+
+	// input of the codec: a slow wander of the level with +-1 count of noise, as a quiet electrode
+	stBench.pbyNeural = (uint8_t*)malloc((size_t)REC_STREAM_NUM * stBench.dwStreamLen + 1);
+	stBench.pbyCoded = (uint8_t*)malloc(dwCodecBound(stBench.dwStreamLen));
+	if (!stBench.pbyNeural || !stBench.pbyCoded)
+	{
+		printf("Can't allocate the codec streams\n");
+		return 1;
+	}
+	uint64_t qwRandom = stSetup.qwSeed | 1;
+	for (uint32_t s = 0; s < REC_STREAM_NUM; s++)
+	{
+		double dLevel = 128;
+		for (uint32_t i = 0; i < stBench.dwStreamLen; i++)
+		{
+			qwRandom = qwRandom * 6364136223846793005ULL + 1442695040888963407ULL;
+			dLevel += (int32_t)((qwRandom >> 33) % 3) - 1 + (128 - dLevel) / 256;
+			stBench.pbyNeural[(size_t)s * stBench.dwStreamLen + i] = (uint8_t)(dLevel + (int32_t)((qwRandom >> 40) % 3) - 1);
+		}
+	}
+
+	printf("%u blocks of %u samples, seed %llu, noise %.0lf, drift %.0lf, %s kernels, %d repeats\n\n",
+		g_dwBlocks, g_dwBlockSamples, (unsigned long long)stSetup.qwSeed, stSetup.dNoise, stSetup.dDriftAmplitude, REC_SIMD_NAME, g_lRepeats);
+	printf("kernel      ns/sample (best/median)   GB/s (best/median)   MS/s best\n");
+	printf("----------------------------------------------------------------------\n");
+
+	int nResult = 0;
+	for (size_t k = 0; k < sizeof(s_astKernel) / sizeof(s_astKernel[0]); k++)
+	{
+		const ST_KERNEL* pstKernel = &s_astKernel[k];
+		if (g_szKernel && strcmp(g_szKernel, pstKernel->szName))
+			continue;
+		if (pstKernel->bWrites && !g_bWriteFiles)
+			continue;
+		if (!bBenchKernel(&stBench, pstKernel))
+			nResult = 1;
+	}
+
+	// the decoded streams have to be the ones of the generator, with left out symbols up to the next sync word
+	uint64_t qwFrames = 0, qwErrors = 0, qwDropped = 0;
+	ST_LOCK stLock;
+	bool bDecoded = bRunDecoder(&stBench, false, &qwFrames, &qwErrors, &qwDropped, &stLock);
+	if (g_dwSyncInterval)
+		printf("\nFrame lock: %llu sync words checked, %llu resyncs, %llu losses, %llu frames dropped\n",
+			(unsigned long long)stLock.qwChecks, (unsigned long long)stLock.qwResyncs, (unsigned long long)stLock.qwLosses, (unsigned long long)qwDropped);
+	if (!bDecoded || qwFrames == 0 || (qwErrors && !stSetup.dwSlipPeriod))
+	{
+		printf("\nDecoded streams: %llu frames, %llu bytes differ from the generator\n", (unsigned long long)qwFrames, (unsigned long long)qwErrors);
+		nResult = 1;
+	}
+	else if (qwErrors)
+		printf("\nDecoded streams: %llu frames, %llu bytes differ from the generator after the slips\n", (unsigned long long)qwFrames, (unsigned long long)qwErrors);
+	else
+		printf("\nDecoded streams: %llu frames, all match the generator\n", (unsigned long long)qwFrames);
+
+	// the codec has to give back what it got
+	if (!g_szKernel || !strcmp(g_szKernel, "codec"))
+	{
+		uint8_t* pbyCheck = (uint8_t*)malloc(stBench.dwStreamLen + 1);
+		uint32_t dwRandomCoded = dwCodecEncode(stBench.apbyStream[0], stBench.dwStreamLen, stBench.pbyCoded);
+		uint32_t dwCoded = dwCodecEncode(stBench.pbyNeural, stBench.dwStreamLen, stBench.pbyCoded);
+		bool bSame = pbyCheck && bCodecDecode(stBench.pbyCoded, dwCoded, pbyCheck, stBench.dwStreamLen) && !memcmp(pbyCheck, stBench.pbyNeural, stBench.dwStreamLen);
+		printf("\nStream codec: %.2lf x smaller on the neural like streams, %.2lf x on the generator streams, decode %s\n",
+			stBench.qwCodedLen ? (double)REC_STREAM_NUM * stBench.dwStreamLen * (g_dwBlocks - 1) / stBench.qwCodedLen : 0.0,
+			dwRandomCoded ? (double)stBench.dwStreamLen / dwRandomCoded : 0.0, bSame ? "ok" : "FAILED");
+		if (!bSame)
+			nResult = 1;
+		free(pbyCheck);
+	}
+
+	// the window slicer has to decide as the original double precision slicer
+	if (!g_szKernel || !strcmp(g_szKernel, "slicer"))
+	{
+		int16_t* pnRef = (int16_t*)malloc((size_t)stBench.dwSymbols * sizeof(int16_t));
+		uint64_t qwDiffer = 0;
+		uint32_t dwSkipped = 0;
+		for (uint32_t b = 0; pnRef && b < g_dwBlocks; b++)
+		{
+			uint32_t dwDiffer;
+			if (bSlicerCompare(stBench.pnSamples + (size_t)b * g_dwBlockSamples, stBench.dwSymbols, g_dwBlockSamples, pnRef, stBench.pqwBits, &dwDiffer))
+				qwDiffer += dwDiffer;
+			else
+				dwSkipped++;
+		}
+		if (!pnRef || qwDiffer)
+		{
+			printf("\nWindow slicer: %llu of %llu symbols differ from the reference slicer\n", (unsigned long long)qwDiffer, (unsigned long long)g_dwBlocks * stBench.dwSymbols);
+			nResult = 1;
+		}
+		else if (dwSkipped)
+			printf("\nWindow slicer: not compared, blocks of %u symbols are shorter than a threshold window of %d\n", stBench.dwSymbols, REC_LOOKING_WINDOW_SIZE);
+		else
+			printf("\nWindow slicer: %llu symbols, all match the reference slicer\n", (unsigned long long)g_dwBlocks * stBench.dwSymbols);
+		free(pnRef);
+	}
+
+	// the benchmark files are of no use
+	for (int32_t s = 0; s < REC_STREAM_NUM; s++)
+	{
+		char szName[64];
+		strcpy(szName, BENCH_PREFIX);
+		pszDecoderStreamName(s, szName + strlen(BENCH_PREFIX), (int32_t)(sizeof(szName) - strlen(BENCH_PREFIX)));
+		remove(szName);
+	}
+
+	vRecAlignedFree(stBench.pnSamples);
+	vRecAlignedFree(stBench.pqwBits);
+	vRecAlignedFree(stBench.plSums);
+	vRecAlignedFree(stBench.pbyStreams);
+	free(stBench.pbyNeural);
+	free(stBench.pbyCoded);
+	return nResult;
+}
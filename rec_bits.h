@@ -0,0 +1,102 @@
+/*
+**************************************************************************
+
+rec_bits.h
+
+**************************************************************************
+
+Helpers for the packed symbol stream: symbol i is bit (i % 64) of word
+i / 64. Streams are always allocated with one word more than they need,
+so a 64 bit read at any symbol position can touch the following word.
+**************************************************************************
+*/
+
+#ifndef REC_BITS_H
+#define REC_BITS_H
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+// ----- words for a stream of dwBits symbols, including the padding word -----
+#define REC_BITS_WORDS(dwBits) (((dwBits) + 63) / 64 + 1)
+
+
+// ----- 64 symbols starting at llPos -----
+static inline uint64_t qwGetBits(const uint64_t* pqwBits, int64_t llPos)
+{
+	int64_t llWord = llPos >> 6;
+	int32_t lShift = (int32_t)(llPos & 63);
+	if (lShift == 0)
+		return pqwBits[llWord];
+	return (pqwBits[llWord] >> lShift) | (pqwBits[llWord + 1] << (64 - lShift));
+}
+
+static inline uint32_t dwGetBit(const uint64_t* pqwBits, int64_t llPos)
+{
+	return (uint32_t)(pqwBits[llPos >> 6] >> (llPos & 63)) & 1;
+}
+
+static inline void vSetBit(uint64_t* pqwBits, int64_t llPos, uint32_t dwBit)
+{
+	if (dwBit)
+		pqwBits[llPos >> 6] |= 1ULL << (llPos & 63);
+	else
+		pqwBits[llPos >> 6] &= ~(1ULL << (llPos & 63));
+}
+
+// ----- ORs llBits symbols of the source to the (cleared) destination -----
+static inline void vAppendBits(uint64_t* pqwDst, int64_t llDstPos, const uint64_t* pqwSrc, int64_t llSrcPos, int64_t llBits)
+{
+	while (llBits > 0)
+	{
+		int32_t lCount = (llBits < 64) ? (int32_t)llBits : 64;
+		uint64_t qwValue = qwGetBits(pqwSrc, llSrcPos);
+		if (lCount < 64)
+			qwValue &= (1ULL << lCount) - 1;
+
+		int32_t lShift = (int32_t)(llDstPos & 63);
+		pqwDst[llDstPos >> 6] |= qwValue << lShift;
+		if (lShift && (lShift + lCount > 64))
+			pqwDst[(llDstPos >> 6) + 1] |= qwValue >> (64 - lShift);
+
+		llDstPos += lCount;
+		llSrcPos += lCount;
+		llBits -= lCount;
+	}
+}
+
+static inline int32_t lLowestBit(uint64_t qwValue)
+{
+#if defined(_MSC_VER)
+	unsigned long dwIdx;
+	_BitScanForward64(&dwIdx, qwValue);
+	return (int32_t)dwIdx;
+#else
+	return __builtin_ctzll(qwValue);
+#endif
+}
+
+static inline int32_t lHighestBit(uint64_t qwValue)
+{
+#if defined(_MSC_VER)
+	unsigned long dwIdx;
+	_BitScanReverse64(&dwIdx, qwValue);
+	return (int32_t)dwIdx;
+#else
+	return 63 - __builtin_clzll(qwValue);
+#endif
+}
+
+static inline int32_t lBitCount(uint64_t qwValue)
+{
+#if defined(_MSC_VER)
+	return (int32_t)__popcnt64(qwValue);
+#else
+	return __builtin_popcountll(qwValue);
+#endif
+}
+
+#endif
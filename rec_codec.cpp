@@ -0,0 +1,443 @@
+/*
+**************************************************************************
+
+rec_codec.cpp
+
+**************************************************************************
+
+Lossless codecs of the decoded streams and the raw samples, see rec_codec.h
+
+**************************************************************************
+*/
+
+#include <string.h>
+
+#include "rec_bits.h"
+#include "rec_codec.h"
+
+#define HEADER_BITS     5
+#define PREDICTORS      2
+#define SAMPLE_HEADER   7
+#define ORDERS          4
+#define LITERAL_BITS    20
+
+
+
+/*
+**************************************************************************
+Bit writer and reader, LSB first
+**************************************************************************
+*/
+
+struct ST_BITWRITER
+{
+	uint8_t*    pbyOut;
+	uint64_t    qwAcc;
+	int32_t     lFill;
+};
+
+// ----- up to 32 bits, the accumulator goes out in 32 bit pieces -----
+static inline void vPutBits(ST_BITWRITER* pstWriter, uint32_t dwValue, int32_t lBits)
+{
+	pstWriter->qwAcc |= (uint64_t)dwValue << pstWriter->lFill;
+	pstWriter->lFill += lBits;
+	if (pstWriter->lFill >= 32)
+	{
+		uint32_t dwWord = (uint32_t)pstWriter->qwAcc;
+		memcpy(pstWriter->pbyOut, &dwWord, sizeof(dwWord));
+		pstWriter->pbyOut += sizeof(dwWord);
+		pstWriter->qwAcc >>= 32;
+		pstWriter->lFill -= 32;
+	}
+}
+
+// ----- rest of the accumulator, the last byte padded with zeros -----
+static inline void vFlushBits(ST_BITWRITER* pstWriter)
+{
+	for (; pstWriter->lFill > 0; pstWriter->lFill -= 8)
+	{
+		*pstWriter->pbyOut++ = (uint8_t)pstWriter->qwAcc;
+		pstWriter->qwAcc >>= 8;
+	}
+	pstWriter->lFill = 0;
+}
+
+struct ST_BITREADER
+{
+	const uint8_t*  pbyIn;
+	const uint8_t*  pbyEnd;
+	uint64_t        qwAcc;
+	int32_t         lFill;
+	int32_t         lPad;       // zero bits behind the end of the data, the top ones of qwAcc
+};
+
+static inline void vRefill(ST_BITREADER* pstReader)
+{
+	while (pstReader->lFill <= 56)
+	{
+		if (pstReader->pbyIn < pstReader->pbyEnd)
+			pstReader->qwAcc |= (uint64_t)*pstReader->pbyIn++ << pstReader->lFill;
+		else
+			pstReader->lPad += 8;
+		pstReader->lFill += 8;
+	}
+}
+
+static inline uint32_t dwGetBits(ST_BITREADER* pstReader, int32_t lBits)
+{
+	uint32_t dwValue = (uint32_t)(pstReader->qwAcc & ((1ULL << lBits) - 1));
+	pstReader->qwAcc >>= lBits;
+	pstReader->lFill -= lBits;
+	return dwValue;
+}
+
+
+
+/*
+**************************************************************************
+Prediction: residual of a byte as zigzag code 0 .. 255
+**************************************************************************
+*/
+
+static inline uint8_t byPredict(int32_t lPredictor, uint8_t byLast, uint8_t byBefore)
+{
+	return lPredictor ? (uint8_t)(2 * byLast - byBefore) : byLast;
+}
+
+static inline uint32_t dwZigZag(uint8_t byValue, uint8_t byPrediction)
+{
+	int32_t lResidual = (int8_t)(uint8_t)(byValue - byPrediction);
+	return (((uint32_t)lResidual << 1) ^ (uint32_t)(lResidual >> 31)) & 0xff;
+}
+
+static inline uint8_t byUnZigZag(uint32_t dwCode, uint8_t byPrediction)
+{
+	int32_t lResidual = (int32_t)(dwCode >> 1) ^ -(int32_t)(dwCode & 1);
+	return (uint8_t)(byPrediction + lResidual);
+}
+
+
+
+/*
+**************************************************************************
+dwCodecBound
+**************************************************************************
+*/
+
+uint32_t dwCodecBound(uint32_t dwLen)
+{
+	uint32_t dwBlocks = (dwLen + REC_CODEC_BLOCK - 1) / REC_CODEC_BLOCK;
+	return dwLen + (dwBlocks * HEADER_BITS + 7) / 8 + 8;
+}
+
+
+
+/*
+**************************************************************************
+dwCodecEncode: residuals of both predictors, the bits of every k are
+added up, the cheapest coding of the block is written
+**************************************************************************
+*/
+
+uint32_t dwCodecEncode(const uint8_t* pbySrc, uint32_t dwLen, uint8_t* pbyDst)
+{
+	ST_BITWRITER stWriter = { pbyDst, 0, 0 };
+	uint8_t byLast = REC_CODEC_START, byBefore = REC_CODEC_START;
+
+	for (uint32_t dwPos = 0; dwPos < dwLen; dwPos += REC_CODEC_BLOCK)
+	{
+		uint32_t dwCount = (dwLen - dwPos < REC_CODEC_BLOCK) ? dwLen - dwPos : REC_CODEC_BLOCK;
+		const uint8_t* pbyBlock = pbySrc + dwPos;
+		uint8_t aabyCode[PREDICTORS][REC_CODEC_BLOCK];
+
+		// bits of the block for every predictor and k, literals as reference
+		int32_t lBestBits = 8 * (int32_t)dwCount, lBestPredictor = 0, lBestK = REC_CODEC_RAW_K;
+		for (int32_t p = 0; p < PREDICTORS; p++)
+		{
+			uint8_t byL = byLast, byB = byBefore;
+			int32_t alBits[REC_CODEC_RAW_K] = { 0 };
+			for (uint32_t i = 0; i < dwCount; i++)
+			{
+				uint32_t dwCode = dwZigZag(pbyBlock[i], byPredict(p, byL, byB));
+				aabyCode[p][i] = (uint8_t)dwCode;
+				byB = byL;
+				byL = pbyBlock[i];
+				for (int32_t k = 0; k < REC_CODEC_RAW_K; k++)
+				{
+					uint32_t dwQ = dwCode >> k;
+					alBits[k] += (dwQ < REC_CODEC_ESCAPE) ? (int32_t)dwQ + 1 + k : REC_CODEC_ESCAPE + 8;
+				}
+			}
+			for (int32_t k = 0; k < REC_CODEC_RAW_K; k++)
+				if (alBits[k] < lBestBits)
+				{
+					lBestBits = alBits[k];
+					lBestPredictor = p;
+					lBestK = k;
+				}
+		}
+
+		vPutBits(&stWriter, (uint32_t)(lBestPredictor | (lBestK << 1)), HEADER_BITS);
+		if (lBestK == REC_CODEC_RAW_K)
+			for (uint32_t i = 0; i < dwCount; i++)
+				vPutBits(&stWriter, pbyBlock[i], 8);
+		else
+			for (uint32_t i = 0; i < dwCount; i++)
+			{
+				uint32_t dwCode = aabyCode[lBestPredictor][i];
+				uint32_t dwQ = dwCode >> lBestK;
+				if (dwQ < REC_CODEC_ESCAPE)
+					vPutBits(&stWriter, ((1u << dwQ) - 1) | ((dwCode & ((1u << lBestK) - 1)) << (dwQ + 1)), (int32_t)dwQ + 1 + lBestK);
+				else
+					vPutBits(&stWriter, ((1u << REC_CODEC_ESCAPE) - 1) | (dwCode << REC_CODEC_ESCAPE), REC_CODEC_ESCAPE + 8);
+			}
+
+		byBefore = (dwCount > 1) ? pbyBlock[dwCount - 2] : byLast;
+		byLast = pbyBlock[dwCount - 1];
+	}
+
+	vFlushBits(&stWriter);
+	return (uint32_t)(stWriter.pbyOut - pbyDst);
+}
+
+
+
+/*
+**************************************************************************
+bCodecDecode
+**************************************************************************
+*/
+
+bool bCodecDecode(const uint8_t* pbySrc, uint32_t dwSrcLen, uint8_t* pbyDst, uint32_t dwLen)
+{
+	ST_BITREADER stReader = { pbySrc, pbySrc + dwSrcLen, 0, 0, 0 };
+	uint8_t byLast = REC_CODEC_START, byBefore = REC_CODEC_START;
+
+	for (uint32_t dwPos = 0; dwPos < dwLen; dwPos += REC_CODEC_BLOCK)
+	{
+		uint32_t dwCount = (dwLen - dwPos < REC_CODEC_BLOCK) ? dwLen - dwPos : REC_CODEC_BLOCK;
+		uint8_t* pbyBlock = pbyDst + dwPos;
+
+		vRefill(&stReader);
+		uint32_t dwHeader = dwGetBits(&stReader, HEADER_BITS);
+		int32_t lPredictor = (int32_t)(dwHeader & 1);
+		int32_t lK = (int32_t)(dwHeader >> 1);
+		if (lK > REC_CODEC_RAW_K)
+			return false;
+
+		for (uint32_t i = 0; i < dwCount; i++)
+		{
+			vRefill(&stReader);
+			if (lK == REC_CODEC_RAW_K)
+				pbyBlock[i] = (uint8_t)dwGetBits(&stReader, 8);
+			else
+			{
+				int32_t lQ = lLowestBit(~stReader.qwAcc | (1ULL << REC_CODEC_ESCAPE));
+				uint32_t dwCode;
+				if (lQ >= REC_CODEC_ESCAPE)
+				{
+					dwGetBits(&stReader, REC_CODEC_ESCAPE);
+					dwCode = dwGetBits(&stReader, 8);
+				}
+				else
+				{
+					dwGetBits(&stReader, lQ + 1);
+					dwCode = ((uint32_t)lQ << lK) | (lK ? dwGetBits(&stReader, lK) : 0);
+				}
+				pbyBlock[i] = byUnZigZag(dwCode, byPredict(lPredictor, byLast, byBefore));
+			}
+			byBefore = byLast;
+			byLast = pbyBlock[i];
+		}
+		// bits taken from behind the end
+		if (stReader.lFill < stReader.lPad)
+			return false;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+Samples: fixed polynomial predictors of order 0 .. 3 of one channel
+**************************************************************************
+*/
+
+static inline int32_t lPredictSample(int32_t lOrder, int32_t l1, int32_t l2, int32_t l3)
+{
+	switch (lOrder)
+	{
+	case 0:  return 0;
+	case 1:  return l1;
+	case 2:  return 2 * l1 - l2;
+	default: return 3 * l1 - 3 * l2 + l3;
+	}
+}
+
+static inline int32_t lHistory(const int16_t* pnData, int64_t llIdx)
+{
+	return (llIdx >= 0) ? pnData[llIdx] : 0;
+}
+
+
+
+/*
+**************************************************************************
+dwCodecSampleBound
+**************************************************************************
+*/
+
+uint32_t dwCodecSampleBound(uint32_t dwSamples)
+{
+	uint32_t dwBlocks = (dwSamples + REC_CODEC_SAMPLE_BLOCK - 1) / REC_CODEC_SAMPLE_BLOCK;
+	return 2 * dwSamples + (dwBlocks * SAMPLE_HEADER + 7) / 8 + 8;
+}
+
+
+
+/*
+**************************************************************************
+dwCodecEncodeSamples: residuals of all orders, the one with the smallest
+sum is taken, k from its mean as FLAC does
+**************************************************************************
+*/
+
+uint32_t dwCodecEncodeSamples(const int16_t* pnSrc, uint32_t dwSamples, int32_t lChannels, uint8_t* pbyDst)
+{
+	ST_BITWRITER stWriter = { pbyDst, 0, 0 };
+	uint32_t aadwCode[ORDERS][REC_CODEC_SAMPLE_BLOCK];
+
+	for (uint32_t dwPos = 0; dwPos < dwSamples; dwPos += REC_CODEC_SAMPLE_BLOCK)
+	{
+		uint32_t dwCount = (dwSamples - dwPos < REC_CODEC_SAMPLE_BLOCK) ? dwSamples - dwPos : REC_CODEC_SAMPLE_BLOCK;
+		uint64_t aqwSum[ORDERS] = { 0 };
+
+		// the first samples of the buffer have no history, the rest without a branch
+		uint32_t dwFirst = 0;
+		for (; dwFirst < dwCount && dwPos + dwFirst < 3 * (uint32_t)lChannels; dwFirst++)
+		{
+			int64_t llIdx = dwPos + dwFirst;
+			int32_t l1 = lHistory(pnSrc, llIdx - lChannels), l2 = lHistory(pnSrc, llIdx - 2 * lChannels), l3 = lHistory(pnSrc, llIdx - 3 * lChannels);
+			for (int32_t o = 0; o < ORDERS; o++)
+			{
+				int32_t lResidual = pnSrc[llIdx] - lPredictSample(o, l1, l2, l3);
+				aadwCode[o][dwFirst] = ((uint32_t)lResidual << 1) ^ (uint32_t)(lResidual >> 31);
+				aqwSum[o] += aadwCode[o][dwFirst];
+			}
+		}
+		const int16_t* pnBlock = pnSrc + dwPos;
+		for (uint32_t i = dwFirst; i < dwCount; i++)
+		{
+			int32_t l0 = pnBlock[i], l1 = pnBlock[(int64_t)i - lChannels], l2 = pnBlock[(int64_t)i - 2 * lChannels], l3 = pnBlock[(int64_t)i - 3 * lChannels];
+			int32_t alResidual[ORDERS] = { l0, l0 - l1, l0 - 2 * l1 + l2, l0 - 3 * l1 + 3 * l2 - l3 };
+			for (int32_t o = 0; o < ORDERS; o++)
+			{
+				uint32_t dwCode = ((uint32_t)alResidual[o] << 1) ^ (uint32_t)(alResidual[o] >> 31);
+				aadwCode[o][i] = dwCode;
+				aqwSum[o] += dwCode;
+			}
+		}
+
+		int32_t lOrder = 0;
+		for (int32_t o = 1; o < ORDERS; o++)
+			if (aqwSum[o] < aqwSum[lOrder])
+				lOrder = o;
+		int32_t lK = 0;
+		while (lK < REC_CODEC_SAMPLE_MAX_K && ((uint64_t)dwCount << (lK + 1)) < aqwSum[lOrder])
+			lK++;
+
+		// exact size against literals
+		const uint32_t* pdwCode = aadwCode[lOrder];
+		uint64_t qwBits = 0;
+		for (uint32_t i = 0; i < dwCount; i++)
+		{
+			uint32_t dwQ = pdwCode[i] >> lK;
+			qwBits += (dwQ < REC_CODEC_SAMPLE_ESCAPE) ? dwQ + 1 + lK : REC_CODEC_SAMPLE_ESCAPE + LITERAL_BITS;
+		}
+		if (qwBits >= 16 * (uint64_t)dwCount)
+		{
+			vPutBits(&stWriter, (uint32_t)REC_CODEC_SAMPLE_RAW_K << 2, SAMPLE_HEADER);
+			for (uint32_t i = 0; i < dwCount; i++)
+				vPutBits(&stWriter, (uint16_t)pnBlock[i], 16);
+			continue;
+		}
+
+		vPutBits(&stWriter, (uint32_t)(lOrder | (lK << 2)), SAMPLE_HEADER);
+		for (uint32_t i = 0; i < dwCount; i++)
+		{
+			uint32_t dwQ = pdwCode[i] >> lK;
+			int32_t lBits = (int32_t)dwQ + 1 + lK;
+			if (dwQ < REC_CODEC_SAMPLE_ESCAPE && lBits <= 32)
+				vPutBits(&stWriter, ((1u << dwQ) - 1) | ((pdwCode[i] & ((1u << lK) - 1)) << (dwQ + 1)), lBits);
+			else if (dwQ < REC_CODEC_SAMPLE_ESCAPE)
+			{
+				vPutBits(&stWriter, (1u << dwQ) - 1, (int32_t)dwQ + 1);
+				vPutBits(&stWriter, pdwCode[i] & ((1u << lK) - 1), lK);
+			}
+			else
+			{
+				vPutBits(&stWriter, (1u << REC_CODEC_SAMPLE_ESCAPE) - 1, REC_CODEC_SAMPLE_ESCAPE);
+				vPutBits(&stWriter, pdwCode[i], LITERAL_BITS);
+			}
+		}
+	}
+
+	vFlushBits(&stWriter);
+	return (uint32_t)(stWriter.pbyOut - pbyDst);
+}
+
+
+
+/*
+**************************************************************************
+bCodecDecodeSamples
+**************************************************************************
+*/
+
+bool bCodecDecodeSamples(const uint8_t* pbySrc, uint32_t dwSrcLen, int16_t* pnDst, uint32_t dwSamples, int32_t lChannels)
+{
+	ST_BITREADER stReader = { pbySrc, pbySrc + dwSrcLen, 0, 0, 0 };
+
+	for (uint32_t dwPos = 0; dwPos < dwSamples; dwPos += REC_CODEC_SAMPLE_BLOCK)
+	{
+		uint32_t dwCount = (dwSamples - dwPos < REC_CODEC_SAMPLE_BLOCK) ? dwSamples - dwPos : REC_CODEC_SAMPLE_BLOCK;
+
+		vRefill(&stReader);
+		uint32_t dwHeader = dwGetBits(&stReader, SAMPLE_HEADER);
+		int32_t lOrder = (int32_t)(dwHeader & 3);
+		int32_t lK = (int32_t)(dwHeader >> 2);
+		if (lK > REC_CODEC_SAMPLE_MAX_K && lK != REC_CODEC_SAMPLE_RAW_K)
+			return false;
+
+		for (uint32_t i = 0; i < dwCount; i++)
+		{
+			int64_t llIdx = dwPos + i;
+			vRefill(&stReader);
+			if (lK == REC_CODEC_SAMPLE_RAW_K)
+			{
+				pnDst[llIdx] = (int16_t)dwGetBits(&stReader, 16);
+				continue;
+			}
+
+			int32_t lQ = lLowestBit(~stReader.qwAcc | (1ULL << REC_CODEC_SAMPLE_ESCAPE));
+			uint32_t dwCode;
+			if (lQ >= REC_CODEC_SAMPLE_ESCAPE)
+			{
+				dwGetBits(&stReader, REC_CODEC_SAMPLE_ESCAPE);
+				dwCode = dwGetBits(&stReader, LITERAL_BITS);
+			}
+			else
+			{
+				dwGetBits(&stReader, lQ + 1);
+				dwCode = ((uint32_t)lQ << lK) | (lK ? dwGetBits(&stReader, lK) : 0);
+			}
+			int32_t lResidual = (int32_t)(dwCode >> 1) ^ -(int32_t)(dwCode & 1);
+			int32_t lPrediction = lPredictSample(lOrder, lHistory(pnDst, llIdx - lChannels), lHistory(pnDst, llIdx - 2 * lChannels), lHistory(pnDst, llIdx - 3 * lChannels));
+			pnDst[llIdx] = (int16_t)(lPrediction + lResidual);
+		}
+		if (stReader.lFill < stReader.lPad)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,78 @@
+/*
+**************************************************************************
+
+rec_codec.h
+
+**************************************************************************
+
+Lossless codecs of the recorder. A decoded byte stream for the stream
+container (rec_writer) holds slowly varying samples, so the codec
+predicts each byte and codes the residual:
+
+	block       REC_CODEC_BLOCK bytes with their own predictor and
+	            Rice parameter, header of 5 bits: predictor (1 bit) and
+	            k (4 bits, 0 .. 7, REC_CODEC_RAW_K for 8 bit literals)
+	predictor   0: last byte, 1: linear from the last two bytes, both
+	            modulo 256 and from REC_CODEC_START at the chunk start
+	residual    zigzag mapped to 0 .. 255, q = u >> k ones, a zero and
+	            the k low bits; from REC_CODEC_ESCAPE ones on the byte
+	            follows as 8 bit literal
+
+The encoder picks predictor and k with the fewest bits for each block.
+Bits are written LSB first, collected in a 64 bit accumulator that goes
+out in 32 bit pieces, the rest at the end byte wise with the last byte
+padded with zeros. The chunk is independent of the others, so each
+chunk of the container can be decoded alone.
+
+The raw ADC blocks (rec_rawwriter) use the same scheme on int16 samples
+of lChannels interleaved channels, as the fixed predictors of FLAC:
+
+	block       REC_CODEC_SAMPLE_BLOCK samples, header of 7 bits: order
+	            (2 bits) and k (5 bits, 0 .. REC_CODEC_SAMPLE_MAX_K,
+	            REC_CODEC_SAMPLE_RAW_K for 16 bit literals)
+	predictor   order 0 to 3 polynomial over the last samples of the same
+	            channel, zeros in front of the buffer
+	residual    zigzag mapped, Rice coded with k as above; from
+	            REC_CODEC_SAMPLE_ESCAPE ones on follows the zigzag code
+	            as 20 bit literal
+**************************************************************************
+*/
+
+#ifndef REC_CODEC_H
+#define REC_CODEC_H
+
+#include <stdint.h>
+
+#define REC_CODEC_NONE          0       // chunk stored as is
+#define REC_CODEC_RICE          1       // chunk coded as above
+
+#define REC_CODEC_BLOCK         64      // bytes with one predictor and k
+#define REC_CODEC_RAW_K         8       // k of a block of literals
+#define REC_CODEC_ESCAPE        8       // unary length of a literal in a Rice block
+#define REC_CODEC_START         128     // history at the chunk start
+
+#define REC_CODEC_SAMPLE_BLOCK  256     // samples with one order and k
+#define REC_CODEC_SAMPLE_MAX_K  19
+#define REC_CODEC_SAMPLE_RAW_K  31      // k of a block of literals
+#define REC_CODEC_SAMPLE_ESCAPE 16      // unary length of a literal in a Rice block
+
+
+// ----- largest coded size of dwLen bytes -----
+uint32_t dwCodecBound(uint32_t dwLen);
+
+// ----- codes dwLen bytes to pbyDst (dwCodecBound bytes), returns the coded size -----
+uint32_t dwCodecEncode(const uint8_t* pbySrc, uint32_t dwLen, uint8_t* pbyDst);
+
+// ----- decodes dwLen bytes from dwSrcLen coded bytes, false if the data is cut or corrupt -----
+bool bCodecDecode(const uint8_t* pbySrc, uint32_t dwSrcLen, uint8_t* pbyDst, uint32_t dwLen);
+
+// ----- largest coded size of dwSamples int16 samples -----
+uint32_t dwCodecSampleBound(uint32_t dwSamples);
+
+// ----- codes dwSamples samples of lChannels interleaved channels to pbyDst (dwCodecSampleBound bytes), returns the coded size -----
+uint32_t dwCodecEncodeSamples(const int16_t* pnSrc, uint32_t dwSamples, int32_t lChannels, uint8_t* pbyDst);
+
+// ----- decodes dwSamples samples from dwSrcLen coded bytes, false if the data is cut or corrupt -----
+bool bCodecDecodeSamples(const uint8_t* pbySrc, uint32_t dwSrcLen, int16_t* pnDst, uint32_t dwSamples, int32_t lChannels);
+
+#endif
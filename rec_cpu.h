@@ -0,0 +1,170 @@
+/*
+**************************************************************************
+
+rec_cpu.h
+
+**************************************************************************
+
+Pinning of the worker threads to cores. With several cards in one
+process each card gets its own range of cores, so the threads of one
+card don't push the threads of the other cards around. Background
+threads (metrics) run with low priority.
+
+The set of a card also says where its buffers go: the NUMA node next to
+the PCIe root of the card (its cores are taken from that node) and if
+they are backed by large pages (rec_mem). The acquisition and decoding
+threads can run at real-time priority, the packers and the background
+threads never do.
+**************************************************************************
+*/
+
+#ifndef REC_CPU_H
+#define REC_CPU_H
+
+#include <stdint.h>
+#include <thread>
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#elif defined(__linux__)
+	#include <stdio.h>
+	#include <pthread.h>
+	#include <sched.h>
+	#include <unistd.h>
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+#endif
+
+// ----- core index of the threads of one card in its set -----
+#define REC_CPU_ACQUIRE         0       // FIFO loop
+#define REC_CPU_DECODE          1       // pipeline decode stage
+#define REC_CPU_OUTPUT          2       // pipeline output stage
+#define REC_CPU_CHANNEL(c)      (2 + (c))   // decoder worker of analog channel c >= 1
+#define REC_CPU_PACKER(t)       (10 + (t))  // raw packer t, behind the workers of 8 channels
+
+#define REC_NODE_ANY            -1      // buffers wherever the system puts them
+
+
+// ----- cores lFirst .. lFirst + lCount - 1, lCount 0 leaves the threads to the scheduler -----
+struct ST_CPUSET
+{
+	int32_t     lFirst;
+	int32_t     lCount;
+	int32_t     lNode;              // NUMA node of the buffers, REC_NODE_ANY for none
+	bool        bRealtime;          // acquisition and decoding threads at real-time priority
+	bool        bLargePages;        // large buffers on large pages if the system has them
+};
+
+// ----- copy of a set, the defaults without one -----
+static inline void vRecCpuCopy(ST_CPUSET* pstDst, const ST_CPUSET* pstSrc)
+{
+	if (pstSrc)
+		*pstDst = *pstSrc;
+	else
+	{
+		pstDst->lFirst = pstDst->lCount = 0;
+		pstDst->lNode = REC_NODE_ANY;
+		pstDst->bRealtime = false;
+		pstDst->bLargePages = true;
+	}
+}
+
+
+static inline int32_t lRecCpuCount()
+{
+	int32_t lCount = (int32_t)std::thread::hardware_concurrency();
+	return (lCount > 0) ? lCount : 1;
+}
+
+// ----- first run of cores of a NUMA node, false if the system doesn't know the node -----
+static inline bool bRecNodeCpus(int32_t lNode, int32_t* plFirst, int32_t* plCount)
+{
+	if (lNode < 0)
+		return false;
+
+#if defined(_WIN32)
+	ULONGLONG qwMask = 0;
+	if (lNode > 255 || !GetNumaNodeProcessorMask((UCHAR)lNode, &qwMask) || !qwMask)
+		return false;
+	int32_t lFirst = 0;
+	while (!(qwMask & ((ULONGLONG)1 << lFirst)))
+		lFirst++;
+	int32_t lLast = lFirst;
+	while (lLast < 63 && (qwMask & ((ULONGLONG)1 << (lLast + 1))))
+		lLast++;
+#elif defined(__linux__)
+	// cpulist is "0-7,16-23" or "3"
+	char szPath[64];
+	snprintf(szPath, sizeof(szPath), "/sys/devices/system/node/node%d/cpulist", lNode);
+	FILE* hFile = fopen(szPath, "r");
+	if (!hFile)
+		return false;
+	int lFirst = -1, lLast = -1;
+	int lFields = fscanf(hFile, "%d-%d", &lFirst, &lLast);
+	fclose(hFile);
+	if (lFields < 1 || lFirst < 0)
+		return false;
+	if (lFields == 1)
+		lLast = lFirst;
+#else
+	int32_t lFirst = 0, lLast = -1;
+	return false;
+#endif
+	*plFirst = lFirst;
+	*plCount = lLast - lFirst + 1;
+	return true;
+}
+
+// ----- the calling thread preempts everything but the system -----
+static inline bool bRecRealtimeThread()
+{
+#if defined(_WIN32)
+	return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#elif defined(__linux__)
+	struct sched_param stParam;
+	stParam.sched_priority = sched_get_priority_max(SCHED_FIFO) / 2;
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &stParam) == 0;
+#else
+	return false;
+#endif
+}
+
+// ----- pins the calling thread to core lIndex of the set, wraps if the set has less cores; real-time up to the packers if the set asks for it -----
+static inline bool bRecPinThread(const ST_CPUSET* pstCpus, int32_t lIndex)
+{
+	if (!pstCpus)
+		return true;
+	bool bOk = true;
+	if (pstCpus->bRealtime && lIndex < REC_CPU_PACKER(0))
+		bOk = bRecRealtimeThread();
+	if (pstCpus->lCount <= 0)
+		return bOk;
+	int32_t lCpu = pstCpus->lFirst + lIndex % pstCpus->lCount;
+
+#if defined(_WIN32)
+	if (lCpu >= 64)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << lCpu) != 0 && bOk;
+#elif defined(__linux__)
+	cpu_set_t stSet;
+	CPU_ZERO(&stSet);
+	CPU_SET(lCpu, &stSet);
+	return pthread_setaffinity_np(pthread_self(), sizeof(stSet), &stSet) == 0 && bOk;
+#else
+	return false;
+#endif
+}
+
+// ----- the calling thread only runs when the FIFO loop and the stages don't need the core -----
+static inline bool bRecLowPriorityThread()
+{
+#if defined(_WIN32)
+	return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST) != 0;
+#elif defined(__linux__)
+	return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19) == 0;
+#else
+	return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,476 @@
+/*
+**************************************************************************
+
+rec_decoder.cpp
+
+**************************************************************************
+
+Decoding chain of the headstage line code, see rec_decoder.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rec_decoder.h"
+#include "rec_slicer.h"
+#include "rec_preamble.h"
+#include "rec_demux.h"
+#include "rec_metrics.h"
+
+
+
+//define getting average function
+double average(int16_t* array, int length) {
+	double sum = 0.0;
+	for (int i = 0; i < length; i++)
+		sum += *(array+i);
+	return sum / length;
+}
+
+
+
+/*
+**************************************************************************
+pszDecoderStreamName: ratX_chY.bin
+**************************************************************************
+*/
+
+char* pszDecoderStreamName(int32_t lStream, char* szBuffer, int32_t lBufferLen)
+{
+	snprintf(szBuffer, lBufferLen, "rat%d_ch%d.bin", lStream % REC_SUBJECT_NUM + 1, lStream / REC_SUBJECT_NUM + 1);
+	return szBuffer;
+}
+
+
+
+/*
+**************************************************************************
+dwArenaSize: symbol sums of the timing recovery, packed bits and streams
+of the largest block
+**************************************************************************
+*/
+
+static size_t dwArenaSize(const ST_DECODER* pstDecoder)
+{
+	uint32_t dwMaxSymbols = dwTimingMaxSymbols(&pstDecoder->stTiming, pstDecoder->dwMaxSamples);
+	size_t dwSums = (pstDecoder->stTiming.lMode == REC_TIMING_TRACK) ? dwMaxSymbols * sizeof(int32_t) + 64 : 0;
+	return dwSums + REC_BITS_WORDS(dwMaxSymbols) * sizeof(uint64_t) + (size_t)REC_STREAM_NUM * dwDecoderMaxStreamLen(pstDecoder->dwMaxSamples, pstDecoder) + 2 * 64;
+}
+
+
+
+/*
+**************************************************************************
+bDecoderInit
+**************************************************************************
+*/
+
+bool bDecoderInit(ST_DECODER* pstDecoder, uint32_t dwMaxSamples, const char* szPreamble, int32_t lPreambleErrors)
+{
+	memset(pstDecoder, 0, sizeof(*pstDecoder));
+	pstDecoder->lLoopCount = 1; //loop_count starting at 1
+	pstDecoder->dwMaxSamples = dwMaxSamples;
+	if (!bPreambleInit(&pstDecoder->stPreamble, szPreamble, lPreambleErrors))
+		return false;
+	bThresholdInit(&pstDecoder->stThreshold, REC_THRESHOLD_WINDOW);
+	bTimingInit(&pstDecoder->stTiming, REC_TIMING_FIXED);
+	bLockInit(&pstDecoder->stLock, 0);
+	return bArenaInit(&pstDecoder->stArena, dwArenaSize(pstDecoder));
+}
+
+
+
+/*
+**************************************************************************
+bDecoderSetThreshold
+**************************************************************************
+*/
+
+bool bDecoderSetThreshold(ST_DECODER* pstDecoder, int32_t lMode, double dHysteresis)
+{
+	return bThresholdInit(&pstDecoder->stThreshold, lMode, dHysteresis);
+}
+
+
+
+/*
+**************************************************************************
+bDecoderSetTiming: the arena is sized again for the symbols of a block
+**************************************************************************
+*/
+
+bool bDecoderSetTiming(ST_DECODER* pstDecoder, int32_t lMode, double dSamplesPerSymbol)
+{
+	if (!bTimingInit(&pstDecoder->stTiming, lMode, dSamplesPerSymbol))
+	{
+		bTimingInit(&pstDecoder->stTiming, REC_TIMING_FIXED);
+		return false;
+	}
+	vArenaFree(&pstDecoder->stArena);
+	return bArenaInit(&pstDecoder->stArena, dwArenaSize(pstDecoder));
+}
+
+
+
+/*
+**************************************************************************
+bDecoderSetLock: a resync can demux a frame from the last block again,
+the arena is sized for it
+**************************************************************************
+*/
+
+bool bDecoderSetLock(ST_DECODER* pstDecoder, uint32_t dwInterval, const char* szSync, int32_t lMaxErrors)
+{
+	if (!bLockInit(&pstDecoder->stLock, dwInterval, szSync, lMaxErrors))
+	{
+		bLockInit(&pstDecoder->stLock, 0);
+		return false;
+	}
+	vArenaFree(&pstDecoder->stArena);
+	return bArenaInit(&pstDecoder->stArena, dwArenaSize(pstDecoder));
+}
+
+
+
+/*
+**************************************************************************
+dwDecoderMaxStreamLen
+**************************************************************************
+*/
+
+uint32_t dwDecoderMaxStreamLen(uint32_t dwSamples, const ST_DECODER* pstDecoder)
+{
+	uint32_t dwMaxSymbols = pstDecoder ? dwTimingMaxSymbols(&pstDecoder->stTiming, dwSamples) : dwSamples / REC_DOWN_SAMPLING_RATE + 1;
+	uint32_t dwResync = (pstDecoder && pstDecoder->stLock.dwInterval) ? 1 : 0;
+	return dwMaxSymbols / REC_FRAME_SIZE + 1 + dwResync;
+}
+
+
+
+/*
+**************************************************************************
+bDecoderSlice: symbol sums and decisions of one block
+**************************************************************************
+*/
+
+bool bDecoderSlice(ST_DECODER* pstDecoder, const int16_t* pnData, uint32_t dwSamples, ST_SLICEDBLOCK* pstSliced)
+{
+	const int down_sampling_rate = REC_DOWN_SAMPLING_RATE;
+	const int number_of_samples = (int)dwSamples;
+
+	int num_samples_from_prev = (pstDecoder->lLoopCount == 1) ? 0 : pstDecoder->lNumRemainSamples;
+
+	if (dwSamples > pstDecoder->dwMaxSamples)
+		return false;
+	vArenaReset(&pstDecoder->stArena);
+
+	ST_SLICERINPUT stInput;
+	stInput.pnStitch = pstDecoder->anStitch;
+	stInput.dwStitchSymbols = 0;
+	stInput.pnBody = pnData;
+	stInput.plSums = NULL;
+
+	int processed_signal_size;
+	int window_samples = number_of_samples;
+	pstSliced->dwSamples = dwSamples;
+	pstSliced->lCarrySamples = num_samples_from_prev;
+	pstSliced->dPos = 0;
+	pstSliced->dSamplesPerSymbol = down_sampling_rate;
+	uint64_t qwTime = qwMetricsStart(pstDecoder->pstMetrics);
+	if (pstDecoder->stTiming.lMode == REC_TIMING_TRACK) {
+		// the first symbol starts in the carried samples
+		pstSliced->lCarrySamples = pstDecoder->stTiming.lCarry;
+		pstSliced->dPos = pstDecoder->stTiming.dPos;
+		pstSliced->dSamplesPerSymbol = pstDecoder->stTiming.dPeriod;
+		// symbol sums with the recovered clock, the samples of an unfinished symbol stay in the timing state
+		int32_t* plSums = (int32_t*)pvArenaAlloc(&pstDecoder->stArena, dwTimingMaxSymbols(&pstDecoder->stTiming, dwSamples) * sizeof(int32_t));
+		if (!plSums)
+			return false;
+		processed_signal_size = (int)dwTimingDo(&pstDecoder->stTiming, pnData, dwSamples, plSums);
+		stInput.plSums = plSums;
+		window_samples = processed_signal_size * down_sampling_rate;
+	}
+	else {
+		// the block is read in place, only the symbol with the samples from prev is stitched
+		int num_remain_samples = (num_samples_from_prev + number_of_samples) % down_sampling_rate;
+		processed_signal_size = (num_samples_from_prev + number_of_samples - num_remain_samples) / down_sampling_rate;
+
+		if (num_samples_from_prev > 0 && processed_signal_size > 0) {
+			memcpy(pstDecoder->anStitch, pstDecoder->anSamplesFromPrev, num_samples_from_prev * sizeof(int16_t));
+			memcpy(pstDecoder->anStitch + num_samples_from_prev, pnData, (down_sampling_rate - num_samples_from_prev) * sizeof(int16_t));
+			stInput.dwStitchSymbols = 1;
+			stInput.pnBody = pnData + down_sampling_rate - num_samples_from_prev;
+		}
+
+		// save remainder signal to next loop's prev signal, a block shorter than a symbol is added to it
+		if (num_remain_samples > number_of_samples)
+			memcpy(pstDecoder->anSamplesFromPrev + num_samples_from_prev, pnData, number_of_samples * sizeof(int16_t));
+		else
+			memcpy(pstDecoder->anSamplesFromPrev, pnData + number_of_samples - num_remain_samples, num_remain_samples * sizeof(int16_t));
+		pstDecoder->lNumRemainSamples = num_remain_samples;
+	}
+	pstDecoder->dwSymbols = processed_signal_size;
+	pstSliced->dwSymbols = processed_signal_size;
+
+	uint64_t* pqwBits = (uint64_t*)pvArenaAlloc(&pstDecoder->stArena, REC_BITS_WORDS(processed_signal_size) * sizeof(uint64_t));
+	if (!pqwBits)
+		return false;
+	pstSliced->pqwBits = pqwBits;
+
+	// slicer: threshold tracked over the blocks or the mean of the next REC_LOOKING_WINDOW_SIZE symbols, 64 symbols per word
+	if (pstDecoder->stThreshold.lMode == REC_THRESHOLD_TRACK)
+		vSlicerTrack(&stInput, processed_signal_size, &pstDecoder->stThreshold, pqwBits);
+	else
+		vSlicerDo(&stInput, processed_signal_size, window_samples, pqwBits);
+	qwMetricsLap(pstDecoder->pstMetrics, REC_STAGE_SLICE, qwTime);
+
+	//loop_count for counting the loop
+	pstDecoder->lLoopCount++;
+
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bDecoderFrames: preamble, lock and demux of the symbols of one block
+**************************************************************************
+*/
+
+bool bDecoderFrames(ST_DECODER* pstDecoder, const ST_SLICEDBLOCK* pstSliced)
+{
+	const uint64_t* pqwBits = pstSliced->pqwBits;
+	int processed_signal_size = (int)pstSliced->dwSymbols;
+
+	pstDecoder->dwStreamLen = 0;
+	pstDecoder->stLock.dwEvents = 0;
+	pstDecoder->dwSymbols = pstSliced->dwSymbols;
+	uint64_t qwTime = qwMetricsStart(pstDecoder->pstMetrics);
+
+	// preamble search, also over the seam to the previous block
+	int64_t llFirst = 0;
+	double dFirstSample = (double)pstDecoder->qwSamples - pstSliced->lCarrySamples + pstSliced->dPos;
+	vLockBlock(&pstDecoder->stLock, (int64_t)pstDecoder->qwSymbols, dFirstSample, pstSliced->dSamplesPerSymbol);
+	if (!pstDecoder->bRecording) {
+		int64_t llDataStart = llPreambleSearch(&pstDecoder->stPreamble, pqwBits, processed_signal_size);
+		qwTime = qwMetricsLap(pstDecoder->pstMetrics, REC_STAGE_PREAMBLE, qwTime);
+
+		// the frames start right behind the preamble
+		if (llDataStart >= 0) {
+			pstDecoder->bRecording = true;
+			vDemuxReset(&pstDecoder->stDemux);
+			vLockStart(&pstDecoder->stLock, llDataStart);
+			llFirst = llDataStart;
+		}
+	}
+
+	// behind a skipped gap the frames go on at the next frame boundary
+	else if (pstDecoder->llFrameSkip) {
+		llFirst = (pstDecoder->llFrameSkip < processed_signal_size) ? pstDecoder->llFrameSkip : processed_signal_size;
+		pstDecoder->llFrameSkip -= llFirst;
+	}
+	pstDecoder->qwSymbols += processed_signal_size;
+	pstDecoder->qwSamples += pstSliced->dwSamples;
+
+	if (pstDecoder->bRecording) {
+		//*************signal separation rat1, rat2 and 8 channels**************//
+		// one byte per stream and frame, plus the frame completed from the last block and a frame again after a resync
+		uint32_t dwNeed = (uint32_t)((processed_signal_size - llFirst) / REC_FRAME_SIZE + 1) + (pstDecoder->stLock.dwInterval ? 1 : 0);
+		pstDecoder->pbyStreams = (uint8_t*)pvArenaAlloc(&pstDecoder->stArena, (size_t)REC_STREAM_NUM * dwNeed);
+		if (!pstDecoder->pbyStreams)
+			return false;
+		pstDecoder->dwStreamCap = dwNeed;
+		for (int i = 0; i < REC_STREAM_NUM; i++)
+			pstDecoder->apbyStream[i] = pstDecoder->pbyStreams + (size_t)i * dwNeed;
+
+		// with sync words the frames are demuxed around them and the lock is checked on the way
+		if (pstDecoder->stLock.dwInterval)
+			pstDecoder->dwStreamLen = dwLockDemux(&pstDecoder->stLock, &pstDecoder->stDemux, pqwBits, llFirst, processed_signal_size, pstDecoder->pbyStreams, pstDecoder->dwStreamCap);
+		else
+			pstDecoder->dwStreamLen = dwDemuxDo(&pstDecoder->stDemux, pqwBits, llFirst, processed_signal_size, pstDecoder->pbyStreams, pstDecoder->dwStreamCap);
+		qwMetricsLap(pstDecoder->pstMetrics, REC_STAGE_DEMUX, qwTime);
+	}
+
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bDecoderDo: slicer, preamble and demux of one block
+**************************************************************************
+*/
+
+bool bDecoderDo(ST_DECODER* pstDecoder, const int16_t* pnData, uint32_t dwSamples)
+{
+	ST_SLICEDBLOCK stSliced;
+
+	pstDecoder->dwStreamLen = 0;
+	pstDecoder->stLock.dwEvents = 0;
+	if (!bDecoderSlice(pstDecoder, pnData, dwSamples, &stSliced))
+		return false;
+	return bDecoderFrames(pstDecoder, &stSliced);
+}
+
+
+
+/*
+**************************************************************************
+vDecoderSeek: slicer of a fresh decoder on the symbol grid at qwSamples,
+the carried samples are zeros, so the first symbol is a guess
+**************************************************************************
+*/
+
+void vDecoderSeek(ST_DECODER* pstDecoder, uint64_t qwSamples)
+{
+	pstDecoder->lLoopCount = qwSamples ? 2 : 1;
+	pstDecoder->lNumRemainSamples = (int32_t)(qwSamples % REC_DOWN_SAMPLING_RATE);
+	memset(pstDecoder->anSamplesFromPrev, 0, sizeof(pstDecoder->anSamplesFromPrev));
+	pstDecoder->qwSamples = qwSamples;
+	pstDecoder->qwSymbols = qwSamples / REC_DOWN_SAMPLING_RATE;
+}
+
+
+
+/*
+**************************************************************************
+vDecoderSkip: the symbol grid and the frame position go on over the gap,
+the samples carried over the gap are zeros as for vDecoderSeek. With
+sync words the lock searches the sync word again, without them the
+frames are counted on; with a recovered clock that only holds if the
+period is exact over the gap.
+**************************************************************************
+*/
+
+void vDecoderSkip(ST_DECODER* pstDecoder, uint32_t dwSamples)
+{
+	uint64_t qwSkipped;
+
+	if (pstDecoder->stTiming.lMode == REC_TIMING_TRACK) {
+		// symbols that start before the first sample behind the gap, phase and period go on
+		ST_TIMING* pstTiming = &pstDecoder->stTiming;
+		double dEnd = pstTiming->lCarry + (double)dwSamples;
+		qwSkipped = (dEnd > pstTiming->dPos) ? (uint64_t)ceil((dEnd - pstTiming->dPos) / pstTiming->dPeriod) : 0;
+		pstTiming->dPos += (double)qwSkipped * pstTiming->dPeriod - dEnd;
+		pstTiming->dPending = 0;
+		pstTiming->lCarry = 0;
+	}
+	else {
+		int32_t lFromPrev = (pstDecoder->lLoopCount == 1) ? 0 : pstDecoder->lNumRemainSamples;
+		uint64_t qwGrid = (uint64_t)lFromPrev + dwSamples;
+		qwSkipped = qwGrid / REC_DOWN_SAMPLING_RATE;
+		pstDecoder->lLoopCount = qwGrid ? 2 : pstDecoder->lLoopCount;
+		pstDecoder->lNumRemainSamples = (int32_t)(qwGrid % REC_DOWN_SAMPLING_RATE);
+		memset(pstDecoder->anSamplesFromPrev, 0, sizeof(pstDecoder->anSamplesFromPrev));
+	}
+	pstDecoder->qwSymbols += qwSkipped;
+	pstDecoder->qwSamples += dwSamples;
+
+	if (!pstDecoder->bRecording)
+		return;
+	if (pstDecoder->stLock.dwInterval) {
+		ST_LOCK* pstLock = &pstDecoder->stLock;
+		pstLock->lState = REC_LOCK_SEARCH;
+		pstLock->lMisses = 0;
+		pstLock->bSkipped = false;
+		pstLock->lTailBits = 0;
+		vPreambleReset(&pstLock->stSearch);
+		pstDecoder->llFrameSkip = 0;
+	}
+	else {
+		// next frame boundary counted from the end of the last block, then from the end of the gap
+		int64_t llBoundary = (pstDecoder->llFrameSkip + REC_FRAME_SIZE - pstDecoder->stDemux.lCarryBits) % REC_FRAME_SIZE;
+		pstDecoder->llFrameSkip = (int64_t)(((uint64_t)llBoundary + REC_FRAME_SIZE - qwSkipped % REC_FRAME_SIZE) % REC_FRAME_SIZE);
+	}
+	vDemuxReset(&pstDecoder->stDemux);
+}
+
+
+
+/*
+**************************************************************************
+vDecoderSaveSlice, vDecoderLoadSlice
+**************************************************************************
+*/
+
+void vDecoderSaveSlice(const ST_DECODER* pstDecoder, ST_SLICECARRY* pstCarry)
+{
+	pstCarry->lLoopCount = pstDecoder->lLoopCount;
+	pstCarry->lNumRemainSamples = pstDecoder->lNumRemainSamples;
+	memcpy(pstCarry->anSamplesFromPrev, pstDecoder->anSamplesFromPrev, sizeof(pstCarry->anSamplesFromPrev));
+	pstCarry->stThreshold = pstDecoder->stThreshold;
+	pstCarry->stTiming = pstDecoder->stTiming;
+}
+
+void vDecoderLoadSlice(ST_DECODER* pstDecoder, const ST_SLICECARRY* pstCarry)
+{
+	pstDecoder->lLoopCount = pstCarry->lLoopCount;
+	pstDecoder->lNumRemainSamples = pstCarry->lNumRemainSamples;
+	memcpy(pstDecoder->anSamplesFromPrev, pstCarry->anSamplesFromPrev, sizeof(pstDecoder->anSamplesFromPrev));
+	pstDecoder->stThreshold = pstCarry->stThreshold;
+	pstDecoder->stTiming = pstCarry->stTiming;
+}
+
+
+
+/*
+**************************************************************************
+bDecoderSameSlice: the fields the next decisions depend on, the
+statistics of the timing recovery and samples behind the carried ones
+don't count
+**************************************************************************
+*/
+
+bool bDecoderSameSlice(const ST_SLICECARRY* pstA, const ST_SLICECARRY* pstB)
+{
+	if ((pstA->lLoopCount == 1) != (pstB->lLoopCount == 1))
+		return false;
+
+	// fixed symbol grid
+	const ST_TIMING* pstTa = &pstA->stTiming;
+	const ST_TIMING* pstTb = &pstB->stTiming;
+	if (pstTa->lMode != REC_TIMING_TRACK)
+	{
+		if (pstA->lNumRemainSamples != pstB->lNumRemainSamples
+			|| memcmp(pstA->anSamplesFromPrev, pstB->anSamplesFromPrev, pstA->lNumRemainSamples * sizeof(int16_t)))
+			return false;
+	}
+	// recovered clock, the doubles have to be the same to the last bit
+	else if (pstTa->bValid != pstTb->bValid || pstTa->lCarry != pstTb->lCarry || pstTa->dwLast != pstTb->dwLast
+		|| memcmp(&pstTa->dPeriod, &pstTb->dPeriod, sizeof(double)) || memcmp(&pstTa->dPos, &pstTb->dPos, sizeof(double))
+		|| memcmp(&pstTa->dPending, &pstTb->dPending, sizeof(double)) || memcmp(&pstTa->dHigh, &pstTb->dHigh, sizeof(double))
+		|| memcmp(&pstTa->dLow, &pstTb->dLow, sizeof(double))
+		|| memcmp(pstTa->anCarry, pstTb->anCarry, pstTa->lCarry * sizeof(int16_t)))
+		return false;
+
+	// the window mean has no state
+	const ST_THRESHOLD* pstHa = &pstA->stThreshold;
+	const ST_THRESHOLD* pstHb = &pstB->stThreshold;
+	if (pstHa->lMode != REC_THRESHOLD_TRACK)
+		return true;
+	return pstHa->bValid == pstHb->bValid && pstHa->lHigh == pstHb->lHigh && pstHa->lLow == pstHb->lLow
+		&& pstHa->dwLast == pstHb->dwLast && pstHa->dwRun == pstHb->dwRun;
+}
+
+
+
+/*
+**************************************************************************
+vDecoderClose
+**************************************************************************
+*/
+
+void vDecoderClose(ST_DECODER* pstDecoder)
+{
+	vArenaFree(&pstDecoder->stArena);
+	pstDecoder->pbyStreams = NULL;
+	memset(pstDecoder->apbyStream, 0, sizeof(pstDecoder->apbyStream));
+	pstDecoder->dwStreamCap = 0;
+	pstDecoder->dwStreamLen = 0;
+}
@@ -0,0 +1,155 @@
+/*
+**************************************************************************
+
+rec_decoder.h
+
+**************************************************************************
+
+Decoding chain of the headstage line code: slicer, preamble search and
+rat/channel demultiplexing, checked by the sync words of the frame lock
+(rec_lock) if the headstage sends them. The decoded streams of a block
+are handed to the caller, the stream files are written by rec_writer.
+
+The decoder does not depend on the card or on Windows, so it can be run
+by the FIFO loop of rec_fifo_hd_speed as well as by the offline replay
+(rec_replay) on any machine. bDecoderDo is split in the slicer stage
+(bDecoderSlice) and the frame stage (bDecoderFrames), so rec_redecode
+can slice the chunks of a capture on all cores and run the frames in
+order.
+**************************************************************************
+*/
+
+#ifndef REC_DECODER_H
+#define REC_DECODER_H
+
+#include <stdint.h>
+
+// ----- line code setup -----
+#define REC_DOWN_SAMPLING_RATE  10                                  // ADC samples per symbol
+#define REC_LOOKING_WINDOW_SIZE 200                                 // symbols per threshold window
+#define REC_CHANNEL_NUM         8                                   // channels per subject
+#define REC_SUBJECT_NUM         2                                   // interleaved subjects (rats)
+#define REC_BITS_NUM            (8 * REC_SUBJECT_NUM)               // symbols per channel in a frame
+#define REC_FRAME_SIZE          (REC_CHANNEL_NUM * REC_BITS_NUM)    // symbols per frame
+#define REC_STREAM_NUM          (REC_CHANNEL_NUM * REC_SUBJECT_NUM) // decoded byte streams
+
+// ----- stages of the chain, they use the line code setup above -----
+#include "rec_arena.h"
+#include "rec_preamble.h"
+#include "rec_demux.h"
+#include "rec_threshold.h"
+#include "rec_timing.h"
+#include "rec_lock.h"
+
+struct ST_METRICS;
+
+/*
+**************************************************************************
+Decoder state, everything that has to survive from one block to the next
+**************************************************************************
+*/
+
+struct ST_DECODER
+{
+	// carry over between the blocks
+	int32_t     lLoopCount;
+	int32_t     lNumRemainSamples;
+	int16_t     anSamplesFromPrev[REC_DOWN_SAMPLING_RATE];
+	int16_t     anStitch[REC_DOWN_SAMPLING_RATE];       // samples from prev and first samples of the block
+	bool        bRecording;
+	ST_DEMUX    stDemux;
+	ST_THRESHOLD stThreshold;                           // slicer threshold, setup and tracked levels
+	ST_TIMING   stTiming;                               // symbol clock, setup and tracked phase and period
+	ST_LOCK     stLock;                                 // sync word check, setup and state; events of the last block
+	uint64_t    qwSymbols;                              // decided before the block
+	uint64_t    qwSamples;                              // decoded before the block
+	int64_t     llFrameSkip;                            // symbols up to the next frame after a skipped gap
+
+	// setup
+	ST_PREAMBLE stPreamble;
+	uint32_t    dwMaxSamples;
+	ST_METRICS* pstMetrics;                             // stage timers, NULL for none
+
+	// working buffers of a block, sized for dwMaxSamples in bDecoderInit
+	ST_ARENA    stArena;
+
+	// result of the last block, valid until the next call of bDecoderDo
+	// stream index is (channel * REC_SUBJECT_NUM + rat): rat1_ch1, rat2_ch1, rat1_ch2 ...
+	// all streams are in pbyStreams (arena), apbyStream[i] = pbyStreams + i * dwStreamCap
+	uint8_t*    pbyStreams;
+	uint32_t    dwStreamCap;
+	uint8_t*    apbyStream[REC_STREAM_NUM];
+	uint32_t    dwStreamLen;
+	uint32_t    dwSymbols;
+};
+
+
+// ----- slicer state carried from block to block, a decoder that starts later in the recording has to find it again -----
+struct ST_SLICECARRY
+{
+	int32_t     lLoopCount;
+	int32_t     lNumRemainSamples;
+	int16_t     anSamplesFromPrev[REC_DOWN_SAMPLING_RATE];
+	ST_THRESHOLD stThreshold;
+	ST_TIMING   stTiming;
+};
+
+// ----- decisions of one block from bDecoderSlice, the bits are valid until the next block of the same decoder -----
+struct ST_SLICEDBLOCK
+{
+	const uint64_t* pqwBits;
+	uint32_t    dwSymbols;
+	uint32_t    dwSamples;                              // new samples of the block
+	int32_t     lCarrySamples;                          // samples of the last block in front of the first symbol
+	double      dPos;                                   // start of the first symbol in them, timing recovery only
+	double      dSamplesPerSymbol;
+};
+
+
+// ----- mean value of an int16 array -----
+double average(int16_t* array, int length);
+
+// ----- stream file name, index as in ST_DECODER::apbyStream -----
+char* pszDecoderStreamName(int32_t lStream, char* szBuffer, int32_t lBufferLen);
+
+// ----- setup the decoder for blocks up to dwMaxSamples, false if the preamble setup is invalid or there is no memory -----
+bool bDecoderInit(ST_DECODER* pstDecoder, uint32_t dwMaxSamples, const char* szPreamble = REC_PREAMBLE_DEFAULT, int32_t lPreambleErrors = 0);
+
+// ----- slicer threshold, REC_THRESHOLD_WINDOW after bDecoderInit, call before the first block -----
+bool bDecoderSetThreshold(ST_DECODER* pstDecoder, int32_t lMode, double dHysteresis = 0);
+
+// ----- symbol timing, REC_TIMING_FIXED after bDecoderInit, call before the first block; false for an invalid setup or no memory -----
+bool bDecoderSetTiming(ST_DECODER* pstDecoder, int32_t lMode, double dSamplesPerSymbol = REC_DOWN_SAMPLING_RATE);
+
+// ----- sync word after every dwInterval frames, 0 (after bDecoderInit) for none; call before the first block -----
+bool bDecoderSetLock(ST_DECODER* pstDecoder, uint32_t dwInterval, const char* szSync = REC_LOCK_SYNC_DEFAULT, int32_t lMaxErrors = 1);
+
+// ----- stream bytes of a block of dwSamples samples, including the frame completed from the last block; with the timing of the decoder if set -----
+uint32_t dwDecoderMaxStreamLen(uint32_t dwSamples, const ST_DECODER* pstDecoder = NULL);
+
+// ----- decodes one block of up to dwMaxSamples raw ADC samples, the block is read in place (DMA buffer) -----
+bool bDecoderDo(ST_DECODER* pstDecoder, const int16_t* pnData, uint32_t dwSamples);
+
+// ----- first half of bDecoderDo: symbol clock and slicer of a block, the bits are in the arena -----
+bool bDecoderSlice(ST_DECODER* pstDecoder, const int16_t* pnData, uint32_t dwSamples, ST_SLICEDBLOCK* pstSliced);
+
+// ----- second half: preamble, lock and demux, the bits may come from another decoder; the streams are put behind them in the arena, reset it if the decoder doesn't slice -----
+bool bDecoderFrames(ST_DECODER* pstDecoder, const ST_SLICEDBLOCK* pstSliced);
+
+// ----- starts the slicer of a fresh decoder at sample qwSamples of the recording, it finds threshold and clock again within the next symbols -----
+void vDecoderSeek(ST_DECODER* pstDecoder, uint64_t qwSamples);
+
+// ----- goes on dwSamples samples later, the samples in between are not decoded (overload, rec_governor); the streams have a gap -----
+void vDecoderSkip(ST_DECODER* pstDecoder, uint32_t dwSamples);
+
+// ----- slicer state of a decoder, to go on from it or to compare it -----
+void vDecoderSaveSlice(const ST_DECODER* pstDecoder, ST_SLICECARRY* pstCarry);
+void vDecoderLoadSlice(ST_DECODER* pstDecoder, const ST_SLICECARRY* pstCarry);
+
+// ----- true if both states give the same decisions for the same samples from here on -----
+bool bDecoderSameSlice(const ST_SLICECARRY* pstA, const ST_SLICECARRY* pstB);
+
+// ----- frees the decoder -----
+void vDecoderClose(ST_DECODER* pstDecoder);
+
+#endif
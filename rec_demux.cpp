@@ -0,0 +1,237 @@
+/*
+**************************************************************************
+
+rec_demux.cpp
+
+**************************************************************************
+
+Rat/channel demultiplexing of the packed sliced symbols, see rec_demux.h
+
+**************************************************************************
+*/
+
+#include <string.h>
+
+#include "rec_bits.h"
+#include "rec_decoder.h"
+#include "rec_demux.h"
+#include "rec_simd.h"
+
+static_assert(REC_FRAME_SIZE <= 64 * (REC_DEMUX_CARRY_WORDS - 1), "frame doesn't fit to the carry of ST_DEMUX");
+
+
+
+/*
+**************************************************************************
+ST_DEMUXTABLE: symbol position of each stream bit, built at compile time
+**************************************************************************
+*/
+
+template <int CHANNELS, int BITS, int SUBJECTS>
+struct ST_DEMUXTABLE
+{
+	static const int lStreams = CHANNELS * SUBJECTS;
+	static const int lByteBits = BITS / SUBJECTS;
+
+	static_assert(BITS % SUBJECTS == 0 && BITS / SUBJECTS <= 8, "a stream gets up to 8 bits per frame");
+
+	uint16_t awPos[lStreams][lByteBits];
+
+	constexpr ST_DEMUXTABLE() : awPos()
+	{
+		for (int ch = 0; ch < CHANNELS; ch++)
+			for (int rat = 0; rat < SUBJECTS; rat++)
+				for (int bit = 0; bit < lByteBits; bit++)
+					awPos[ch * SUBJECTS + rat][bit] = (uint16_t)(BITS * ch + SUBJECTS * bit + rat);
+	}
+};
+
+
+
+/*
+**************************************************************************
+vDemuxFrames: dwFrames frames starting at symbol llPos to byte dwIdx ...
+of each stream, any layout
+**************************************************************************
+*/
+
+template <int CHANNELS, int BITS, int SUBJECTS>
+static void vDemuxFrames(const uint64_t* pqwBits, int64_t llPos, uint32_t dwFrames, uint8_t* pbyStreams, uint32_t dwStride, uint32_t dwIdx)
+{
+	typedef ST_DEMUXTABLE<CHANNELS, BITS, SUBJECTS> TABLE;
+	static constexpr TABLE stTable = TABLE();
+
+	for (uint32_t f = 0; f < dwFrames; f++, llPos += CHANNELS * BITS)
+		for (int s = 0; s < TABLE::lStreams; s++)
+		{
+			uint32_t dwValue = 0;
+			for (int bit = 0; bit < TABLE::lByteBits; bit++)
+				dwValue = dwValue * 2 + dwGetBit(pqwBits, llPos + stTable.awPos[s][bit]);
+			pbyStreams[s * dwStride + dwIdx + f] = (uint8_t)dwValue;
+		}
+}
+
+
+
+/*
+**************************************************************************
+headstage layout: 8 channels of 16 bits with 2 rats, a frame is 2 words
+**************************************************************************
+*/
+
+// ----- 4 channels of a frame to 8 stream bytes -----
+static inline uint64_t qwDemuxWord(uint64_t x)
+{
+	uint64_t t;
+
+	// even bits (rat 1) to the low, odd bits (rat 2) to the high byte of each 16 bit field
+	t = (x ^ (x >> 1)) & 0x2222222222222222ULL; x ^= t ^ (t << 1);
+	t = (x ^ (x >> 2)) & 0x0C0C0C0C0C0C0C0CULL; x ^= t ^ (t << 2);
+	t = (x ^ (x >> 4)) & 0x00F000F000F000F0ULL; x ^= t ^ (t << 4);
+
+	// the first symbol is the MSB of the stream byte
+	x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return x;
+}
+
+#if defined(REC_SIMD_SSE2)
+// ----- qwDemuxWord on both words of a frame -----
+static inline __m128i xDemuxWords(__m128i x)
+{
+	__m128i t;
+
+	t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 1)), _mm_set1_epi64x(0x2222222222222222LL));
+	x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 1)));
+	t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 2)), _mm_set1_epi64x(0x0C0C0C0C0C0C0C0CLL));
+	x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 2)));
+	t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 4)), _mm_set1_epi64x(0x00F000F000F000F0LL));
+	x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 4)));
+
+	const __m128i m1 = _mm_set1_epi8(0x55);
+	const __m128i m2 = _mm_set1_epi8(0x33);
+	const __m128i m4 = _mm_set1_epi8(0x0F);
+	x = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(x, 1), m1), _mm_slli_epi64(_mm_and_si128(x, m1), 1));
+	x = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(x, 2), m2), _mm_slli_epi64(_mm_and_si128(x, m2), 2));
+	x = _mm_or_si128(_mm_and_si128(_mm_srli_epi64(x, 4), m4), _mm_slli_epi64(_mm_and_si128(x, m4), 4));
+	return x;
+}
+
+// ----- 8 bytes of 2 streams, stream s in the low half -----
+static inline void vStoreStreams(__m128i x, uint8_t* pbyDst, uint32_t dwStride)
+{
+	_mm_storel_epi64((__m128i*)pbyDst, x);
+	_mm_storel_epi64((__m128i*)(pbyDst + dwStride), _mm_unpackhi_epi64(x, x));
+}
+#endif
+
+template <>
+void vDemuxFrames<8, 16, 2>(const uint64_t* pqwBits, int64_t llPos, uint32_t dwFrames, uint8_t* pbyStreams, uint32_t dwStride, uint32_t dwIdx)
+{
+	uint32_t f = 0;
+
+#if defined(REC_SIMD_SSE2)
+	// 8 frames as 16 stream bytes each, transposed to 8 bytes of each stream
+	for (; f + 8 <= dwFrames; f += 8, llPos += 8 * 128)
+	{
+		__m128i x[8];
+		for (int k = 0; k < 8; k++)
+			x[k] = xDemuxWords(_mm_set_epi64x((long long)qwGetBits(pqwBits, llPos + 128 * k + 64), (long long)qwGetBits(pqwBits, llPos + 128 * k)));
+
+		for (int h = 0; h < 2; h++)
+		{
+			__m128i a0, a1, a2, a3;
+			if (h == 0)
+			{
+				a0 = _mm_unpacklo_epi8(x[0], x[1]);
+				a1 = _mm_unpacklo_epi8(x[2], x[3]);
+				a2 = _mm_unpacklo_epi8(x[4], x[5]);
+				a3 = _mm_unpacklo_epi8(x[6], x[7]);
+			}
+			else
+			{
+				a0 = _mm_unpackhi_epi8(x[0], x[1]);
+				a1 = _mm_unpackhi_epi8(x[2], x[3]);
+				a2 = _mm_unpackhi_epi8(x[4], x[5]);
+				a3 = _mm_unpackhi_epi8(x[6], x[7]);
+			}
+
+			__m128i c0 = _mm_unpacklo_epi16(a0, a1);
+			__m128i c1 = _mm_unpackhi_epi16(a0, a1);
+			__m128i c2 = _mm_unpacklo_epi16(a2, a3);
+			__m128i c3 = _mm_unpackhi_epi16(a2, a3);
+
+			uint8_t* pbyDst = pbyStreams + (size_t)(8 * h) * dwStride + dwIdx + f;
+			vStoreStreams(_mm_unpacklo_epi32(c0, c2), pbyDst + 0 * (size_t)dwStride, dwStride);
+			vStoreStreams(_mm_unpackhi_epi32(c0, c2), pbyDst + 2 * (size_t)dwStride, dwStride);
+			vStoreStreams(_mm_unpacklo_epi32(c1, c3), pbyDst + 4 * (size_t)dwStride, dwStride);
+			vStoreStreams(_mm_unpackhi_epi32(c1, c3), pbyDst + 6 * (size_t)dwStride, dwStride);
+		}
+	}
+#endif
+
+	for (; f < dwFrames; f++, llPos += 128)
+	{
+		uint64_t qwLow = qwDemuxWord(qwGetBits(pqwBits, llPos));
+		uint64_t qwHigh = qwDemuxWord(qwGetBits(pqwBits, llPos + 64));
+		for (int i = 0; i < 8; i++)
+		{
+			pbyStreams[(size_t)i * dwStride + dwIdx + f] = (uint8_t)(qwLow >> (8 * i));
+			pbyStreams[(size_t)(8 + i) * dwStride + dwIdx + f] = (uint8_t)(qwHigh >> (8 * i));
+		}
+	}
+}
+
+
+
+/*
+**************************************************************************
+vDemuxReset
+**************************************************************************
+*/
+
+void vDemuxReset(ST_DEMUX* pstDemux)
+{
+	memset(pstDemux, 0, sizeof(*pstDemux));
+}
+
+
+
+/*
+**************************************************************************
+dwDemuxDo: carried frame first, then the complete frames of the block
+**************************************************************************
+*/
+
+uint32_t dwDemuxDo(ST_DEMUX* pstDemux, const uint64_t* pqwBits, int64_t llFirst, int64_t llEnd, uint8_t* pbyStreams, uint32_t dwStride)
+{
+	uint32_t dwIdx = 0;
+	int64_t llPos = llFirst;
+
+	if (pstDemux->lCarryBits > 0)
+	{
+		int64_t llNeed = REC_FRAME_SIZE - pstDemux->lCarryBits;
+		if (llEnd - llPos < llNeed)
+		{
+			vAppendBits(pstDemux->aqwCarry, pstDemux->lCarryBits, pqwBits, llPos, llEnd - llPos);
+			pstDemux->lCarryBits += (int32_t)(llEnd - llPos);
+			return 0;
+		}
+		vAppendBits(pstDemux->aqwCarry, pstDemux->lCarryBits, pqwBits, llPos, llNeed);
+		vDemuxFrames<REC_CHANNEL_NUM, REC_BITS_NUM, REC_SUBJECT_NUM>(pstDemux->aqwCarry, 0, 1, pbyStreams, dwStride, dwIdx++);
+		llPos += llNeed;
+	}
+
+	uint32_t dwFrames = (uint32_t)((llEnd - llPos) / REC_FRAME_SIZE);
+	vDemuxFrames<REC_CHANNEL_NUM, REC_BITS_NUM, REC_SUBJECT_NUM>(pqwBits, llPos, dwFrames, pbyStreams, dwStride, dwIdx);
+	dwIdx += dwFrames;
+	llPos += (int64_t)dwFrames * REC_FRAME_SIZE;
+
+	// keep the cut frame for the next block
+	memset(pstDemux->aqwCarry, 0, sizeof(pstDemux->aqwCarry));
+	vAppendBits(pstDemux->aqwCarry, 0, pqwBits, llPos, llEnd - llPos);
+	pstDemux->lCarryBits = (int32_t)(llEnd - llPos);
+
+	return dwIdx;
+}
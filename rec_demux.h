@@ -0,0 +1,45 @@
+/*
+**************************************************************************
+
+rec_demux.h
+
+**************************************************************************
+
+Rat/channel demultiplexing of the packed sliced symbols. Symbol
+(BITS * ch + SUBJECTS * bit + rat) of a frame is bit (7 - bit) of the
+byte of stream (ch * SUBJECTS + rat). The kernel is a template on the
+frame layout, the position table is built at compile time. The layout
+of the headstage (8 channels, 16 bits, 2 rats) has its own kernel: a
+frame is two words, the even and odd bits of each 16 bit field are
+unshuffled with shift/mask steps and eight frames are transposed to the
+streams with SIMD byte unpacks.
+
+The streams are written to one structure of arrays buffer, stream i
+starts at pbyStreams + i * dwStride.
+
+A frame that is cut by the end of a block is kept and completed with
+the first symbols of the next block.
+**************************************************************************
+*/
+
+#ifndef REC_DEMUX_H
+#define REC_DEMUX_H
+
+#include <stdint.h>
+
+#define REC_DEMUX_CARRY_WORDS   5       // frames up to 256 symbols plus the padding word
+
+struct ST_DEMUX
+{
+	uint64_t    aqwCarry[REC_DEMUX_CARRY_WORDS];    // partial frame of the last block
+	int32_t     lCarryBits;
+};
+
+
+// ----- forgets the partial frame -----
+void vDemuxReset(ST_DEMUX* pstDemux);
+
+// ----- demuxes symbols llFirst to llEnd - 1 of a packed block, returns the number of bytes written to each stream -----
+uint32_t dwDemuxDo(ST_DEMUX* pstDemux, const uint64_t* pqwBits, int64_t llFirst, int64_t llEnd, uint8_t* pbyStreams, uint32_t dwStride);
+
+#endif
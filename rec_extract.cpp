@@ -0,0 +1,185 @@
+/*
+**************************************************************************
+
+rec_extract.cpp
+
+**************************************************************************
+
+Reads a range of the streams back from a stream container (streams.rec
+of rec_replay -container or of the FIFO loop) to extract_ratX_chY.bin
+files. The range is given in seconds from the start of the recording
+(-from, -len) or in bytes of the streams (-offset, -bytes); only the
+chunks of the range are read and decoded (rec_reader), so a few seconds
+out of a long recording come back at once. -stream limits the output
+to one stream (ch * 2 + rat), -info lists the streams only.
+
+usage: rec_extract [-from s] [-len s] [-offset bytes] [-bytes n] [-stream index] [-p prefix] [-info] [streams.rec]
+**************************************************************************
+*/
+
+
+
+// ----- standard c include files -----
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// ----- decoding chain -----
+#include "rec_reader.h"
+
+#define EXTRACT_PREFIX  "extract_"
+#define EXTRACT_BLOCK   (1024 * 1024)
+
+
+// ----- global setup for the run -----
+double   g_dFrom = 0;
+double   g_dLen = -1;                   // to the end
+int64_t  g_llOffset = -1;               // from g_dFrom if not set
+int64_t  g_llBytes = -1;
+int32_t  g_lStream = -1;                // all
+const char* g_szPrefix = EXTRACT_PREFIX;
+bool     g_bInfo = false;
+
+
+
+/*
+**************************************************************************
+bExtractStream: the range of one stream to its file
+**************************************************************************
+*/
+
+static bool bExtractStream(ST_STREAMREADER* pstReader, uint32_t dwStream, uint8_t* pbyBuffer, uint64_t* pqwWritten)
+{
+	uint64_t qwLen = qwStreamReaderLen(pstReader, dwStream);
+	int64_t llStartUs = llStreamReaderStartUs(pstReader, dwStream);
+
+	// seconds are placed by the chunk times, bytes are taken as they are
+	uint64_t qwFirst, qwEnd;
+	if (g_llOffset >= 0)
+	{
+		qwFirst = (uint64_t)g_llOffset;
+		qwEnd = (g_llBytes >= 0) ? qwFirst + (uint64_t)g_llBytes : qwLen;
+	}
+	else
+	{
+		qwFirst = qwStreamReaderOffsetAt(pstReader, dwStream, llStartUs + (int64_t)(g_dFrom * 1.0e6));
+		qwEnd = (g_dLen >= 0) ? qwStreamReaderOffsetAt(pstReader, dwStream, llStartUs + (int64_t)((g_dFrom + g_dLen) * 1.0e6)) : qwLen;
+	}
+	qwEnd = (qwEnd > qwLen) ? qwLen : qwEnd;
+
+	char szName[64];
+	int32_t lPrefix = snprintf(szName, sizeof(szName), "%s", g_szPrefix);
+	pszDecoderStreamName(dwStream, szName + lPrefix, sizeof(szName) - lPrefix);
+	FILE* fp = fopen(szName, "wb");
+	if (!fp)
+	{
+		printf("Can't create %s\n", szName);
+		return false;
+	}
+
+	bool bOk = true;
+	for (uint64_t qwPos = qwFirst; bOk && qwPos < qwEnd; )
+	{
+		uint32_t dwLen = (qwEnd - qwPos < EXTRACT_BLOCK) ? (uint32_t)(qwEnd - qwPos) : EXTRACT_BLOCK;
+		uint32_t dwRead = dwStreamReaderRead(pstReader, dwStream, qwPos, pbyBuffer, dwLen);
+		bOk = (dwRead == dwLen) && fwrite(pbyBuffer, 1, dwRead, fp) == dwRead;
+		qwPos += dwRead;
+		*pqwWritten += dwRead;
+	}
+	fclose(fp);
+	if (!bOk)
+		printf("Can't read stream %u from byte %llu on\n", dwStream, (unsigned long long)qwFirst);
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+vPrintInfo
+**************************************************************************
+*/
+
+static void vPrintInfo(const ST_STREAMREADER* pstReader, const char* szFileName)
+{
+	printf("%s: %u streams, %u chunks%s, %.2lf frames/s\n", szFileName, pstReader->dwStreams, pstReader->dwChunks,
+		pstReader->bIndexed ? "" : " (no index, the recording was not closed)", pstReader->dFrameRate);
+	for (uint32_t i = 0; i < pstReader->dwStreams; i++)
+	{
+		char szName[32];
+		uint64_t qwLen = qwStreamReaderLen(pstReader, i);
+		uint64_t qwStored = 0;
+		for (uint32_t j = pstReader->adwFirst[i]; j < pstReader->adwFirst[i + 1]; j++)
+			qwStored += pstReader->pstIndex[j].dwStoredLen;
+		printf("  %-14s %12llu bytes, %8.2lf s, %.2lf x smaller\n", pszDecoderStreamName(i, szName, sizeof(szName)), (unsigned long long)qwLen,
+			(pstReader->dFrameRate > 0) ? qwLen / pstReader->dFrameRate : 0.0, qwStored ? (double)qwLen / qwStored : 0.0);
+	}
+}
+
+
+
+/*
+**************************************************************************
+main
+**************************************************************************
+*/
+
+int main(int argc, char** argv)
+{
+	ST_STREAMREADER stReader;
+	const char*     szFileName = REC_WRITER_CONTAINER;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-from") && (i + 1 < argc))
+			g_dFrom = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-len") && (i + 1 < argc))
+			g_dLen = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-offset") && (i + 1 < argc))
+			g_llOffset = atoll(argv[++i]);
+		else if (!strcmp(argv[i], "-bytes") && (i + 1 < argc))
+			g_llBytes = atoll(argv[++i]);
+		else if (!strcmp(argv[i], "-stream") && (i + 1 < argc))
+			g_lStream = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+			g_szPrefix = argv[++i];
+		else if (!strcmp(argv[i], "-info"))
+			g_bInfo = true;
+		else if (argv[i][0] == '-')
+		{
+			printf("usage: %s [-from s] [-len s] [-offset bytes] [-bytes n] [-stream index] [-p prefix] [-info] [streams.rec]\n", argv[0]);
+			return 1;
+		}
+		else
+			szFileName = argv[i];
+	}
+	if (g_lStream >= REC_STREAM_NUM || g_dFrom < 0)
+	{
+		printf("Invalid stream or start\n");
+		return 1;
+	}
+
+	if (!bStreamReaderOpen(&stReader, szFileName))
+		return 1;
+	if (g_bInfo)
+	{
+		vPrintInfo(&stReader, szFileName);
+		vStreamReaderClose(&stReader);
+		return 0;
+	}
+	if (g_llOffset < 0 && stReader.dFrameRate <= 0 && (g_dFrom > 0 || g_dLen >= 0))
+		printf("%s has no frame rate, the times are placed at the chunk starts only\n", szFileName);
+
+	uint8_t* pbyBuffer = (uint8_t*)malloc(EXTRACT_BLOCK);
+	uint64_t qwWritten = 0;
+	bool bOk = pbyBuffer != NULL;
+	for (uint32_t i = 0; bOk && i < stReader.dwStreams; i++)
+		if (g_lStream < 0 || (uint32_t)g_lStream == i)
+			bOk = bExtractStream(&stReader, i, pbyBuffer, &qwWritten);
+	free(pbyBuffer);
+	vStreamReaderClose(&stReader);
+
+	printf("%.2lf MByte extracted to %sratX_chY.bin\n", (double)qwWritten / (1024 * 1024), g_szPrefix);
+	return bOk ? 0 : 1;
+}
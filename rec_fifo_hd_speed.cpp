@@ -10,6 +10,14 @@ this example supports all acquistion cards
 Does FIFO acquistion to hard disk to test the maximum writing performance
 of the hard disk
 
+With more than one card all cards can run at the same time, each with
+its own FIFO loop, decoder threads on own cores and output directory
+cardX_snY.
+
+If the processing can't follow, the governor (rec_governor) sheds plot,
+preview, stream compression and at last the decoding while the buffers
+fill up, the raw data always goes to disk.
+
 This program only runs under Windows as it uses some windows specific API
 calls for data writing, time measurement and key checking
 **************************************************************************
@@ -25,7 +33,6 @@ calls for data writing, time measurement and key checking
 // ----- new include files -----
 #include <Windows.h> // for Sleep func
 #include <math.h>
-#include "engine.h" // for matlab engine
 #include <typeinfo>
 
 //#include <Eigen/Dense> // for eigen
@@ -33,33 +40,55 @@ calls for data writing, time measurement and key checking
 #include <stdint.h>
 #include <inttypes.h>
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 // ----- include of common example librarys -----
 #include "../common/spcm_lib_card.h"
 #include "../common/spcm_lib_data.h"
 #include "../common/spcm_lib_thread.h"
 
+// ----- decoding chain -----
+#include "rec_cpu.h"
+#include "rec_multi.h"
+#include "rec_plot.h"
+#include "rec_preview.h"
+#include "rec_governor.h"
+#include "rec_writer.h"
+#include "rec_rawwriter.h"
+#include "rec_pipeline.h"
+#include "rec_metrics.h"
+
 
 // ----- global setup for the run (can be changed interactively) -----
 int32   g_lSamplingRate = MEGA(20);
 int32   g_lNotifySize = KILO_B(1024*16);
-int32   g_lBufferSize = MEGA_B(1024*32);
+int64   g_llBufferSize = MEGA_B(1024*32);
 bool    g_bThread = false;
 uint64  g_qwChannelEnable = 1;
 uint32  g_dwUpdateBuffers = 1;
-uint32  g_dwUpdateCount = 0;
 enum    { eStandard, eHDSpeedTest, eSpeedTest } g_eMode = eStandard;
+char    g_szPreamble[REC_PREAMBLE_MAX_BITS + 1] = REC_PREAMBLE_DEFAULT;
+int32   g_lPreambleErrors = 0;
+int32   g_lThresholdMode = REC_THRESHOLD_WINDOW;
+double  g_dHysteresis = 0;
+double  g_dSamplesPerSymbol = 0;
+uint32  g_dwSyncInterval = 0;
+bool    g_bStreamContainer = false;
+int32   g_lWriteDepth = REC_RAWWRITER_DEPTH;
+int32   g_lRawPackers = 0;
+bool    g_bPipeline = true;
+bool    g_bAllCards = false;
+bool    g_bMetrics = false;
+bool    g_bPreview = true;
+bool    g_bGovernor = true;
+int32   g_alNumaNode[MAXBRD];             // node of each card, the last one for the cards behind
+int32   g_lNumaNodes = 0;                 // 0: any node, threads left to the scheduler in single card mode
+bool    g_bRealtime = false;
+bool    g_bLargePages = true;
 
 #define FILENAME "500mVPP_500MHz_Squares"
-#define DATA_LENGTH 16777216
-
-//define getting average function
-double average(int16_t* array, int length) {
-	double sum = 0.0;
-	for (int i = 0; i < length; i++)
-		sum += *(array+i);
-	return sum / length;
-}
 
 /*
 **************************************************************************
@@ -91,6 +120,73 @@ bool bDoCardSetup(ST_SPCM_CARDINFO *pstCard)
 
 
 
+/*
+**************************************************************************
+placement: buffer length for the card library, cores and NUMA node of
+a card
+**************************************************************************
+*/
+
+// ----- the card library takes the buffer length in 32 bit: whole notify blocks below 4 GByte -----
+static uint32 dwLibBufferLen(int64 llBufferSize, int32 lNotifySize)
+{
+	int64 llMax = (int64)0xFFFFFFFF;
+	if (lNotifySize > 0)
+		llMax -= llMax % lNotifySize;
+	return (uint32)((llBufferSize > llMax) ? llMax : (llBufferSize > 0) ? llBufferSize : 0);
+}
+
+// ----- microseconds since 1970, the time of a block for the raw capture and the stream container -----
+static int64 llWallTimeUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int32 lCardNode(int32 lCard)
+{
+	if (g_lNumaNodes <= 0)
+		return REC_NODE_ANY;
+	return g_alNumaNode[(lCard < g_lNumaNodes) ? lCard : g_lNumaNodes - 1];
+}
+
+// ----- the cards of one node share its cores; without nodes all cards share all cores, a single card is left to the scheduler -----
+static void vCardCpus(ST_CPUSET* pstCpus, int32 lCard, int32 lCardCount, bool bAllCards)
+{
+	pstCpus->lFirst = pstCpus->lCount = 0;
+	pstCpus->lNode = lCardNode(lCard);
+	pstCpus->bRealtime = g_bRealtime;
+	pstCpus->bLargePages = g_bLargePages;
+
+	int32 lNodeFirst, lNodeCount;
+	if (bRecNodeCpus(pstCpus->lNode, &lNodeFirst, &lNodeCount))
+	{
+		int32 lShare = 1, lPos = 0;
+		if (bAllCards)
+		{
+			lShare = 0;
+			for (int32 j = 0; j < lCardCount; j++)
+				if (lCardNode(j) == pstCpus->lNode)
+				{
+					if (j < lCard)
+						lPos++;
+					lShare++;
+				}
+		}
+		int32 lPerCard = (lNodeCount >= lShare) ? lNodeCount / lShare : 1;
+		pstCpus->lFirst = lNodeFirst + (lPos * lPerCard) % lNodeCount;
+		pstCpus->lCount = lPerCard;
+	}
+	else if (bAllCards)
+	{
+		int32 lCores = lRecCpuCount();
+		int32 lPerCard = (lCores >= lCardCount) ? lCores / lCardCount : 1;
+		pstCpus->lFirst = (lCores >= lCardCount) ? lCard * lPerCard : lCard % lCores;
+		pstCpus->lCount = lPerCard;
+	}
+}
+
+
+
 /*
 **************************************************************************
 Working routine data
@@ -98,18 +194,153 @@ Working routine data
 */
 
 
+// ----- status of one card for the combined status line, written by the FIFO loop of the card -----
+struct ST_WORKSTATUS
+{
+	std::atomic<int64>  llTransferred;
+	std::atomic<int32>  lHwFill;            // promille
+	std::atomic<int32>  lSwFill;            // promille
+	std::atomic<double> dAverageSpeed;      // MB/s
+	std::atomic<bool>   bRunning;
+};
+
 struct ST_WORKDATA
 {
+	char            szOutDir[64];       // with separator, empty for the working directory
+	ST_CPUSET       stCpus;             // cores of the card, none in single card mode
+	ST_WORKSTATUS   stStatus;
+	uint32          dwUpdateCount;
 	int64           llWritten;
-	HANDLE          hFile;
+	ST_RAWWRITER    stRaw;
+	bool            bRaw;
 	char            szFileName[100];
 	LARGE_INTEGER   uStartTime;
 	LARGE_INTEGER   uLastTime;
 	LARGE_INTEGER   uHighResFreq;
+	ST_MULTIDECODER stDecoder;
+	ST_STREAMWRITER astWriter[REC_MAX_ADC];
+	int32           lWriters;
+	ST_PLOTSINK     stPlot;
+	bool            bPlot;
+	ST_PREVIEW      stPreview;          // envelopes for rec_view
+	bool            bPreview;
+	ST_PIPELINE     stPipe;
+	bool            bPipe;
+	ST_GOVERNOR     stGovernor;         // sheds work under overload
+	bool            bGovernor;
+	bool            bStreamGap;         // blocks were not decoded, the streams behind them start new buffers
+	ST_METRICS*     pstMetrics;         // stage timers and fill levels, NULL if off
 };
 
 
 
+/*
+**************************************************************************
+bWorkStreamLevel: overload level of a block for the stream writers, the
+container stores the chunks from REC_GOVERN_STORE on; the buffers are
+flushed in front of the first streams behind a gap, so the chunks keep
+their time
+**************************************************************************
+*/
+
+static bool bWorkStreamLevel(ST_WORKDATA * pstWorkData, int32 lLevel)
+{
+	bool bFlush = pstWorkData->bStreamGap && (lLevel < REC_GOVERN_RAW);
+	bool bOk = true;
+
+	for (int32 i = 0; i < pstWorkData->lWriters; i++)
+	{
+		vStreamWriterStore(&pstWorkData->astWriter[i], lLevel >= REC_GOVERN_STORE);
+		if (bFlush)
+			bOk = bStreamWriterFlush(&pstWorkData->astWriter[i]) && bOk;
+	}
+	pstWorkData->bStreamGap = (lLevel >= REC_GOVERN_RAW);
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+bWorkOutput: raw data, stream files and plots of one decoded block
+**************************************************************************
+*/
+
+bool bWorkOutput(void * pvWorkData, ST_PIPEBLOCK * pstBlock)
+{
+	ST_WORKDATA* pstWorkData = (ST_WORKDATA *)pvWorkData;
+
+	uint64_t qwTime = qwMetricsStart(pstWorkData->pstMetrics);
+	if (!bWorkStreamLevel(pstWorkData, pstBlock->lLevel))
+	{
+		printf("\nStream write error\n");
+		return false;
+	}
+	for (int32 i = 0; i < pstWorkData->lWriters; i++)
+	{
+		ST_PIPESTREAMS* pstStreams = &pstBlock->astChannel[i];
+		if ((pstStreams->dwStreamLen && !bStreamWriterAppend(&pstWorkData->astWriter[i], pstStreams->apbyStream, pstStreams->dwStreamLen, pstBlock->llTimeUs))
+			|| !bStreamWriterLog(&pstWorkData->astWriter[i], pstStreams->astEvent, pstStreams->dwEvents, g_lSamplingRate))
+		{
+			printf("\nStream write error\n");
+			return false;
+		}
+	}
+
+	qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_STREAMS, qwTime);
+
+	// the plot shows the first analog channel
+	if (pstWorkData->bPlot && (pstBlock->lLevel < REC_GOVERN_NOPLOT) && pstBlock->astChannel[0].bRecording)
+	{
+		vPlotSinkPost(&pstWorkData->stPlot, pstBlock->astChannel[0].apbyStream, pstBlock->astChannel[0].dwStreamLen);
+		qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_PLOT, qwTime);
+	}
+
+	// the live preview is a few cache lines in shared memory, the viewers never hold the loop up
+	if (pstWorkData->bPreview)
+	{
+		ST_PIPESTREAMS* pstStreams = &pstBlock->astChannel[0];
+		uint32 dwStreamLen = pstStreams->bRecording ? pstStreams->dwStreamLen : 0;
+		if (pstBlock->lLevel < REC_GOVERN_NOPLOT)
+			vPreviewPublish(&pstWorkData->stPreview, pstBlock->pnSamples, pstBlock->dwBytes / sizeof(int16_t),
+				pstStreams->bRecording ? pstStreams->apbyStream : NULL, dwStreamLen, pstBlock->llTimeUs);
+		else
+			vPreviewSkip(&pstWorkData->stPreview, pstBlock->dwBytes / sizeof(int16_t), dwStreamLen);
+		qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_PREVIEW, qwTime);
+	}
+
+	ST_RAWSTAMP stStamp = { pstBlock->llTimeUs, pstBlock->lHwFill, pstBlock->lSwFill };
+	if (!bRawWriterQueue(&pstWorkData->stRaw, pstBlock->pnSamples, pstBlock->dwBytes, &stStamp))
+	{
+		printf("\nData Write error\n");
+		return false;
+	}
+	qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_RAW, qwTime);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+lDecodeChannels: analog channels in the data, digital cards deliver all
+lines in one 16 bit word
+**************************************************************************
+*/
+
+int32 lDecodeChannels(ST_SPCM_CARDINFO * pstCard)
+{
+	int32 lChannels = 0;
+
+	if (!pstCard || (pstCard->eCardFunction != AnalogIn))
+		return 1;
+	for (uint64 qwMask = g_qwChannelEnable; qwMask; qwMask &= qwMask - 1)
+		lChannels++;
+	return lChannels;
+}
+
+
+
 /*
 **************************************************************************
 Setup working routine
@@ -121,29 +352,125 @@ bool bWorkInit(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
 	ST_WORKDATA* pstWorkData = (ST_WORKDATA *)pvWorkData;
 
 	// setup for the transfer, to avoid overrun we use quite large blocks as this has a better throughput to hard disk
-	pstBufferData->dwDataBufLen = g_lBufferSize;
+	pstBufferData->dwDataBufLen = dwLibBufferLen(g_llBufferSize, g_lNotifySize);
 	pstBufferData->dwDataNotify = g_lNotifySize;
 
 	// setup for the work
 	pstWorkData->llWritten = 0;
+	pstWorkData->bRaw = pstWorkData->bPlot = pstWorkData->bPreview = pstWorkData->bPipe = false;
+	pstWorkData->bGovernor = pstWorkData->bStreamGap = false;
+	pstWorkData->lWriters = 0;
+	pstWorkData->dwUpdateCount = g_dwUpdateBuffers;
+	pstWorkData->pstMetrics = NULL;
 
-	sprintf(pstWorkData->szFileName, "%s.bin", FILENAME);
+	sprintf(pstWorkData->szFileName, "%s%s%s", pstWorkData->szOutDir, FILENAME, REC_RAWFILE_EXT);
 
-	printf("\n");
-	printf("Written      HW-Buf      SW-Buf   Average   Current\n-----------------------------------------------------\n");
-	if ((g_eMode == eStandard) || (g_eMode == eHDSpeedTest))
-		pstWorkData->hFile = CreateFile(pstWorkData->szFileName,
-		GENERIC_WRITE,
-		FILE_SHARE_READ | FILE_SHARE_WRITE,
-		NULL,
-		CREATE_ALWAYS,
-		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING,
-		NULL);
+	// with all cards the main thread prints one status line for all
+	if (!g_bAllCards)
+	{
+		printf("\n");
+		printf("Written      HW-Buf      SW-Buf   Average   Current   Disk Lat\n----------------------------------------------------------------\n");
+	}
 
 	QueryPerformanceFrequency(&pstWorkData->uHighResFreq);
 	pstWorkData->uStartTime.QuadPart = 0;
 
-	return ((pstWorkData->hFile != NULL) || (g_eMode == eSpeedTest));
+	// one decoder per analog channel, all working buffers are allocated and locked here, none in the FIFO loop
+	if (!bMultiDecoderInit(&pstWorkData->stDecoder, lDecodeChannels(pstBufferData->pstCard), g_lNotifySize / sizeof(int16_t), g_szPreamble, g_lPreambleErrors, &pstWorkData->stCpus))
+	{
+		printf("\nInvalid preamble setup or no memory for the decoder\n");
+		return false;
+	}
+	if (!bMultiDecoderSetThreshold(&pstWorkData->stDecoder, g_lThresholdMode, g_dHysteresis))
+	{
+		printf("\nInvalid slicer hysteresis %.1lf\n", g_dHysteresis);
+		return false;
+	}
+	if (g_dSamplesPerSymbol > 0 && !bMultiDecoderSetTiming(&pstWorkData->stDecoder, REC_TIMING_TRACK, g_dSamplesPerSymbol))
+	{
+		printf("\nInvalid symbol timing of %.2lf samples per symbol or no memory\n", g_dSamplesPerSymbol);
+		return false;
+	}
+	if (g_dwSyncInterval && !bMultiDecoderSetLock(&pstWorkData->stDecoder, g_dwSyncInterval))
+	{
+		printf("\nNo memory for the frame lock\n");
+		return false;
+	}
+
+	// stage timers, the budget of a block is its time at the sampling rate
+	if (g_bMetrics)
+	{
+		double dBlockBudget = (double)g_lNotifySize / ((double)g_lSamplingRate * pstWorkData->stDecoder.lChannels * sizeof(int16_t));
+		pstWorkData->pstMetrics = pstMetricsStart(pstWorkData->szOutDir, REC_METRICS_PERIOD, dBlockBudget);
+		if (!pstWorkData->pstMetrics)
+			return false;
+		vMultiDecoderSetMetrics(&pstWorkData->stDecoder, pstWorkData->pstMetrics);
+	}
+
+	// the raw data is written by overlapped I/O from a ring of g_lWriteDepth blocks, packed by g_lRawPackers threads if set;
+	// the header of the capture holds the setup of the card
+	if ((g_eMode == eStandard) || (g_eMode == eHDSpeedTest))
+	{
+		ST_SPCM_CARDINFO* pstCard = pstBufferData->pstCard;
+		ST_RAWSETUP stSetup;
+		stSetup.llSamplingRate = pstCard->lSetSamplerate;
+		stSetup.qwChannelMask = g_qwChannelEnable;
+		stSetup.lChannels = pstWorkData->stDecoder.lChannels;
+		stSetup.lBytesPerSample = (pstCard->eCardFunction == AnalogIn) ? pstCard->lBytesPerSample : (int32)sizeof(int16_t);
+		stSetup.lCardType = pstCard->lCardType;
+		stSetup.lSerialNumber = pstCard->lSerialNumber;
+		if (!bRawWriterOpen(&pstWorkData->stRaw, pstWorkData->szFileName, g_lNotifySize, &stSetup, g_lWriteDepth, g_lRawPackers, &pstWorkData->stCpus))
+			return false;
+		pstWorkData->bRaw = true;
+	}
+
+	// the stream files stay open for the whole run, adcX_ in front of the names with several channels;
+	// one byte per stream and frame, the sync words take their symbols too
+	double dSamplesPerSymbol = (g_dSamplesPerSymbol > 0) ? g_dSamplesPerSymbol : REC_DOWN_SAMPLING_RATE;
+	double dFrameRate = g_lSamplingRate / (dSamplesPerSymbol * (REC_FRAME_SIZE + (g_dwSyncInterval ? (double)strlen(REC_LOCK_SYNC_DEFAULT) / g_dwSyncInterval : 0)));
+	if (g_eMode != eSpeedTest)
+		for (int32 i = 0; i < pstWorkData->stDecoder.lChannels; i++)
+		{
+			char szAdc[16], szPrefix[REC_WRITER_PATH_MAX];
+			snprintf(szPrefix, sizeof(szPrefix), "%s%s", pstWorkData->szOutDir, pszMultiPrefix(&pstWorkData->stDecoder, i, szAdc, sizeof(szAdc)));
+			if (!bStreamWriterOpen(&pstWorkData->astWriter[i], g_bStreamContainer, szPrefix, dFrameRate))
+				return false;
+			pstWorkData->lWriters = i + 1;
+		}
+
+	// MATLAB is opened once for the whole run, we record without plots if it is missing
+	if (g_eMode != eSpeedTest)
+		pstWorkData->bPlot = bPlotSinkInit(&pstWorkData->stPlot);
+
+	// live preview in shared memory named after the output directory of the card
+	if (g_bPreview && (g_eMode != eSpeedTest))
+	{
+		char szTag[64];
+		strcpy(szTag, pstWorkData->szOutDir);
+		size_t dwTagLen = strlen(szTag);
+		if (dwTagLen)
+			szTag[dwTagLen - 1] = 0;
+		pstWorkData->bPreview = bPreviewOpen(&pstWorkData->stPreview, szTag, pstWorkData->stDecoder.lChannels, g_lSamplingRate, dFrameRate);
+		if (!pstWorkData->bPreview)
+			printf("\nNo shared memory for the live preview, recording without\n");
+	}
+
+	// the governor watches the fill of every block, the raw capture is never shed
+	if (g_bGovernor && (g_eMode != eSpeedTest))
+	{
+		vGovernorInit(&pstWorkData->stGovernor, pstWorkData->szOutDir);
+		pstWorkData->bGovernor = true;
+	}
+
+	// decoding and writing on own threads, the FIFO loop only copies the block
+	if (g_bPipeline && (g_eMode != eSpeedTest))
+	{
+		pstWorkData->bPipe = true;
+		if (!bPipelineStart(&pstWorkData->stPipe, &pstWorkData->stDecoder, bWorkOutput, pstWorkData, g_lNotifySize, REC_PIPELINE_BLOCKS, &pstWorkData->stCpus))
+			return false;
+	}
+
+	return true;
 }
 
 
@@ -185,556 +512,84 @@ bool bWorkDo(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
 		pstWorkData->uLastTime.QuadPart = uTime.QuadPart;
 	}
 
+	// arrival and fill levels of every block for the time series, the block heads of the raw capture and the stream chunks
+	uint64_t qwBlockTime = qwMetricsStart(pstWorkData->pstMetrics);
+	ST_RAWSTAMP stStamp = { llWallTimeUs(), -1, (int32)(1000.0 * pstBufferData->dwDataAvailBytes / pstBufferData->dwDataBufLen) };
+	if (pstWorkData->pstMetrics || pstWorkData->bRaw || pstWorkData->bGovernor)
+	{
+		spcm_dwGetParam_i64(pstBufferData->pstCard->hDrv, SPC_FILLSIZEPROMILLE, &llBufferFillPromille);
+		stStamp.lHwFill = (int32)llBufferFillPromille;
+		if (pstWorkData->pstMetrics)
+			vMetricsFill(pstWorkData->pstMetrics, (int32)llBufferFillPromille, pstBufferData->dwDataAvailBytes);
+	}
+
+	// work of the block under overload, the first sample of a channel dates the changes
+	int32 lLevel = REC_GOVERN_FULL;
+	if (pstWorkData->bGovernor)
+		lLevel = lGovernorDo(&pstWorkData->stGovernor, stStamp.lHwFill, stStamp.lSwFill,
+			(uint64)pstWorkData->llWritten / (sizeof(int16_t) * pstWorkData->stDecoder.lChannels));
+
 	// write the data and count the samples
 	if (g_eMode == eSpeedTest)
 		dwWritten = pstBufferData->dwDataNotify;
-	else {
-		/*************************** signal plot in matlab ***********************/		
-		static int recording_flag = 0;
-		//open matlab engine
-		Engine *ep;
-		mxArray *T = NULL;
-
-		if (!(ep = engOpen(""))) {
-			fprintf(stderr, "\nCan't start MATLAB engine\n");
-			return EXIT_FAILURE;
-		}
-
-		//define T(matlab array)
-		const size_t dims[2] = { pstBufferData->dwDataNotify / sizeof(int16_t), 1 };
-		T = mxCreateNumericArray(1, dims, mxINT16_CLASS, mxREAL);
-
-		//copy signal_int16 to T		
-		int16_t* signal_int16 = (int16_t *)malloc(pstBufferData->dwDataNotify);
-		int16_t* signal_int16_addr = signal_int16;
-		signal_int16 = (int16_t *)mxGetData(T);
-
-		memcpy(signal_int16, pstBufferData->pvDataCurrentBuf, (pstBufferData->dwDataNotify));
-	
-		//print T using matlab
-		engPutVariable(ep, "T", T);
-
-		/************************  signal process  ****************************/
-		// signal_int16(=input_signal) exist from 0 to 8388607		
-		// define variables
-		static int loop_count = 1; //loop_count starting at 1
-		static int num_samples_from_prev = 0;
-		static int num_remain_samples = 0;
-
-		if (loop_count == 1) {
-			num_samples_from_prev = 0;
-		}
-		else {
-			num_samples_from_prev = num_remain_samples;
-		}
-
-		const int number_of_samples = DATA_LENGTH / 2;
-		const int down_sampling_rate = 10;
-		const int looking_window_size = 200;
-		int moving_flag = 0;
-		double th = 0;
-		int processed_signal_size = floor(number_of_samples / down_sampling_rate);
 
-		int16_t* tmp_signal = (int16_t*)malloc((number_of_samples + down_sampling_rate) * sizeof(int16_t));
+	// pipeline: the block is copied and goes back to the card, the threads do the rest
+	else if (pstWorkData->bPipe)
+		dwWritten = bPipelinePush(&pstWorkData->stPipe, pstBufferData->pvDataCurrentBuf, pstBufferData->dwDataNotify, stStamp.lHwFill, stStamp.lSwFill, lLevel, stStamp.llTimeUs) ? pstBufferData->dwDataNotify : 0;
 
-		static int16_t* samples_from_prev = (int16_t*)malloc(down_sampling_rate * sizeof(int16_t));
-		static int16_t* remain_samples = (int16_t*)malloc(down_sampling_rate * sizeof(int16_t));
-	
-		// regenerate input_signal using prev signal
-		memcpy(tmp_signal, signal_int16, number_of_samples * sizeof(int16_t));
-		memcpy(signal_int16, samples_from_prev, num_samples_from_prev * sizeof(int16_t));
-		memcpy(signal_int16 + num_samples_from_prev, tmp_signal, number_of_samples * sizeof(int16_t));
-
-		// save remainder signal to next loop's prev signal
-		num_remain_samples = (num_samples_from_prev + number_of_samples) % down_sampling_rate;
-		memcpy(remain_samples, signal_int16 + num_samples_from_prev + number_of_samples - num_remain_samples, num_remain_samples*sizeof(int16_t));
-		memcpy(samples_from_prev, remain_samples, num_remain_samples * sizeof(int16_t));
-
-		// change input signal to be multiple of 10, copy signal_int16 to input_signal
-		int16_t* input_signal = (int16_t*)malloc((num_samples_from_prev + number_of_samples - num_remain_samples) * sizeof(int16_t));
-		memcpy(input_signal, signal_int16, (num_samples_from_prev + number_of_samples - num_remain_samples) * sizeof(int16_t));
-
-		processed_signal_size = floor((num_samples_from_prev + number_of_samples - num_remain_samples) / down_sampling_rate);
-		printf("\n processed_signal_size = %d \n", processed_signal_size);
-		
-		int16_t* answer_signal = (int16_t*)malloc(processed_signal_size * sizeof(int16_t));
-		int16_t* out_signal = (int16_t*)malloc(processed_signal_size * sizeof(int16_t));
-
-		//print signal
-		static int cnt_signal = 0;
-		cnt_signal++;
-
-		//for testing samples
-		//if (1 <= loop_count <= 4) {
-		//	printf("\n loop_count = %d and num_samples_from_prev = %d and num_remains_samples = %d \n", loop_count, num_samples_from_prev, num_remain_samples);
-		//	for (int i = 0; i < 15; i++) {
-		//		//printf("\n\n %d th samples_from_prev = %hd", i, *(samples_from_prev + i));
-		//		printf("\n\n %d th input_signal = %hd", i, *(input_signal + i));
-		//	}
-		//	printf("\n--------------------------------\n");
-		//	for (int i = 8388590; i < 8388615; i++) {
-		//		printf("\n\n %d th input_signal = %hd", i, *(input_signal + i));
-		//	}
-		//}
-
-		// make answer_signal as 0
-		for (int i = 0; i < processed_signal_size; i++) {
-			answer_signal[i] = 0;
+	else {
+		// decode the block: slicer, preamble and demux of each analog channel; under full overload the decoders only count on
+		if (lLevel >= REC_GOVERN_RAW)
+			vMultiDecoderSkip(&pstWorkData->stDecoder, pstBufferData->dwDataNotify / sizeof(int16_t));
+		else if (!bMultiDecoderDo(&pstWorkData->stDecoder, (int16_t*)pstBufferData->pvDataCurrentBuf, pstBufferData->dwDataNotify / sizeof(int16_t)))
+		{
+			printf("\nDecoder error\n");
+			return false;
 		}
-		
-		//main procedure
-		for (int i = 0; i < processed_signal_size; i++) {
-			if (i % looking_window_size == 0) {
-				if (i*down_sampling_rate + 1 <= number_of_samples && (i + 1)*down_sampling_rate + down_sampling_rate*looking_window_size <= number_of_samples) {
-					th = average(input_signal + i*down_sampling_rate, down_sampling_rate*looking_window_size);
-					//printf("\n\n if case, i = %d and th = %f", i, th);
-				}
-				else {
-					th = average(input_signal + down_sampling_rate*(processed_signal_size - looking_window_size), down_sampling_rate*looking_window_size);
-					//printf("\n\n else case, i = %d and th = %f", i, th);
-				}
-			}
 
-			//// create answer_signal
-			//int num_amend = 1000;
-			//if (i % num_amend == 0) {
-			//	if (i < 838000) {
-			//		if (average(input_signal + down_sampling_rate*i, down_sampling_rate * 1) >= th) {
-			//			for (int ii = 0; ii < num_amend; ii++) {
-			//				if (ii % 2 == 0) {
-			//					answer_signal[i + ii] = 1;
-			//				}
-			//			}
-			//		}
-			//		else {
-			//			for (int ii = 0; ii < num_amend; ii++) {
-			//				if (ii % 2 == 1) {
-			//					answer_signal[i + ii] = 1;
-			//				}
-			//			}
-			//		}
-			//		//for print th and average value
-			//		//printf("\n th = %f \n", th);
-			//		//printf("\n average = %f \n", average(input_signal + down_sampling_rate*i, down_sampling_rate * 1));
-			//	}
-
-			//	// when i >= 830000
-			//	else {
-			//		if (average(input_signal + down_sampling_rate*i, down_sampling_rate * 1) >= th) {
-			//			for (int ii = i; ii < processed_signal_size; ii++) {
-			//				if (ii % 2 == 0) {
-			//					answer_signal[ii] = 1;
-			//				}
-			//			}
-			//		}
-			//		else {
-			//			for (int ii = i; ii < processed_signal_size; ii++) {
-			//				if (ii % 2 == 1) {
-			//					answer_signal[ii] = 1;
-			//				}
-			//			}
-			//		}
-			//	}
-			//}
-			if (average(input_signal + down_sampling_rate*i, down_sampling_rate * 1) >= th)
-				out_signal[i] = 1;
-			else
-				out_signal[i] = 0;
+		// the writers only copy the streams, the disk sees them when their buffers are full
+		uint64_t qwTime = qwMetricsStart(pstWorkData->pstMetrics);
+		if (!bWorkStreamLevel(pstWorkData, lLevel))
+		{
+			printf("\nStream write error\n");
+			return false;
 		}
-		
-		//print the answer_signal and input_signal togheter
-		//for (int i = 838800; i < 838810; i++) {
-		//	printf("\n---------------------------------\n");
-		//	printf("%d th output_signal = %d and answer_signal = %d", i, out_signal[i], answer_signal[i]);
-		//	printf("\n\n");
-		//}
-
-		//plot the out_signal
-		//int count_differ = 0;
-		//for (int i = 0; i < processed_signal_size-1; i++) {
-		//	if (out_signal[i] == out_signal[i + 1]) {
-		//		count_differ++;
-		//	}
-		//}
-
-		//printf("%d", count_differ);
-
-		//print the accuracy
-		//int number_of_correct_samples = 0;
-		//for (int i = 0; i < processed_signal_size; i++) {
-		//	if (out_signal[i] == answer_signal[i])
-		//		number_of_correct_samples++;
-		//}
-
-		//double whole_accuracy = ((double)number_of_correct_samples / (double)processed_signal_size) * 100;
-		//printf("\n %d th correct samples = %d \n", loop_count, number_of_correct_samples);
-		//printf("\n %d th processed_signal_size = %d \n", loop_count, processed_signal_size);
-		//printf("\n\n %d th loop's whole accuracy = %f \n", loop_count, whole_accuracy);
-
-		//recording_flaging using preamble
-		static const int preamble_size = 16;
-		int third_1_cnt = 0;
-		int third_0_cnt = 0;
-		int fourth_1_cnt = 0;
-		int fourth_0_cnt = 0;
-		int fifth_1_cnt = 0;
-		int fifth_0_cnt = 0;
-		int sixth_1_cnt = 0;
-		int sixth_0_cnt = 0;
-
-		if (recording_flag == 0) {
-			for (int i = 0; i < processed_signal_size - 16; i++) {
-				if (out_signal[i] == 1 && out_signal[i + 1] == 0 && out_signal[i + 2] == 1 && out_signal[i + 3] == 0) {
-					if (out_signal[i + 4] == 1 && out_signal[i + 5] == 1 && out_signal[i + 6] == 0 && out_signal[i + 7] == 0) {
-						for (int j = 1; j <= 4; j++) {
-							if (out_signal[i + 7 + j] == 1) {
-								third_1_cnt++;
-							}
-							if (out_signal[i + 11 + j] == 0) {
-								third_0_cnt++;
-							}
-						}
-						//third_1_cnt = 3;
-						//third_0_cnt = 4;
-
-						if (third_1_cnt == 4 && third_0_cnt == 4) {
-							for (int j = 1; j <= 8; j++) {
-								if (out_signal[i + 15 + j] == 1) {
-									fourth_1_cnt++;
-								}
-								if (out_signal[i + 23 + j] == 0) {
-									fourth_0_cnt++;
-								}
-							}
-							
-							if (fourth_1_cnt == 8 && fourth_0_cnt == 8) {
-								for (int j = 1; j <= 16; j++) {
-									if (out_signal[i + 31 + j] == 1) {
-										fifth_1_cnt++;
-									}
-									if (out_signal[i + 47 + j] == 0) {
-										fifth_0_cnt++;
-									}
-								}
-								if (fifth_1_cnt == 16 && fifth_0_cnt == 16) {
-									for (int j = 1; j <= 32; j++) {
-										if (out_signal[i + 63 + j] == 1) {
-											sixth_1_cnt++;
-										}
-									}
-									for (int j = 1; j <= 23; j++) {
-										if (out_signal[i + 95 + j] == 0) {
-											sixth_0_cnt++;
-										}
-									}
-									if (sixth_1_cnt == 32 && sixth_0_cnt == 23) {
-										recording_flag = 1;
-										memcpy(out_signal, out_signal + preamble_size, processed_signal_size - i - preamble_size);
-										processed_signal_size = processed_signal_size - i - preamble_size;
-									}
-								}
-								
-							}
-						}
-					}
-					third_1_cnt = 0;
-					third_0_cnt = 0;
-					fourth_1_cnt = 0;
-					fourth_0_cnt = 0;
-					fifth_1_cnt = 0;
-					fifth_0_cnt = 0;
-					sixth_1_cnt = 0;
-					sixth_0_cnt = 0;
-				}
+		for (int32 i = 0; i < pstWorkData->lWriters; i++)
+		{
+			ST_DECODER* pstDecoder = &pstWorkData->stDecoder.astDecoder[i];
+			if ((pstDecoder->dwStreamLen && !bStreamWriterAppend(&pstWorkData->astWriter[i], pstDecoder->apbyStream, pstDecoder->dwStreamLen, stStamp.llTimeUs))
+				|| !bStreamWriterLog(&pstWorkData->astWriter[i], pstDecoder->stLock.astEvent, pstDecoder->stLock.dwEvents, g_lSamplingRate))
+			{
+				printf("\nStream write error\n");
+				return false;
 			}
 		}
 
-		if (recording_flag == 1) {
-			//*************signal separation rat1, rat2 and 8 channels**************//
-			const static int CHANNEL_NUM = 8;
-			const static int BITS_NUM = 8 * 2;
-			static int starting_point = 0;
-			int k = 0;
-			uint8_t* tmp_full_storage = (uint8_t*)malloc(128 * sizeof(uint8_t));
-			static uint8_t* tmp_storage = (uint8_t*)malloc(128 * (sizeof(uint8_t)));
-
-			//define T(matlab array)
-			mxArray *T_RAT1_CH1 = NULL; mxArray *T_RAT2_CH1 = NULL;
-			mxArray *T_RAT1_CH2 = NULL; mxArray *T_RAT2_CH2 = NULL;
-			mxArray *T_RAT1_CH3 = NULL; mxArray *T_RAT2_CH3 = NULL;
-			mxArray *T_RAT1_CH4 = NULL; mxArray *T_RAT2_CH4 = NULL;
-			mxArray *T_RAT1_CH5 = NULL; mxArray *T_RAT2_CH5 = NULL;
-			mxArray *T_RAT1_CH6 = NULL; mxArray *T_RAT2_CH6 = NULL;
-			mxArray *T_RAT1_CH7 = NULL; mxArray *T_RAT2_CH7 = NULL;
-			mxArray *T_RAT1_CH8 = NULL; mxArray *T_RAT2_CH8 = NULL;
-
-			uint8_t* rat1_ch1 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch1 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch2 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch2 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch3 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch3 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch4 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch4 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch5 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch5 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch6 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch6 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch7 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch7 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat1_ch8 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-			uint8_t* rat2_ch8 = (uint8_t*)malloc((int)processed_signal_size / BITS_NUM * sizeof(uint8_t));
-
-			const size_t rat1_ch1_dims[2] = { floor(processed_signal_size / BITS_NUM / 8), 1 };
-			T_RAT1_CH1 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH1 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH2 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH2 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH3 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH3 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH4 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH4 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH5 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH5 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH6 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH6 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH7 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH7 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT1_CH8 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-			T_RAT2_CH8 = mxCreateNumericArray(1, rat1_ch1_dims, mxUINT8_CLASS, mxREAL);
-
-			rat1_ch1 = (uint8_t *)mxGetData(T_RAT1_CH1); rat2_ch1 = (uint8_t *)mxGetData(T_RAT2_CH1);
-			rat1_ch2 = (uint8_t *)mxGetData(T_RAT1_CH2); rat2_ch2 = (uint8_t *)mxGetData(T_RAT2_CH2);
-			rat1_ch3 = (uint8_t *)mxGetData(T_RAT1_CH3); rat2_ch3 = (uint8_t *)mxGetData(T_RAT2_CH3);
-			rat1_ch4 = (uint8_t *)mxGetData(T_RAT1_CH4); rat2_ch4 = (uint8_t *)mxGetData(T_RAT2_CH4);
-			rat1_ch5 = (uint8_t *)mxGetData(T_RAT1_CH5); rat2_ch5 = (uint8_t *)mxGetData(T_RAT2_CH5);
-			rat1_ch6 = (uint8_t *)mxGetData(T_RAT1_CH6); rat2_ch6 = (uint8_t *)mxGetData(T_RAT2_CH6);
-			rat1_ch7 = (uint8_t *)mxGetData(T_RAT1_CH7); rat2_ch7 = (uint8_t *)mxGetData(T_RAT2_CH7);
-			rat1_ch8 = (uint8_t *)mxGetData(T_RAT1_CH8); rat2_ch8 = (uint8_t *)mxGetData(T_RAT2_CH8);
-
-			//main procedure of decoding from CDMA encoded signal
-			memcpy(tmp_full_storage, tmp_storage, starting_point);
-			memcpy(tmp_full_storage + starting_point, out_signal, 128 - starting_point);
-
-			if (starting_point != 0) {
-				rat1_ch1[0] = tmp_full_storage[0] * 128 + tmp_full_storage[2] * 64 + tmp_full_storage[4] * 32 + tmp_full_storage[6] * 16 + tmp_full_storage[8] * 8 + tmp_full_storage[10] * 4 + tmp_full_storage[12] * 2 + tmp_full_storage[14] * 1;
-				rat2_ch1[0] = tmp_full_storage[0 + 1] * 128 + tmp_full_storage[2 + 1] * 64 + tmp_full_storage[4 + 1] * 32 + tmp_full_storage[6 + 1] * 16 + tmp_full_storage[8 + 1] * 8 + tmp_full_storage[10 + 1] * 4 + tmp_full_storage[12 + 1] * 2 + tmp_full_storage[14 + 1] * 1;
-				rat1_ch2[0] = tmp_full_storage[16 * 1 + 0] * 128 + tmp_full_storage[16 * 1 + 2] * 64 + tmp_full_storage[16 * 1 + 4] * 32 + tmp_full_storage[16 * 1 + 6] * 16 + tmp_full_storage[16 * 1 + 8] * 8 + tmp_full_storage[16 * 1 + 10] * 4 + tmp_full_storage[16 * 1 + 12] * 2 + tmp_full_storage[16 * 1 + 14] * 1;
-				rat2_ch2[0] = tmp_full_storage[16 * 1 + 0 + 1] * 128 + tmp_full_storage[16 * 1 + 2 + 1] * 64 + tmp_full_storage[16 * 1 + 4 + 1] * 32 + tmp_full_storage[16 * 1 + 6 + 1] * 16 + tmp_full_storage[16 * 1 + 8 + 1] * 8 + tmp_full_storage[16 * 1 + 10 + 1] * 4 + tmp_full_storage[16 * 1 + 12 + 1] * 2 + tmp_full_storage[16 * 1 + 14 + 1] * 1;
-				rat1_ch3[0] = tmp_full_storage[16 * 2 + 0] * 128 + tmp_full_storage[16 * 2 + 2] * 64 + tmp_full_storage[16 * 2 + 4] * 32 + tmp_full_storage[16 * 2 + 6] * 16 + tmp_full_storage[16 * 2 + 8] * 8 + tmp_full_storage[16 * 2 + 10] * 4 + tmp_full_storage[16 * 2 + 12] * 2 + tmp_full_storage[16 * 2 + 14] * 1;
-				rat2_ch3[0] = tmp_full_storage[16 * 2 + 0 + 1] * 128 + tmp_full_storage[16 * 2 + 2 + 1] * 64 + tmp_full_storage[16 * 2 + 4 + 1] * 32 + tmp_full_storage[16 * 2 + 6 + 1] * 16 + tmp_full_storage[16 * 2 + 8 + 1] * 8 + tmp_full_storage[16 * 2 + 10 + 1] * 4 + tmp_full_storage[16 * 2 + 12 + 1] * 2 + tmp_full_storage[16 * 2 + 14 + 1] * 1;
-				rat1_ch4[0] = tmp_full_storage[16 * 3 + 0] * 128 + tmp_full_storage[16 * 3 + 2] * 64 + tmp_full_storage[16 * 3 + 4] * 32 + tmp_full_storage[16 * 3 + 6] * 16 + tmp_full_storage[16 * 3 + 8] * 8 + tmp_full_storage[16 * 3 + 10] * 4 + tmp_full_storage[16 * 3 + 12] * 2 + tmp_full_storage[16 * 3 + 14] * 1;
-				rat2_ch4[0] = tmp_full_storage[16 * 3 + 0 + 1] * 128 + tmp_full_storage[16 * 3 + 2 + 1] * 64 + tmp_full_storage[16 * 3 + 4 + 1] * 32 + tmp_full_storage[16 * 3 + 6 + 1] * 16 + tmp_full_storage[16 * 3 + 8 + 1] * 8 + tmp_full_storage[16 * 3 + 10 + 1] * 4 + tmp_full_storage[16 * 3 + 12 + 1] * 2 + tmp_full_storage[16 * 3 + 14 + 1] * 1;
-				rat1_ch5[0] = tmp_full_storage[16 * 4 + 0] * 128 + tmp_full_storage[16 * 4 + 2] * 64 + tmp_full_storage[16 * 4 + 4] * 32 + tmp_full_storage[16 * 4 + 6] * 16 + tmp_full_storage[16 * 4 + 8] * 8 + tmp_full_storage[16 * 4 + 10] * 4 + tmp_full_storage[16 * 4 + 12] * 2 + tmp_full_storage[16 * 4 + 14] * 1;
-				rat2_ch5[0] = tmp_full_storage[16 * 4 + 0 + 1] * 128 + tmp_full_storage[16 * 4 + 2 + 1] * 64 + tmp_full_storage[16 * 4 + 4 + 1] * 32 + tmp_full_storage[16 * 4 + 6 + 1] * 16 + tmp_full_storage[16 * 4 + 8 + 1] * 8 + tmp_full_storage[16 * 4 + 10 + 1] * 4 + tmp_full_storage[16 * 4 + 12 + 1] * 2 + tmp_full_storage[16 * 4 + 14 + 1] * 1;
-				rat1_ch6[0] = tmp_full_storage[16 * 5 + 0] * 128 + tmp_full_storage[16 * 5 + 2] * 64 + tmp_full_storage[16 * 5 + 4] * 32 + tmp_full_storage[16 * 5 + 6] * 16 + tmp_full_storage[16 * 5 + 8] * 8 + tmp_full_storage[16 * 5 + 10] * 4 + tmp_full_storage[16 * 5 + 12] * 2 + tmp_full_storage[16 * 5 + 14] * 1;
-				rat2_ch6[0] = tmp_full_storage[16 * 5 + 0 + 1] * 128 + tmp_full_storage[16 * 5 + 2 + 1] * 64 + tmp_full_storage[16 * 5 + 4 + 1] * 32 + tmp_full_storage[16 * 5 + 6 + 1] * 16 + tmp_full_storage[16 * 5 + 8 + 1] * 8 + tmp_full_storage[16 * 5 + 10 + 1] * 4 + tmp_full_storage[16 * 5 + 12 + 1] * 2 + tmp_full_storage[16 * 5 + 14 + 1] * 1;
-				rat1_ch7[0] = tmp_full_storage[16 * 6 + 0] * 128 + tmp_full_storage[16 * 6 + 2] * 64 + tmp_full_storage[16 * 6 + 4] * 32 + tmp_full_storage[16 * 6 + 6] * 16 + tmp_full_storage[16 * 6 + 8] * 8 + tmp_full_storage[16 * 6 + 10] * 4 + tmp_full_storage[16 * 6 + 12] * 2 + tmp_full_storage[16 * 6 + 14] * 1;
-				rat2_ch7[0] = tmp_full_storage[16 * 6 + 0 + 1] * 128 + tmp_full_storage[16 * 6 + 2 + 1] * 64 + tmp_full_storage[16 * 6 + 4 + 1] * 32 + tmp_full_storage[16 * 6 + 6 + 1] * 16 + tmp_full_storage[16 * 6 + 8 + 1] * 8 + tmp_full_storage[16 * 6 + 10 + 1] * 4 + tmp_full_storage[16 * 6 + 12 + 1] * 2 + tmp_full_storage[16 * 6 + 14 + 1] * 1;
-				rat1_ch8[0] = tmp_full_storage[16 * 7 + 0] * 128 + tmp_full_storage[16 * 7 + 2] * 64 + tmp_full_storage[16 * 7 + 4] * 32 + tmp_full_storage[16 * 7 + 6] * 16 + tmp_full_storage[16 * 7 + 8] * 8 + tmp_full_storage[16 * 7 + 10] * 4 + tmp_full_storage[16 * 7 + 12] * 2 + tmp_full_storage[16 * 7 + 14] * 1;
-				rat2_ch8[0] = tmp_full_storage[16 * 7 + 0 + 1] * 128 + tmp_full_storage[16 * 7 + 2 + 1] * 64 + tmp_full_storage[16 * 7 + 4 + 1] * 32 + tmp_full_storage[16 * 7 + 6 + 1] * 16 + tmp_full_storage[16 * 7 + 8 + 1] * 8 + tmp_full_storage[16 * 7 + 10 + 1] * 4 + tmp_full_storage[16 * 7 + 12 + 1] * 2 + tmp_full_storage[16 * 7 + 14 + 1] * 1;
-
-				while (CHANNEL_NUM*BITS_NUM*(k + 2) <= processed_signal_size) {
-					rat1_ch1[k + 1] = (uint8_t)(out_signal[starting_point + k * 128] * 128 + out_signal[starting_point + k * 128 + 2] * 64 + out_signal[starting_point + k * 128 + 4] * 32 + out_signal[starting_point + k * 128 + 6] * 16 + out_signal[starting_point + k * 128 + 8] * 8 + out_signal[starting_point + k * 128 + 10] * 4 + out_signal[starting_point + k * 128 + 12] * 2 + out_signal[starting_point + k * 128 + 14] * 1);
-					rat2_ch1[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 1] * 128 + out_signal[starting_point + k * 128 + 3] * 64 + out_signal[starting_point + k * 128 + 5] * 32 + out_signal[starting_point + k * 128 + 7] * 16 + out_signal[starting_point + k * 128 + 9] * 8 + out_signal[starting_point + k * 128 + 11] * 4 + out_signal[starting_point + k * 128 + 13] * 2 + out_signal[starting_point + k * 128 + 15] * 1);
-					rat1_ch2[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16] * 128 + out_signal[starting_point + k * 128 + 16 + 2] * 64 + out_signal[starting_point + k * 128 + 16 + 4] * 32 + out_signal[starting_point + k * 128 + 16 + 6] * 16 + out_signal[starting_point + k * 128 + 16 + 8] * 8 + out_signal[starting_point + k * 128 + 16 + 10] * 4 + out_signal[starting_point + k * 128 + 16 + 12] * 2 + out_signal[starting_point + k * 128 + 16 + 14] * 1);
-					rat2_ch2[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 + 1] * 128 + out_signal[starting_point + k * 128 + 16 + 3] * 64 + out_signal[starting_point + k * 128 + 16 + 5] * 32 + out_signal[starting_point + k * 128 + 16 + 7] * 16 + out_signal[starting_point + k * 128 + 16 + 9] * 8 + out_signal[starting_point + k * 128 + 16 + 11] * 4 + out_signal[starting_point + k * 128 + 16 + 13] * 2 + out_signal[starting_point + k * 128 + 16 + 15] * 1);
-					rat1_ch3[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 2] * 128 + out_signal[starting_point + k * 128 + 16 * 2 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 2 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 2 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 2 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 2 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 2 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 2 + 14] * 1);
-					rat2_ch3[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 2 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 2 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 2 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 2 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 2 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 2 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 2 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 2 + 15] * 1);
-					rat1_ch4[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 3] * 128 + out_signal[starting_point + k * 128 + 16 * 3 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 3 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 3 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 3 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 3 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 3 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 3 + 14] * 1);
-					rat2_ch4[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 3 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 3 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 3 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 3 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 3 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 3 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 3 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 3 + 15] * 1);
-					rat1_ch5[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 4] * 128 + out_signal[starting_point + k * 128 + 16 * 4 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 4 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 4 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 4 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 4 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 4 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 4 + 14] * 1);
-					rat2_ch5[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 4 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 4 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 4 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 4 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 4 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 4 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 4 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 4 + 15] * 1);
-					rat1_ch6[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 5] * 128 + out_signal[starting_point + k * 128 + 16 * 5 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 5 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 5 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 5 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 5 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 5 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 5 + 14] * 1);
-					rat2_ch6[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 5 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 5 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 5 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 5 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 5 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 5 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 5 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 5 + 15] * 1);
-					rat1_ch7[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 6] * 128 + out_signal[starting_point + k * 128 + 16 * 6 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 6 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 6 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 6 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 6 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 6 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 6 + 14] * 1);
-					rat2_ch7[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 6 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 6 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 6 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 6 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 6 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 6 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 6 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 6 + 15] * 1);
-					rat1_ch8[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 7] * 128 + out_signal[starting_point + k * 128 + 16 * 7 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 7 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 7 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 7 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 7 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 7 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 7 + 14] * 1);
-					rat2_ch8[k + 1] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 7 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 7 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 7 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 7 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 7 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 7 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 7 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 7 + 15] * 1);
-					//printf("rat1_ch1 value = %d ", rat1_ch1[k]);
-					k = k + 1;
-				}
-			}
-
-			else {
-				while (CHANNEL_NUM*BITS_NUM*(k + 1) <= processed_signal_size) {
-					rat1_ch1[k] = (uint8_t)(out_signal[starting_point + k * 128] * 128 + out_signal[starting_point + k * 128 + 2] * 64 + out_signal[starting_point + k * 128 + 4] * 32 + out_signal[starting_point + k * 128 + 6] * 16 + out_signal[starting_point + k * 128 + 8] * 8 + out_signal[starting_point + k * 128 + 10] * 4 + out_signal[starting_point + k * 128 + 12] * 2 + out_signal[starting_point + k * 128 + 14] * 1);
-					rat2_ch1[k] = (uint8_t)(out_signal[starting_point + k * 128 + 1] * 128 + out_signal[starting_point + k * 128 + 3] * 64 + out_signal[starting_point + k * 128 + 5] * 32 + out_signal[starting_point + k * 128 + 7] * 16 + out_signal[starting_point + k * 128 + 9] * 8 + out_signal[starting_point + k * 128 + 11] * 4 + out_signal[starting_point + k * 128 + 13] * 2 + out_signal[starting_point + k * 128 + 15] * 1);
-					rat1_ch2[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16] * 128 + out_signal[starting_point + k * 128 + 16 + 2] * 64 + out_signal[starting_point + k * 128 + 16 + 4] * 32 + out_signal[starting_point + k * 128 + 16 + 6] * 16 + out_signal[starting_point + k * 128 + 16 + 8] * 8 + out_signal[starting_point + k * 128 + 16 + 10] * 4 + out_signal[starting_point + k * 128 + 16 + 12] * 2 + out_signal[starting_point + k * 128 + 16 + 14] * 1);
-					rat2_ch2[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 + 1] * 128 + out_signal[starting_point + k * 128 + 16 + 3] * 64 + out_signal[starting_point + k * 128 + 16 + 5] * 32 + out_signal[starting_point + k * 128 + 16 + 7] * 16 + out_signal[starting_point + k * 128 + 16 + 9] * 8 + out_signal[starting_point + k * 128 + 16 + 11] * 4 + out_signal[starting_point + k * 128 + 16 + 13] * 2 + out_signal[starting_point + k * 128 + 16 + 15] * 1);
-					rat1_ch3[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 2] * 128 + out_signal[starting_point + k * 128 + 16 * 2 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 2 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 2 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 2 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 2 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 2 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 2 + 14] * 1);
-					rat2_ch3[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 2 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 2 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 2 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 2 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 2 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 2 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 2 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 2 + 15] * 1);
-					rat1_ch4[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 3] * 128 + out_signal[starting_point + k * 128 + 16 * 3 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 3 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 3 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 3 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 3 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 3 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 3 + 14] * 1);
-					rat2_ch4[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 3 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 3 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 3 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 3 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 3 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 3 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 3 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 3 + 15] * 1);
-					rat1_ch5[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 4] * 128 + out_signal[starting_point + k * 128 + 16 * 4 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 4 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 4 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 4 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 4 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 4 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 4 + 14] * 1);
-					rat2_ch5[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 4 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 4 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 4 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 4 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 4 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 4 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 4 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 4 + 15] * 1);
-					rat1_ch6[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 5] * 128 + out_signal[starting_point + k * 128 + 16 * 5 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 5 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 5 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 5 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 5 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 5 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 5 + 14] * 1);
-					rat2_ch6[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 5 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 5 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 5 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 5 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 5 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 5 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 5 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 5 + 15] * 1);
-					rat1_ch7[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 6] * 128 + out_signal[starting_point + k * 128 + 16 * 6 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 6 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 6 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 6 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 6 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 6 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 6 + 14] * 1);
-					rat2_ch7[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 6 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 6 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 6 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 6 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 6 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 6 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 6 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 6 + 15] * 1);
-					rat1_ch8[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 7] * 128 + out_signal[starting_point + k * 128 + 16 * 7 + 2] * 64 + out_signal[starting_point + k * 128 + 16 * 7 + 4] * 32 + out_signal[starting_point + k * 128 + 16 * 7 + 6] * 16 + out_signal[starting_point + k * 128 + 16 * 7 + 8] * 8 + out_signal[starting_point + k * 128 + 16 * 7 + 10] * 4 + out_signal[starting_point + k * 128 + 16 * 7 + 12] * 2 + out_signal[starting_point + k * 128 + 16 * 7 + 14] * 1);
-					rat2_ch8[k] = (uint8_t)(out_signal[starting_point + k * 128 + 16 * 7 + 1] * 128 + out_signal[starting_point + k * 128 + 16 * 7 + 3] * 64 + out_signal[starting_point + k * 128 + 16 * 7 + 5] * 32 + out_signal[starting_point + k * 128 + 16 * 7 + 7] * 16 + out_signal[starting_point + k * 128 + 16 * 7 + 9] * 8 + out_signal[starting_point + k * 128 + 16 * 7 + 11] * 4 + out_signal[starting_point + k * 128 + 16 * 7 + 13] * 2 + out_signal[starting_point + k * 128 + 16 * 7 + 15] * 1);
-					//printf("rat1_ch1 value = %d ", rat1_ch1[k]);
-					k = k + 1;
-				}
-			}
-
+		qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_STREAMS, qwTime);
 
-			//print T using matlab
-			engPutVariable(ep, "T_RAT1_CH1", T_RAT1_CH1); engPutVariable(ep, "T_RAT2_CH1", T_RAT2_CH1);
-			engPutVariable(ep, "T_RAT1_CH2", T_RAT1_CH2); engPutVariable(ep, "T_RAT2_CH2", T_RAT2_CH2);
-			engPutVariable(ep, "T_RAT1_CH3", T_RAT1_CH3); engPutVariable(ep, "T_RAT2_CH3", T_RAT2_CH3);
-			engPutVariable(ep, "T_RAT1_CH4", T_RAT1_CH4); engPutVariable(ep, "T_RAT2_CH4", T_RAT2_CH4);
-			engPutVariable(ep, "T_RAT1_CH5", T_RAT1_CH5); engPutVariable(ep, "T_RAT2_CH5", T_RAT2_CH5);
-			engPutVariable(ep, "T_RAT1_CH6", T_RAT1_CH6); engPutVariable(ep, "T_RAT2_CH6", T_RAT2_CH6);
-			engPutVariable(ep, "T_RAT1_CH7", T_RAT1_CH7); engPutVariable(ep, "T_RAT2_CH7", T_RAT2_CH7);
-			engPutVariable(ep, "T_RAT1_CH8", T_RAT1_CH8); engPutVariable(ep, "T_RAT2_CH8", T_RAT2_CH8);
-			//engEvalString(ep, "control_val = 50");
-			engEvalString(ep, "x1 = T_RAT1_CH1(1:end);"); engEvalString(ep, "x2 = T_RAT2_CH1(1:end);");
-			engEvalString(ep, "x3 = T_RAT1_CH2(1:end);"); engEvalString(ep, "x4 = T_RAT2_CH2(1:end);");
-			engEvalString(ep, "x5 = T_RAT1_CH3(1:end);"); engEvalString(ep, "x6 = T_RAT2_CH3(1:end);");
-			engEvalString(ep, "x7 = T_RAT1_CH4(1:end);"); engEvalString(ep, "x8 = T_RAT2_CH4(1:end);");
-			engEvalString(ep, "x9 = T_RAT1_CH5(1:end);"); engEvalString(ep, "x10 = T_RAT2_CH5(1:end);");
-			engEvalString(ep, "x11 = T_RAT1_CH6(1:end);"); engEvalString(ep, "x12 = T_RAT2_CH6(1:end);");
-			engEvalString(ep, "x13 = T_RAT1_CH7(1:end);"); engEvalString(ep, "x14 = T_RAT2_CH7(1:end);");
-			engEvalString(ep, "x15 = T_RAT1_CH8(1:end);"); engEvalString(ep, "x16 = T_RAT2_CH8(1:end);");
-
-			engEvalString(ep, "figure(1)");
-			engEvalString(ep, "subplot(2,4,1);");
-			engEvalString(ep, "plot(x1);");
-
-			engEvalString(ep, "subplot(2,4,2)");
-			engEvalString(ep, "plot(x3)");
-
-			engEvalString(ep, "subplot(2,4,3)");
-			engEvalString(ep, "plot(x5)");
-
-			engEvalString(ep, "subplot(2,4,4)");
-			engEvalString(ep, "plot(x7)");
-
-			engEvalString(ep, "subplot(2,4,5)");
-			engEvalString(ep, "plot(x9)");
-
-			engEvalString(ep, "subplot(2,4,6)");
-			engEvalString(ep, "plot(x11)");
-
-			engEvalString(ep, "subplot(2,4,7)");
-			engEvalString(ep, "plot(x13)");
-
-			engEvalString(ep, "subplot(2,4,8)");
-			engEvalString(ep, "plot(x15)");
-
-			engEvalString(ep, "figure(2)");
-			engEvalString(ep, "subplot(2,4,1)");
-			engEvalString(ep, "plot(x2)");
-
-			engEvalString(ep, "subplot(2,4,2)");
-			engEvalString(ep, "plot(x4)");
-
-			engEvalString(ep, "subplot(2,4,3)");
-			engEvalString(ep, "plot(x6)");
-
-			engEvalString(ep, "subplot(2,4,4)");
-			engEvalString(ep, "plot(x8)");
-
-			engEvalString(ep, "subplot(2,4,5)");
-			engEvalString(ep, "plot(x10)");
-
-			engEvalString(ep, "subplot(2,4,6)");
-			engEvalString(ep, "plot(x12)");
-
-			engEvalString(ep, "subplot(2,4,7)");
-			engEvalString(ep, "plot(x14)");
-
-			engEvalString(ep, "subplot(2,4,8)");
-			engEvalString(ep, "plot(x16)");
-
-			engEvalString(ep, "drawnow");
-			engEvalString(ep, "hold off");
-
-			//out_signal : 0 ~ processed_signal_size
-
-			//write file
-			if (starting_point == 0) {
-				FILE *fp1 = fopen("rat1_ch1.bin", "a"); fwrite(rat1_ch1, 1, k, fp1); fclose(fp1);
-				FILE *fp2 = fopen("rat2_ch1.bin", "a"); fwrite(rat2_ch1, 1, k, fp2); fclose(fp2);
-				FILE *fp3 = fopen("rat1_ch2.bin", "a"); fwrite(rat1_ch2, 1, k, fp3); fclose(fp3);
-				FILE *fp4 = fopen("rat2_ch2.bin", "a"); fwrite(rat2_ch2, 1, k, fp4); fclose(fp4);
-				FILE *fp5 = fopen("rat1_ch3.bin", "a"); fwrite(rat1_ch3, 1, k, fp5); fclose(fp5);
-				FILE *fp6 = fopen("rat2_ch3.bin", "a"); fwrite(rat2_ch3, 1, k, fp6); fclose(fp6);
-				FILE *fp7 = fopen("rat1_ch4.bin", "a"); fwrite(rat1_ch4, 1, k, fp7); fclose(fp7);
-				FILE *fp8 = fopen("rat2_ch4.bin", "a"); fwrite(rat2_ch4, 1, k, fp8); fclose(fp8);
-				FILE *fp9 = fopen("rat1_ch5.bin", "a"); fwrite(rat1_ch5, 1, k, fp9); fclose(fp9);
-				FILE *fp10 = fopen("rat2_ch5.bin", "a"); fwrite(rat2_ch5, 1, k, fp10); fclose(fp10);
-				FILE *fp11 = fopen("rat1_ch6.bin", "a"); fwrite(rat1_ch6, 1, k, fp11); fclose(fp11);
-				FILE *fp12 = fopen("rat2_ch6.bin", "a"); fwrite(rat2_ch6, 1, k, fp12); fclose(fp12);
-				FILE *fp13 = fopen("rat1_ch7.bin", "a"); fwrite(rat1_ch7, 1, k, fp13); fclose(fp13);
-				FILE *fp14 = fopen("rat2_ch7.bin", "a"); fwrite(rat2_ch7, 1, k, fp14); fclose(fp14);
-				FILE *fp15 = fopen("rat1_ch8.bin", "a"); fwrite(rat1_ch8, 1, k, fp15); fclose(fp15);
-				FILE *fp16 = fopen("rat2_ch8.bin", "a"); fwrite(rat2_ch8, 1, k, fp16); fclose(fp16);
-			}
-			else {
-				FILE *fp1 = fopen("rat1_ch1.bin", "a"); fwrite(rat1_ch1, 1, k + 1, fp1); fclose(fp1);
-				FILE *fp2 = fopen("rat2_ch1.bin", "a"); fwrite(rat2_ch1, 1, k + 1, fp2); fclose(fp2);
-				FILE *fp3 = fopen("rat1_ch2.bin", "a"); fwrite(rat1_ch2, 1, k + 1, fp3); fclose(fp3);
-				FILE *fp4 = fopen("rat2_ch2.bin", "a"); fwrite(rat2_ch2, 1, k + 1, fp4); fclose(fp4);
-				FILE *fp5 = fopen("rat1_ch3.bin", "a"); fwrite(rat1_ch3, 1, k + 1, fp5); fclose(fp5);
-				FILE *fp6 = fopen("rat2_ch3.bin", "a"); fwrite(rat2_ch3, 1, k + 1, fp6); fclose(fp6);
-				FILE *fp7 = fopen("rat1_ch4.bin", "a"); fwrite(rat1_ch4, 1, k + 1, fp7); fclose(fp7);
-				FILE *fp8 = fopen("rat2_ch4.bin", "a"); fwrite(rat2_ch4, 1, k + 1, fp8); fclose(fp8);
-				FILE *fp9 = fopen("rat1_ch5.bin", "a"); fwrite(rat1_ch5, 1, k + 1, fp9); fclose(fp9);
-				FILE *fp10 = fopen("rat2_ch5.bin", "a"); fwrite(rat2_ch5, 1, k + 1, fp10); fclose(fp10);
-				FILE *fp11 = fopen("rat1_ch6.bin", "a"); fwrite(rat1_ch6, 1, k + 1, fp11); fclose(fp11);
-				FILE *fp12 = fopen("rat2_ch6.bin", "a"); fwrite(rat2_ch6, 1, k + 1, fp12); fclose(fp12);
-				FILE *fp13 = fopen("rat1_ch7.bin", "a"); fwrite(rat1_ch7, 1, k + 1, fp13); fclose(fp13);
-				FILE *fp14 = fopen("rat2_ch7.bin", "a"); fwrite(rat2_ch7, 1, k + 1, fp14); fclose(fp14);
-				FILE *fp15 = fopen("rat1_ch8.bin", "a"); fwrite(rat1_ch8, 1, k + 1, fp15); fclose(fp15);
-				FILE *fp16 = fopen("rat2_ch8.bin", "a"); fwrite(rat2_ch8, 1, k + 1, fp16); fclose(fp16);
-			}
-			starting_point = (starting_point + processed_signal_size) % 128;
-			memcpy(tmp_storage, out_signal + processed_signal_size - starting_point, starting_point);
-		
-			//memory free error??
-			//free(tmp_full_storage);
-			//free(tmp_storage);
-			//free(rat1_ch1);
-			//free(rat2_ch1);
-			//free(rat1_ch2);
-			//free(rat2_ch2);
-			//free(rat1_ch3);
-			//free(rat2_ch3);
-			//free(rat1_ch4);
-			//free(rat2_ch4);
-			//free(rat1_ch5);
-			//free(rat2_ch5);
-			//free(rat1_ch6);
-			//free(rat2_ch6);
-			//free(rat1_ch7);
-			//free(rat2_ch7);
-			//free(rat1_ch8);
-			//free(rat2_ch8);
+		// hand the streams of the first channel to the plot thread, it drops frames if MATLAB is too slow
+		ST_DECODER* pstPlotDecoder = &pstWorkData->stDecoder.astDecoder[0];
+		if (pstWorkData->bPlot && (lLevel < REC_GOVERN_NOPLOT) && pstPlotDecoder->bRecording)
+		{
+			vPlotSinkPost(&pstWorkData->stPlot, pstPlotDecoder->apbyStream, pstPlotDecoder->dwStreamLen);
+			qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_PLOT, qwTime);
+		}
+		if (pstWorkData->bPreview)
+		{
+			uint32 dwStreamLen = pstPlotDecoder->bRecording ? pstPlotDecoder->dwStreamLen : 0;
+			if (lLevel < REC_GOVERN_NOPLOT)
+				vPreviewPublish(&pstWorkData->stPreview, (int16_t*)pstBufferData->pvDataCurrentBuf, pstBufferData->dwDataNotify / sizeof(int16_t),
+					pstPlotDecoder->bRecording ? pstPlotDecoder->apbyStream : NULL, dwStreamLen, stStamp.llTimeUs);
+			else
+				vPreviewSkip(&pstWorkData->stPreview, pstBufferData->dwDataNotify / sizeof(int16_t), dwStreamLen);
+			qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_PREVIEW, qwTime);
 		}
 
-		//loop_count for counting the loop
-		loop_count++;
-
-		//original write file
-		WriteFile(pstWorkData->hFile, pstBufferData->pvDataCurrentBuf, pstBufferData->dwDataNotify, &dwWritten, NULL);
-
-		//free allocated array and pointers
-		mxDestroyArray(T);
-		
-		free(signal_int16_addr);
-		free(tmp_signal);
-
-		//free(answer_signal);
-		free(input_signal);
-		free(answer_signal);
-		free(out_signal);
-
-		//free(samples_from_prev);
-		//free(remain_samples);
+		// raw data: copied to the write ring and queued, the block goes back to the card at once
+		dwWritten = bRawWriterQueue(&pstWorkData->stRaw, pstBufferData->pvDataCurrentBuf, pstBufferData->dwDataNotify, &stStamp) ? pstBufferData->dwDataNotify : 0;
+		qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_RAW, qwTime);
 	}
+	qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_BLOCK, qwBlockTime);
 
 	pstWorkData->llWritten += dwWritten;
 	if (dwWritten != pstBufferData->dwDataNotify)
@@ -744,24 +599,39 @@ bool bWorkDo(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
 	}
 
 	// current status
-	if (--g_dwUpdateCount == 0)
+	if (--pstWorkData->dwUpdateCount == 0)
 	{
-		g_dwUpdateCount = g_dwUpdateBuffers;
+		pstWorkData->dwUpdateCount = g_dwUpdateBuffers;
 		spcm_dwGetParam_i64(pstBufferData->pstCard->hDrv, SPC_FILLSIZEPROMILLE, &llBufferFillPromille);
 
-		printf("\r");
-		if (pstBufferData->llDataTransferred > GIGA_B(1))
-			printf("%7.2lf GB", (double)pstBufferData->llDataTransferred / GIGA_B(1));
+		// all cards: the main thread collects the status of the cards to one line
+		if (g_bAllCards)
+		{
+			pstWorkData->stStatus.llTransferred.store(pstBufferData->llDataTransferred);
+			pstWorkData->stStatus.lHwFill.store((int32)llBufferFillPromille);
+			pstWorkData->stStatus.lSwFill.store((int32)(1000.0 * pstBufferData->dwDataAvailBytes / pstBufferData->dwDataBufLen));
+			pstWorkData->stStatus.dAverageSpeed.store(dAverageSpeed);
+		}
 		else
-			printf("%7.2lf MB", (double)pstBufferData->llDataTransferred / MEGA_B(1));
+		{
+			printf("\r");
+			if (pstBufferData->llDataTransferred > GIGA_B(1))
+				printf("%7.2lf GB", (double)pstBufferData->llDataTransferred / GIGA_B(1));
+			else
+				printf("%7.2lf MB", (double)pstBufferData->llDataTransferred / MEGA_B(1));
 
-		printf(" %6.1lf %%", (double)llBufferFillPromille / 10.0);
+			printf(" %6.1lf %%", (double)llBufferFillPromille / 10.0);
 
-		printf("    %6.1lf %%", 100.0 * (double)pstBufferData->dwDataAvailBytes / pstBufferData->dwDataBufLen);
+			printf("    %6.1lf %%", 100.0 * (double)pstBufferData->dwDataAvailBytes / pstBufferData->dwDataBufLen);
 
-		// print transfer speed
-		printf("   %6.2lf MB/s", dAverageSpeed);
-		printf("   %6.2lf MB/s", dLastSpeed);
+			// print transfer speed
+			printf("   %6.2lf MB/s", dAverageSpeed);
+			printf("   %6.2lf MB/s", dLastSpeed);
+
+			// completion time of the last raw write
+			if (pstWorkData->bRaw)
+				printf("   %6.1lf ms", pstWorkData->stRaw.dLatencyLast * 1000.0);
+		}
 	}
 
 	pstBufferData->dwDataAvailBytes = pstBufferData->dwDataNotify;
@@ -784,8 +654,73 @@ void vWorkClose(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
 {
 	ST_WORKDATA* pstWorkData = (ST_WORKDATA *)pvWorkData;
 
-	if (pstWorkData->hFile && (g_eMode != eSpeedTest))
-		CloseHandle(pstWorkData->hFile);
+	// the threads finish the blocks they have before the outputs are closed
+	if (pstWorkData->bPipe)
+	{
+		LARGE_INTEGER uTime;
+		QueryPerformanceCounter(&uTime);
+		bPipelineStop(&pstWorkData->stPipe);
+		if (pstWorkData->uStartTime.QuadPart)
+			vPipelinePrintStats(&pstWorkData->stPipe, (double)(uTime.QuadPart - pstWorkData->uStartTime.QuadPart) / pstWorkData->uHighResFreq.QuadPart);
+	}
+	pstWorkData->bPipe = false;
+
+	if (pstWorkData->bRaw)
+	{
+		vRawWriterClose(&pstWorkData->stRaw);
+		printf("\nWrite ring: %d x %.1lf MByte on %s pages, NUMA node %s\n", pstWorkData->stRaw.lDepth, (double)pstWorkData->stRaw.dwRecordLen / MEGA_B(1),
+			pstWorkData->stRaw.bLargePages ? "large" : "normal", (pstWorkData->stCpus.lNode >= 0) ? "of the card" : "any");
+		if (pstWorkData->stRaw.qwCompleted)
+			printf("\nDisk writes: %llu, latency avg %.1lf ms, max %.1lf ms, %llu waits for a free slot\n",
+				(unsigned long long)pstWorkData->stRaw.qwCompleted,
+				pstWorkData->stRaw.dLatencySum / pstWorkData->stRaw.qwCompleted * 1000.0,
+				pstWorkData->stRaw.dLatencyMax * 1000.0,
+				(unsigned long long)pstWorkData->stRaw.qwWaits);
+		if (pstWorkData->stRaw.qwPackedBytes)
+			printf("Raw packing: %.2lf of %.2lf MByte, %.2lf x smaller, packers %.1lf s busy\n",
+				(double)pstWorkData->stRaw.qwPackedBytes / MEGA_B(1), (double)pstWorkData->stRaw.qwRawBytes / MEGA_B(1),
+				(double)pstWorkData->stRaw.qwRawBytes / pstWorkData->stRaw.qwPackedBytes, pstWorkData->stRaw.dPackBusy);
+	}
+	pstWorkData->bRaw = false;
+
+	if (pstWorkData->bGovernor)
+		vGovernorClose(&pstWorkData->stGovernor);
+	pstWorkData->bGovernor = false;
+
+	if (pstWorkData->bPlot)
+		vPlotSinkClose(&pstWorkData->stPlot);
+	pstWorkData->bPlot = false;
+	if (pstWorkData->bPreview)
+		vPreviewClose(&pstWorkData->stPreview);
+	pstWorkData->bPreview = false;
+
+	uint64 qwStreamBytes = 0, qwStoredBytes = 0;
+	for (int32 i = 0; i < pstWorkData->lWriters; i++)
+	{
+		vStreamWriterClose(&pstWorkData->astWriter[i]);
+		qwStreamBytes += pstWorkData->astWriter[i].qwStreamBytes * REC_STREAM_NUM;
+		qwStoredBytes += pstWorkData->astWriter[i].qwStoredBytes;
+	}
+	pstWorkData->lWriters = 0;
+	if (qwStoredBytes)
+		printf("\nStream container: %.2lf of %.2lf MByte stream data, %.2lf x smaller\n", (double)qwStoredBytes / MEGA_B(1), (double)qwStreamBytes / MEGA_B(1), (double)qwStreamBytes / qwStoredBytes);
+
+	// all stages are done, the last dump and the summary of the run
+	if (pstWorkData->pstMetrics)
+	{
+		vMetricsStop(pstWorkData->pstMetrics);
+		printf("\n");
+		vMetricsPrint(pstWorkData->pstMetrics);
+		vMetricsFree(pstWorkData->pstMetrics);
+		pstWorkData->pstMetrics = NULL;
+	}
+
+	size_t dwArenaUsed, dwArenaSize;
+	bool bArenaLocked;
+	vMultiDecoderArena(&pstWorkData->stDecoder, &dwArenaUsed, &dwArenaSize, &bArenaLocked);
+	if (dwArenaSize)
+		printf("\nDecoder arena: %.2lf of %.2lf MByte used%s\n", (double)dwArenaUsed / MEGA_B(1), (double)dwArenaSize / MEGA_B(1), bArenaLocked ? ", locked" : "");
+	vMultiDecoderClose(&pstWorkData->stDecoder);
 }
 
 
@@ -802,6 +737,45 @@ bool bKeyCheckAsync(void *, ST_BUFFERDATA *)
 
 
 
+/*
+**************************************************************************
+vSetupChannels: channels, sampling rate and FIFO speed test mode of the
+menu to one card
+**************************************************************************
+*/
+
+static void vSetupChannels(ST_SPCM_CARDINFO * pstCard)
+{
+	spcm_dwSetParam_i64(pstCard->hDrv, SPC_CHENABLE, g_qwChannelEnable);
+	spcm_dwSetParam_i64(pstCard->hDrv, SPC_SAMPLERATE, g_lSamplingRate);
+	spcm_dwSetParam_i32(pstCard->hDrv, SPC_TEST_FIFOSPEED, (g_eMode != eStandard) ? 1 : 0);
+}
+
+
+
+/*
+**************************************************************************
+bSetupOtherCard: all cards mode, a card behind the first one gets the
+setup of the menu; false on a setup error
+**************************************************************************
+*/
+
+static bool bSetupOtherCard(ST_SPCM_CARDINFO * pstCard)
+{
+	char szErrorText[ERRORTEXTLEN];
+
+	spcm_dwSetParam_i64(pstCard->hDrv, SPC_M2CMD, M2CMD_CARD_RESET);
+	vSetupChannels(pstCard);
+	if (spcm_dwGetErrorInfo_i32(pstCard->hDrv, NULL, NULL, szErrorText) != ERR_OK)
+	{
+		printf("\nSetup Error of card sn %05d:\n------------\n%s\n\n", pstCard->lSerialNumber, szErrorText);
+		return false;
+	}
+	return true;
+}
+
+
+
 /*
 **************************************************************************
 bSetup: returns true if start, false if abort
@@ -821,7 +795,7 @@ bool bSetup(ST_SPCM_CARDINFO * pstCard)
 	spcm_dwSetParam_i64(pstCard->hDrv, SPC_M2CMD, M2CMD_CARD_RESET);
 	spcm_dwGetContBuf_i64(pstCard->hDrv, SPCM_BUF_DATA, &pvTmp, &qwContBufLen);
 	if (qwContBufLen > 0)
-		g_lBufferSize = (int32)qwContBufLen;
+		g_llBufferSize = (int64)qwContBufLen;
 
 	while (1)
 	{
@@ -835,21 +809,59 @@ bool bSetup(ST_SPCM_CARDINFO * pstCard)
 		case eHDSpeedTest: printf("Max PCI/PCIe interface speed to HD\n"); break;
 		case eSpeedTest:   printf("Max PCI/PCIe interface speed only\n"); break;
 		}
-		printf("B ....... Buffer Size:      %.2lf MByte (Continuous Buffer: %d MByte)\n", (double)g_lBufferSize / MEGA_B(1), (int32)(qwContBufLen / MEGA_B(1)));
+		if (g_eMode != eSpeedTest)
+		{
+			printf("Q ....... Write Queue:      %d blocks\n", g_lWriteDepth);
+			if (g_lRawPackers)
+				printf("Z ....... Raw Compression:  %d packer threads\n", g_lRawPackers);
+			else
+				printf("Z ....... Raw Compression:  off\n");
+		}
+		printf("B ....... Buffer Size:      %.2lf MByte (Continuous Buffer: %.0lf MByte)\n", (double)g_llBufferSize / MEGA_B(1), (double)qwContBufLen / MEGA_B(1));
+		if ((int64)dwLibBufferLen(g_llBufferSize, g_lNotifySize) < g_llBufferSize)
+			printf("          cut to %.2lf MByte, the card library takes 32 bit lengths\n", (double)dwLibBufferLen(g_llBufferSize, g_lNotifySize) / MEGA_B(1));
 		printf("N ....... Notify Size:      %d kByte\n", g_lNotifySize / KILO_B(1));
 		if (g_eMode == eStandard)
 		{
 			printf("S ....... Sampling Rate:    %.2lf MS/s\n", (double)g_lSamplingRate / MEGA(1));
 			printf("T ....... Thread Mode:      %s\n", g_bThread ? "on" : "off");
 			printf("C ....... Channel Enable:   %x\n", g_qwChannelEnable);
+			printf("P ....... Preamble:         %d symbols\n", (int32)strlen(g_szPreamble));
+			printf("E ....... Preamble Errors:  %d\n", g_lPreambleErrors);
+			printf("L ....... Slicer Threshold: %s\n", (g_lThresholdMode == REC_THRESHOLD_TRACK) ? "tracked over the blocks" : "window mean per block");
+			if (g_lThresholdMode == REC_THRESHOLD_TRACK)
+				printf("H ....... Hysteresis:       %.1lf ADC counts\n", g_dHysteresis);
+			if (g_dSamplesPerSymbol > 0)
+				printf("R ....... Symbol Timing:    recovered, %.2lf samples per symbol\n", g_dSamplesPerSymbol);
+			else
+				printf("R ....... Symbol Timing:    fixed, %d samples per symbol\n", REC_DOWN_SAMPLING_RATE);
+			if (g_dwSyncInterval)
+				printf("F ....... Frame Lock:       sync word after every %u frames\n", g_dwSyncInterval);
+			else
+				printf("F ....... Frame Lock:       off, no sync words\n");
+			printf("M ....... Pipeline:         %s\n", g_bPipeline ? "decode and write threads" : "off");
+			printf("O ....... Stream Output:    %s\n", g_bStreamContainer ? REC_WRITER_CONTAINER " (compressed)" : "ratX_chY.bin files");
+			printf("X ....... Metrics:          %s\n", g_bMetrics ? "stage latencies to metrics_*.csv" : "off");
+			printf("V ....... Live Preview:     %s\n", g_bPreview ? "envelopes in shared memory for rec_view" : "off");
+			printf("D ....... Governor:         %s\n", g_bGovernor ? "sheds plot, compression and decoding while the buffers fill" : "off");
 		}
+		if (g_lNumaNodes > 0)
+		{
+			printf("U ....... NUMA Nodes:       ");
+			for (int32 i = 0; i < g_lNumaNodes; i++)
+				printf("%s%d", i ? "," : "", g_alNumaNode[i]);
+			printf(" (cores and buffers of card i on node i, the last node for the cards behind)\n");
+		}
+		else
+			printf("U ....... NUMA Nodes:       any\n");
+		printf("Y ....... Thread Priority:  %s\n", g_bRealtime ? "real-time for acquisition and decoding" : "normal");
+		if (g_eMode != eSpeedTest)
+			printf("G ....... Large Pages:      %s\n", g_bLargePages ? "write ring and pipeline blocks, if the system gives them" : "off");
 		printf("Enter ... Start Test\n");
 		printf("Esc ..... Abort\n");
 
-		spcm_dwSetParam_i64(pstCard->hDrv, SPC_CHENABLE, g_qwChannelEnable);
-		spcm_dwSetParam_i64(pstCard->hDrv, SPC_SAMPLERATE, g_lSamplingRate);
+		vSetupChannels(pstCard);
 		spcm_dwGetParam_i32(pstCard->hDrv, SPC_CHCOUNT, &lChannels);
-		spcm_dwSetParam_i32(pstCard->hDrv, SPC_TEST_FIFOSPEED, (g_eMode != eStandard) ? 1 : 0);
 
 		if (spcm_dwGetErrorInfo_i32(pstCard->hDrv, NULL, NULL, szErrorText) != ERR_OK)
 			printf("\nSetup Error:\n------------\n%s\n\n", szErrorText);
@@ -870,7 +882,6 @@ bool bSetup(ST_SPCM_CARDINFO * pstCard)
 			g_dwUpdateBuffers = (uint32)(dTransferSpeed / g_lNotifySize / 4);
 			if (g_dwUpdateBuffers < 1)
 				g_dwUpdateBuffers = 1;
-			g_dwUpdateCount = g_dwUpdateBuffers;
 		}
 		printf("\n");
 
@@ -879,7 +890,7 @@ bool bSetup(ST_SPCM_CARDINFO * pstCard)
 		{
 		case 27: return false;
 		case 13:
-			if (g_lBufferSize <= (int32)qwContBufLen)
+			if ((uint64)dwLibBufferLen(g_llBufferSize, g_lNotifySize) <= qwContBufLen)
 				printf("\n***** Continuous Buffer from Kernel Driver used *****\n\n");
 			return true;
 
@@ -909,7 +920,7 @@ bool bSetup(ST_SPCM_CARDINFO * pstCard)
 		case 'B':
 			printf("Buffer Size (MByte): ");
 			scanf("%lf", &dTmp);
-			g_lBufferSize = (int32)(dTmp * MEGA_B(1));
+			g_llBufferSize = (int64)(dTmp * MEGA_B(1));
 			break;
 
 		case 'n':
@@ -926,12 +937,212 @@ bool bSetup(ST_SPCM_CARDINFO * pstCard)
 			g_qwChannelEnable = dwTmp;
 			break;
 
+		case 'p':
+		case 'P':
+			printf("Preamble (0/1 string): ");
+			scanf("%256s", g_szPreamble);
+			break;
+
+		case 'e':
+		case 'E':
+			printf("Allowed Preamble Errors: ");
+			scanf("%d", &g_lPreambleErrors);
+			break;
+
+		case 'l':
+		case 'L':
+			g_lThresholdMode = (g_lThresholdMode == REC_THRESHOLD_TRACK) ? REC_THRESHOLD_WINDOW : REC_THRESHOLD_TRACK;
+			break;
+
+		case 'h':
+		case 'H':
+			printf("Hysteresis (ADC counts): ");
+			scanf("%lf", &g_dHysteresis);
+			if (g_dHysteresis < 0)
+				g_dHysteresis = 0;
+			break;
+
+		case 'r':
+		case 'R':
+			printf("Samples per Symbol (0 for fixed %d): ", REC_DOWN_SAMPLING_RATE);
+			scanf("%lf", &g_dSamplesPerSymbol);
+			if (g_dSamplesPerSymbol < 0)
+				g_dSamplesPerSymbol = 0;
+			break;
+
+		case 'f':
+		case 'F':
+			printf("Frames between the Sync Words (0 for none): ");
+			scanf("%u", &g_dwSyncInterval);
+			break;
+
+		case 'q':
+		case 'Q':
+			printf("Write Queue Depth (blocks): ");
+			scanf("%d", &g_lWriteDepth);
+			if (g_lWriteDepth < 1)
+				g_lWriteDepth = 1;
+			break;
+
+		case 'z':
+		case 'Z':
+			printf("Raw Packer Threads (0 for off, max %d): ", REC_RAWWRITER_MAX_PACKERS);
+			scanf("%d", &g_lRawPackers);
+			g_lRawPackers = (g_lRawPackers < 0) ? 0 : (g_lRawPackers > REC_RAWWRITER_MAX_PACKERS) ? REC_RAWWRITER_MAX_PACKERS : g_lRawPackers;
+			break;
+
+		case 'm':
+		case 'M':
+			g_bPipeline = !g_bPipeline;
+			break;
+
+		case 'o':
+		case 'O':
+			g_bStreamContainer = !g_bStreamContainer;
+			break;
+
+		case 'x':
+		case 'X':
+			g_bMetrics = !g_bMetrics;
+			break;
+
+		case 'v':
+		case 'V':
+			g_bPreview = !g_bPreview;
+			break;
+
+		case 'd':
+		case 'D':
+			g_bGovernor = !g_bGovernor;
+			break;
+
+		case 'u':
+		case 'U':
+			{
+				char szNodes[100];
+				printf("NUMA Node of each Card (e.g. 0,1; -1 for any): ");
+				g_lNumaNodes = 0;
+				if (scanf("%99s", szNodes) == 1)
+					for (char* pszNode = strtok(szNodes, ","); pszNode && g_lNumaNodes < MAXBRD; pszNode = strtok(NULL, ","))
+						g_alNumaNode[g_lNumaNodes++] = atoi(pszNode);
+				if (g_lNumaNodes && g_alNumaNode[0] < 0)
+					g_lNumaNodes = 0;
+			}
+			break;
+
+		case 'y':
+		case 'Y':
+			g_bRealtime = !g_bRealtime;
+			break;
+
+		case 'g':
+		case 'G':
+			g_bLargePages = !g_bLargePages;
+			break;
+
 		}
 	}
 }
 
 
 
+/*
+**************************************************************************
+vDoAllCardsLoop: one FIFO loop thread per card, each card on its own
+cores and with its own output directory. The main thread prints the
+combined status line until all loops are done.
+**************************************************************************
+*/
+
+struct ST_CARDRUN
+{
+	ST_BUFFERDATA   stBufferData;
+	ST_WORKDATA     stWorkData;
+	std::thread     oThread;
+};
+
+void vCardThread(ST_CARDRUN * pstRun)
+{
+	bRecPinThread(&pstRun->stWorkData.stCpus, REC_CPU_ACQUIRE);
+
+	if (g_bThread)
+		vDoThreadMainLoop(&pstRun->stBufferData, &pstRun->stWorkData, bWorkInit, bWorkDo, vWorkClose, bKeyCheckAsync);
+	else
+		vDoMainLoop(&pstRun->stBufferData, &pstRun->stWorkData, bWorkInit, bWorkDo, vWorkClose, bKeyCheckAsync);
+
+	pstRun->stWorkData.stStatus.bRunning.store(false);
+}
+
+// ----- static, the pipeline rings inside need their 64 byte alignment -----
+static ST_CARDRUN s_astCardRun[MAXBRD];
+
+void vDoAllCardsLoop(ST_SPCM_CARDINFO * pstCards, int32 lCardCount)
+{
+	ST_CARDRUN* pstRuns = s_astCardRun;
+
+	for (int32 i = 0; i < lCardCount; i++)
+	{
+		ST_CARDRUN* pstRun = &pstRuns[i];
+		pstRun->stWorkData.stStatus.llTransferred.store(0);
+		pstRun->stWorkData.stStatus.lHwFill.store(0);
+		pstRun->stWorkData.stStatus.lSwFill.store(0);
+		pstRun->stWorkData.stStatus.dAverageSpeed.store(0);
+		pstRun->stWorkData.stStatus.bRunning.store(false);
+		if (pstCards[i].bSetError)
+			continue;
+
+		memset(&pstRun->stBufferData, 0, sizeof(pstRun->stBufferData));
+		pstRun->stBufferData.pstCard = &pstCards[i];
+		pstRun->stBufferData.bStartCard = true;
+		pstRun->stBufferData.bStartData = true;
+		pstRun->stBufferData.lTimeout = g_bThread ? 5000 : 100;
+
+		// own directory per card, the files of the cards have the same names
+		char szDir[50];
+		sprintf(szDir, "card%d_sn%05d", i, pstCards[i].lSerialNumber);
+		CreateDirectoryA(szDir, NULL);
+		sprintf(pstRun->stWorkData.szOutDir, "%s\\", szDir);
+
+		vCardCpus(&pstRun->stWorkData.stCpus, i, lCardCount, true);
+		pstRun->stWorkData.stStatus.bRunning.store(true);
+		pstRun->oThread = std::thread(vCardThread, pstRun);
+	}
+
+	printf("\n");
+	printf("Written      per card: HW-Buf / SW-Buf / Average           Total\n----------------------------------------------------------------\n");
+
+	bool bRunning = true;
+	while (bRunning)
+	{
+		Sleep(250);
+
+		int64 llTotal = 0;
+		double dTotalSpeed = 0;
+		bRunning = false;
+		for (int32 i = 0; i < lCardCount; i++)
+		{
+			llTotal += pstRuns[i].stWorkData.stStatus.llTransferred.load();
+			dTotalSpeed += pstRuns[i].stWorkData.stStatus.dAverageSpeed.load();
+			bRunning = bRunning || pstRuns[i].stWorkData.stStatus.bRunning.load();
+		}
+
+		printf("\r%7.2lf GB ", (double)llTotal / GIGA_B(1));
+		for (int32 i = 0; i < lCardCount; i++)
+			printf("  %d: %5.1lf %% %5.1lf %% %7.2lf MB/s", i,
+				(double)pstRuns[i].stWorkData.stStatus.lHwFill.load() / 10.0,
+				(double)pstRuns[i].stWorkData.stStatus.lSwFill.load() / 10.0,
+				pstRuns[i].stWorkData.stStatus.dAverageSpeed.load());
+		printf("   %8.2lf MB/s", dTotalSpeed);
+	}
+	printf("\n");
+
+	for (int32 i = 0; i < lCardCount; i++)
+		if (pstRuns[i].oThread.joinable())
+			pstRuns[i].oThread.join();
+}
+
+
+
 /*
 **************************************************************************
 main
@@ -946,6 +1157,7 @@ int main()
 	ST_WORKDATA         stWorkData;         // work data for the working functions
 	int32               lCardIdx = 0;
 	int32               lCardCount = 0;
+	int32               lFirstCard, lLastCard;
 
 	// ------------------------------------------------------------------------
 	// init cards, get some information and print it
@@ -974,27 +1186,37 @@ int main()
 			printf("-------------------------------\n");
 			for (lCardIdx = 0; lCardIdx < lCardCount; lCardIdx++)
 				printf("%d ..... M2i.%04x sn %05d\n", lCardIdx, astCard[lCardIdx].lCardType & TYP_VERSIONMASK, astCard[lCardIdx].lSerialNumber);
+			printf("A ..... all cards at the same time\n");
 
 			int16 nSelection = _getch();
 			if (nSelection == 27)
 				return 1;
-			if ((nSelection >= '0') && (nSelection < ('0' + lCardIdx)))
+			if ((nSelection == 'a') || (nSelection == 'A'))
+				g_bAllCards = true;
+			else if ((nSelection >= '0') && (nSelection < ('0' + lCardIdx)))
 				lCardIdx = (nSelection - '0');
-		} while (lCardIdx == lCardCount);
+		} while (!g_bAllCards && (lCardIdx == lCardCount));
 
 		// close all the other cards allowing a second instance of the program to run
-		for (int32 lCloseIdx = 0; lCloseIdx < lCardCount; lCloseIdx++)
-		if (lCloseIdx != lCardIdx)
-			vSpcMCloseCard(&astCard[lCloseIdx]);
+		if (!g_bAllCards)
+			for (int32 lCloseIdx = 0; lCloseIdx < lCardCount; lCloseIdx++)
+			if (lCloseIdx != lCardIdx)
+				vSpcMCloseCard(&astCard[lCloseIdx]);
 	}
 	else
 		lCardIdx = 0;
 
+	// all cards run with the setup of the first one
+	lFirstCard = g_bAllCards ? 0 : lCardIdx;
+	lLastCard = g_bAllCards ? lCardCount - 1 : lCardIdx;
+	lCardIdx = lFirstCard;
+
 
 
 	// check whether we support this card type in the example
-	if ((astCard[lCardIdx].eCardFunction != AnalogIn) && (astCard[lCardIdx].eCardFunction != DigitalIn) && (astCard[lCardIdx].eCardFunction != DigitalIO))
-		return nSpcMErrorMessageStdOut(&astCard[lCardIdx], "Error: Card function not supported by this example\n", false);
+	for (int32 i = lFirstCard; i <= lLastCard; i++)
+		if ((astCard[i].eCardFunction != AnalogIn) && (astCard[i].eCardFunction != DigitalIn) && (astCard[i].eCardFunction != DigitalIO))
+			return nSpcMErrorMessageStdOut(&astCard[i], "Error: Card function not supported by this example\n", false);
 
 
 	// we start with 16 bit acquisition as this is supported by all cards
@@ -1037,10 +1259,28 @@ int main()
 	// do the card setup, error is routed in the structure so we don't care for the return values
 	while (bSetup(&astCard[lCardIdx]))
 	{
+		// the menu set up the first card, the other cards get its setup and none is started if one fails
+		for (int32 i = lFirstCard + 1; i <= lLastCard; i++)
+			if (!bSetupOtherCard(&astCard[i]))
+				return nSpcMErrorMessageStdOut(&astCard[i], "Error: The cards can't all run with this setup\n", false);
+
 		//Sleep(sleep_t);
-		if (!astCard[lCardIdx].bSetError)
-			bDoCardSetup(&astCard[lCardIdx]);
-		
+		for (int32 i = lFirstCard; i <= lLastCard; i++)
+			if (!astCard[i].bSetError)
+				bDoCardSetup(&astCard[i]);
+
+		// all cards: own FIFO loops, the main thread only shows the status
+		if (g_bAllCards)
+		{
+			g_nKeyPress = GetAsyncKeyState(VK_ESCAPE);
+			vDoAllCardsLoop(astCard, lCardCount);
+
+			for (int32 i = 0; i < lCardCount; i++)
+				if (astCard[i].bSetError)
+					return nSpcMErrorMessageStdOut(&astCard[i], "An error occured while programming the card:\n", true);
+			continue;
+		}
+
 
 		// ------------------------------------------------------------------------
 		// setup the data transfer thread and start it, we use atimeout of 5 s in the example
@@ -1049,6 +1289,11 @@ int main()
 		stBufferData.bStartCard = true;
 		stBufferData.bStartData = true;
 		stBufferData.lTimeout = 5000;
+		stWorkData.szOutDir[0] = 0;
+		vCardCpus(&stWorkData.stCpus, lCardIdx, 1, false);
+
+		// the library allocates the buffer in the loop, from a thread on the node of the card
+		bRecPinThread(&stWorkData.stCpus, REC_CPU_ACQUIRE);
 
 		// setup for async esc check
 		g_nKeyPress = GetAsyncKeyState(VK_ESCAPE);
@@ -1078,7 +1323,8 @@ int main()
 
 
 	// clean up and close the driver
-	vSpcMCloseCard(&astCard[lCardIdx]);
+	for (int32 i = lFirstCard; i <= lLastCard; i++)
+		vSpcMCloseCard(&astCard[i]);
 
 	return 1;
 }
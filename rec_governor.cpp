@@ -0,0 +1,167 @@
+/*
+**************************************************************************
+
+rec_governor.cpp
+
+**************************************************************************
+
+Overload governor of the FIFO loop, see rec_governor.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+
+#include "rec_governor.h"
+
+
+
+/*
+**************************************************************************
+vGovernorInit
+**************************************************************************
+*/
+
+void vGovernorInit(ST_GOVERNOR* pstGovernor, const char* szPrefix, uint32_t dwHoldBlocks)
+{
+	static const int32_t s_alUp[REC_GOVERN_LEVELS - 1] = REC_GOVERN_UP;
+	static const int32_t s_alDown[REC_GOVERN_LEVELS - 1] = REC_GOVERN_DOWN;
+
+	memset(pstGovernor, 0, sizeof(*pstGovernor));
+	memcpy(pstGovernor->alUp, s_alUp, sizeof(s_alUp));
+	memcpy(pstGovernor->alDown, s_alDown, sizeof(s_alDown));
+	pstGovernor->dwHoldBlocks = dwHoldBlocks;
+	snprintf(pstGovernor->szPrefix, sizeof(pstGovernor->szPrefix), "%s", szPrefix);
+	pstGovernor->fpLog = NULL;
+	pstGovernor->lLevel = REC_GOVERN_FULL;
+}
+
+
+
+/*
+**************************************************************************
+vLogChange: console line and side log with the wall clock, the log is
+created with the first change
+**************************************************************************
+*/
+
+static void vLogChange(ST_GOVERNOR* pstGovernor, int32_t lFrom, int32_t lHwFill, int32_t lSwFill, uint64_t qwSample)
+{
+	int64_t llTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	time_t tSeconds = (time_t)(llTimeUs / 1000000);
+	struct tm stTime;
+	char szTime[32];
+#if defined(_WIN32)
+	localtime_s(&stTime, &tSeconds);
+#else
+	localtime_r(&tSeconds, &stTime);
+#endif
+	size_t dwLen = strftime(szTime, sizeof(szTime), "%Y-%m-%d %H:%M:%S", &stTime);
+	snprintf(szTime + dwLen, sizeof(szTime) - dwLen, ".%03d", (int)(llTimeUs / 1000 % 1000));
+
+	printf("\n%s %sGovernor: %s -> %s at block %llu, HW-Buf %.1lf %%, SW-Buf %.1lf %%\n", szTime, pstGovernor->szPrefix,
+		pszGovernorLevelName(lFrom), pszGovernorLevelName(pstGovernor->lLevel), (unsigned long long)pstGovernor->qwBlocks,
+		lHwFill / 10.0, lSwFill / 10.0);
+
+	if (!pstGovernor->fpLog)
+	{
+		char szName[128];
+		snprintf(szName, sizeof(szName), "%s%s", pstGovernor->szPrefix, REC_GOVERN_LOG);
+		pstGovernor->fpLog = fopen(szName, "w");
+		if (!pstGovernor->fpLog)
+			return;
+		fprintf(pstGovernor->fpLog, "time_us,time,block,sample,from,to,hw_fill_promille,sw_fill_promille\n");
+	}
+	fprintf(pstGovernor->fpLog, "%lld,%s,%llu,%llu,%s,%s,%d,%d\n", (long long)llTimeUs, szTime,
+		(unsigned long long)pstGovernor->qwBlocks, (unsigned long long)qwSample,
+		pszGovernorLevelName(lFrom), pszGovernorLevelName(pstGovernor->lLevel), lHwFill, lSwFill);
+	fflush(pstGovernor->fpLog);
+}
+
+
+
+/*
+**************************************************************************
+lGovernorDo: up at once, down one level after the hold time
+**************************************************************************
+*/
+
+int32_t lGovernorDo(ST_GOVERNOR* pstGovernor, int32_t lHwFill, int32_t lSwFill, uint64_t qwSample)
+{
+	int32_t lFill = (lHwFill > lSwFill) ? lHwFill : lSwFill;
+	int32_t lFrom = pstGovernor->lLevel;
+	int32_t lLevel = lFrom;
+
+	while (lLevel < REC_GOVERN_LEVELS - 1 && lFill >= pstGovernor->alUp[lLevel])
+		lLevel++;
+	if (lLevel > lFrom)
+		pstGovernor->dwCalm = 0;
+	else if (lLevel > REC_GOVERN_FULL && lFill < pstGovernor->alDown[lLevel - 1])
+	{
+		if (++pstGovernor->dwCalm >= pstGovernor->dwHoldBlocks)
+		{
+			lLevel--;
+			pstGovernor->dwCalm = 0;
+		}
+	}
+	else
+		pstGovernor->dwCalm = 0;
+
+	pstGovernor->lLevel = lLevel;
+	if (lLevel != lFrom)
+	{
+		pstGovernor->qwChanges++;
+		vLogChange(pstGovernor, lFrom, lHwFill, lSwFill, qwSample);
+	}
+
+	if (lFill > pstGovernor->lMaxFill)
+		pstGovernor->lMaxFill = lFill;
+	pstGovernor->aqwLevelBlocks[lLevel]++;
+	pstGovernor->qwBlocks++;
+	return lLevel;
+}
+
+
+
+/*
+**************************************************************************
+pszGovernorLevelName
+**************************************************************************
+*/
+
+const char* pszGovernorLevelName(int32_t lLevel)
+{
+	switch (lLevel)
+	{
+		case REC_GOVERN_FULL:   return "full";
+		case REC_GOVERN_NOPLOT: return "no_plot";
+		case REC_GOVERN_STORE:  return "no_compression";
+		case REC_GOVERN_RAW:    return "raw_only";
+	}
+	return "unknown";
+}
+
+
+
+/*
+**************************************************************************
+vGovernorClose
+**************************************************************************
+*/
+
+void vGovernorClose(ST_GOVERNOR* pstGovernor)
+{
+	if (pstGovernor->qwChanges)
+	{
+		printf("\nGovernor: %llu changes, max fill %.1lf %%, blocks", (unsigned long long)pstGovernor->qwChanges, pstGovernor->lMaxFill / 10.0);
+		for (int32_t i = 0; i < REC_GOVERN_LEVELS; i++)
+			printf("%s %s %llu", i ? "," : "", pszGovernorLevelName(i), (unsigned long long)pstGovernor->aqwLevelBlocks[i]);
+		printf("\n");
+	}
+	if (pstGovernor->fpLog)
+		fclose(pstGovernor->fpLog);
+	pstGovernor->fpLog = NULL;
+}
@@ -0,0 +1,90 @@
+/*
+**************************************************************************
+
+rec_governor.h
+
+**************************************************************************
+
+Overload governor of the FIFO loop. If the processing can't follow the
+card, the fill of the card buffer (SPC_FILLSIZEPROMILLE) and of the
+software buffer (dwDataAvailBytes) climbs until the card overruns and
+the run is lost. The governor takes the higher of both fills of every
+block and sheds the optional work in steps, the raw capture is never
+shed:
+
+	REC_GOVERN_FULL     all work
+	REC_GOVERN_NOPLOT   no plot and no live preview
+	REC_GOVERN_STORE    the stream container stores its chunks without
+	                    compression
+	REC_GOVERN_RAW      no decoding, only the raw data goes to disk; the
+	                    decoders count on over the blocks (vDecoderSkip),
+	                    the streams have a gap; with a recovered clock
+	                    only the sync words (rec_lock) find the frames
+	                    behind it for sure
+
+A level is entered as soon as the fill reaches its alUp threshold, more
+than one level at once if the fill jumps. It is left one level at a
+time after dwHoldBlocks blocks in a row below its alDown threshold, so
+a drained buffer does not bring the load back at once. Every change
+goes to the console and with the wall clock, the block and the raw
+sample of a channel to the side log governor_log.csv in the output
+directory. The log is created with the first change, a run without
+overload leaves no file.
+**************************************************************************
+*/
+
+#ifndef REC_GOVERNOR_H
+#define REC_GOVERNOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// ----- levels, each one sheds the work of the levels below too -----
+#define REC_GOVERN_FULL         0
+#define REC_GOVERN_NOPLOT       1
+#define REC_GOVERN_STORE        2
+#define REC_GOVERN_RAW          3
+#define REC_GOVERN_LEVELS       4
+
+#define REC_GOVERN_HOLD         16          // default blocks below the down threshold before a level is left
+#define REC_GOVERN_LOG          "governor_log.csv"
+
+// ----- default thresholds in promille of the buffers, index level - 1 -----
+#define REC_GOVERN_UP           { 400, 600, 750 }
+#define REC_GOVERN_DOWN         { 200, 350, 500 }
+
+
+struct ST_GOVERNOR
+{
+	// setup
+	int32_t     alUp[REC_GOVERN_LEVELS - 1];
+	int32_t     alDown[REC_GOVERN_LEVELS - 1];
+	uint32_t    dwHoldBlocks;
+	char        szPrefix[100];              // output directory of the card, in front of the log and the console lines
+	FILE*       fpLog;
+
+	// state, FIFO loop only; the pipeline blocks carry the level they were acquired with
+	int32_t     lLevel;
+	uint32_t    dwCalm;                     // blocks in a row below the down threshold of the level
+	uint64_t    qwBlocks;
+
+	// statistics
+	uint64_t    aqwLevelBlocks[REC_GOVERN_LEVELS];
+	uint64_t    qwChanges;
+	int32_t     lMaxFill;                   // promille
+};
+
+
+// ----- default thresholds, the log goes to szPrefix governor_log.csv -----
+void vGovernorInit(ST_GOVERNOR* pstGovernor, const char* szPrefix, uint32_t dwHoldBlocks = REC_GOVERN_HOLD);
+
+// ----- fills of one block in promille (-1 if unknown) and its first raw sample of a channel; returns the level for the block -----
+int32_t lGovernorDo(ST_GOVERNOR* pstGovernor, int32_t lHwFill, int32_t lSwFill, uint64_t qwSample);
+
+// ----- name of a level -----
+const char* pszGovernorLevelName(int32_t lLevel);
+
+// ----- prints the blocks of each level, closes the log -----
+void vGovernorClose(ST_GOVERNOR* pstGovernor);
+
+#endif
@@ -0,0 +1,319 @@
+/*
+**************************************************************************
+
+rec_lock.cpp
+
+**************************************************************************
+
+Frame lock of the decoder, see rec_lock.h
+
+**************************************************************************
+*/
+
+#include <string.h>
+
+#include "rec_bits.h"
+#include "rec_decoder.h"
+#include "rec_lock.h"
+
+
+
+/*
+**************************************************************************
+bLockInit
+**************************************************************************
+*/
+
+bool bLockInit(ST_LOCK* pstLock, uint32_t dwInterval, const char* szSync, int32_t lMaxErrors)
+{
+	memset(pstLock, 0, sizeof(*pstLock));
+	pstLock->lState = REC_LOCK_LOCKED;
+
+	for (const char* pc = szSync; *pc; pc++)
+	{
+		if ((*pc != '0' && *pc != '1') || pstLock->lBits >= REC_LOCK_MAX_BITS)
+			return false;
+		if (*pc == '1')
+			pstLock->qwPattern |= 1ULL << pstLock->lBits;
+		pstLock->lBits++;
+	}
+	if (pstLock->lBits == 0 || lMaxErrors < 0 || 2 * lMaxErrors >= pstLock->lBits)
+		return false;
+	pstLock->lMaxErrors = lMaxErrors;
+	pstLock->dwInterval = dwInterval;
+	return bPreambleInit(&pstLock->stSearch, szSync, lMaxErrors);
+}
+
+
+
+/*
+**************************************************************************
+vLockBlock, vLockStart
+**************************************************************************
+*/
+
+void vLockBlock(ST_LOCK* pstLock, int64_t llBase, double dFirstSample, double dSamplesPerSymbol)
+{
+	pstLock->llBase = llBase;
+	pstLock->dFirstSample = dFirstSample;
+	pstLock->dSamplesPerSymbol = dSamplesPerSymbol;
+	pstLock->dwEvents = 0;
+}
+
+static void vLockEvent(ST_LOCK* pstLock, int32_t lType, int64_t llSymbol, int32_t lOffset)
+{
+	pstLock->qwEvents++;
+	if (pstLock->dwEvents >= REC_LOCK_MAX_EVENTS)
+		return;
+
+	double dSample = pstLock->dFirstSample + (double)(llSymbol - pstLock->llBase) * pstLock->dSamplesPerSymbol;
+	ST_LOCKEVENT* pstEvent = &pstLock->astEvent[pstLock->dwEvents++];
+	pstEvent->lType = lType;
+	pstEvent->lOffset = lOffset;
+	pstEvent->qwSymbol = (uint64_t)llSymbol;
+	pstEvent->qwSample = (dSample > 0) ? (uint64_t)(dSample + 0.5) : 0;
+}
+
+void vLockStart(ST_LOCK* pstLock, int64_t llStart)
+{
+	int64_t llSymbol = pstLock->llBase + llStart;
+	pstLock->lState = REC_LOCK_LOCKED;
+	pstLock->lMisses = 0;
+	pstLock->llNext = llSymbol + (int64_t)pstLock->dwInterval * REC_FRAME_SIZE;
+	pstLock->bSkipped = false;
+	vLockEvent(pstLock, REC_LOCK_ACQUIRED, llSymbol, 0);
+}
+
+
+
+/*
+**************************************************************************
+Line access: the symbols of the block and the tail of the blocks before,
+positions are line symbols
+**************************************************************************
+*/
+
+// ----- 64 line symbols from llPos, llPos is at most 64 symbols in front of the block -----
+static uint64_t qwLineBits(const ST_LOCK* pstLock, const uint64_t* pqwBits, int64_t llPos)
+{
+	int64_t llRel = llPos - pstLock->llBase;
+	if (llRel >= 0)
+		return qwGetBits(pqwBits, llRel);
+
+	uint64_t qwValue = qwGetBits(pstLock->aqwTail, pstLock->lTailBits + llRel);
+	int32_t lFromTail = (int32_t)-llRel;
+	if (lFromTail >= 64)
+		return qwValue;
+	return (qwValue & ((1ULL << lFromTail) - 1)) | (pqwBits[0] << lFromTail);
+}
+
+// ----- symbols that differ from the sync word at llPos, more than lBits if llPos is not in the tail and the block -----
+static int32_t lSyncErrors(const ST_LOCK* pstLock, const uint64_t* pqwBits, uint32_t dwBits, int64_t llPos)
+{
+	if (llPos < pstLock->llBase - pstLock->lTailBits || llPos + pstLock->lBits > pstLock->llBase + dwBits)
+		return pstLock->lBits + 1;
+	uint64_t qwMask = (pstLock->lBits == 64) ? ~0ULL : (1ULL << pstLock->lBits) - 1;
+	return lBitCount((qwLineBits(pstLock, pqwBits, llPos) ^ pstLock->qwPattern) & qwMask);
+}
+
+// ----- best match in REC_LOCK_WINDOW symbols around llPos, the nearest one of equal matches -----
+static bool bFindSync(const ST_LOCK* pstLock, const uint64_t* pqwBits, uint32_t dwBits, int64_t llPos, int32_t* plOffset)
+{
+	int32_t lBest = pstLock->lMaxErrors + 1;
+	for (int32_t i = 0; i <= 2 * REC_LOCK_WINDOW; i++)
+	{
+		int32_t lOffset = (i & 1) ? -(i + 1) / 2 : i / 2;
+		int32_t lErrors = lSyncErrors(pstLock, pqwBits, dwBits, llPos + lOffset);
+		if (lErrors < lBest)
+		{
+			lBest = lErrors;
+			*plOffset = lOffset;
+		}
+	}
+	return lBest <= pstLock->lMaxErrors;
+}
+
+// ----- demuxes line symbols llFrom to llTo - 1, from the tail first; no more than dwStride bytes per stream -----
+static uint32_t dwDemuxLine(ST_LOCK* pstLock, ST_DEMUX* pstDemux, const uint64_t* pqwBits, int64_t llFrom, int64_t llTo, uint8_t* pbyStreams, uint32_t dwLen, uint32_t dwStride)
+{
+	int64_t llRoom = (int64_t)(dwStride - dwLen) * REC_FRAME_SIZE - pstDemux->lCarryBits + REC_FRAME_SIZE - 1;
+	if (llTo - llFrom > llRoom)
+		llTo = llFrom + llRoom;
+
+	if (llFrom < pstLock->llBase && llFrom < llTo)
+	{
+		int64_t llTailStart = pstLock->llBase - pstLock->lTailBits;
+		int64_t llTailTo = (llTo < pstLock->llBase) ? llTo : pstLock->llBase;
+		dwLen += dwDemuxDo(pstDemux, pstLock->aqwTail, llFrom - llTailStart, llTailTo - llTailStart, pbyStreams + dwLen, dwStride);
+		llFrom = llTailTo;
+	}
+	if (llFrom < llTo)
+		dwLen += dwDemuxDo(pstDemux, pqwBits, llFrom - pstLock->llBase, llTo - pstLock->llBase, pbyStreams + dwLen, dwStride);
+	return dwLen;
+}
+
+// ----- last symbols of the line for the next block -----
+static void vLockTail(ST_LOCK* pstLock, const uint64_t* pqwBits, uint32_t dwBits)
+{
+	const int32_t lMaxBits = REC_LOCK_TAIL_WORDS * 64;
+	uint64_t aqwTail[REC_LOCK_TAIL_WORDS + 1];
+	int32_t lFromBlock = ((int64_t)dwBits < lMaxBits) ? (int32_t)dwBits : lMaxBits;
+	int32_t lFromTail = (pstLock->lTailBits < lMaxBits - lFromBlock) ? pstLock->lTailBits : lMaxBits - lFromBlock;
+
+	memset(aqwTail, 0, sizeof(aqwTail));
+	vAppendBits(aqwTail, 0, pstLock->aqwTail, pstLock->lTailBits - lFromTail, lFromTail);
+	vAppendBits(aqwTail, lFromTail, pqwBits, dwBits - lFromBlock, lFromBlock);
+	memcpy(pstLock->aqwTail, aqwTail, sizeof(aqwTail));
+	pstLock->lTailBits = lFromTail + lFromBlock;
+}
+
+
+
+/*
+**************************************************************************
+dwLockDemux: frames up to the next sync word, the sync word is checked
+as soon as the window behind it is in the block
+**************************************************************************
+*/
+
+uint32_t dwLockDemux(ST_LOCK* pstLock, ST_DEMUX* pstDemux, const uint64_t* pqwBits, int64_t llFirst, uint32_t dwBits, uint8_t* pbyStreams, uint32_t dwStride)
+{
+	const int64_t llEnd = pstLock->llBase + dwBits;
+	const int64_t llFrames = (int64_t)pstLock->dwInterval * REC_FRAME_SIZE;
+	const int64_t llPeriod = llFrames + pstLock->lBits;
+	int64_t llCursor = pstLock->llBase + llFirst;
+	uint32_t dwLen = 0;
+	bool bSearched = false;
+	int32_t lOffset = 0;
+
+	// a sync word cut by the end of the last block goes on in this one
+	if (pstLock->lState == REC_LOCK_LOCKED && pstLock->bSkipped && pstLock->llNext + pstLock->lBits > llCursor)
+		llCursor = pstLock->llNext + pstLock->lBits;
+
+	for (;;)
+	{
+		int64_t llSync = pstLock->llNext;
+		bool bWindowIn = (llSync + pstLock->lBits + REC_LOCK_WINDOW <= llEnd);
+
+		if (pstLock->lState == REC_LOCK_LOCKED)
+		{
+			// frames up to the sync word, the sync word itself is skipped
+			if (!pstLock->bSkipped)
+			{
+				int64_t llTo = (llSync < llEnd) ? llSync : llEnd;
+				dwLen = dwDemuxLine(pstLock, pstDemux, pqwBits, llCursor, llTo, pbyStreams, dwLen, dwStride);
+				if (llSync >= llEnd)
+					break;
+				pstLock->bSkipped = true;
+				llCursor = llSync + pstLock->lBits;
+			}
+
+			// the frames behind it stay in the demux carry until the sync word is checked
+			if (!bWindowIn)
+			{
+				dwLen = dwDemuxLine(pstLock, pstDemux, pqwBits, llCursor, llEnd, pbyStreams, dwLen, dwStride);
+				break;
+			}
+			pstLock->bSkipped = false;
+			pstLock->qwChecks++;
+			if (lSyncErrors(pstLock, pqwBits, dwBits, llSync) <= pstLock->lMaxErrors)
+			{
+				pstLock->llNext += llPeriod;
+				continue;
+			}
+
+			// moved by a dropped or an extra symbol: the frames go on behind the sync word found
+			vDemuxReset(pstDemux);
+			if (bFindSync(pstLock, pqwBits, dwBits, llSync, &lOffset))
+			{
+				vLockEvent(pstLock, REC_LOCK_RESYNC, llSync + lOffset, lOffset);
+				pstLock->qwResyncs++;
+				llCursor = llSync + lOffset + pstLock->lBits;
+				pstLock->llNext = llCursor + llFrames;
+				continue;
+			}
+			vLockEvent(pstLock, REC_LOCK_LOST, llSync, 0);
+			pstLock->qwLosses++;
+			pstLock->lState = REC_LOCK_HUNT;
+			pstLock->lMisses = 1;
+			pstLock->llNext += llPeriod;
+		}
+		else if (pstLock->lState == REC_LOCK_HUNT)
+		{
+			// window around the expected sync word, nothing is demuxed until it is found
+			if (!bWindowIn)
+				break;
+			if (bFindSync(pstLock, pqwBits, dwBits, llSync, &lOffset))
+			{
+				vLockEvent(pstLock, REC_LOCK_RESYNC, llSync + lOffset, lOffset);
+				pstLock->qwResyncs++;
+				pstLock->lState = REC_LOCK_LOCKED;
+				pstLock->lMisses = 0;
+				llCursor = llSync + lOffset + pstLock->lBits;
+				pstLock->llNext = llCursor + llFrames;
+				continue;
+			}
+			pstLock->llNext += llPeriod;
+			if (++pstLock->lMisses > REC_LOCK_MAX_MISSES)
+			{
+				pstLock->lState = REC_LOCK_SEARCH;
+				vPreambleReset(&pstLock->stSearch);
+			}
+		}
+		else if (pstLock->lState == REC_LOCK_SEARCH)
+		{
+			// whole block, once
+			if (bSearched)
+				break;
+			bSearched = true;
+			int64_t llFound = llPreambleSearch(&pstLock->stSearch, pqwBits, dwBits);
+			if (llFound < 0)
+				break;
+			pstLock->lState = REC_LOCK_CONFIRM;
+			pstLock->llNext = pstLock->llBase + llFound + llFrames;
+		}
+		else
+		{
+			// REC_LOCK_CONFIRM: a sync word found by the search counts if the next one is in place
+			if (llSync + pstLock->lBits > llEnd)
+				break;
+			if (lSyncErrors(pstLock, pqwBits, dwBits, llSync) <= pstLock->lMaxErrors)
+			{
+				vLockEvent(pstLock, REC_LOCK_ACQUIRED, llSync + pstLock->lBits, 0);
+				vDemuxReset(pstDemux);
+				pstLock->lState = REC_LOCK_LOCKED;
+				pstLock->lMisses = 0;
+				pstLock->bSkipped = false;
+				llCursor = llSync + pstLock->lBits;
+				pstLock->llNext = llCursor + llFrames;
+			}
+			else
+			{
+				pstLock->lState = REC_LOCK_SEARCH;
+				vPreambleReset(&pstLock->stSearch);
+			}
+		}
+	}
+
+	vLockTail(pstLock, pqwBits, dwBits);
+	return dwLen;
+}
+
+
+
+/*
+**************************************************************************
+pszLockEventName
+**************************************************************************
+*/
+
+const char* pszLockEventName(int32_t lType)
+{
+	switch (lType)
+	{
+		case REC_LOCK_ACQUIRED: return "acquired";
+		case REC_LOCK_RESYNC:   return "resync";
+		case REC_LOCK_LOST:     return "lost";
+	}
+	return "unknown";
+}
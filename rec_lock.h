@@ -0,0 +1,115 @@
+/*
+**************************************************************************
+
+rec_lock.h
+
+**************************************************************************
+
+Frame lock of the decoder. After the preamble the decoder only counts
+symbols, a dropped or an extra symbol shifts every later frame. A
+headstage that sends a sync word after every dwInterval frames lets the
+decoder check the frame position while demuxing:
+
+	locked      the sync word is compared at the expected position, the
+	            frames in between go to the demux
+	hunt        a sync word was missed, nothing is demuxed; at every
+	            expected position the sync word is searched in a window
+	            of REC_LOCK_WINDOW symbols on each side
+	search      REC_LOCK_MAX_MISSES windows without the sync word, the
+	            whole block is searched as for the preamble; the found
+	            position counts only after the next sync word matches
+
+A sync word found off its expected position in locked state resyncs
+the frames at once, the partial frame in the demux is dropped. All
+changes are kept as events of the block with the symbol and an
+estimate of the sample they happened at, rec_writer logs them.
+
+dwInterval 0 switches the check off: the headstage sends frames only,
+as the original line code.
+**************************************************************************
+*/
+
+#ifndef REC_LOCK_H
+#define REC_LOCK_H
+
+#include <stdint.h>
+
+// ----- 16 symbols with an aperiodic autocorrelation of at most 2 off the peak -----
+#define REC_LOCK_SYNC_DEFAULT   "1111100110010100"
+
+#define REC_LOCK_MAX_BITS       64          // sync word
+#define REC_LOCK_WINDOW         16          // symbols searched on each side of the expected sync word
+#define REC_LOCK_MAX_MISSES     4           // windows without the sync word before the whole block is searched
+#define REC_LOCK_MAX_EVENTS     16          // per block, more are only counted
+#define REC_LOCK_TAIL_WORDS     3           // last symbols of a block, sync word and both windows
+
+#define REC_LOCK_LOCKED         0
+#define REC_LOCK_HUNT           1
+#define REC_LOCK_SEARCH         2
+#define REC_LOCK_CONFIRM        3           // found by the search, waiting for the next sync word
+
+// ----- event types -----
+#define REC_LOCK_ACQUIRED       0           // preamble or confirmed search, frames from lSymbol on
+#define REC_LOCK_RESYNC         1           // sync word lOffset symbols off the expected position
+#define REC_LOCK_LOST           2           // no sync word at the expected position
+
+
+struct ST_LOCKEVENT
+{
+	int32_t     lType;
+	int32_t     lOffset;            // REC_LOCK_RESYNC: symbols, negative if the sync word came early
+	uint64_t    qwSymbol;           // of the line, counted from the first block
+	uint64_t    qwSample;           // estimated from the symbol clock
+};
+
+struct ST_LOCK
+{
+	// setup
+	uint64_t    qwPattern;          // bit j is sync symbol j
+	int32_t     lBits;
+	int32_t     lMaxErrors;
+	uint32_t    dwInterval;         // frames between the sync words, 0 for no check
+	ST_PREAMBLE stSearch;           // sync word as preamble, REC_LOCK_SEARCH
+
+	// carried from block to block
+	int32_t     lState;
+	int32_t     lMisses;            // windows without the sync word
+	int64_t     llNext;             // line symbol of the next sync word
+	bool        bSkipped;           // the demux has skipped the next sync word already, it is checked with the next block
+	uint64_t    aqwTail[REC_LOCK_TAIL_WORDS + 1];
+	int32_t     lTailBits;          // symbols in aqwTail, they end at the current block
+
+	// line symbol 0 of the block and its sample, samples per symbol
+	int64_t     llBase;
+	double      dFirstSample;
+	double      dSamplesPerSymbol;
+
+	// events of the last block
+	ST_LOCKEVENT astEvent[REC_LOCK_MAX_EVENTS];
+	uint32_t    dwEvents;
+
+	// statistics
+	uint64_t    qwChecks;
+	uint64_t    qwResyncs;
+	uint64_t    qwLosses;
+	uint64_t    qwEvents;           // including the ones not kept
+};
+
+
+// ----- sync word as string of '0' and '1' after dwInterval frames, lMaxErrors symbols may differ; dwInterval 0 for no check -----
+bool bLockInit(ST_LOCK* pstLock, uint32_t dwInterval, const char* szSync = REC_LOCK_SYNC_DEFAULT, int32_t lMaxErrors = 1);
+
+// ----- new block: line symbol and sample of its first symbol, samples per symbol; clears the events -----
+void vLockBlock(ST_LOCK* pstLock, int64_t llBase, double dFirstSample, double dSamplesPerSymbol);
+
+// ----- preamble found, the frames start at symbol llStart of the block -----
+void vLockStart(ST_LOCK* pstLock, int64_t llStart);
+
+// ----- demuxes the frames of symbols llFirst to dwBits - 1 of a block around the sync words,
+// ----- returns the number of bytes written to each stream, at most dwBits / REC_FRAME_SIZE + 1
+uint32_t dwLockDemux(ST_LOCK* pstLock, ST_DEMUX* pstDemux, const uint64_t* pqwBits, int64_t llFirst, uint32_t dwBits, uint8_t* pbyStreams, uint32_t dwStride);
+
+// ----- name of an event type -----
+const char* pszLockEventName(int32_t lType);
+
+#endif
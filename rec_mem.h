@@ -0,0 +1,152 @@
+/*
+**************************************************************************
+
+rec_mem.h
+
+**************************************************************************
+
+Aligned allocation for the buffers that go to the disk or to SIMD
+kernels.
+
+The large buffers of the recording (the write ring of the raw capture,
+the blocks of the pipeline) can be backed by large pages, a few TLB
+entries then cover gigabytes, and placed on the NUMA node of the card.
+Large pages need the lock memory privilege on Windows (granted by the
+policy "Lock pages in memory") and reserved huge pages under Linux
+(vm.nr_hugepages), else the buffer gets normal pages, under Linux with
+transparent huge pages if the kernel has them.
+**************************************************************************
+*/
+
+#ifndef REC_MEM_H
+#define REC_MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+	#include <malloc.h>
+	#include <Windows.h>
+#else
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#if defined(__linux__)
+		#include <sys/syscall.h>
+		#include <linux/mempolicy.h>
+	#endif
+#endif
+
+#define REC_MEM_ALIGNMENT   4096    // page and sector size
+#define REC_MEM_HUGE_PAGE   (2 * 1024 * 1024)   // huge page of x64 Linux
+
+
+static inline void* pvRecAlignedAlloc(size_t dwLen, size_t dwAlignment = REC_MEM_ALIGNMENT)
+{
+#if defined(_WIN32)
+	return _aligned_malloc(dwLen, dwAlignment);
+#else
+	void* pv = NULL;
+	return (posix_memalign(&pv, dwAlignment, dwLen) == 0) ? pv : NULL;
+#endif
+}
+
+static inline void vRecAlignedFree(void* pv)
+{
+#if defined(_WIN32)
+	_aligned_free(pv);
+#else
+	free(pv);
+#endif
+}
+
+// ----- the lock memory privilege for large pages, once per process -----
+#if defined(_WIN32)
+static inline bool bRecLargePagePrivilege()
+{
+	static int s_lGranted = -1;
+	if (s_lGranted < 0)
+	{
+		HANDLE hToken;
+		TOKEN_PRIVILEGES stPrivileges;
+		s_lGranted = 0;
+		if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+		{
+			stPrivileges.PrivilegeCount = 1;
+			stPrivileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &stPrivileges.Privileges[0].Luid)
+				&& AdjustTokenPrivileges(hToken, FALSE, &stPrivileges, 0, NULL, NULL) && GetLastError() == ERROR_SUCCESS)
+				s_lGranted = 1;
+			CloseHandle(hToken);
+		}
+	}
+	return s_lGranted == 1;
+}
+#endif
+
+// ----- page aligned buffer on large pages if bLarge and the system gives them, on NUMA node lNode (< 0 for any); *pbLarge tells which pages it got -----
+static inline void* pvRecLargeAlloc(size_t dwLen, int32_t lNode, bool bLarge, bool* pbLarge)
+{
+	void* pv = NULL;
+	if (pbLarge)
+		*pbLarge = false;
+
+#if defined(_WIN32)
+	DWORD dwNode = (lNode >= 0) ? (DWORD)lNode : NUMA_NO_PREFERRED_NODE;
+	SIZE_T dwLargePage = GetLargePageMinimum();
+	if (bLarge && dwLargePage && bRecLargePagePrivilege())
+	{
+		SIZE_T dwLargeLen = (dwLen + dwLargePage - 1) & ~(dwLargePage - 1);
+		pv = VirtualAllocExNuma(GetCurrentProcess(), NULL, dwLargeLen, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, dwNode);
+		if (pv && pbLarge)
+			*pbLarge = true;
+	}
+	if (!pv)
+		pv = VirtualAllocExNuma(GetCurrentProcess(), NULL, dwLen, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, dwNode);
+	return pv;
+#else
+	size_t dwMapLen = (dwLen + REC_MEM_HUGE_PAGE - 1) & ~(size_t)(REC_MEM_HUGE_PAGE - 1);
+	#if defined(MAP_HUGETLB)
+	if (bLarge)
+	{
+		pv = mmap(NULL, dwMapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (pv != MAP_FAILED && pbLarge)
+			*pbLarge = true;
+	}
+	#endif
+	if (!pv || pv == MAP_FAILED)
+	{
+		pv = mmap(NULL, dwMapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pv == MAP_FAILED)
+			return NULL;
+	#if defined(MADV_HUGEPAGE)
+		if (bLarge)
+			madvise(pv, dwMapLen, MADV_HUGEPAGE);
+	#endif
+	}
+	// the pages are placed at the first touch, so the policy is set before
+	#if defined(__linux__)
+	if (lNode >= 0 && lNode < (int32_t)(8 * sizeof(unsigned long)))
+	{
+		unsigned long qwNodeMask = 1UL << lNode;
+		syscall(SYS_mbind, pv, dwMapLen, MPOL_PREFERRED, &qwNodeMask, 8 * sizeof(qwNodeMask), 0);
+	}
+	#endif
+	return pv;
+#endif
+}
+
+// ----- frees a buffer of pvRecLargeAlloc of the same length -----
+static inline void vRecLargeFree(void* pv, size_t dwLen)
+{
+	if (!pv)
+		return;
+#if defined(_WIN32)
+	(void)dwLen;
+	VirtualFree(pv, 0, MEM_RELEASE);
+#else
+	munmap(pv, (dwLen + REC_MEM_HUGE_PAGE - 1) & ~(size_t)(REC_MEM_HUGE_PAGE - 1));
+#endif
+}
+
+#endif
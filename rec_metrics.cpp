@@ -0,0 +1,322 @@
+/*
+**************************************************************************
+
+rec_metrics.cpp
+
+**************************************************************************
+
+Latency histograms and fill level time series, see rec_metrics.h
+
+**************************************************************************
+*/
+
+#include <string.h>
+#include <new>
+
+#include "rec_cpu.h"
+#include "rec_metrics.h"
+
+static const char* s_apszStage[REC_STAGE_NUM] = { "copy", "slice", "preamble", "demux", "streams", "raw", "plot", "preview", "block" };
+
+
+
+/*
+**************************************************************************
+qwBucketTop: largest value of a bucket
+**************************************************************************
+*/
+
+static uint64_t qwBucketTop(int32_t lBucket)
+{
+	if (lBucket < (1 << REC_METRICS_SUB_BITS))
+		return (uint64_t)lBucket;
+	int32_t lExp = (lBucket >> REC_METRICS_SUB_BITS) + REC_METRICS_SUB_BITS - 1;
+	uint64_t qwSub = (uint64_t)(lBucket & ((1 << REC_METRICS_SUB_BITS) - 1));
+	uint64_t qwWidth = 1ULL << (lExp - REC_METRICS_SUB_BITS);
+	return (((1ULL << REC_METRICS_SUB_BITS) + qwSub) << (lExp - REC_METRICS_SUB_BITS)) + qwWidth - 1;
+}
+
+// ----- value below which dQuantile of the counts are, the top of a bucket is cut to the largest value seen -----
+static uint64_t qwPercentile(const uint64_t* paqwCount, uint64_t qwTotal, double dQuantile, uint64_t qwMax)
+{
+	uint64_t qwTarget = (uint64_t)(dQuantile * qwTotal + 0.999999);
+	uint64_t qwSum = 0;
+
+	if (qwTarget == 0)
+		qwTarget = 1;
+	for (int32_t i = 0; i < REC_METRICS_BUCKETS; i++)
+	{
+		qwSum += paqwCount[i];
+		if (qwSum >= qwTarget)
+			return (qwBucketTop(i) < qwMax) ? qwBucketTop(i) : qwMax;
+	}
+	return qwMax;
+}
+
+const char* pszMetricsStage(int32_t lStage)
+{
+	return (lStage >= 0 && lStage < REC_STAGE_NUM) ? s_apszStage[lStage] : "?";
+}
+
+
+
+/*
+**************************************************************************
+vDump: histograms of the last period and the new fill samples
+**************************************************************************
+*/
+
+static void vDump(ST_METRICS* pstMetrics, double dPeriodTime)
+{
+	double dTime = (double)(qwMetricsNow() - pstMetrics->qwStartNs) / 1.0e9;
+	uint64_t aqwDelta[REC_METRICS_BUCKETS];
+
+	for (int32_t s = 0; s < REC_STAGE_NUM; s++)
+	{
+		ST_HISTOGRAM* pstHist = &pstMetrics->astStage[s];
+		uint64_t qwCount = 0;
+		for (int32_t i = 0; i < REC_METRICS_BUCKETS; i++)
+		{
+			uint64_t qwNow = pstHist->aqwBucket[i].load(std::memory_order_relaxed);
+			aqwDelta[i] = qwNow - pstMetrics->aqwLast[s][i];
+			pstMetrics->aqwLast[s][i] = qwNow;
+			qwCount += aqwDelta[i];
+		}
+		uint64_t qwSum = pstHist->qwSum.load(std::memory_order_relaxed);
+		uint64_t qwSumDelta = qwSum - pstMetrics->aqwLastSum[s];
+		pstMetrics->aqwLastSum[s] = qwSum;
+		uint64_t qwMax = pstHist->qwMax.exchange(0, std::memory_order_relaxed);
+		if (qwMax > pstHist->qwRunMax)
+			pstHist->qwRunMax = qwMax;
+
+		if (qwCount == 0 || !pstMetrics->fpStages)
+			continue;
+		double dMean = (double)qwSumDelta / qwCount;
+		fprintf(pstMetrics->fpStages, "%.3lf,%s,%llu,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf\n",
+			dTime, s_apszStage[s], (unsigned long long)qwCount, dMean / 1000.0,
+			qwPercentile(aqwDelta, qwCount, 0.5, qwMax) / 1000.0,
+			qwPercentile(aqwDelta, qwCount, 0.9, qwMax) / 1000.0,
+			qwPercentile(aqwDelta, qwCount, 0.99, qwMax) / 1000.0,
+			qwPercentile(aqwDelta, qwCount, 0.999, qwMax) / 1000.0,
+			qwMax / 1000.0,
+			(dPeriodTime > 0) ? 100.0 * qwSumDelta / 1.0e9 / dPeriodTime : 0.0,
+			(pstMetrics->dBlockBudget > 0) ? 100.0 * dMean / 1.0e9 / pstMetrics->dBlockBudget : 0.0);
+	}
+
+	// samples the FIFO loop has overwritten already are lost
+	uint64_t qwWrite = pstMetrics->qwFillWrite.load(std::memory_order_acquire);
+	if (qwWrite - pstMetrics->qwFillRead > REC_METRICS_FILL)
+		pstMetrics->qwFillRead = qwWrite - REC_METRICS_FILL;
+	for (; pstMetrics->qwFillRead < qwWrite; pstMetrics->qwFillRead++)
+	{
+		const ST_FILLSAMPLE* pstSample = &pstMetrics->astFill[pstMetrics->qwFillRead % REC_METRICS_FILL];
+		if (pstMetrics->fpFill)
+			fprintf(pstMetrics->fpFill, "%.4lf,%d,%u\n", pstSample->dTime, pstSample->lHwFill, pstSample->dwAvailBytes);
+	}
+
+	if (pstMetrics->fpStages)
+		fflush(pstMetrics->fpStages);
+	if (pstMetrics->fpFill)
+		fflush(pstMetrics->fpFill);
+}
+
+static void vDumpThread(ST_METRICS* pstMetrics)
+{
+	bRecLowPriorityThread();
+
+	uint64_t qwLast = qwMetricsNow();
+	std::unique_lock<std::mutex> oGuard(pstMetrics->oLock);
+	while (!pstMetrics->bStop)
+	{
+		pstMetrics->oWake.wait_for(oGuard, std::chrono::duration<double>(pstMetrics->dPeriod));
+		oGuard.unlock();
+
+		uint64_t qwNow = qwMetricsNow();
+		vDump(pstMetrics, (double)(qwNow - qwLast) / 1.0e9);
+		qwLast = qwNow;
+
+		oGuard.lock();
+	}
+}
+
+
+
+/*
+**************************************************************************
+pstMetricsStart
+**************************************************************************
+*/
+
+static FILE* fpOpenMetrics(const char* szPrefix, const char* szName, const char* szHeader)
+{
+	char szFile[150];
+	snprintf(szFile, sizeof(szFile), "%s%s", szPrefix, szName);
+	FILE* fp = fopen(szFile, "w");
+	if (!fp)
+		printf("Can't create %s\n", szFile);
+	else
+		fputs(szHeader, fp);
+	return fp;
+}
+
+ST_METRICS* pstMetricsStart(const char* szPrefix, double dPeriod, double dBlockBudget)
+{
+	// too large for the stack of the work data
+	ST_METRICS* pstMetrics = new (std::nothrow) ST_METRICS;
+	if (!pstMetrics)
+		return NULL;
+
+	for (int32_t s = 0; s < REC_STAGE_NUM; s++)
+	{
+		ST_HISTOGRAM* pstHist = &pstMetrics->astStage[s];
+		for (int32_t i = 0; i < REC_METRICS_BUCKETS; i++)
+			pstHist->aqwBucket[i].store(0);
+		pstHist->qwCount.store(0);
+		pstHist->qwSum.store(0);
+		pstHist->qwMax.store(0);
+		pstHist->qwRunMax = 0;
+	}
+	memset(pstMetrics->aqwLast, 0, sizeof(pstMetrics->aqwLast));
+	memset(pstMetrics->aqwLastSum, 0, sizeof(pstMetrics->aqwLastSum));
+	pstMetrics->qwFillWrite.store(0);
+	pstMetrics->qwFillRead = 0;
+	pstMetrics->dPeriod = (dPeriod > 0) ? dPeriod : REC_METRICS_PERIOD;
+	pstMetrics->dBlockBudget = dBlockBudget;
+	pstMetrics->qwStartNs = qwMetricsNow();
+	snprintf(pstMetrics->szPrefix, sizeof(pstMetrics->szPrefix), "%s", szPrefix);
+	pstMetrics->bStop = false;
+	pstMetrics->bRunning = false;
+
+	pstMetrics->fpStages = fpOpenMetrics(szPrefix, "metrics_stages.csv", "time_s,stage,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us,busy_pct,budget_pct\n");
+	pstMetrics->fpFill = fpOpenMetrics(szPrefix, "metrics_fill.csv", "time_s,hw_fill_promille,sw_avail_bytes\n");
+	if (!pstMetrics->fpStages || !pstMetrics->fpFill)
+	{
+		vMetricsStop(pstMetrics);
+		vMetricsFree(pstMetrics);
+		return NULL;
+	}
+
+	pstMetrics->oThread = std::thread(vDumpThread, pstMetrics);
+	pstMetrics->bRunning = true;
+	return pstMetrics;
+}
+
+
+
+/*
+**************************************************************************
+vMetricsFill
+**************************************************************************
+*/
+
+void vMetricsFill(ST_METRICS* pstMetrics, int32_t lHwFill, uint32_t dwAvailBytes)
+{
+	if (!pstMetrics)
+		return;
+
+	uint64_t qwWrite = pstMetrics->qwFillWrite.load(std::memory_order_relaxed);
+	ST_FILLSAMPLE* pstSample = &pstMetrics->astFill[qwWrite % REC_METRICS_FILL];
+	pstSample->dTime = (double)(qwMetricsNow() - pstMetrics->qwStartNs) / 1.0e9;
+	pstSample->lHwFill = lHwFill;
+	pstSample->dwAvailBytes = dwAvailBytes;
+	pstMetrics->qwFillWrite.store(qwWrite + 1, std::memory_order_release);
+}
+
+
+
+/*
+**************************************************************************
+vMetricsStop: the JSON summary holds the histograms of the whole run
+**************************************************************************
+*/
+
+void vMetricsStop(ST_METRICS* pstMetrics)
+{
+	if (pstMetrics->bRunning)
+	{
+		{
+			std::lock_guard<std::mutex> oGuard(pstMetrics->oLock);
+			pstMetrics->bStop = true;
+		}
+		pstMetrics->oWake.notify_all();
+		pstMetrics->oThread.join();
+		pstMetrics->bRunning = false;
+
+		FILE* fp = fpOpenMetrics(pstMetrics->szPrefix, "metrics.json", "");
+		if (fp)
+		{
+			fprintf(fp, "{\n\t\"run_s\": %.3lf,\n\t\"block_budget_us\": %.1lf,\n\t\"stages\": {\n",
+				(double)(qwMetricsNow() - pstMetrics->qwStartNs) / 1.0e9, pstMetrics->dBlockBudget * 1.0e6);
+			bool bFirst = true;
+			for (int32_t s = 0; s < REC_STAGE_NUM; s++)
+			{
+				const uint64_t* paqwCount = pstMetrics->aqwLast[s];
+				uint64_t qwCount = 0;
+				for (int32_t i = 0; i < REC_METRICS_BUCKETS; i++)
+					qwCount += paqwCount[i];
+				if (qwCount == 0)
+					continue;
+				fprintf(fp, "%s\t\t\"%s\": { \"count\": %llu, \"mean_us\": %.1lf, \"p50_us\": %.1lf, \"p90_us\": %.1lf, \"p99_us\": %.1lf, \"p999_us\": %.1lf, \"max_us\": %.1lf }",
+					bFirst ? "" : ",\n", s_apszStage[s], (unsigned long long)qwCount,
+					(double)pstMetrics->aqwLastSum[s] / qwCount / 1000.0,
+					qwPercentile(paqwCount, qwCount, 0.5, pstMetrics->astStage[s].qwRunMax) / 1000.0,
+					qwPercentile(paqwCount, qwCount, 0.9, pstMetrics->astStage[s].qwRunMax) / 1000.0,
+					qwPercentile(paqwCount, qwCount, 0.99, pstMetrics->astStage[s].qwRunMax) / 1000.0,
+					qwPercentile(paqwCount, qwCount, 0.999, pstMetrics->astStage[s].qwRunMax) / 1000.0,
+					pstMetrics->astStage[s].qwRunMax / 1000.0);
+				bFirst = false;
+			}
+			fprintf(fp, "\n\t}\n}\n");
+			fclose(fp);
+		}
+	}
+
+	if (pstMetrics->fpStages)
+		fclose(pstMetrics->fpStages);
+	if (pstMetrics->fpFill)
+		fclose(pstMetrics->fpFill);
+	pstMetrics->fpStages = pstMetrics->fpFill = NULL;
+}
+
+
+
+/*
+**************************************************************************
+vMetricsPrint: after vMetricsStop
+**************************************************************************
+*/
+
+void vMetricsPrint(const ST_METRICS* pstMetrics)
+{
+	printf("Stage        count     mean      p99    p99.9      max  [us]%s\n", (pstMetrics->dBlockBudget > 0) ? "   p99 of budget" : "");
+	for (int32_t s = 0; s < REC_STAGE_NUM; s++)
+	{
+		const uint64_t* paqwCount = pstMetrics->aqwLast[s];
+		uint64_t qwCount = 0;
+		for (int32_t i = 0; i < REC_METRICS_BUCKETS; i++)
+			qwCount += paqwCount[i];
+		if (qwCount == 0)
+			continue;
+
+		uint64_t qwP99 = qwPercentile(paqwCount, qwCount, 0.99, pstMetrics->astStage[s].qwRunMax);
+		printf("%-9s %8llu %8.1lf %8.1lf %8.1lf %8.1lf", s_apszStage[s], (unsigned long long)qwCount,
+			(double)pstMetrics->aqwLastSum[s] / qwCount / 1000.0, qwP99 / 1000.0,
+			qwPercentile(paqwCount, qwCount, 0.999, pstMetrics->astStage[s].qwRunMax) / 1000.0, pstMetrics->astStage[s].qwRunMax / 1000.0);
+		if (pstMetrics->dBlockBudget > 0)
+			printf("        %6.1lf %%", 100.0 * qwP99 / 1.0e9 / pstMetrics->dBlockBudget);
+		printf("\n");
+	}
+}
+
+
+
+/*
+**************************************************************************
+vMetricsFree
+**************************************************************************
+*/
+
+void vMetricsFree(ST_METRICS* pstMetrics)
+{
+	delete pstMetrics;
+}
@@ -0,0 +1,162 @@
+/*
+**************************************************************************
+
+rec_metrics.h
+
+**************************************************************************
+
+Latency histograms of the processing stages and fill level time series
+of the FIFO loop. The hot path only takes a time stamp and adds one
+count to a lock-free histogram with log-linear buckets: 16 sub buckets
+per power of two, so every value is kept with 6 % resolution from one
+ns up to the full 64 bit range.
+
+A low priority thread dumps the histograms every dPeriod seconds:
+
+	<prefix>metrics_stages.csv  per period and stage: count, mean, p50,
+	                            p90, p99, p99.9, max in us and the busy
+	                            time in % of the period
+	<prefix>metrics_fill.csv    one line per sample: time, HW-Buf fill
+	                            in promille, SW-Buf bytes available
+	<prefix>metrics.json        summary of the whole run, written at
+	                            the stop
+
+With the block budget set (time of one notify block at the sampling
+rate) a stage that eats the budget shows up in the busy time and the
+tail latency of the period of the overrun.
+**************************************************************************
+*/
+
+#ifndef REC_METRICS_H
+#define REC_METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rec_bits.h"
+
+#define REC_METRICS_SUB_BITS    4                                       // 16 sub buckets per power of two
+#define REC_METRICS_BUCKETS     ((64 - REC_METRICS_SUB_BITS + 1) << REC_METRICS_SUB_BITS)
+#define REC_METRICS_FILL        8192                                    // fill samples between two dumps
+#define REC_METRICS_PERIOD      1.0                                     // default seconds between dumps
+
+// ----- timed stages -----
+enum
+{
+	REC_STAGE_COPY,         // block copy to the pipeline, channel de-interleave
+	REC_STAGE_SLICE,
+	REC_STAGE_PREAMBLE,
+	REC_STAGE_DEMUX,
+	REC_STAGE_STREAMS,      // stream writer append and flush
+	REC_STAGE_RAW,          // raw writer queue
+	REC_STAGE_PLOT,
+	REC_STAGE_PREVIEW,      // envelope to the shared memory ring
+	REC_STAGE_BLOCK,        // whole work routine of the FIFO loop
+	REC_STAGE_NUM
+};
+
+
+struct ST_HISTOGRAM
+{
+	std::atomic<uint64_t>   aqwBucket[REC_METRICS_BUCKETS];
+	std::atomic<uint64_t>   qwCount;
+	std::atomic<uint64_t>   qwSum;          // ns
+	std::atomic<uint64_t>   qwMax;          // ns, since the last dump
+	uint64_t                qwRunMax;       // ns, whole run, dump thread only
+};
+
+struct ST_FILLSAMPLE
+{
+	double      dTime;                      // s since the start
+	int32_t     lHwFill;                    // promille
+	uint32_t    dwAvailBytes;
+};
+
+struct ST_METRICS
+{
+	ST_HISTOGRAM            astStage[REC_STAGE_NUM];
+
+	// fill time series, FIFO loop -> dump thread
+	ST_FILLSAMPLE           astFill[REC_METRICS_FILL];
+	std::atomic<uint64_t>   qwFillWrite;
+	uint64_t                qwFillRead;
+
+	// dump thread
+	double                  dPeriod;
+	double                  dBlockBudget;   // s per block, 0 if unknown
+	uint64_t                qwStartNs;
+	uint64_t                aqwLast[REC_STAGE_NUM][REC_METRICS_BUCKETS];
+	uint64_t                aqwLastSum[REC_STAGE_NUM];
+	char                    szPrefix[100];
+	FILE*                   fpStages;
+	FILE*                   fpFill;
+	std::thread             oThread;
+	std::mutex              oLock;
+	std::condition_variable oWake;
+	bool                    bStop;
+	bool                    bRunning;
+};
+
+
+// ----- ns of a steady clock -----
+static inline uint64_t qwMetricsNow()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline int32_t lMetricsBucket(uint64_t qwValue)
+{
+	if (qwValue < (1u << REC_METRICS_SUB_BITS))
+		return (int32_t)qwValue;
+	int32_t lExp = lHighestBit(qwValue);
+	return ((lExp - REC_METRICS_SUB_BITS + 1) << REC_METRICS_SUB_BITS) + (int32_t)((qwValue >> (lExp - REC_METRICS_SUB_BITS)) & ((1u << REC_METRICS_SUB_BITS) - 1));
+}
+
+// ----- start of a timed section, 0 without metrics -----
+static inline uint64_t qwMetricsStart(const ST_METRICS* pstMetrics)
+{
+	return pstMetrics ? qwMetricsNow() : 0;
+}
+
+// ----- adds the time since qwStart to the stage, returns the time as start of the next section -----
+static inline uint64_t qwMetricsLap(ST_METRICS* pstMetrics, int32_t lStage, uint64_t qwStart)
+{
+	if (!pstMetrics)
+		return 0;
+
+	uint64_t qwNow = qwMetricsNow();
+	uint64_t qwValue = qwNow - qwStart;
+	ST_HISTOGRAM* pstHist = &pstMetrics->astStage[lStage];
+	pstHist->aqwBucket[lMetricsBucket(qwValue)].fetch_add(1, std::memory_order_relaxed);
+	pstHist->qwCount.fetch_add(1, std::memory_order_relaxed);
+	pstHist->qwSum.fetch_add(qwValue, std::memory_order_relaxed);
+	uint64_t qwMax = pstHist->qwMax.load(std::memory_order_relaxed);
+	while (qwValue > qwMax && !pstHist->qwMax.compare_exchange_weak(qwMax, qwValue, std::memory_order_relaxed))
+		;
+	return qwNow;
+}
+
+// ----- allocates the metrics and starts the dump thread, dBlockBudget are the seconds of one block or 0, NULL on error -----
+ST_METRICS* pstMetricsStart(const char* szPrefix, double dPeriod = REC_METRICS_PERIOD, double dBlockBudget = 0);
+
+// ----- fill levels of the FIFO loop, one producer thread only -----
+void vMetricsFill(ST_METRICS* pstMetrics, int32_t lHwFill, uint32_t dwAvailBytes);
+
+// ----- last dump, writes the summary and stops the thread -----
+void vMetricsStop(ST_METRICS* pstMetrics);
+
+// ----- summary table of the whole run to stdout, after vMetricsStop -----
+void vMetricsPrint(const ST_METRICS* pstMetrics);
+
+// ----- frees the stopped metrics -----
+void vMetricsFree(ST_METRICS* pstMetrics);
+
+// ----- name of a stage -----
+const char* pszMetricsStage(int32_t lStage);
+
+#endif
@@ -0,0 +1,356 @@
+/*
+**************************************************************************
+
+rec_multi.cpp
+
+**************************************************************************
+
+Decoding of several analog channels of one card, see rec_multi.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rec_mem.h"
+#include "rec_metrics.h"
+#include "rec_multi.h"
+#include "rec_simd.h"
+
+
+
+/*
+**************************************************************************
+vMultiDeinterleave: samples of lChannel out of dwFrames interleaved frames
+**************************************************************************
+*/
+
+#if defined(REC_SIMD_SSE2)
+// ----- even (bOdd = 0) or odd int16 of a and b, packed -----
+static inline __m128i xPick(__m128i a, __m128i b, int32_t bOdd)
+{
+	if (bOdd)
+	{
+		a = _mm_srai_epi32(a, 16);
+		b = _mm_srai_epi32(b, 16);
+	}
+	else
+	{
+		a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+	}
+	return _mm_packs_epi32(a, b);
+}
+
+// ----- 2^LEVELS channels: each level halves the vectors, 8 samples of the channel are left -----
+template <int LEVELS>
+static void vDeinterleaveSIMD(const int16_t* pnSrc, uint32_t dwFrames, int32_t lChannel, int16_t* pnDst)
+{
+	const int32_t lChannels = 1 << LEVELS;
+	uint32_t f = 0;
+
+	for (; f + 8 <= dwFrames; f += 8)
+	{
+		__m128i v[1 << LEVELS];
+		for (int32_t k = 0; k < lChannels; k++)
+			v[k] = _mm_loadu_si128((const __m128i*)(pnSrc + (size_t)f * lChannels + 8 * k));
+
+		int32_t lVectors = lChannels;
+		for (int32_t l = 0; l < LEVELS; l++)
+		{
+			lVectors /= 2;
+			for (int32_t k = 0; k < lVectors; k++)
+				v[k] = xPick(v[2 * k], v[2 * k + 1], (lChannel >> l) & 1);
+		}
+		_mm_storeu_si128((__m128i*)(pnDst + f), v[0]);
+	}
+
+	for (; f < dwFrames; f++)
+		pnDst[f] = pnSrc[(size_t)f * lChannels + lChannel];
+}
+#endif
+
+void vMultiDeinterleave(const int16_t* pnSrc, uint32_t dwFrames, int32_t lChannels, int32_t lChannel, int16_t* pnDst)
+{
+#if defined(REC_SIMD_SSE2)
+	switch (lChannels)
+	{
+	case 2: vDeinterleaveSIMD<1>(pnSrc, dwFrames, lChannel, pnDst); return;
+	case 4: vDeinterleaveSIMD<2>(pnSrc, dwFrames, lChannel, pnDst); return;
+	case 8: vDeinterleaveSIMD<3>(pnSrc, dwFrames, lChannel, pnDst); return;
+	}
+#endif
+
+	for (uint32_t f = 0; f < dwFrames; f++)
+		pnDst[f] = pnSrc[(size_t)f * lChannels + lChannel];
+}
+
+
+
+/*
+**************************************************************************
+bDecodeChannel: de-interleave and decode one channel of the current block
+**************************************************************************
+*/
+
+static bool bDecodeChannel(ST_MULTIDECODER* pstMulti, int32_t lChannel)
+{
+	uint32_t dwFrames = pstMulti->dwBlockSamples / pstMulti->lChannels;
+	uint64_t qwTime = qwMetricsStart(pstMulti->pstMetrics);
+	vMultiDeinterleave(pstMulti->pnBlock, dwFrames, pstMulti->lChannels, lChannel, pstMulti->apnChannel[lChannel]);
+	qwMetricsLap(pstMulti->pstMetrics, REC_STAGE_COPY, qwTime);
+	return bDecoderDo(&pstMulti->astDecoder[lChannel], pstMulti->apnChannel[lChannel], dwFrames);
+}
+
+static void vWorkerThread(ST_MULTIDECODER* pstMulti, int32_t lChannel)
+{
+	uint64_t qwDone = 0;
+
+	bRecPinThread(&pstMulti->stCpus, REC_CPU_CHANNEL(lChannel));
+	while (1)
+	{
+		{
+			std::unique_lock<std::mutex> oGuard(pstMulti->oLock);
+			pstMulti->oStart.wait(oGuard, [pstMulti, qwDone] { return pstMulti->bStop || pstMulti->qwGeneration != qwDone; });
+			if (pstMulti->bStop)
+				return;
+			qwDone = pstMulti->qwGeneration;
+		}
+
+		pstMulti->abOk[lChannel] = bDecodeChannel(pstMulti, lChannel);
+
+		{
+			std::lock_guard<std::mutex> oGuard(pstMulti->oLock);
+			pstMulti->lBusy--;
+		}
+		pstMulti->oDone.notify_one();
+	}
+}
+
+
+
+/*
+**************************************************************************
+bMultiDecoderInit
+**************************************************************************
+*/
+
+bool bMultiDecoderInit(ST_MULTIDECODER* pstMulti, int32_t lChannels, uint32_t dwMaxSamples, const char* szPreamble, int32_t lPreambleErrors, const ST_CPUSET* pstCpus)
+{
+	pstMulti->lChannels = 0;
+	pstMulti->dwMaxSamples = dwMaxSamples;
+	pstMulti->qwGeneration = 0;
+	pstMulti->lBusy = 0;
+	pstMulti->bStop = false;
+	pstMulti->pstMetrics = NULL;
+	vRecCpuCopy(&pstMulti->stCpus, pstCpus);
+	memset(pstMulti->apnChannel, 0, sizeof(pstMulti->apnChannel));
+
+	if (lChannels < 1 || lChannels > REC_MAX_ADC)
+	{
+		printf("Can decode 1 to %d channels, not %d\n", REC_MAX_ADC, lChannels);
+		return false;
+	}
+
+	// lChannels is set per decoder, so the close only frees what is set up
+	uint32_t dwChannelSamples = dwMaxSamples / lChannels;
+	for (int32_t i = 0; i < lChannels; i++)
+	{
+		pstMulti->lChannels = i + 1;
+		if (!bDecoderInit(&pstMulti->astDecoder[i], dwChannelSamples, szPreamble, lPreambleErrors))
+			return false;
+
+		if (lChannels > 1)
+		{
+			pstMulti->apnChannel[i] = (int16_t*)pvRecAlignedAlloc((size_t)dwChannelSamples * sizeof(int16_t));
+			if (!pstMulti->apnChannel[i])
+				return false;
+			memset(pstMulti->apnChannel[i], 0, (size_t)dwChannelSamples * sizeof(int16_t));
+		}
+	}
+
+	for (int32_t i = 1; i < lChannels; i++)
+		pstMulti->aoWorker[i] = std::thread(vWorkerThread, pstMulti, i);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bMultiDecoderDo
+**************************************************************************
+*/
+
+bool bMultiDecoderDo(ST_MULTIDECODER* pstMulti, const int16_t* pnData, uint32_t dwSamples)
+{
+	if (pstMulti->lChannels == 1)
+		return bDecoderDo(&pstMulti->astDecoder[0], pnData, dwSamples);
+
+	{
+		std::lock_guard<std::mutex> oGuard(pstMulti->oLock);
+		pstMulti->pnBlock = pnData;
+		pstMulti->dwBlockSamples = dwSamples;
+		pstMulti->lBusy = pstMulti->lChannels - 1;
+		pstMulti->qwGeneration++;
+	}
+	pstMulti->oStart.notify_all();
+
+	pstMulti->abOk[0] = bDecodeChannel(pstMulti, 0);
+
+	std::unique_lock<std::mutex> oGuard(pstMulti->oLock);
+	pstMulti->oDone.wait(oGuard, [pstMulti] { return pstMulti->lBusy == 0; });
+
+	bool bOk = true;
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+		bOk = bOk && pstMulti->abOk[i];
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+vMultiDecoderSkip: no workers needed, the decoders only count on
+**************************************************************************
+*/
+
+void vMultiDecoderSkip(ST_MULTIDECODER* pstMulti, uint32_t dwSamples)
+{
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+	{
+		ST_DECODER* pstDecoder = &pstMulti->astDecoder[i];
+		vDecoderSkip(pstDecoder, dwSamples / pstMulti->lChannels);
+		pstDecoder->dwStreamLen = 0;
+		pstDecoder->stLock.dwEvents = 0;
+	}
+}
+
+
+
+/*
+**************************************************************************
+vMultiDecoderSetMetrics
+**************************************************************************
+*/
+
+void vMultiDecoderSetMetrics(ST_MULTIDECODER* pstMulti, ST_METRICS* pstMetrics)
+{
+	pstMulti->pstMetrics = pstMetrics;
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+		pstMulti->astDecoder[i].pstMetrics = pstMetrics;
+}
+
+
+
+/*
+**************************************************************************
+bMultiDecoderSetThreshold
+**************************************************************************
+*/
+
+bool bMultiDecoderSetThreshold(ST_MULTIDECODER* pstMulti, int32_t lMode, double dHysteresis)
+{
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+		if (!bDecoderSetThreshold(&pstMulti->astDecoder[i], lMode, dHysteresis))
+			return false;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bMultiDecoderSetTiming
+**************************************************************************
+*/
+
+bool bMultiDecoderSetTiming(ST_MULTIDECODER* pstMulti, int32_t lMode, double dSamplesPerSymbol)
+{
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+		if (!bDecoderSetTiming(&pstMulti->astDecoder[i], lMode, dSamplesPerSymbol))
+			return false;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bMultiDecoderSetLock
+**************************************************************************
+*/
+
+bool bMultiDecoderSetLock(ST_MULTIDECODER* pstMulti, uint32_t dwInterval, const char* szSync, int32_t lMaxErrors)
+{
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+		if (!bDecoderSetLock(&pstMulti->astDecoder[i], dwInterval, szSync, lMaxErrors))
+			return false;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vMultiDecoderArena
+**************************************************************************
+*/
+
+void vMultiDecoderArena(const ST_MULTIDECODER* pstMulti, size_t* pdwHighWater, size_t* pdwSize, bool* pbLocked)
+{
+	*pdwHighWater = *pdwSize = 0;
+	*pbLocked = pstMulti->lChannels > 0;
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+	{
+		*pdwHighWater += pstMulti->astDecoder[i].stArena.dwHighWater;
+		*pdwSize += pstMulti->astDecoder[i].stArena.dwSize;
+		*pbLocked = *pbLocked && pstMulti->astDecoder[i].stArena.bLocked;
+	}
+}
+
+
+
+/*
+**************************************************************************
+vMultiDecoderClose
+**************************************************************************
+*/
+
+void vMultiDecoderClose(ST_MULTIDECODER* pstMulti)
+{
+	{
+		std::lock_guard<std::mutex> oGuard(pstMulti->oLock);
+		pstMulti->bStop = true;
+	}
+	pstMulti->oStart.notify_all();
+	for (int32_t i = 1; i < REC_MAX_ADC; i++)
+		if (pstMulti->aoWorker[i].joinable())
+			pstMulti->aoWorker[i].join();
+
+	for (int32_t i = 0; i < pstMulti->lChannels; i++)
+	{
+		vDecoderClose(&pstMulti->astDecoder[i]);
+		vRecAlignedFree(pstMulti->apnChannel[i]);
+		pstMulti->apnChannel[i] = NULL;
+	}
+	pstMulti->lChannels = 0;
+}
+
+
+
+/*
+**************************************************************************
+pszMultiPrefix: adcX_ in front of the stream names
+**************************************************************************
+*/
+
+char* pszMultiPrefix(const ST_MULTIDECODER* pstMulti, int32_t lChannel, char* szBuffer, int32_t lBufferLen)
+{
+	if (pstMulti->lChannels > 1)
+		snprintf(szBuffer, lBufferLen, "adc%d_", lChannel);
+	else if (lBufferLen > 0)
+		szBuffer[0] = 0;
+	return szBuffer;
+}
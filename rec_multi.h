@@ -0,0 +1,89 @@
+/*
+**************************************************************************
+
+rec_multi.h
+
+**************************************************************************
+
+Decoding of several analog channels of one card. The card delivers the
+samples of the enabled channels interleaved. Every channel has its own
+decoder (slicer, preamble, demux and carry over), the channels are
+de-interleaved and decoded in parallel: channel 0 on the calling
+thread, the other channels on one worker thread each. With one channel
+the block goes straight to the decoder without a copy.
+**************************************************************************
+*/
+
+#ifndef REC_MULTI_H
+#define REC_MULTI_H
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rec_cpu.h"
+#include "rec_decoder.h"
+
+#define REC_MAX_ADC     8       // analog channels decoded at once
+
+
+struct ST_MULTIDECODER
+{
+	int32_t                 lChannels;
+	uint32_t                dwMaxSamples;               // interleaved samples of a block
+	ST_DECODER              astDecoder[REC_MAX_ADC];
+	ST_METRICS*             pstMetrics;                 // stage timers of all channels, NULL for none
+	int16_t*                apnChannel[REC_MAX_ADC];    // de-interleaved samples of the block
+
+	// workers of the channels 1 .. lChannels - 1
+	ST_CPUSET               stCpus;
+	std::thread             aoWorker[REC_MAX_ADC];
+	std::mutex              oLock;
+	std::condition_variable oStart;
+	std::condition_variable oDone;
+	uint64_t                qwGeneration;               // counts the blocks, protected by oLock
+	int32_t                 lBusy;                      // workers still decoding, protected by oLock
+	bool                    bStop;
+
+	// current block
+	const int16_t*          pnBlock;
+	uint32_t                dwBlockSamples;
+	bool                    abOk[REC_MAX_ADC];
+};
+
+
+// ----- lChannels decoders for interleaved blocks of up to dwMaxSamples, starts the workers, pinned if pstCpus is set -----
+bool bMultiDecoderInit(ST_MULTIDECODER* pstMulti, int32_t lChannels, uint32_t dwMaxSamples, const char* szPreamble = REC_PREAMBLE_DEFAULT, int32_t lPreambleErrors = 0, const ST_CPUSET* pstCpus = NULL);
+
+// ----- decodes all channels of one interleaved block, the results are in astDecoder -----
+bool bMultiDecoderDo(ST_MULTIDECODER* pstMulti, const int16_t* pnData, uint32_t dwSamples);
+
+// ----- all channels go on behind dwSamples interleaved samples that are not decoded, see vDecoderSkip -----
+void vMultiDecoderSkip(ST_MULTIDECODER* pstMulti, uint32_t dwSamples);
+
+// ----- stage timers for all channels, NULL switches them off -----
+void vMultiDecoderSetMetrics(ST_MULTIDECODER* pstMulti, ST_METRICS* pstMetrics);
+
+// ----- slicer threshold of all channels, see bDecoderSetThreshold -----
+bool bMultiDecoderSetThreshold(ST_MULTIDECODER* pstMulti, int32_t lMode, double dHysteresis = 0);
+
+// ----- symbol timing of all channels, see bDecoderSetTiming -----
+bool bMultiDecoderSetTiming(ST_MULTIDECODER* pstMulti, int32_t lMode, double dSamplesPerSymbol = REC_DOWN_SAMPLING_RATE);
+
+// ----- sync word check of all channels, see bDecoderSetLock -----
+bool bMultiDecoderSetLock(ST_MULTIDECODER* pstMulti, uint32_t dwInterval, const char* szSync = REC_LOCK_SYNC_DEFAULT, int32_t lMaxErrors = 1);
+
+// ----- arena use of all channels -----
+void vMultiDecoderArena(const ST_MULTIDECODER* pstMulti, size_t* pdwHighWater, size_t* pdwSize, bool* pbLocked);
+
+// ----- stops the workers and frees the decoders -----
+void vMultiDecoderClose(ST_MULTIDECODER* pstMulti);
+
+// ----- samples of lChannel out of dwFrames frames of lChannels interleaved channels -----
+void vMultiDeinterleave(const int16_t* pnSrc, uint32_t dwFrames, int32_t lChannels, int32_t lChannel, int16_t* pnDst);
+
+// ----- file name prefix of the streams of a channel, empty with one channel -----
+char* pszMultiPrefix(const ST_MULTIDECODER* pstMulti, int32_t lChannel, char* szBuffer, int32_t lBufferLen);
+
+#endif
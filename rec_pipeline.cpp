@@ -0,0 +1,294 @@
+/*
+**************************************************************************
+
+rec_pipeline.cpp
+
+**************************************************************************
+
+Threaded processing of the notify blocks, see rec_pipeline.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "rec_mem.h"
+#include "rec_metrics.h"
+#include "rec_pipeline.h"
+
+
+
+static double dPipeTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t llWallTimeUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// ----- waits for an entry, NULL if the pipeline stops and the ring is empty -----
+static void* pvWaitPop(ST_PIPESTAGE* pstStage, ST_SPSCRING* pstRing)
+{
+	int32_t lSpins = 0;
+	while (1)
+	{
+		void* pvEntry = pvSpscPop(pstRing);
+		if (pvEntry)
+			return pvEntry;
+		if (pstStage->bStop.load(std::memory_order_acquire))
+		{
+			// the producer may have pushed right before the stop
+			return pvSpscPop(pstRing);
+		}
+		if (++lSpins < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+static void vWaitPush(ST_SPSCRING* pstRing, void* pvEntry)
+{
+	while (!bSpscPush(pstRing, pvEntry))
+		std::this_thread::yield();
+}
+
+
+
+/*
+**************************************************************************
+vDecodeThread: decoder and copy of the streams to the pipeline block
+**************************************************************************
+*/
+
+static void vDecodeThread(ST_PIPELINE* pstPipe)
+{
+	ST_PIPEBLOCK* pstBlock;
+	ST_MULTIDECODER* pstMulti = pstPipe->pstDecoder;
+
+	bRecPinThread(&pstPipe->stCpus, REC_CPU_DECODE);
+	while ((pstBlock = (ST_PIPEBLOCK*)pvWaitPop(&pstPipe->stDecodeStage, &pstPipe->stDecode)) != NULL)
+	{
+		double dStart = dPipeTime();
+		for (int32_t c = 0; c < pstBlock->lChannels; c++)
+		{
+			pstBlock->astChannel[c].dwStreamLen = 0;
+			pstBlock->astChannel[c].dwEvents = 0;
+		}
+
+		if (pstBlock->lLevel >= REC_GOVERN_RAW)
+			vMultiDecoderSkip(pstMulti, pstBlock->dwBytes / sizeof(int16_t));
+		else if (!pstPipe->bError.load() && !bMultiDecoderDo(pstMulti, pstBlock->pnSamples, pstBlock->dwBytes / sizeof(int16_t)))
+			pstPipe->bError.store(true);
+
+		// the decoders reuse their arenas with the next block, the block gets a copy of the streams
+		for (int32_t c = 0; c < pstBlock->lChannels; c++)
+		{
+			ST_DECODER* pstDecoder = &pstMulti->astDecoder[c];
+			ST_PIPESTREAMS* pstStreams = &pstBlock->astChannel[c];
+
+			pstStreams->bRecording = pstDecoder->bRecording;
+			pstStreams->dwEvents = pstDecoder->stLock.dwEvents;
+			memcpy(pstStreams->astEvent, pstDecoder->stLock.astEvent, pstStreams->dwEvents * sizeof(ST_LOCKEVENT));
+			if (pstDecoder->dwStreamLen <= pstBlock->dwStreamCap)
+			{
+				for (int i = 0; i < REC_STREAM_NUM; i++)
+					memcpy(pstStreams->apbyStream[i], pstDecoder->apbyStream[i], pstDecoder->dwStreamLen);
+				pstStreams->dwStreamLen = pstDecoder->dwStreamLen;
+			}
+			else
+				pstPipe->bError.store(true);
+		}
+
+		pstPipe->stDecodeStage.dBusy += dPipeTime() - dStart;
+		pstPipe->stDecodeStage.qwBlocks++;
+		vWaitPush(&pstPipe->stOutput, pstBlock);
+	}
+}
+
+
+
+/*
+**************************************************************************
+vOutputThread: output callback, then the block is free again
+**************************************************************************
+*/
+
+static void vOutputThread(ST_PIPELINE* pstPipe)
+{
+	ST_PIPEBLOCK* pstBlock;
+
+	bRecPinThread(&pstPipe->stCpus, REC_CPU_OUTPUT);
+	while ((pstBlock = (ST_PIPEBLOCK*)pvWaitPop(&pstPipe->stOutputStage, &pstPipe->stOutput)) != NULL)
+	{
+		double dStart = dPipeTime();
+		if (!pstPipe->bError.load() && !pstPipe->bOutput(pstPipe->pvOutput, pstBlock))
+			pstPipe->bError.store(true);
+		pstPipe->stOutputStage.dBusy += dPipeTime() - dStart;
+		pstPipe->stOutputStage.qwBlocks++;
+		vWaitPush(&pstPipe->stFree, pstBlock);
+	}
+}
+
+
+
+/*
+**************************************************************************
+bPipelineStart
+**************************************************************************
+*/
+
+bool bPipelineStart(ST_PIPELINE* pstPipe, ST_MULTIDECODER* pstDecoder, bool (*bOutput) (void*, ST_PIPEBLOCK*), void* pvOutput, uint32_t dwBlockBytes, int32_t lBlocks, const ST_CPUSET* pstCpus)
+{
+	pstPipe->pstBlocks = NULL;
+	pstPipe->stFree.ppvSlot = pstPipe->stDecode.ppvSlot = pstPipe->stOutput.ppvSlot = NULL;
+	pstPipe->lBlocks = (lBlocks < 2) ? 2 : lBlocks;
+	pstPipe->dwBlockBytes = dwBlockBytes;
+	pstPipe->pstDecoder = pstDecoder;
+	pstPipe->bOutput = bOutput;
+	pstPipe->pvOutput = pvOutput;
+	vRecCpuCopy(&pstPipe->stCpus, pstCpus);
+	pstPipe->stAcquire.dBusy = pstPipe->stDecodeStage.dBusy = pstPipe->stOutputStage.dBusy = 0;
+	pstPipe->stAcquire.qwBlocks = pstPipe->stDecodeStage.qwBlocks = pstPipe->stOutputStage.qwBlocks = 0;
+	pstPipe->qwAcquireWaits = 0;
+	pstPipe->stDecodeStage.bStop.store(false);
+	pstPipe->stOutputStage.bStop.store(false);
+	pstPipe->bError.store(false);
+	pstPipe->bRunning = false;
+
+	if (!bSpscInit(&pstPipe->stFree, pstPipe->lBlocks) || !bSpscInit(&pstPipe->stDecode, pstPipe->lBlocks) || !bSpscInit(&pstPipe->stOutput, pstPipe->lBlocks))
+		return false;
+
+	pstPipe->pstBlocks = (ST_PIPEBLOCK*)calloc(pstPipe->lBlocks, sizeof(ST_PIPEBLOCK));
+	if (!pstPipe->pstBlocks)
+		return false;
+	for (int32_t i = 0; i < pstPipe->lBlocks; i++)
+	{
+		pstPipe->pstBlocks[i].pnSamples = (int16_t*)pvRecLargeAlloc(dwBlockBytes, pstPipe->stCpus.lNode, pstPipe->stCpus.bLargePages, &pstPipe->bLargePages);
+		if (!pstPipe->pstBlocks[i].pnSamples)
+		{
+			printf("Can't allocate %d pipeline blocks of %u kByte\n", pstPipe->lBlocks, dwBlockBytes / 1024);
+			return false;
+		}
+		memset(pstPipe->pstBlocks[i].pnSamples, 0, dwBlockBytes);    // no page faults in the FIFO loop
+
+		// streams of the largest block of each channel, allocated once as the samples
+		ST_PIPEBLOCK* pstBlock = &pstPipe->pstBlocks[i];
+		size_t dwStreamsLen;
+		pstBlock->lChannels = pstDecoder->lChannels;
+		pstBlock->dwStreamCap = dwDecoderMaxStreamLen(dwBlockBytes / sizeof(int16_t) / pstDecoder->lChannels, &pstDecoder->astDecoder[0]);
+		dwStreamsLen = (size_t)pstBlock->lChannels * REC_STREAM_NUM * pstBlock->dwStreamCap;
+		pstBlock->pbyStreams = (uint8_t*)pvRecAlignedAlloc(dwStreamsLen);
+		if (!pstBlock->pbyStreams)
+			return false;
+		memset(pstBlock->pbyStreams, 0, dwStreamsLen);
+		for (int32_t c = 0; c < pstBlock->lChannels; c++)
+			for (int k = 0; k < REC_STREAM_NUM; k++)
+				pstBlock->astChannel[c].apbyStream[k] = pstBlock->pbyStreams + ((size_t)c * REC_STREAM_NUM + k) * pstBlock->dwStreamCap;
+		bSpscPush(&pstPipe->stFree, &pstPipe->pstBlocks[i]);
+	}
+
+	pstPipe->stDecodeStage.oThread = std::thread(vDecodeThread, pstPipe);
+	pstPipe->stOutputStage.oThread = std::thread(vOutputThread, pstPipe);
+	pstPipe->bRunning = true;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bPipelinePush
+**************************************************************************
+*/
+
+bool bPipelinePush(ST_PIPELINE* pstPipe, const void* pvData, uint32_t dwBytes, int32_t lHwFill, int32_t lSwFill, int32_t lLevel, int64_t llTimeUs)
+{
+	if (pstPipe->bError.load() || dwBytes > pstPipe->dwBlockBytes)
+		return false;
+
+	ST_PIPEBLOCK* pstBlock = (ST_PIPEBLOCK*)pvSpscPop(&pstPipe->stFree);
+	if (!pstBlock)
+	{
+		pstPipe->qwAcquireWaits++;
+		while ((pstBlock = (ST_PIPEBLOCK*)pvSpscPop(&pstPipe->stFree)) == NULL)
+		{
+			if (pstPipe->bError.load())
+				return false;
+			std::this_thread::yield();
+		}
+	}
+
+	double dStart = dPipeTime();
+	uint64_t qwTime = qwMetricsStart(pstPipe->pstDecoder->pstMetrics);
+	memcpy(pstBlock->pnSamples, pvData, dwBytes);
+	pstBlock->dwBytes = dwBytes;
+	pstBlock->llTimeUs = llTimeUs ? llTimeUs : llWallTimeUs();
+	pstBlock->lHwFill = lHwFill;
+	pstBlock->lSwFill = lSwFill;
+	pstBlock->lLevel = lLevel;
+	qwMetricsLap(pstPipe->pstDecoder->pstMetrics, REC_STAGE_COPY, qwTime);
+	pstPipe->stAcquire.dBusy += dPipeTime() - dStart;
+	pstPipe->stAcquire.qwBlocks++;
+
+	vWaitPush(&pstPipe->stDecode, pstBlock);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bPipelineStop
+**************************************************************************
+*/
+
+bool bPipelineStop(ST_PIPELINE* pstPipe)
+{
+	if (pstPipe->bRunning)
+	{
+		// each stage empties its ring before it stops, the output stage after the decode stage
+		pstPipe->stDecodeStage.bStop.store(true, std::memory_order_release);
+		pstPipe->stDecodeStage.oThread.join();
+		pstPipe->stOutputStage.bStop.store(true, std::memory_order_release);
+		pstPipe->stOutputStage.oThread.join();
+		pstPipe->bRunning = false;
+	}
+
+	if (pstPipe->pstBlocks)
+		for (int32_t i = 0; i < pstPipe->lBlocks; i++)
+		{
+			vRecLargeFree(pstPipe->pstBlocks[i].pnSamples, pstPipe->dwBlockBytes);
+			vRecAlignedFree(pstPipe->pstBlocks[i].pbyStreams);
+		}
+	free(pstPipe->pstBlocks);
+	pstPipe->pstBlocks = NULL;
+	vSpscFree(&pstPipe->stFree);
+	vSpscFree(&pstPipe->stDecode);
+	vSpscFree(&pstPipe->stOutput);
+
+	return !pstPipe->bError.load();
+}
+
+
+
+/*
+**************************************************************************
+vPipelinePrintStats
+**************************************************************************
+*/
+
+void vPipelinePrintStats(const ST_PIPELINE* pstPipe, double dWallTime)
+{
+	if (dWallTime <= 0)
+		return;
+	printf("Pipeline load:    acquire %.0lf %%, decode %.0lf %%, output %.0lf %%, %llu waits for a free block\n",
+		100.0 * pstPipe->stAcquire.dBusy / dWallTime,
+		100.0 * pstPipe->stDecodeStage.dBusy / dWallTime,
+		100.0 * pstPipe->stOutputStage.dBusy / dWallTime,
+		(unsigned long long)pstPipe->qwAcquireWaits);
+}
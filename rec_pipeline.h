@@ -0,0 +1,115 @@
+/*
+**************************************************************************
+
+rec_pipeline.h
+
+**************************************************************************
+
+Threaded processing of the notify blocks in three stages:
+
+	acquire     FIFO loop thread, copies the block to a free pipeline block,
+	            after that the block can go back to the card
+	decode      own thread, slicer, preamble and demux of all analog
+	            channels (rec_multi); blocks acquired under overload
+	            are only counted by the decoders
+	output      own thread, the bOutput callback of the caller: raw and
+	            stream files, plots
+
+The stages are connected by lock-free SPSC rings, the pipeline blocks
+go round from acquire over decode and output back to acquire. The
+throughput is the one of the slowest stage. If the later stages can't
+follow, the acquire stage waits for a free block and the card buffer
+fills up.
+**************************************************************************
+*/
+
+#ifndef REC_PIPELINE_H
+#define REC_PIPELINE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+#include "rec_cpu.h"
+#include "rec_governor.h"
+#include "rec_multi.h"
+#include "rec_spsc.h"
+
+#define REC_PIPELINE_BLOCKS     8   // default pipeline blocks in flight
+
+
+// ----- decoded streams of one analog channel -----
+struct ST_PIPESTREAMS
+{
+	uint8_t*        apbyStream[REC_STREAM_NUM];
+	uint32_t        dwStreamLen;
+	bool            bRecording;
+	ST_LOCKEVENT    astEvent[REC_LOCK_MAX_EVENTS];  // frame lock events of the block
+	uint32_t        dwEvents;
+};
+
+struct ST_PIPEBLOCK
+{
+	// raw block, filled by the acquire stage with the wall clock and the buffer fill levels for the raw capture
+	int16_t*    pnSamples;
+	uint32_t    dwBytes;
+	int64_t     llTimeUs;
+	int32_t     lHwFill;
+	int32_t     lSwFill;
+	int32_t     lLevel;         // overload level of the acquire (rec_governor), the decode stage skips REC_GOVERN_RAW blocks
+
+	// decoded streams, filled by the decode stage, stride dwStreamCap
+	uint8_t*        pbyStreams;
+	uint32_t        dwStreamCap;
+	int32_t         lChannels;
+	ST_PIPESTREAMS  astChannel[REC_MAX_ADC];
+};
+
+struct ST_PIPESTAGE
+{
+	std::thread         oThread;
+	std::atomic<bool>   bStop;          // input ring gets no more blocks
+	double              dBusy;          // seconds of work
+	uint64_t            qwBlocks;
+};
+
+struct ST_PIPELINE
+{
+	ST_PIPEBLOCK*       pstBlocks;
+	int32_t             lBlocks;
+	uint32_t            dwBlockBytes;
+
+	ST_SPSCRING         stFree;         // output -> acquire
+	ST_SPSCRING         stDecode;       // acquire -> decode
+	ST_SPSCRING         stOutput;       // decode -> output
+
+	ST_MULTIDECODER*    pstDecoder;
+	bool                (*bOutput) (void*, ST_PIPEBLOCK*);
+	void*               pvOutput;
+
+	ST_CPUSET           stCpus;
+	bool                bLargePages;    // the sample blocks are on large pages
+
+	ST_PIPESTAGE        stAcquire;
+	ST_PIPESTAGE        stDecodeStage;
+	ST_PIPESTAGE        stOutputStage;
+	uint64_t            qwAcquireWaits; // no free block
+
+	std::atomic<bool>   bError;
+	bool                bRunning;
+};
+
+
+// ----- starts the decode and output threads, pinned if pstCpus is set, bOutput(pvOutput, block) is called in order for every block -----
+bool bPipelineStart(ST_PIPELINE* pstPipe, ST_MULTIDECODER* pstDecoder, bool (*bOutput) (void*, ST_PIPEBLOCK*), void* pvOutput, uint32_t dwBlockBytes, int32_t lBlocks = REC_PIPELINE_BLOCKS, const ST_CPUSET* pstCpus = NULL);
+
+// ----- acquire stage: copies one block to the pipeline with the fill levels in promille (-1 if unknown), the overload level and its wall clock (0 for now), false if a later stage failed -----
+bool bPipelinePush(ST_PIPELINE* pstPipe, const void* pvData, uint32_t dwBytes, int32_t lHwFill = -1, int32_t lSwFill = -1, int32_t lLevel = REC_GOVERN_FULL, int64_t llTimeUs = 0);
+
+// ----- processes the pushed blocks, stops the threads and frees the blocks, false if a stage failed -----
+bool bPipelineStop(ST_PIPELINE* pstPipe);
+
+// ----- prints the load of the stages -----
+void vPipelinePrintStats(const ST_PIPELINE* pstPipe, double dWallTime);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+**************************************************************************
+
+rec_plot.cpp
+
+**************************************************************************
+
+MATLAB plotting sink for the decoded streams, see rec_plot.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h" // for matlab engine
+#include "rec_plot.h"
+
+
+// rat1 in figure 1, rat2 in figure 2, one subplot per channel, X is streams x points
+static const char* s_szPlotCmd =
+	"figure(1); for c = 1:8, subplot(2,4,c); plot(X(2*c-1,:)); end; "
+	"figure(2); for c = 1:8, subplot(2,4,c); plot(X(2*c,:)); end; "
+	"drawnow; hold off";
+
+
+
+/*
+**************************************************************************
+vPlotThread: owns the engine, plots the latest frame of the mailbox
+**************************************************************************
+*/
+
+static void vPlotThread(ST_PLOTSINK* pstSink, bool* pbStarted)
+{
+	Engine* ep = engOpen("");
+
+	{
+		std::lock_guard<std::mutex> oGuard(pstSink->oLock);
+		pstSink->bEngineOk = (ep != NULL);
+		*pbStarted = true;
+	}
+	pstSink->oWake.notify_all();
+
+	if (!ep)
+		return;
+
+	while (1)
+	{
+		// take the latest frame, the acquisition can post the next one meanwhile
+		{
+			std::unique_lock<std::mutex> oGuard(pstSink->oLock);
+			pstSink->oWake.wait(oGuard, [pstSink] { return pstSink->bStop || pstSink->bNewFrame; });
+			if (pstSink->bStop)
+				break;
+
+			uint8_t* pbyTmp = pstSink->pbyFrame;
+			pstSink->pbyFrame = pstSink->pbyMailbox;
+			pstSink->pbyMailbox = pbyTmp;
+			pstSink->dwFramePoints = pstSink->dwMailboxPoints;
+			pstSink->bNewFrame = false;
+		}
+
+		// one matrix and one command per refresh
+		mxArray* X = mxCreateNumericMatrix(REC_STREAM_NUM, pstSink->dwFramePoints, mxUINT8_CLASS, mxREAL);
+		memcpy(mxGetData(X), pstSink->pbyFrame, (size_t)REC_STREAM_NUM * pstSink->dwFramePoints);
+		engPutVariable(ep, "X", X);
+		mxDestroyArray(X);
+		engEvalString(ep, s_szPlotCmd);
+
+		pstSink->qwPlotted++;
+	}
+
+	engClose(ep);
+}
+
+
+
+/*
+**************************************************************************
+bPlotSinkInit
+**************************************************************************
+*/
+
+bool bPlotSinkInit(ST_PLOTSINK* pstSink, uint32_t dwMaxPoints)
+{
+	bool bStarted = false;
+
+	pstSink->bStop = false;
+	pstSink->bNewFrame = false;
+	pstSink->bEngineOk = false;
+	pstSink->dwMaxPoints = dwMaxPoints;
+	pstSink->dwMailboxPoints = 0;
+	pstSink->dwFramePoints = 0;
+	pstSink->qwPosted = 0;
+	pstSink->qwPlotted = 0;
+	pstSink->pbyMailbox = (uint8_t*)malloc((size_t)REC_STREAM_NUM * dwMaxPoints);
+	pstSink->pbyFrame = (uint8_t*)malloc((size_t)REC_STREAM_NUM * dwMaxPoints);
+	if (!pstSink->pbyMailbox || !pstSink->pbyFrame)
+	{
+		vPlotSinkClose(pstSink);
+		return false;
+	}
+
+	// the engine is opened by the thread itself, we wait for the result
+	pstSink->oThread = std::thread(vPlotThread, pstSink, &bStarted);
+	{
+		std::unique_lock<std::mutex> oGuard(pstSink->oLock);
+		pstSink->oWake.wait(oGuard, [&bStarted] { return bStarted; });
+	}
+
+	if (!pstSink->bEngineOk)
+	{
+		fprintf(stderr, "\nCan't start MATLAB engine, plotting disabled\n");
+		vPlotSinkClose(pstSink);
+		return false;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vPlotSinkPost: decimates the streams into the mailbox
+**************************************************************************
+*/
+
+void vPlotSinkPost(ST_PLOTSINK* pstSink, uint8_t* const* apbyStream, uint32_t dwStreamLen)
+{
+	if (!pstSink->bEngineOk || dwStreamLen == 0)
+		return;
+
+	// the sink thread only holds the lock for a pointer swap, if we miss it the frame is dropped
+	std::unique_lock<std::mutex> oGuard(pstSink->oLock, std::try_to_lock);
+	if (!oGuard.owns_lock())
+		return;
+
+	uint32_t dwStep = (dwStreamLen + pstSink->dwMaxPoints - 1) / pstSink->dwMaxPoints;
+	uint32_t dwPoints = dwStreamLen / dwStep;
+	uint8_t* pbyDst = pstSink->pbyMailbox;
+	for (uint32_t i = 0; i < dwPoints; i++)
+		for (int32_t lStream = 0; lStream < REC_STREAM_NUM; lStream++)
+			*pbyDst++ = apbyStream[lStream][i * dwStep];
+
+	pstSink->dwMailboxPoints = dwPoints;
+	pstSink->bNewFrame = true;
+	pstSink->qwPosted++;
+	oGuard.unlock();
+
+	pstSink->oWake.notify_one();
+}
+
+
+
+/*
+**************************************************************************
+vPlotSinkClose
+**************************************************************************
+*/
+
+void vPlotSinkClose(ST_PLOTSINK* pstSink)
+{
+	{
+		std::lock_guard<std::mutex> oGuard(pstSink->oLock);
+		pstSink->bStop = true;
+	}
+	pstSink->oWake.notify_all();
+
+	if (pstSink->oThread.joinable())
+		pstSink->oThread.join();
+
+	pstSink->bEngineOk = false;
+	free(pstSink->pbyMailbox);
+	free(pstSink->pbyFrame);
+	pstSink->pbyMailbox = NULL;
+	pstSink->pbyFrame = NULL;
+}
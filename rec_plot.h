@@ -0,0 +1,60 @@
+/*
+**************************************************************************
+
+rec_plot.h
+
+**************************************************************************
+
+MATLAB plotting sink for the decoded streams. The engine is opened once
+and driven by an own thread. The acquisition only posts a decimated copy
+of the streams to a one frame mailbox, newer frames replace older ones
+that have not been plotted yet, so a slow MATLAB never stalls the FIFO.
+**************************************************************************
+*/
+
+#ifndef REC_PLOT_H
+#define REC_PLOT_H
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rec_decoder.h"
+
+#define REC_PLOT_POINTS 2000    // default points per stream and refresh
+
+
+struct ST_PLOTSINK
+{
+	std::thread             oThread;
+	std::mutex              oLock;
+	std::condition_variable oWake;
+
+	// protected by oLock
+	bool                    bStop;
+	bool                    bNewFrame;
+	uint8_t*                pbyMailbox;     // REC_STREAM_NUM x dwMailboxPoints, latest posted frame
+	uint32_t                dwMailboxPoints;
+
+	// owned by the sink thread
+	uint8_t*                pbyFrame;       // frame currently plotted
+	uint32_t                dwFramePoints;
+
+	uint32_t                dwMaxPoints;
+	bool                    bEngineOk;
+	uint64_t                qwPosted;
+	uint64_t                qwPlotted;
+};
+
+
+// ----- opens the engine on the sink thread, false if MATLAB is not available -----
+bool bPlotSinkInit(ST_PLOTSINK* pstSink, uint32_t dwMaxPoints = REC_PLOT_POINTS);
+
+// ----- posts the streams of one block, never waits for the sink -----
+void vPlotSinkPost(ST_PLOTSINK* pstSink, uint8_t* const* apbyStream, uint32_t dwStreamLen);
+
+// ----- stops the thread and closes the engine -----
+void vPlotSinkClose(ST_PLOTSINK* pstSink);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+**************************************************************************
+
+rec_preamble.cpp
+
+**************************************************************************
+
+Preamble search on the packed sliced bits, see rec_preamble.h
+
+**************************************************************************
+*/
+
+#include <string.h>
+
+#include "rec_bits.h"
+#include "rec_preamble.h"
+
+#define MAX_PLANES  10  // counter planes for up to REC_PREAMBLE_MAX_BITS errors
+
+
+
+/*
+**************************************************************************
+llScan: first alignment in [llFirst, llLast] with at most lMaxErrors
+mismatches, -1 if there is none
+**************************************************************************
+*/
+
+static int64_t llScan(const ST_PREAMBLE* pstPreamble, const uint64_t* pqwBits, int64_t llFirst, int64_t llLast)
+{
+	// the counter of each alignment starts at 2^planes - 1 - max errors, so the
+	// carry out of the top plane is the error that is one too many
+	int32_t lPlanes = 1;
+	while ((1 << lPlanes) < pstPreamble->lMaxErrors + 2)
+		lPlanes++;
+	int32_t lInit = (1 << lPlanes) - 1 - pstPreamble->lMaxErrors;
+
+	for (int64_t llBase = llFirst; llBase <= llLast; llBase += 64)
+	{
+		uint64_t qwAlive = (llLast - llBase >= 63) ? ~0ULL : ((1ULL << (llLast - llBase + 1)) - 1);
+		uint64_t aqwCount[MAX_PLANES];
+		for (int32_t i = 0; i < lPlanes; i++)
+			aqwCount[i] = ((lInit >> i) & 1) ? ~0ULL : 0;
+
+		for (int32_t j = 0; qwAlive && (j < pstPreamble->lBits); j++)
+		{
+			uint64_t qwExpected = ((pstPreamble->aqwPattern[j >> 6] >> (j & 63)) & 1) ? ~0ULL : 0;
+			uint64_t qwCarry = qwGetBits(pqwBits, llBase + j) ^ qwExpected;
+			for (int32_t i = 0; qwCarry && (i < lPlanes); i++)
+			{
+				uint64_t qwTmp = aqwCount[i] & qwCarry;
+				aqwCount[i] ^= qwCarry;
+				qwCarry = qwTmp;
+			}
+			qwAlive &= ~qwCarry;
+		}
+
+		if (qwAlive)
+			return llBase + lLowestBit(qwAlive);
+	}
+	return -1;
+}
+
+
+
+/*
+**************************************************************************
+bPreambleInit
+**************************************************************************
+*/
+
+bool bPreambleInit(ST_PREAMBLE* pstPreamble, const char* szPattern, int32_t lMaxErrors)
+{
+	memset(pstPreamble, 0, sizeof(*pstPreamble));
+
+	for (const char* pc = szPattern; *pc; pc++)
+	{
+		if ((*pc != '0' && *pc != '1') || (pstPreamble->lBits >= REC_PREAMBLE_MAX_BITS))
+			return false;
+		vSetBit(pstPreamble->aqwPattern, pstPreamble->lBits++, *pc == '1');
+	}
+
+	if (pstPreamble->lBits == 0 || lMaxErrors < 0 || lMaxErrors >= pstPreamble->lBits)
+		return false;
+	pstPreamble->lMaxErrors = lMaxErrors;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vPreambleReset
+**************************************************************************
+*/
+
+void vPreambleReset(ST_PREAMBLE* pstPreamble)
+{
+	memset(pstPreamble->aqwTail, 0, sizeof(pstPreamble->aqwTail));
+	pstPreamble->lTailBits = 0;
+}
+
+
+
+/*
+**************************************************************************
+llPreambleSearch: carried bits first, then the block itself
+**************************************************************************
+*/
+
+int64_t llPreambleSearch(ST_PREAMBLE* pstPreamble, const uint64_t* pqwBits, uint32_t dwBits)
+{
+	const int64_t llLen = pstPreamble->lBits;
+	const int64_t llTail = pstPreamble->lTailBits;
+	int64_t llFound = -1;
+
+	// alignments that start in the carried bits end in this block
+	if (llTail > 0)
+	{
+		uint64_t aqwSeam[2 * REC_PREAMBLE_WORDS + 1];
+		int64_t llHead = (dwBits < llLen - 1) ? dwBits : llLen - 1;
+
+		memset(aqwSeam, 0, sizeof(aqwSeam));
+		for (int64_t i = 0; i < llTail; i++)
+			vSetBit(aqwSeam, i, dwGetBit(pstPreamble->aqwTail, i));
+		for (int64_t i = 0; i < llHead; i++)
+			vSetBit(aqwSeam, llTail + i, dwGetBit(pqwBits, i));
+
+		int64_t llLast = (llTail + llHead - llLen < llTail - 1) ? llTail + llHead - llLen : llTail - 1;
+		int64_t llPos = (llLast >= 0) ? llScan(pstPreamble, aqwSeam, 0, llLast) : -1;
+		if (llPos >= 0)
+			llFound = llPos + llLen - llTail;
+	}
+
+	if ((llFound < 0) && (dwBits >= llLen))
+	{
+		int64_t llPos = llScan(pstPreamble, pqwBits, 0, dwBits - llLen);
+		if (llPos >= 0)
+			llFound = llPos + llLen;
+	}
+
+	// carry the last lBits - 1 symbols of carried bits and block
+	uint64_t aqwNewTail[REC_PREAMBLE_WORDS];
+	int64_t llKeep = (llTail + dwBits < llLen - 1) ? llTail + dwBits : llLen - 1;
+	int64_t llStart = llTail + dwBits - llKeep;
+
+	memset(aqwNewTail, 0, sizeof(aqwNewTail));
+	for (int64_t i = 0; i < llKeep; i++)
+	{
+		int64_t llPos = llStart + i;
+		vSetBit(aqwNewTail, i, (llPos < llTail) ? dwGetBit(pstPreamble->aqwTail, llPos) : dwGetBit(pqwBits, llPos - llTail));
+	}
+	memcpy(pstPreamble->aqwTail, aqwNewTail, sizeof(aqwNewTail));
+	pstPreamble->lTailBits = (int32_t)llKeep;
+
+	return llFound;
+}
+
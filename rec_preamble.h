@@ -0,0 +1,61 @@
+/*
+**************************************************************************
+
+rec_preamble.h
+
+**************************************************************************
+
+Preamble search on the packed sliced bits. All 64 alignments of a word are
+checked at once: for every pattern bit the bits at that offset are
+compared word wide and the mismatches are added up in a bit sliced
+counter per alignment. A word is left as soon as every alignment has
+more than the allowed errors, on line data that is after a few pattern
+bits.
+
+The last bits of a block are kept, so a preamble that spans two notify
+blocks is found as well.
+**************************************************************************
+*/
+
+#ifndef REC_PREAMBLE_H
+#define REC_PREAMBLE_H
+
+#include <stdint.h>
+
+#define REC_PREAMBLE_MAX_BITS   256
+#define REC_PREAMBLE_WORDS      (REC_PREAMBLE_MAX_BITS / 64)
+
+// ----- preamble of the headstage: 1010 1100 followed by 4, 8, 16 and 32 ones and zeros, the last zeros cut to 23 -----
+#define REC_PREAMBLE_DEFAULT \
+	"10101100" \
+	"11110000" \
+	"1111111100000000" \
+	"11111111111111110000000000000000" \
+	"11111111111111111111111111111111" \
+	"00000000000000000000000"
+
+
+struct ST_PREAMBLE
+{
+	// setup
+	uint64_t    aqwPattern[REC_PREAMBLE_WORDS];     // bit j is pattern symbol j
+	int32_t     lBits;
+	int32_t     lMaxErrors;
+
+	// last lBits - 1 symbols of the stream, carried to the next block
+	uint64_t    aqwTail[REC_PREAMBLE_WORDS];
+	int32_t     lTailBits;
+};
+
+
+// ----- pattern as string of '0' and '1', lMaxErrors symbols may differ -----
+bool bPreambleInit(ST_PREAMBLE* pstPreamble, const char* szPattern, int32_t lMaxErrors);
+
+// ----- forgets the carried bits -----
+void vPreambleReset(ST_PREAMBLE* pstPreamble);
+
+// ----- searches a block of packed symbols (see rec_bits.h), returns the index of the first symbol
+// ----- behind the preamble, dwBits if it ends with the block, -1 if not found
+int64_t llPreambleSearch(ST_PREAMBLE* pstPreamble, const uint64_t* pqwBits, uint32_t dwBits);
+
+#endif
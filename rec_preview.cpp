@@ -0,0 +1,519 @@
+/*
+**************************************************************************
+
+rec_preview.cpp
+
+**************************************************************************
+
+Shared memory ring of the live preview, see rec_preview.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <chrono>
+
+#if !defined(_WIN32)
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "rec_simd.h"
+#include "rec_preview.h"
+
+static_assert(offsetof(ST_PREVIEWSHARED, aqwPublished) == 64, "preview head must fill one cache line");
+static_assert(REC_PREVIEW_BINS % REC_PREVIEW_FANIN == 0, "bins of a frame must split into the fan in");
+
+// ----- bytes of a frame up to the last written raw row -----
+#define PREVIEW_FRAME_LEN(lChannels) (offsetof(ST_PREVIEWFRAME, aastRaw) + (size_t)(lChannels) * sizeof(((ST_PREVIEWFRAME*)0)->aastRaw[0]))
+
+
+
+static int64_t llWallTimeUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+
+/*
+**************************************************************************
+platform part: create, open and drop the named shared memory
+**************************************************************************
+*/
+
+char* pszPreviewName(const char* szTag, char* szBuffer, int32_t lBufferLen)
+{
+#if defined(_WIN32)
+	const char* szPrefix = "Local\\";
+#else
+	const char* szPrefix = "/";
+#endif
+	if (szTag && szTag[0])
+		snprintf(szBuffer, lBufferLen, "%s%s_%s", szPrefix, REC_PREVIEW_NAME, szTag);
+	else
+		snprintf(szBuffer, lBufferLen, "%s%s", szPrefix, REC_PREVIEW_NAME);
+	return szBuffer;
+}
+
+#if defined(_WIN32)
+
+static ST_PREVIEWSHARED* pstCreateShared(ST_PREVIEW* pstPreview, const char* szName)
+{
+	pstPreview->hMap = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(ST_PREVIEWSHARED), szName);
+	if (!pstPreview->hMap)
+		return NULL;
+	return (ST_PREVIEWSHARED*)MapViewOfFile(pstPreview->hMap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ST_PREVIEWSHARED));
+}
+
+static void vDropShared(ST_PREVIEW* pstPreview)
+{
+	if (pstPreview->pstShared)
+		UnmapViewOfFile(pstPreview->pstShared);
+	if (pstPreview->hMap)
+		CloseHandle(pstPreview->hMap);
+	pstPreview->pstShared = NULL;
+	pstPreview->hMap = NULL;
+}
+
+static const ST_PREVIEWSHARED* pstOpenShared(ST_PREVIEWVIEW* pstView, const char* szName)
+{
+	pstView->hMap = OpenFileMapping(FILE_MAP_READ, FALSE, szName);
+	if (!pstView->hMap)
+		return NULL;
+	return (const ST_PREVIEWSHARED*)MapViewOfFile(pstView->hMap, FILE_MAP_READ, 0, 0, sizeof(ST_PREVIEWSHARED));
+}
+
+void vPreviewDetach(ST_PREVIEWVIEW* pstView)
+{
+	if (pstView->pstShared)
+		UnmapViewOfFile(pstView->pstShared);
+	if (pstView->hMap)
+		CloseHandle(pstView->hMap);
+	pstView->pstShared = NULL;
+	pstView->hMap = NULL;
+}
+
+#else
+
+static ST_PREVIEWSHARED* pstCreateShared(ST_PREVIEW* pstPreview, const char* szName)
+{
+	// a left over of a crashed run is unlinked, viewers still mapping it keep it until they detach
+	shm_unlink(szName);
+	int hShm = shm_open(szName, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (hShm < 0)
+		return NULL;
+	snprintf(pstPreview->szName, sizeof(pstPreview->szName), "%s", szName);
+	void* pvMap = MAP_FAILED;
+	if (ftruncate(hShm, (off_t)sizeof(ST_PREVIEWSHARED)) == 0)
+		pvMap = mmap(NULL, sizeof(ST_PREVIEWSHARED), PROT_READ | PROT_WRITE, MAP_SHARED, hShm, 0);
+	close(hShm);
+	return pvMap != MAP_FAILED ? (ST_PREVIEWSHARED*)pvMap : NULL;
+}
+
+static void vDropShared(ST_PREVIEW* pstPreview)
+{
+	if (pstPreview->pstShared)
+		munmap(pstPreview->pstShared, sizeof(ST_PREVIEWSHARED));
+	if (pstPreview->szName[0])
+		shm_unlink(pstPreview->szName);
+	pstPreview->pstShared = NULL;
+	pstPreview->szName[0] = 0;
+}
+
+static const ST_PREVIEWSHARED* pstOpenShared(ST_PREVIEWVIEW* pstView, const char* szName)
+{
+	int hShm = shm_open(szName, O_RDONLY, 0);
+	if (hShm < 0)
+		return NULL;
+	struct stat stStat;
+	void* pvMap = MAP_FAILED;
+	if (fstat(hShm, &stStat) == 0 && (size_t)stStat.st_size >= sizeof(ST_PREVIEWSHARED))
+		pvMap = mmap(NULL, sizeof(ST_PREVIEWSHARED), PROT_READ, MAP_SHARED, hShm, 0);
+	close(hShm);
+	if (pvMap == MAP_FAILED)
+		return NULL;
+	pstView->dwMapLen = sizeof(ST_PREVIEWSHARED);
+	return (const ST_PREVIEWSHARED*)pvMap;
+}
+
+void vPreviewDetach(ST_PREVIEWVIEW* pstView)
+{
+	if (pstView->pstShared)
+		munmap((void*)pstView->pstShared, pstView->dwMapLen);
+	pstView->pstShared = NULL;
+	pstView->dwMapLen = 0;
+}
+
+#endif
+
+
+
+/*
+**************************************************************************
+envelopes: min/max of the bins of a block
+**************************************************************************
+*/
+
+// ----- empty bins, a merge or a scan fills them -----
+static void vClearFrame(ST_PREVIEWFRAME* pstFrame, int32_t lChannels)
+{
+	memset(pstFrame->aastStream, 0, sizeof(pstFrame->aastStream));
+	for (int32_t s = 0; s < REC_STREAM_NUM; s++)
+		for (int32_t b = 0; b < REC_PREVIEW_BINS; b++)
+			pstFrame->aastStream[s][b].byMin = 0xFF;
+	for (int32_t c = 0; c < lChannels; c++)
+		for (int32_t b = 0; b < REC_PREVIEW_BINS; b++)
+		{
+			pstFrame->aastRaw[c][b].nMin = INT16_MAX;
+			pstFrame->aastRaw[c][b].nMax = INT16_MIN;
+		}
+}
+
+// ----- envelope of one stream, the bins split the bytes evenly -----
+static void vStreamBins(const uint8_t* pbyStream, uint32_t dwLen, ST_PREVIEWBIN8* pstBin)
+{
+	for (uint32_t b = 0; b < REC_PREVIEW_BINS; b++)
+	{
+		uint32_t dwStart = (uint32_t)((uint64_t)dwLen * b / REC_PREVIEW_BINS);
+		uint32_t dwEnd = (uint32_t)((uint64_t)dwLen * (b + 1) / REC_PREVIEW_BINS);
+		if (dwStart == dwEnd)
+			continue;
+
+		uint32_t i = dwStart;
+		uint8_t byMin = 0xFF, byMax = 0;
+#if defined(REC_SIMD_SSE2)
+		if (dwEnd - dwStart >= 16)
+		{
+			__m128i vMin = _mm_set1_epi8((char)0xFF), vMax = _mm_setzero_si128();
+			for (; i + 16 <= dwEnd; i += 16)
+			{
+				__m128i vData = _mm_loadu_si128((const __m128i*)(pbyStream + i));
+				vMin = _mm_min_epu8(vMin, vData);
+				vMax = _mm_max_epu8(vMax, vData);
+			}
+			uint8_t abyMin[16], abyMax[16];
+			_mm_storeu_si128((__m128i*)abyMin, vMin);
+			_mm_storeu_si128((__m128i*)abyMax, vMax);
+			for (int32_t k = 0; k < 16; k++)
+			{
+				if (abyMin[k] < byMin) byMin = abyMin[k];
+				if (abyMax[k] > byMax) byMax = abyMax[k];
+			}
+		}
+#endif
+		for (; i < dwEnd; i++)
+		{
+			if (pbyStream[i] < byMin) byMin = pbyStream[i];
+			if (pbyStream[i] > byMax) byMax = pbyStream[i];
+		}
+		pstBin[b].byMin = byMin;
+		pstBin[b].byMax = byMax;
+	}
+}
+
+// ----- envelope of the interleaved raw samples of all channels, the bins split the samples of a channel evenly -----
+static void vRawBins(const int16_t* pnSamples, uint32_t dwFrames, int32_t lChannels, ST_PREVIEWFRAME* pstFrame)
+{
+	for (uint32_t b = 0; b < REC_PREVIEW_BINS; b++)
+	{
+		uint32_t dwStart = (uint32_t)((uint64_t)dwFrames * b / REC_PREVIEW_BINS) * lChannels;
+		uint32_t dwEnd = (uint32_t)((uint64_t)dwFrames * (b + 1) / REC_PREVIEW_BINS) * lChannels;
+		if (dwStart == dwEnd)
+			continue;
+
+		int16_t anMin[REC_MAX_ADC], anMax[REC_MAX_ADC];
+		for (int32_t c = 0; c < lChannels; c++)
+		{
+			anMin[c] = INT16_MAX;
+			anMax[c] = INT16_MIN;
+		}
+
+		uint32_t i = dwStart;
+#if defined(REC_SIMD_SSE2)
+		// with 1, 2, 4 or 8 channels lane k of a vector is always channel k % lChannels, the bins start on a whole frame
+		if ((8 % lChannels) == 0 && dwEnd - dwStart >= 8)
+		{
+			__m128i vMin = _mm_set1_epi16(INT16_MAX), vMax = _mm_set1_epi16(INT16_MIN);
+			for (; i + 8 <= dwEnd; i += 8)
+			{
+				__m128i vData = _mm_loadu_si128((const __m128i*)(pnSamples + i));
+				vMin = _mm_min_epi16(vMin, vData);
+				vMax = _mm_max_epi16(vMax, vData);
+			}
+			int16_t anLaneMin[8], anLaneMax[8];
+			_mm_storeu_si128((__m128i*)anLaneMin, vMin);
+			_mm_storeu_si128((__m128i*)anLaneMax, vMax);
+			for (int32_t k = 0; k < 8; k++)
+			{
+				int32_t c = k % lChannels;
+				if (anLaneMin[k] < anMin[c]) anMin[c] = anLaneMin[k];
+				if (anLaneMax[k] > anMax[c]) anMax[c] = anLaneMax[k];
+			}
+		}
+#endif
+		// the tail still starts on a whole frame
+		for (int32_t c = 0; i < dwEnd; i++)
+		{
+			if (pnSamples[i] < anMin[c]) anMin[c] = pnSamples[i];
+			if (pnSamples[i] > anMax[c]) anMax[c] = pnSamples[i];
+			if (++c == lChannels)
+				c = 0;
+		}
+
+		for (int32_t c = 0; c < lChannels; c++)
+		{
+			pstFrame->aastRaw[c][b].nMin = anMin[c];
+			pstFrame->aastRaw[c][b].nMax = anMax[c];
+		}
+	}
+}
+
+// ----- frame pstSrc goes to its part of the frame of the next level -----
+static void vMergeFrame(ST_PREVIEWFRAME* pstDst, const ST_PREVIEWFRAME* pstSrc, int32_t lPart, int32_t lChannels)
+{
+	const int32_t lBins = REC_PREVIEW_BINS / REC_PREVIEW_FANIN;
+
+	if (lPart == 0)
+	{
+		pstDst->qwFirstSample = pstSrc->qwFirstSample;
+		pstDst->qwFirstStream = pstSrc->qwFirstStream;
+		pstDst->qwSamples = 0;
+		pstDst->dwStreamLen = 0;
+		pstDst->dwBlocks = 0;
+		vClearFrame(pstDst, lChannels);
+	}
+	pstDst->llTimeUs = pstSrc->llTimeUs;
+	pstDst->qwSamples += pstSrc->qwSamples;
+	pstDst->dwStreamLen += pstSrc->dwStreamLen;
+	pstDst->dwBlocks += pstSrc->dwBlocks;
+
+	for (int32_t k = 0; k < lBins; k++)
+	{
+		int32_t lDst = lPart * lBins + k;
+		for (int32_t j = k * REC_PREVIEW_FANIN; j < (k + 1) * REC_PREVIEW_FANIN; j++)
+		{
+			for (int32_t s = 0; s < REC_STREAM_NUM; s++)
+			{
+				const ST_PREVIEWBIN8* pstFrom = &pstSrc->aastStream[s][j];
+				ST_PREVIEWBIN8* pstTo = &pstDst->aastStream[s][lDst];
+				if (pstFrom->byMin < pstTo->byMin) pstTo->byMin = pstFrom->byMin;
+				if (pstFrom->byMax > pstTo->byMax) pstTo->byMax = pstFrom->byMax;
+			}
+			for (int32_t c = 0; c < lChannels; c++)
+			{
+				const ST_PREVIEWBIN16* pstFrom = &pstSrc->aastRaw[c][j];
+				ST_PREVIEWBIN16* pstTo = &pstDst->aastRaw[c][lDst];
+				if (pstFrom->nMin < pstTo->nMin) pstTo->nMin = pstFrom->nMin;
+				if (pstFrom->nMax > pstTo->nMax) pstTo->nMax = pstFrom->nMax;
+			}
+		}
+	}
+}
+
+
+
+/*
+**************************************************************************
+writer
+**************************************************************************
+*/
+
+// ----- seqlock write of one slot, the viewers never hold it up -----
+static void vWriteSlot(ST_PREVIEW* pstPreview, int32_t lLevel, const ST_PREVIEWFRAME* pstFrame)
+{
+	uint64_t qwFrame = pstFrame->qwFrame;
+	ST_PREVIEWSLOT* pstSlot = &pstPreview->pstShared->aastSlot[lLevel][qwFrame % REC_PREVIEW_SLOTS];
+
+	pstSlot->qwSeq.store(2 * qwFrame + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&pstSlot->stFrame, pstFrame, PREVIEW_FRAME_LEN(pstPreview->lChannels));
+	pstSlot->qwSeq.store(2 * qwFrame + 2, std::memory_order_release);
+	pstPreview->pstShared->aqwPublished[lLevel].store(qwFrame + 1, std::memory_order_release);
+}
+
+// ----- frame of a level done: written, merged into the next level which is written when it is full -----
+static void vPublishLevel(ST_PREVIEW* pstPreview, int32_t lLevel)
+{
+	ST_PREVIEWFRAME* pstFrame = &pstPreview->astFrame[lLevel];
+	pstFrame->qwFrame = pstPreview->aqwFrames[lLevel]++;
+	vWriteSlot(pstPreview, lLevel, pstFrame);
+
+	if (lLevel + 1 >= REC_PREVIEW_LEVELS)
+		return;
+	int32_t lPart = (int32_t)(pstFrame->qwFrame % REC_PREVIEW_FANIN);
+	vMergeFrame(&pstPreview->astFrame[lLevel + 1], pstFrame, lPart, pstPreview->lChannels);
+	if (lPart == REC_PREVIEW_FANIN - 1)
+		vPublishLevel(pstPreview, lLevel + 1);
+}
+
+
+
+/*
+**************************************************************************
+bPreviewOpen: creates the shared memory, sets up the head and publishes it
+**************************************************************************
+*/
+
+bool bPreviewOpen(ST_PREVIEW* pstPreview, const char* szTag, int32_t lChannels, double dSamplingRate, double dFrameRate)
+{
+	memset(pstPreview, 0, sizeof(ST_PREVIEW));
+	if (lChannels < 1 || lChannels > REC_MAX_ADC)
+		return false;
+
+	char szName[80];
+	pstPreview->pstShared = pstCreateShared(pstPreview, pszPreviewName(szTag, szName, sizeof(szName)));
+	if (!pstPreview->pstShared)
+	{
+		vDropShared(pstPreview);
+		return false;
+	}
+	pstPreview->lChannels = lChannels;
+
+	// fresh pages are zero, all sequences even and nothing published; the magic goes last
+	ST_PREVIEWSHARED* pstShared = pstPreview->pstShared;
+	pstShared->dwVersion = REC_PREVIEW_VERSION;
+	pstShared->dwSize = (uint32_t)sizeof(ST_PREVIEWSHARED);
+	pstShared->lChannels = lChannels;
+	pstShared->dwBins = REC_PREVIEW_BINS;
+	pstShared->dwFanIn = REC_PREVIEW_FANIN;
+	pstShared->dwLevels = REC_PREVIEW_LEVELS;
+	pstShared->dwSlots = REC_PREVIEW_SLOTS;
+	pstShared->dSamplingRate = dSamplingRate;
+	pstShared->dFrameRate = dFrameRate;
+	pstShared->llStartUs = llWallTimeUs();
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(pstShared->achMagic, REC_PREVIEW_MAGIC, sizeof(pstShared->achMagic));
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vPreviewPublish: envelope of one block to level 0 and up the levels
+**************************************************************************
+*/
+
+void vPreviewPublish(ST_PREVIEW* pstPreview, const int16_t* pnSamples, uint32_t dwSamples, uint8_t* const* apbyStream, uint32_t dwStreamLen, int64_t llTimeUs)
+{
+	if (!pstPreview->pstShared)
+		return;
+
+	ST_PREVIEWFRAME* pstFrame = &pstPreview->astFrame[0];
+	uint32_t dwFrames = dwSamples / pstPreview->lChannels;
+	if (!apbyStream)
+		dwStreamLen = 0;
+
+	vClearFrame(pstFrame, pstPreview->lChannels);
+	pstFrame->llTimeUs = llTimeUs ? llTimeUs : llWallTimeUs();
+	pstFrame->qwFirstSample = pstPreview->qwSamples;
+	pstFrame->qwSamples = dwFrames;
+	pstFrame->qwFirstStream = pstPreview->qwStream;
+	pstFrame->dwStreamLen = dwStreamLen;
+	pstFrame->dwBlocks = 1;
+	vRawBins(pnSamples, dwFrames, pstPreview->lChannels, pstFrame);
+	for (int32_t s = 0; s < REC_STREAM_NUM && dwStreamLen; s++)
+		vStreamBins(apbyStream[s], dwStreamLen, pstFrame->aastStream[s]);
+
+	pstPreview->qwSamples += dwFrames;
+	pstPreview->qwStream += dwStreamLen;
+	vPublishLevel(pstPreview, 0);
+}
+
+
+
+/*
+**************************************************************************
+vPreviewSkip: a block that is not published still counts, the open
+frames of the levels above span it
+**************************************************************************
+*/
+
+void vPreviewSkip(ST_PREVIEW* pstPreview, uint32_t dwSamples, uint32_t dwStreamLen)
+{
+	if (!pstPreview->pstShared)
+		return;
+
+	uint32_t dwFrames = dwSamples / pstPreview->lChannels;
+	for (int32_t l = 1; l < REC_PREVIEW_LEVELS; l++)
+		if (pstPreview->aqwFrames[l - 1] % REC_PREVIEW_FANIN)
+		{
+			pstPreview->astFrame[l].qwSamples += dwFrames;
+			pstPreview->astFrame[l].dwStreamLen += dwStreamLen;
+		}
+	pstPreview->qwSamples += dwFrames;
+	pstPreview->qwStream += dwStreamLen;
+}
+
+
+
+/*
+**************************************************************************
+vPreviewClose: drops the shared memory
+**************************************************************************
+*/
+
+void vPreviewClose(ST_PREVIEW* pstPreview)
+{
+	vDropShared(pstPreview);
+}
+
+
+
+/*
+**************************************************************************
+viewer
+**************************************************************************
+*/
+
+bool bPreviewAttach(ST_PREVIEWVIEW* pstView, const char* szTag)
+{
+	memset(pstView, 0, sizeof(ST_PREVIEWVIEW));
+
+	char szName[80];
+	pstView->pstShared = pstOpenShared(pstView, pszPreviewName(szTag, szName, sizeof(szName)));
+	if (!pstView->pstShared)
+	{
+		vPreviewDetach(pstView);
+		return false;
+	}
+
+	// the recorder may still set up the head
+	const ST_PREVIEWSHARED* pstShared = pstView->pstShared;
+	bool bValid = memcmp(pstShared->achMagic, REC_PREVIEW_MAGIC, sizeof(pstShared->achMagic)) == 0;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!bValid || pstShared->dwVersion != REC_PREVIEW_VERSION || pstShared->dwSize != sizeof(ST_PREVIEWSHARED)
+		|| pstShared->lChannels < 1 || pstShared->lChannels > REC_MAX_ADC)
+	{
+		vPreviewDetach(pstView);
+		return false;
+	}
+	return true;
+}
+
+uint64_t qwPreviewPublished(const ST_PREVIEWVIEW* pstView, int32_t lLevel)
+{
+	if (lLevel < 0 || lLevel >= REC_PREVIEW_LEVELS)
+		return 0;
+	return pstView->pstShared->aqwPublished[lLevel].load(std::memory_order_acquire);
+}
+
+bool bPreviewRead(const ST_PREVIEWVIEW* pstView, int32_t lLevel, uint64_t qwFrame, ST_PREVIEWFRAME* pstFrame)
+{
+	if (lLevel < 0 || lLevel >= REC_PREVIEW_LEVELS)
+		return false;
+
+	const ST_PREVIEWSLOT* pstSlot = &pstView->pstShared->aastSlot[lLevel][qwFrame % REC_PREVIEW_SLOTS];
+	uint64_t qwSeq = pstSlot->qwSeq.load(std::memory_order_acquire);
+	if (qwSeq != 2 * qwFrame + 2)
+		return false;
+	memcpy(pstFrame, &pstSlot->stFrame, PREVIEW_FRAME_LEN(pstView->pstShared->lChannels));
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return pstSlot->qwSeq.load(std::memory_order_relaxed) == qwSeq;
+}
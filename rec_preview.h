@@ -0,0 +1,165 @@
+/*
+**************************************************************************
+
+rec_preview.h
+
+**************************************************************************
+
+Live preview of the recording for any number of local viewers. The
+recorder publishes a min/max envelope of the 16 decoded streams of the
+first analog channel and of the raw ADC samples of every channel to a
+ring in shared memory, the viewers (rec_view) map it read only and take
+the newest frames. Nothing goes back from the viewers, a viewer that is
+too slow finds its frames overwritten and goes on with the newest, so
+the FIFO loop never waits for one.
+
+	level 0     one frame per block, REC_PREVIEW_BINS bins over the block
+	level l     one frame per REC_PREVIEW_FANIN frames of level l - 1,
+	            each of them gives REC_PREVIEW_BINS / REC_PREVIEW_FANIN
+	            bins of REC_PREVIEW_FANIN of its bins
+
+so a viewer shows seconds or hours with the same number of bins. Each
+slot of a ring has a sequence number, odd while it is written; a viewer
+copies the slot and takes it only if the sequence was even and the same
+before and after the copy. A block writes one slot of about 20 cache
+lines with one channel, the levels above only every REC_PREVIEW_FANIN
+blocks.
+
+The shared memory is named REC_PREVIEW_NAME with the tag of the card
+behind it ("Local\rec_preview_card0_sn01234" on Windows,
+"/rec_preview_card0_sn01234" under POSIX).
+**************************************************************************
+*/
+
+#ifndef REC_PREVIEW_H
+#define REC_PREVIEW_H
+
+#include <stdint.h>
+#include <atomic>
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#endif
+
+#include "rec_decoder.h"
+#include "rec_multi.h"
+
+#define REC_PREVIEW_NAME        "rec_preview"
+#define REC_PREVIEW_MAGIC       "RECPREV1"
+#define REC_PREVIEW_VERSION     1
+#define REC_PREVIEW_BINS        32      // bins of a frame
+#define REC_PREVIEW_FANIN       8       // frames of a level in one frame of the next
+#define REC_PREVIEW_LEVELS      4
+#define REC_PREVIEW_SLOTS       256     // frames of a level in the ring
+
+
+// ----- envelope of a bin, min > max if the bin is empty -----
+struct ST_PREVIEWBIN8
+{
+	uint8_t     byMin;
+	uint8_t     byMax;
+};
+
+struct ST_PREVIEWBIN16
+{
+	int16_t     nMin;
+	int16_t     nMax;
+};
+
+// ----- one frame of a level, only the rows of lChannels raw channels are written -----
+struct ST_PREVIEWFRAME
+{
+	uint64_t    qwFrame;                // index in its level
+	int64_t     llTimeUs;               // wall clock of the last block
+	uint64_t    qwFirstSample;          // first raw sample of a channel
+	uint64_t    qwSamples;              // raw samples of a channel
+	uint64_t    qwFirstStream;          // first stream byte (line code frame) of the first channel
+	uint32_t    dwStreamLen;            // stream bytes
+	uint32_t    dwBlocks;
+	ST_PREVIEWBIN8  aastStream[REC_STREAM_NUM][REC_PREVIEW_BINS];
+	ST_PREVIEWBIN16 aastRaw[REC_MAX_ADC][REC_PREVIEW_BINS];
+};
+
+struct ST_PREVIEWSLOT
+{
+	std::atomic<uint64_t>   qwSeq;      // 2 * frame + 1 while written, 2 * frame + 2 when done
+	uint8_t                 abyPad[56];
+	ST_PREVIEWFRAME         stFrame;
+};
+
+// ----- layout of the shared memory -----
+struct ST_PREVIEWSHARED
+{
+	char        achMagic[8];            // set last, viewers wait for it
+	uint32_t    dwVersion;
+	uint32_t    dwSize;                 // bytes of the shared memory
+	int32_t     lChannels;
+	uint32_t    dwBins;
+	uint32_t    dwFanIn;
+	uint32_t    dwLevels;
+	uint32_t    dwSlots;
+	uint32_t    dwReserved;
+	double      dSamplingRate;
+	double      dFrameRate;             // stream bytes per second
+	int64_t     llStartUs;              // wall clock at the start of the run, new for each run
+	std::atomic<uint64_t>   aqwPublished[REC_PREVIEW_LEVELS];   // frames written to each level
+	uint8_t     abyPad2[64 - REC_PREVIEW_LEVELS * 8];
+	ST_PREVIEWSLOT  aastSlot[REC_PREVIEW_LEVELS][REC_PREVIEW_SLOTS];
+};
+
+// ----- writer of the recorder -----
+struct ST_PREVIEW
+{
+#if defined(_WIN32)
+	HANDLE      hMap;
+#else
+	char        szName[80];
+#endif
+	ST_PREVIEWSHARED* pstShared;
+	int32_t     lChannels;
+	uint64_t    qwSamples;              // raw samples of a channel so far
+	uint64_t    qwStream;               // stream bytes so far
+	ST_PREVIEWFRAME astFrame[REC_PREVIEW_LEVELS];   // frame in work on each level
+	uint64_t    aqwFrames[REC_PREVIEW_LEVELS];      // frames published on each level
+};
+
+// ----- read only view of a viewer -----
+struct ST_PREVIEWVIEW
+{
+#if defined(_WIN32)
+	HANDLE      hMap;
+#else
+	size_t      dwMapLen;
+#endif
+	const ST_PREVIEWSHARED* pstShared;
+};
+
+
+// ----- shared memory name for the tag (empty for a single card) -----
+char* pszPreviewName(const char* szTag, char* szBuffer, int32_t lBufferLen);
+
+// ----- creates the shared memory of the run, false if the system has none for us -----
+bool bPreviewOpen(ST_PREVIEW* pstPreview, const char* szTag, int32_t lChannels, double dSamplingRate, double dFrameRate);
+
+// ----- envelope of one block: dwSamples interleaved raw samples, the streams of the first channel (NULL before the preamble) -----
+void vPreviewPublish(ST_PREVIEW* pstPreview, const int16_t* pnSamples, uint32_t dwSamples, uint8_t* const* apbyStream, uint32_t dwStreamLen, int64_t llTimeUs);
+
+// ----- block that is not published (overload, rec_governor): the positions of the later frames go on behind it, the frame of a level above that is open spans it -----
+void vPreviewSkip(ST_PREVIEW* pstPreview, uint32_t dwSamples, uint32_t dwStreamLen);
+
+// ----- removes the shared memory, attached viewers keep their mapping -----
+void vPreviewClose(ST_PREVIEW* pstPreview);
+
+// ----- maps the shared memory of a running recorder read only, false if there is none -----
+bool bPreviewAttach(ST_PREVIEWVIEW* pstView, const char* szTag);
+
+// ----- frames published on a level, the newest is this - 1 -----
+uint64_t qwPreviewPublished(const ST_PREVIEWVIEW* pstView, int32_t lLevel);
+
+// ----- copy of a frame, false if it is overwritten, in work or not yet written -----
+bool bPreviewRead(const ST_PREVIEWVIEW* pstView, int32_t lLevel, uint64_t qwFrame, ST_PREVIEWFRAME* pstFrame);
+
+// ----- unmaps the view -----
+void vPreviewDetach(ST_PREVIEWVIEW* pstView);
+
+#endif
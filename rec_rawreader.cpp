@@ -0,0 +1,440 @@
+/*
+**************************************************************************
+
+rec_rawreader.cpp
+
+**************************************************************************
+
+Random access reader of the raw captures, see rec_rawreader.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "rec_codec.h"
+#include "rec_mem.h"
+#include "rec_rawreader.h"
+
+
+
+/*
+**************************************************************************
+platform part: map and unmap the whole file read only
+**************************************************************************
+*/
+
+#if defined(_WIN32)
+
+static bool bMapFile(ST_RAWREADER* pstReader, const char* szFileName)
+{
+	pstReader->hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (pstReader->hFile == INVALID_HANDLE_VALUE)
+	{
+		pstReader->hFile = NULL;
+		return false;
+	}
+
+	LARGE_INTEGER uLen;
+	if (!GetFileSizeEx(pstReader->hFile, &uLen) || uLen.QuadPart == 0)
+		return false;
+	pstReader->qwFileLen = (uint64_t)uLen.QuadPart;
+	pstReader->hMap = CreateFileMapping(pstReader->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!pstReader->hMap)
+		return false;
+	pstReader->pbyMap = (const uint8_t*)MapViewOfFile(pstReader->hMap, FILE_MAP_READ, 0, 0, 0);
+	return pstReader->pbyMap != NULL;
+}
+
+static void vUnmapFile(ST_RAWREADER* pstReader)
+{
+	if (pstReader->pbyMap)
+		UnmapViewOfFile(pstReader->pbyMap);
+	if (pstReader->hMap)
+		CloseHandle(pstReader->hMap);
+	if (pstReader->hFile)
+		CloseHandle(pstReader->hFile);
+	pstReader->pbyMap = NULL;
+	pstReader->hMap = pstReader->hFile = NULL;
+}
+
+#else
+
+static bool bMapFile(ST_RAWREADER* pstReader, const char* szFileName)
+{
+	pstReader->hFile = open(szFileName, O_RDONLY);
+	if (pstReader->hFile < 0)
+		return false;
+
+	struct stat stStat;
+	if (fstat(pstReader->hFile, &stStat) != 0 || stStat.st_size == 0)
+		return false;
+	pstReader->qwFileLen = (uint64_t)stStat.st_size;
+	void* pvMap = mmap(NULL, (size_t)pstReader->qwFileLen, PROT_READ, MAP_SHARED, pstReader->hFile, 0);
+	if (pvMap == MAP_FAILED)
+		return false;
+	pstReader->pbyMap = (const uint8_t*)pvMap;
+	return true;
+}
+
+static void vUnmapFile(ST_RAWREADER* pstReader)
+{
+	if (pstReader->pbyMap)
+		munmap((void*)pstReader->pbyMap, (size_t)pstReader->qwFileLen);
+	if (pstReader->hFile >= 0)
+		close(pstReader->hFile);
+	pstReader->pbyMap = NULL;
+	pstReader->hFile = -1;
+}
+
+#endif
+
+
+
+// ----- block i with its index entry inside the file up to qwEnd -----
+static bool bBlockValid(const ST_RAWREADER* pstReader, const ST_RAWINDEX* pstEntry, uint64_t qwRawOffset, uint64_t qwEnd)
+{
+	return pstEntry->qwFileOffset >= pstReader->stHead.dwHeadLen && (pstEntry->qwFileOffset % REC_MEM_ALIGNMENT) == 0
+		&& pstEntry->dwRecordLen >= sizeof(ST_RAWBLOCKHEAD) && pstEntry->qwFileOffset + pstEntry->dwRecordLen <= qwEnd
+		&& pstEntry->qwRawOffset == qwRawOffset && pstEntry->dwRawLen > 0 && pstEntry->dwRawLen <= pstReader->stHead.dwBlockLen;
+}
+
+
+
+/*
+**************************************************************************
+bLoadIndex: index of the trailer if it is there and fits the file
+**************************************************************************
+*/
+
+static bool bLoadIndex(ST_RAWREADER* pstReader)
+{
+	ST_RAWTRAILER stTrailer;
+
+	if (pstReader->qwFileLen < pstReader->stHead.dwHeadLen + sizeof(stTrailer))
+		return false;
+	memcpy(&stTrailer, pstReader->pbyMap + pstReader->qwFileLen - sizeof(stTrailer), sizeof(stTrailer));
+	if (memcmp(stTrailer.achMagic, REC_RAWINDEX_MAGIC, sizeof(stTrailer.achMagic)) || stTrailer.qwIndexOffset < pstReader->stHead.dwHeadLen
+		|| stTrailer.qwBlocks > (pstReader->qwFileLen - stTrailer.qwIndexOffset) / sizeof(ST_RAWINDEX)
+		|| stTrailer.qwIndexOffset + stTrailer.qwBlocks * sizeof(ST_RAWINDEX) + sizeof(stTrailer) > pstReader->qwFileLen)
+		return false;
+
+	pstReader->pstIndex = (ST_RAWINDEX*)malloc((size_t)(stTrailer.qwBlocks ? stTrailer.qwBlocks : 1) * sizeof(ST_RAWINDEX));
+	if (!pstReader->pstIndex)
+		return false;
+	memcpy(pstReader->pstIndex, pstReader->pbyMap + stTrailer.qwIndexOffset, (size_t)stTrailer.qwBlocks * sizeof(ST_RAWINDEX));
+
+	uint64_t qwRawOffset = 0;
+	for (uint64_t i = 0; i < stTrailer.qwBlocks; i++)
+	{
+		if (!bBlockValid(pstReader, &pstReader->pstIndex[i], qwRawOffset, stTrailer.qwIndexOffset))
+			return false;
+		qwRawOffset += pstReader->pstIndex[i].dwRawLen;
+	}
+	if (qwRawOffset != stTrailer.qwRawLen)
+		return false;
+	pstReader->qwBlocks = stTrailer.qwBlocks;
+	pstReader->qwRawLen = qwRawOffset;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bWalkBlocks: block heads from the first one on, up to the first one that
+is cut, out of order or makes no sense
+**************************************************************************
+*/
+
+static bool bWalkBlocks(ST_RAWREADER* pstReader)
+{
+	uint64_t qwIndexLen = 0;
+	uint64_t qwOffset = pstReader->stHead.dwHeadLen;
+
+	free(pstReader->pstIndex);
+	pstReader->pstIndex = NULL;
+	pstReader->qwBlocks = pstReader->qwRawLen = 0;
+
+	ST_RAWBLOCKHEAD stHead;
+	while (qwOffset + sizeof(stHead) <= pstReader->qwFileLen)
+	{
+		memcpy(&stHead, pstReader->pbyMap + qwOffset, sizeof(stHead));
+		ST_RAWINDEX stEntry;
+		stEntry.qwFileOffset = qwOffset;
+		stEntry.qwRawOffset = stHead.qwRawOffset;
+		stEntry.llTimeUs = stHead.llTimeUs;
+		stEntry.dwRawLen = stHead.dwRawLen;
+		stEntry.dwRecordLen = stHead.dwRecordLen;
+		if (memcmp(stHead.achMagic, REC_RAWBLOCK_MAGIC, sizeof(stHead.achMagic)) || stHead.qwSequence != pstReader->qwBlocks
+			|| !bBlockValid(pstReader, &stEntry, pstReader->qwRawLen, pstReader->qwFileLen))
+			break;
+
+		if (pstReader->qwBlocks == qwIndexLen)
+		{
+			uint64_t qwNewLen = qwIndexLen ? 2 * qwIndexLen : 1024;
+			ST_RAWINDEX* pstNew = (ST_RAWINDEX*)realloc(pstReader->pstIndex, (size_t)qwNewLen * sizeof(ST_RAWINDEX));
+			if (!pstNew)
+				return false;
+			pstReader->pstIndex = pstNew;
+			qwIndexLen = qwNewLen;
+		}
+		pstReader->pstIndex[pstReader->qwBlocks++] = stEntry;
+		pstReader->qwRawLen += stEntry.dwRawLen;
+		qwOffset += stEntry.dwRecordLen;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bRawReaderProbe
+**************************************************************************
+*/
+
+bool bRawReaderProbe(const char* szFileName)
+{
+	char achMagic[8];
+	FILE* fp = fopen(szFileName, "rb");
+	if (!fp)
+		return false;
+	bool bCapture = fread(achMagic, 1, sizeof(achMagic), fp) == sizeof(achMagic) && !memcmp(achMagic, REC_RAWFILE_MAGIC, sizeof(achMagic));
+	fclose(fp);
+	return bCapture;
+}
+
+
+
+/*
+**************************************************************************
+bRawReaderOpen
+**************************************************************************
+*/
+
+bool bRawReaderOpen(ST_RAWREADER* pstReader, const char* szFileName)
+{
+	memset(pstReader, 0, sizeof(*pstReader));
+#if !defined(_WIN32)
+	pstReader->hFile = -1;
+#endif
+	pstReader->llCached = -1;
+
+	if (!bMapFile(pstReader, szFileName))
+	{
+		printf("Can't map %s\n", szFileName);
+		vRawReaderClose(pstReader);
+		return false;
+	}
+
+	ST_RAWFILEHEAD* pstHead = &pstReader->stHead;
+	if (pstReader->qwFileLen < sizeof(*pstHead) || memcmp(pstReader->pbyMap, REC_RAWFILE_MAGIC, sizeof(pstHead->achMagic)))
+	{
+		printf("%s is no raw capture\n", szFileName);
+		vRawReaderClose(pstReader);
+		return false;
+	}
+	memcpy(pstHead, pstReader->pbyMap, sizeof(*pstHead));
+	if (pstHead->dwVersion != REC_RAWFILE_VERSION || pstHead->dwHeadLen < sizeof(*pstHead) || (pstHead->dwHeadLen % REC_MEM_ALIGNMENT)
+		|| pstHead->stSetup.lChannels < 1 || pstHead->stSetup.lBytesPerSample < 1 || pstHead->dwBlockLen == 0)
+	{
+		printf("%s has an invalid header\n", szFileName);
+		vRawReaderClose(pstReader);
+		return false;
+	}
+	pstReader->dwFrameLen = (uint32_t)(pstHead->stSetup.lChannels * pstHead->stSetup.lBytesPerSample);
+
+	pstReader->bIndexed = bLoadIndex(pstReader);
+	if (!pstReader->bIndexed && !bWalkBlocks(pstReader))
+	{
+		printf("No memory for the index of %s\n", szFileName);
+		vRawReaderClose(pstReader);
+		return false;
+	}
+
+	pstReader->pbyBlock = (uint8_t*)malloc(pstHead->dwBlockLen);
+	if (!pstReader->pbyBlock)
+	{
+		printf("No memory for the blocks of %s\n", szFileName);
+		vRawReaderClose(pstReader);
+		return false;
+	}
+
+	pstReader->bUniform = true;
+	for (uint64_t i = 0; i + 1 < pstReader->qwBlocks; i++)
+		if (pstReader->pstIndex[i].dwRawLen != pstHead->dwBlockLen)
+			pstReader->bUniform = false;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+qwRawReaderLen
+**************************************************************************
+*/
+
+uint64_t qwRawReaderLen(const ST_RAWREADER* pstReader)
+{
+	return pstReader->qwRawLen;
+}
+
+
+
+/*
+**************************************************************************
+qwRawReaderOffsetAt: the FIFO loop has no gaps, the sample number is the
+time at the sampling rate
+**************************************************************************
+*/
+
+uint64_t qwRawReaderOffsetAt(const ST_RAWREADER* pstReader, double dSeconds)
+{
+	if (dSeconds <= 0 || pstReader->stHead.stSetup.llSamplingRate <= 0)
+		return 0;
+	uint64_t qwOffset = (uint64_t)(dSeconds * (double)pstReader->stHead.stSetup.llSamplingRate) * pstReader->dwFrameLen;
+	return (qwOffset < pstReader->qwRawLen) ? qwOffset : pstReader->qwRawLen;
+}
+
+
+
+/*
+**************************************************************************
+llRawReaderBlockOf: a division for blocks of the same length, else the
+last block that starts at or before the offset
+**************************************************************************
+*/
+
+int64_t llRawReaderBlockOf(const ST_RAWREADER* pstReader, uint64_t qwOffset)
+{
+	if (qwOffset >= pstReader->qwRawLen)
+		return -1;
+
+	if (pstReader->bUniform)
+	{
+		uint64_t qwBlock = qwOffset / pstReader->stHead.dwBlockLen;
+		return (int64_t)((qwBlock < pstReader->qwBlocks) ? qwBlock : pstReader->qwBlocks - 1);
+	}
+
+	uint64_t qwLow = 0, qwHigh = pstReader->qwBlocks;
+	while (qwHigh - qwLow > 1)
+	{
+		uint64_t qwMid = (qwLow + qwHigh) / 2;
+		if (pstReader->pstIndex[qwMid].qwRawOffset <= qwOffset)
+			qwLow = qwMid;
+		else
+			qwHigh = qwMid;
+	}
+	return (int64_t)qwLow;
+}
+
+
+
+/*
+**************************************************************************
+pstRawReaderBlock
+**************************************************************************
+*/
+
+const ST_RAWBLOCKHEAD* pstRawReaderBlock(const ST_RAWREADER* pstReader, uint64_t qwBlock)
+{
+	if (qwBlock >= pstReader->qwBlocks)
+		return NULL;
+
+	// the record is aligned in the mapped file, the head can be used in place
+	const ST_RAWINDEX* pstEntry = &pstReader->pstIndex[qwBlock];
+	const ST_RAWBLOCKHEAD* pstHead = (const ST_RAWBLOCKHEAD*)(pstReader->pbyMap + pstEntry->qwFileOffset);
+	if (memcmp(pstHead->achMagic, REC_RAWBLOCK_MAGIC, sizeof(pstHead->achMagic)) || pstHead->qwSequence != qwBlock
+		|| pstHead->qwRawOffset != pstEntry->qwRawOffset || pstHead->dwRawLen != pstEntry->dwRawLen
+		|| pstHead->dwStoredLen > pstEntry->dwRecordLen - sizeof(ST_RAWBLOCKHEAD)
+		|| (pstHead->dwCodec != REC_CODEC_RICE && (pstHead->dwCodec != REC_CODEC_NONE || pstHead->dwStoredLen != pstHead->dwRawLen)))
+		return NULL;
+	return pstHead;
+}
+
+
+
+/*
+**************************************************************************
+dwRawReaderRead
+**************************************************************************
+*/
+
+// ----- samples of a block, in the mapped file or decoded to pbyBlock -----
+static const uint8_t* pbyLoadBlock(ST_RAWREADER* pstReader, uint64_t qwBlock)
+{
+	const ST_RAWBLOCKHEAD* pstHead = pstRawReaderBlock(pstReader, qwBlock);
+	if (!pstHead)
+	{
+		printf("Block %llu of the raw capture is corrupt\n", (unsigned long long)qwBlock);
+		return NULL;
+	}
+
+	const uint8_t* pbyStored = (const uint8_t*)(pstHead + 1);
+	if (pstHead->dwCodec == REC_CODEC_NONE)
+		return pbyStored;
+	if (pstReader->llCached == (int64_t)qwBlock)
+		return pstReader->pbyBlock;
+
+	pstReader->llCached = -1;
+	if ((pstHead->dwRawLen % sizeof(int16_t))
+		|| !bCodecDecodeSamples(pbyStored, pstHead->dwStoredLen, (int16_t*)pstReader->pbyBlock, pstHead->dwRawLen / sizeof(int16_t), pstReader->stHead.stSetup.lChannels))
+	{
+		printf("Block %llu of the raw capture can't be decoded\n", (unsigned long long)qwBlock);
+		return NULL;
+	}
+	pstReader->llCached = (int64_t)qwBlock;
+	return pstReader->pbyBlock;
+}
+
+uint32_t dwRawReaderRead(ST_RAWREADER* pstReader, uint64_t qwOffset, uint8_t* pbyData, uint32_t dwLen)
+{
+	int64_t llBlock = llRawReaderBlockOf(pstReader, qwOffset);
+	if (llBlock < 0)
+		return 0;
+
+	uint32_t dwDone = 0;
+	for (uint64_t i = (uint64_t)llBlock; dwDone < dwLen && i < pstReader->qwBlocks; i++)
+	{
+		const ST_RAWINDEX* pstEntry = &pstReader->pstIndex[i];
+		const uint8_t* pbyBlock = pbyLoadBlock(pstReader, i);
+		if (!pbyBlock)
+			break;
+
+		uint32_t dwSkip = (uint32_t)(qwOffset + dwDone - pstEntry->qwRawOffset);
+		uint32_t dwCopy = (pstEntry->dwRawLen - dwSkip < dwLen - dwDone) ? pstEntry->dwRawLen - dwSkip : dwLen - dwDone;
+		memcpy(pbyData + dwDone, pbyBlock + dwSkip, dwCopy);
+		dwDone += dwCopy;
+	}
+	return dwDone;
+}
+
+
+
+/*
+**************************************************************************
+vRawReaderClose
+**************************************************************************
+*/
+
+void vRawReaderClose(ST_RAWREADER* pstReader)
+{
+	vUnmapFile(pstReader);
+	free(pstReader->pstIndex);
+	pstReader->pstIndex = NULL;
+	free(pstReader->pbyBlock);
+	pstReader->pbyBlock = NULL;
+	pstReader->qwBlocks = pstReader->qwRawLen = 0;
+	pstReader->llCached = -1;
+}
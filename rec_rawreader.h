@@ -0,0 +1,82 @@
+/*
+**************************************************************************
+
+rec_rawreader.h
+
+**************************************************************************
+
+Random access reader of the raw captures written by rec_rawwriter. The
+file is mapped to memory, the header gives the setup of the card and
+the index at the end of the file the place of every block, so a read
+touches only the pages of its own blocks, however long the recording
+is. Without the trailer (the recording was not closed) the blocks are
+found by walking the block heads from the first one up to the last
+complete one.
+
+Offsets are raw bytes of the capture as the card delivered them, the
+blocks of the FIFO loop all have the same length, so the block of an
+offset is found by a division. Packed blocks are decoded to a buffer
+of the reader, the last one stays there for the next read.
+**************************************************************************
+*/
+
+#ifndef REC_RAWREADER_H
+#define REC_RAWREADER_H
+
+#include <stdint.h>
+
+#include "rec_rawwriter.h"
+
+
+struct ST_RAWREADER
+{
+#if defined(_WIN32)
+	HANDLE          hFile;
+	HANDLE          hMap;
+#else
+	int             hFile;
+#endif
+	const uint8_t*  pbyMap;
+	uint64_t        qwFileLen;
+
+	ST_RAWFILEHEAD  stHead;
+	uint32_t        dwFrameLen;         // bytes of one sample of all channels
+	bool            bIndexed;           // false if the blocks were walked
+
+	// one entry per block in file order, the raw offsets without gaps
+	ST_RAWINDEX*    pstIndex;
+	uint64_t        qwBlocks;
+	uint64_t        qwRawLen;
+	bool            bUniform;           // all blocks but the last have dwBlockLen bytes
+
+	// last decoded packed block
+	uint8_t*        pbyBlock;
+	int64_t         llCached;           // index of the block in pbyBlock, -1 for none
+};
+
+
+// ----- true if the file starts with the header of a raw capture -----
+bool bRawReaderProbe(const char* szFileName);
+
+// ----- maps the capture and loads its index, false if it is no raw capture or can't be read -----
+bool bRawReaderOpen(ST_RAWREADER* pstReader, const char* szFileName);
+
+// ----- raw bytes of the capture -----
+uint64_t qwRawReaderLen(const ST_RAWREADER* pstReader);
+
+// ----- raw offset of the sample at dSeconds from the start at the sampling rate of the header -----
+uint64_t qwRawReaderOffsetAt(const ST_RAWREADER* pstReader, double dSeconds);
+
+// ----- block that holds the raw offset, -1 behind the end -----
+int64_t llRawReaderBlockOf(const ST_RAWREADER* pstReader, uint64_t qwOffset);
+
+// ----- head of a block in the mapped file (time and fill levels), NULL if it is corrupt -----
+const ST_RAWBLOCKHEAD* pstRawReaderBlock(const ST_RAWREADER* pstReader, uint64_t qwBlock);
+
+// ----- reads up to dwLen raw bytes from qwOffset on, returns the bytes read, 0 at the end or on error -----
+uint32_t dwRawReaderRead(ST_RAWREADER* pstReader, uint64_t qwOffset, uint8_t* pbyData, uint32_t dwLen);
+
+// ----- unmaps the file and frees the index -----
+void vRawReaderClose(ST_RAWREADER* pstReader);
+
+#endif
@@ -0,0 +1,713 @@
+/*
+**************************************************************************
+
+rec_rawwriter.cpp
+
+**************************************************************************
+
+Asynchronous writer of the raw ADC data, see rec_rawwriter.h
+
+**************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+
+#if !defined(_WIN32)
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "rec_codec.h"
+#include "rec_mem.h"
+#include "rec_rawwriter.h"
+
+
+
+static double dRawWriterTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t llWallTimeUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t dwSectorRound(uint64_t qwLen)
+{
+	return (uint32_t)((qwLen + REC_MEM_ALIGNMENT - 1) & ~(uint64_t)(REC_MEM_ALIGNMENT - 1));
+}
+
+
+
+/*
+**************************************************************************
+platform part: start a write and check or wait for its completion
+**************************************************************************
+*/
+
+#if defined(_WIN32)
+
+static bool bOpenFile(ST_RAWWRITER* pstWriter, const char* szFileName)
+{
+	pstWriter->hFile = CreateFile(szFileName,
+		GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+		NULL);
+	if (pstWriter->hFile == INVALID_HANDLE_VALUE)
+	{
+		pstWriter->hFile = NULL;
+		return false;
+	}
+
+	// one event per slot, more than one write is in flight on the handle
+	for (int32_t i = 0; i < pstWriter->lDepth; i++)
+	{
+		pstWriter->pstSlots[i].stOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (!pstWriter->pstSlots[i].stOverlapped.hEvent)
+			return false;
+	}
+	return true;
+}
+
+static void vCloseFile(ST_RAWWRITER* pstWriter)
+{
+	for (int32_t i = 0; i < pstWriter->lDepth; i++)
+		if (pstWriter->pstSlots[i].stOverlapped.hEvent)
+			CloseHandle(pstWriter->pstSlots[i].stOverlapped.hEvent);
+	if (pstWriter->hFile)
+		CloseHandle(pstWriter->hFile);
+	pstWriter->hFile = NULL;
+}
+
+static bool bStartWrite(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	HANDLE hEvent = pstSlot->stOverlapped.hEvent;
+	memset(&pstSlot->stOverlapped, 0, sizeof(pstSlot->stOverlapped));
+	pstSlot->stOverlapped.hEvent = hEvent;
+	pstSlot->stOverlapped.Offset = (DWORD)(pstWriter->llOffset & 0xFFFFFFFF);
+	pstSlot->stOverlapped.OffsetHigh = (DWORD)(pstWriter->llOffset >> 32);
+	ResetEvent(hEvent);
+
+	if (!WriteFile(pstWriter->hFile, pstSlot->pbyOut, pstSlot->dwOutLen, NULL, &pstSlot->stOverlapped) && (GetLastError() != ERROR_IO_PENDING))
+		return false;
+	return true;
+}
+
+// ----- 1 done, 0 still in flight, -1 error -----
+static int32_t lCheckWrite(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot, bool bWait)
+{
+	DWORD dwDone = 0;
+	if (!GetOverlappedResult(pstWriter->hFile, &pstSlot->stOverlapped, &dwDone, bWait ? TRUE : FALSE))
+		return (GetLastError() == ERROR_IO_INCOMPLETE) ? 0 : -1;
+	return (dwDone == pstSlot->dwOutLen) ? 1 : -1;
+}
+
+// ----- blocks until the write is done, the result is taken by lCheckWrite -----
+static void vWaitWrite(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	(void)pstWriter;
+	WaitForSingleObject(pstSlot->stOverlapped.hEvent, INFINITE);
+}
+
+#else
+
+static bool bOpenFile(ST_RAWWRITER* pstWriter, const char* szFileName)
+{
+	pstWriter->hFile = open(szFileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+
+	// not every file system can do O_DIRECT
+	if (pstWriter->hFile < 0 && errno == EINVAL)
+		pstWriter->hFile = open(szFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	return pstWriter->hFile >= 0;
+}
+
+static void vCloseFile(ST_RAWWRITER* pstWriter)
+{
+	if (pstWriter->hFile >= 0)
+		close(pstWriter->hFile);
+	pstWriter->hFile = -1;
+}
+
+static bool bStartWrite(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	memset(&pstSlot->stAio, 0, sizeof(pstSlot->stAio));
+	pstSlot->stAio.aio_fildes = pstWriter->hFile;
+	pstSlot->stAio.aio_buf = pstSlot->pbyOut;
+	pstSlot->stAio.aio_nbytes = pstSlot->dwOutLen;
+	pstSlot->stAio.aio_offset = (off_t)pstWriter->llOffset;
+	return aio_write(&pstSlot->stAio) == 0;
+}
+
+// ----- 1 done, 0 still in flight, -1 error -----
+static int32_t lCheckWrite(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot, bool bWait)
+{
+	const struct aiocb* apstList[1] = { &pstSlot->stAio };
+	(void)pstWriter;
+
+	int lError = aio_error(&pstSlot->stAio);
+	while (bWait && lError == EINPROGRESS)
+	{
+		aio_suspend(apstList, 1, NULL);
+		lError = aio_error(&pstSlot->stAio);
+	}
+	if (lError == EINPROGRESS)
+		return 0;
+	return (aio_return(&pstSlot->stAio) == (ssize_t)pstSlot->dwOutLen) ? 1 : -1;
+}
+
+// ----- blocks until the write is done, the result is taken by lCheckWrite -----
+static void vWaitWrite(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	const struct aiocb* apstList[1] = { &pstSlot->stAio };
+	(void)pstWriter;
+	while (aio_error(&pstSlot->stAio) == EINPROGRESS)
+		aio_suspend(apstList, 1, NULL);
+}
+
+#endif
+
+
+
+/*
+**************************************************************************
+bWriteNow: header and index, written through slot 0 when nothing is in
+flight, the buffer is aligned and dwLen a multiple of REC_MEM_ALIGNMENT
+**************************************************************************
+*/
+
+static bool bWriteNow(ST_RAWWRITER* pstWriter, uint8_t* pbyBuffer, uint32_t dwLen)
+{
+	ST_RAWSLOT* pstSlot = &pstWriter->pstSlots[0];
+	uint8_t* pbyOut = pstSlot->pbyOut;
+
+	pstSlot->pbyOut = pbyBuffer;
+	pstSlot->dwOutLen = dwLen;
+	bool bOk = bStartWrite(pstWriter, pstSlot) && lCheckWrite(pstWriter, pstSlot, true) == 1;
+	pstSlot->pbyOut = pbyOut;
+	pstWriter->llOffset += dwLen;
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+bStartRecord: starts the write of the slot's record at the file end and
+adds it to the index
+**************************************************************************
+*/
+
+static bool bStartRecord(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	if (pstWriter->qwBlocks == pstWriter->qwIndexCap)
+	{
+		uint64_t qwCap = pstWriter->qwIndexCap ? pstWriter->qwIndexCap * 2 : 1024;
+		ST_RAWINDEX* pstIndex = (ST_RAWINDEX*)realloc(pstWriter->pstIndex, (size_t)qwCap * sizeof(ST_RAWINDEX));
+		if (!pstIndex)
+			return false;
+		pstWriter->pstIndex = pstIndex;
+		pstWriter->qwIndexCap = qwCap;
+	}
+	ST_RAWINDEX* pstEntry = &pstWriter->pstIndex[pstWriter->qwBlocks];
+	pstEntry->qwFileOffset = (uint64_t)pstWriter->llOffset;
+	pstEntry->qwRawOffset = pstSlot->stHead.qwRawOffset;
+	pstEntry->llTimeUs = pstSlot->stHead.llTimeUs;
+	pstEntry->dwRawLen = pstSlot->stHead.dwRawLen;
+	pstEntry->dwRecordLen = pstSlot->dwOutLen;
+
+	bool bOk = bStartWrite(pstWriter, pstSlot);
+	pstWriter->qwBlocks++;
+	pstWriter->llOffset += pstSlot->dwOutLen;
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+bComplete: checks (or waits for) one slot and books its latency
+**************************************************************************
+*/
+
+static bool bComplete(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot, bool bWait)
+{
+	if (!pstSlot->bPending)
+		return true;
+
+	int32_t lState = lCheckWrite(pstWriter, pstSlot, bWait);
+	if (lState == 0)
+		return false;
+
+	pstSlot->bPending = false;
+	pstSlot->lState = REC_RAWSLOT_FREE;
+	if (lState < 0)
+	{
+		pstWriter->bError = true;
+		return true;
+	}
+
+	double dLatency = dRawWriterTime() - pstSlot->dQueued;
+	pstWriter->qwCompleted++;
+	pstWriter->dLatencySum += dLatency;
+	pstWriter->dLatencyLast = dLatency;
+	if (dLatency > pstWriter->dLatencyMax)
+		pstWriter->dLatencyMax = dLatency;
+	return true;
+}
+
+
+
+// ----- with packers: waits for the write without the lock, the slot state changes under it -----
+static void vCompletePacked(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	if (!pstSlot->bPending)
+		return;
+	vWaitWrite(pstWriter, pstSlot);
+	std::lock_guard<std::mutex> oGuard(pstWriter->pstPacker->oLock);
+	bComplete(pstWriter, pstSlot, false);
+}
+
+
+
+/*
+**************************************************************************
+vSealSlot: the head in front of the samples as is, zeros up to the next
+multiple of REC_MEM_ALIGNMENT
+**************************************************************************
+*/
+
+static void vSealSlot(ST_RAWSLOT* pstSlot)
+{
+	uint32_t dwUsed = (uint32_t)sizeof(ST_RAWBLOCKHEAD) + pstSlot->stHead.dwRawLen;
+
+	pstSlot->stHead.dwCodec = REC_CODEC_NONE;
+	pstSlot->stHead.dwStoredLen = pstSlot->stHead.dwRawLen;
+	pstSlot->stHead.dwRecordLen = dwSectorRound(dwUsed);
+	memcpy(pstSlot->pbyRecord, &pstSlot->stHead, sizeof(ST_RAWBLOCKHEAD));
+	memset(pstSlot->pbyRecord + dwUsed, 0, pstSlot->stHead.dwRecordLen - dwUsed);
+
+	pstSlot->pbyOut = pstSlot->pbyRecord;
+	pstSlot->dwOutLen = pstSlot->stHead.dwRecordLen;
+}
+
+
+
+/*
+**************************************************************************
+vPackSlot: the coded samples behind the head, or the slot's record as
+is if the codec gains nothing
+**************************************************************************
+*/
+
+static void vPackSlot(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot)
+{
+	ST_RAWBLOCKHEAD* pstHead = &pstSlot->stHead;
+	uint8_t* pbyData = pstSlot->pbyPacked + sizeof(ST_RAWBLOCKHEAD);
+
+	if (pstHead->dwRawLen % sizeof(int16_t))
+	{
+		vSealSlot(pstSlot);
+		return;
+	}
+	pstHead->dwStoredLen = dwCodecEncodeSamples((const int16_t*)pstSlot->pbyData, pstHead->dwRawLen / sizeof(int16_t), pstWriter->stFileHead.stSetup.lChannels, pbyData);
+	if (pstHead->dwStoredLen >= pstHead->dwRawLen)
+	{
+		vSealSlot(pstSlot);
+		return;
+	}
+
+	uint32_t dwUsed = (uint32_t)sizeof(ST_RAWBLOCKHEAD) + pstHead->dwStoredLen;
+	pstHead->dwCodec = REC_CODEC_RICE;
+	pstHead->dwRecordLen = dwSectorRound(dwUsed);
+	memcpy(pstSlot->pbyPacked, pstHead, sizeof(ST_RAWBLOCKHEAD));
+	memset(pstSlot->pbyPacked + dwUsed, 0, pstHead->dwRecordLen - dwUsed);
+
+	pstSlot->pbyOut = pstSlot->pbyPacked;
+	pstSlot->dwOutLen = pstHead->dwRecordLen;
+}
+
+
+
+/*
+**************************************************************************
+vPackerThread: packs the queued slots in turn, the writes are started in
+slot order by the packer that completes the oldest packed slot
+**************************************************************************
+*/
+
+static void vPackerThread(ST_RAWWRITER* pstWriter, int32_t lIndex)
+{
+	ST_RAWPACKER* pstPacker = pstWriter->pstPacker;
+
+	bRecPinThread(&pstPacker->stCpus, REC_CPU_PACKER(lIndex));
+	std::unique_lock<std::mutex> oGuard(pstPacker->oLock);
+	while (1)
+	{
+		pstPacker->oWork.wait(oGuard, [pstWriter, pstPacker] { return pstPacker->bStop || pstWriter->pstSlots[pstPacker->lNextPack].lState == REC_RAWSLOT_QUEUED; });
+		ST_RAWSLOT* pstSlot = &pstWriter->pstSlots[pstPacker->lNextPack];
+		if (pstSlot->lState != REC_RAWSLOT_QUEUED)
+			return;
+		pstSlot->lState = REC_RAWSLOT_PACKING;
+		pstPacker->lNextPack = (pstPacker->lNextPack + 1) % pstWriter->lDepth;
+
+		oGuard.unlock();
+		double dStart = dRawWriterTime();
+		vPackSlot(pstWriter, pstSlot);
+		double dBusy = dRawWriterTime() - dStart;
+		oGuard.lock();
+
+		pstSlot->lState = REC_RAWSLOT_PACKED;
+		pstPacker->dBusy += dBusy;
+		pstPacker->qwRawBytes += pstSlot->stHead.dwRawLen;
+		pstPacker->qwPackedBytes += pstSlot->dwOutLen;
+		for (ST_RAWSLOT* pstNext = &pstWriter->pstSlots[pstPacker->lNextWrite]; pstNext->lState == REC_RAWSLOT_PACKED; pstNext = &pstWriter->pstSlots[pstPacker->lNextWrite])
+		{
+			if (!bStartRecord(pstWriter, pstNext))
+			{
+				pstWriter->bError = true;
+				pstNext->lState = REC_RAWSLOT_FREE;
+			}
+			else
+			{
+				pstNext->bPending = true;
+				pstNext->lState = REC_RAWSLOT_WRITING;
+			}
+			pstPacker->lNextWrite = (pstPacker->lNextWrite + 1) % pstWriter->lDepth;
+		}
+		pstPacker->oDone.notify_all();
+	}
+}
+
+
+
+// ----- head of the next block, the lengths and the codec are set when it is written -----
+static void vStampSlot(ST_RAWWRITER* pstWriter, ST_RAWSLOT* pstSlot, uint32_t dwLen, const ST_RAWSTAMP* pstStamp)
+{
+	ST_RAWBLOCKHEAD* pstHead = &pstSlot->stHead;
+
+	memset(pstHead, 0, sizeof(*pstHead));
+	memcpy(pstHead->achMagic, REC_RAWBLOCK_MAGIC, sizeof(pstHead->achMagic));
+	pstHead->qwSequence = pstWriter->qwSequence++;
+	pstHead->qwRawOffset = pstWriter->qwRawOffset;
+	pstHead->llTimeUs = (pstStamp && pstStamp->llTimeUs) ? pstStamp->llTimeUs : llWallTimeUs();
+	pstHead->dwRawLen = dwLen;
+	pstHead->lHwFill = pstStamp ? pstStamp->lHwFill : -1;
+	pstHead->lSwFill = pstStamp ? pstStamp->lSwFill : -1;
+	pstWriter->qwRawOffset += dwLen;
+}
+
+
+
+/*
+**************************************************************************
+bQueuePacked: the slot goes to the packers, its write is started by them
+**************************************************************************
+*/
+
+static bool bQueuePacked(ST_RAWWRITER* pstWriter, const void* pvData, uint32_t dwLen, const ST_RAWSTAMP* pstStamp)
+{
+	ST_RAWPACKER* pstPacker = pstWriter->pstPacker;
+	ST_RAWSLOT* pstSlot = &pstWriter->pstSlots[pstWriter->lNext];
+
+	// book the writes that are done meanwhile, wait for the slot if the packers or the disk are behind
+	{
+		std::unique_lock<std::mutex> oGuard(pstPacker->oLock);
+		for (int32_t i = 0; i < pstWriter->lDepth; i++)
+			if (pstWriter->pstSlots[i].lState == REC_RAWSLOT_WRITING)
+				bComplete(pstWriter, &pstWriter->pstSlots[i], false);
+		if (pstSlot->lState != REC_RAWSLOT_FREE)
+		{
+			pstWriter->qwWaits++;
+			pstPacker->oDone.wait(oGuard, [pstSlot] { return pstSlot->lState == REC_RAWSLOT_WRITING || pstSlot->lState == REC_RAWSLOT_FREE; });
+		}
+		if (pstWriter->bError)
+			return false;
+	}
+
+	// only this thread completes writes, the packers don't touch a slot in writing state
+	vCompletePacked(pstWriter, pstSlot);
+
+	memcpy(pstSlot->pbyData, pvData, dwLen);
+	{
+		std::lock_guard<std::mutex> oGuard(pstPacker->oLock);
+		if (pstWriter->bError)
+			return false;
+		vStampSlot(pstWriter, pstSlot, dwLen, pstStamp);
+		pstSlot->dQueued = dRawWriterTime();
+		pstSlot->lState = REC_RAWSLOT_QUEUED;
+	}
+	pstPacker->oWork.notify_one();
+
+	pstWriter->lNext = (pstWriter->lNext + 1) % pstWriter->lDepth;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bRawWriterOpen
+**************************************************************************
+*/
+
+bool bRawWriterOpen(ST_RAWWRITER* pstWriter, const char* szFileName, uint32_t dwSlotLen, const ST_RAWSETUP* pstSetup, int32_t lDepth, int32_t lPackers, const ST_CPUSET* pstCpus)
+{
+	memset(pstWriter, 0, sizeof(*pstWriter));
+#if !defined(_WIN32)
+	pstWriter->hFile = -1;
+#endif
+	pstWriter->lDepth = (lDepth < 1) ? 1 : lDepth;
+	pstWriter->dwSlotLen = dwSlotLen;
+	pstWriter->dwRecordLen = dwSectorRound((uint64_t)sizeof(ST_RAWBLOCKHEAD) + dwSlotLen);
+
+	ST_RAWFILEHEAD* pstHead = &pstWriter->stFileHead;
+	memcpy(pstHead->achMagic, REC_RAWFILE_MAGIC, sizeof(pstHead->achMagic));
+	pstHead->dwVersion = REC_RAWFILE_VERSION;
+	pstHead->dwHeadLen = REC_MEM_ALIGNMENT;
+	if (pstSetup)
+		pstHead->stSetup = *pstSetup;
+	if (pstHead->stSetup.lChannels < 1)
+		pstHead->stSetup.lChannels = 1;
+	pstHead->dwBlockLen = dwSlotLen;
+	pstHead->dwPackers = (lPackers > 0) ? (uint32_t)lPackers : 0;
+	pstHead->llStartTimeUs = llWallTimeUs();
+
+	// the ring rides out the stalls of the disk, on the node of the card and with as few TLB entries as the system allows
+	ST_CPUSET stCpus;
+	vRecCpuCopy(&stCpus, pstCpus);
+	pstWriter->pstSlots = (ST_RAWSLOT*)calloc(pstWriter->lDepth, sizeof(ST_RAWSLOT));
+	pstWriter->pbyRing = (uint8_t*)pvRecLargeAlloc((size_t)pstWriter->lDepth * pstWriter->dwRecordLen, stCpus.lNode, stCpus.bLargePages, &pstWriter->bLargePages);
+	if (!pstWriter->pstSlots || !pstWriter->pbyRing)
+	{
+		printf("Can't allocate the write ring of %d x %u kByte\n", pstWriter->lDepth, pstWriter->dwRecordLen / 1024);
+		vRawWriterClose(pstWriter);
+		return false;
+	}
+	memset(pstWriter->pbyRing, 0, (size_t)pstWriter->lDepth * pstWriter->dwRecordLen);   // no page faults in the FIFO loop
+	for (int32_t i = 0; i < pstWriter->lDepth; i++)
+	{
+		pstWriter->pstSlots[i].pbyRecord = pstWriter->pbyRing + (size_t)i * pstWriter->dwRecordLen;
+		pstWriter->pstSlots[i].pbyData = pstWriter->pstSlots[i].pbyRecord + sizeof(ST_RAWBLOCKHEAD);
+		pstWriter->pstSlots[i].pbyOut = pstWriter->pstSlots[i].pbyRecord;
+	}
+
+	// a packed record holds the coded block, the slot's record is written if the codec gains nothing
+	if (lPackers > 0)
+	{
+		pstWriter->pstPacker = new (std::nothrow) ST_RAWPACKER;
+		if (!pstWriter->pstPacker)
+		{
+			vRawWriterClose(pstWriter);
+			return false;
+		}
+		ST_RAWPACKER* pstPacker = pstWriter->pstPacker;
+		pstPacker->lThreads = 0;
+		pstPacker->stCpus = stCpus;
+		pstPacker->lNextPack = pstPacker->lNextWrite = 0;
+		pstPacker->bStop = false;
+		pstPacker->qwRawBytes = pstPacker->qwPackedBytes = 0;
+		pstPacker->dBusy = 0;
+
+		uint32_t dwPackedLen = dwSectorRound((uint64_t)sizeof(ST_RAWBLOCKHEAD) + dwCodecSampleBound(dwSlotLen / sizeof(int16_t)));
+		for (int32_t i = 0; i < pstWriter->lDepth; i++)
+			if (!(pstWriter->pstSlots[i].pbyPacked = (uint8_t*)pvRecAlignedAlloc(dwPackedLen)))
+			{
+				printf("Can't allocate the packed write ring of %d x %u kByte\n", pstWriter->lDepth, dwPackedLen / 1024);
+				vRawWriterClose(pstWriter);
+				return false;
+			}
+	}
+
+	if (!bOpenFile(pstWriter, szFileName))
+	{
+		printf("Can't create %s\n", szFileName);
+		vRawWriterClose(pstWriter);
+		return false;
+	}
+
+	// the header goes first, the ring is still empty
+	uint8_t* pbyHead = pstWriter->pstSlots[0].pbyRecord;
+	memset(pbyHead, 0, REC_MEM_ALIGNMENT);
+	memcpy(pbyHead, pstHead, sizeof(*pstHead));
+	if (!bWriteNow(pstWriter, pbyHead, REC_MEM_ALIGNMENT))
+	{
+		printf("Can't write the header of %s\n", szFileName);
+		pstWriter->bError = true;
+		vRawWriterClose(pstWriter);
+		return false;
+	}
+
+	if (pstWriter->pstPacker)
+	{
+		pstWriter->pstPacker->lThreads = (lPackers > REC_RAWWRITER_MAX_PACKERS) ? REC_RAWWRITER_MAX_PACKERS : lPackers;
+		for (int32_t i = 0; i < pstWriter->pstPacker->lThreads; i++)
+			pstWriter->pstPacker->aoThread[i] = std::thread(vPackerThread, pstWriter, i);
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bRawWriterQueue
+**************************************************************************
+*/
+
+bool bRawWriterQueue(ST_RAWWRITER* pstWriter, const void* pvData, uint32_t dwLen, const ST_RAWSTAMP* pstStamp)
+{
+	if (dwLen > pstWriter->dwSlotLen)
+		return false;
+	if (pstWriter->pstPacker)
+		return bQueuePacked(pstWriter, pvData, dwLen, pstStamp);
+
+	// book the writes that are done meanwhile
+	for (int32_t i = 0; i < pstWriter->lDepth; i++)
+		bComplete(pstWriter, &pstWriter->pstSlots[i], false);
+
+	// all slots in flight: the disk is slower than the card
+	ST_RAWSLOT* pstSlot = &pstWriter->pstSlots[pstWriter->lNext];
+	if (pstSlot->bPending)
+	{
+		pstWriter->qwWaits++;
+		bComplete(pstWriter, pstSlot, true);
+	}
+	if (pstWriter->bError)
+		return false;
+
+	memcpy(pstSlot->pbyData, pvData, dwLen);
+	vStampSlot(pstWriter, pstSlot, dwLen, pstStamp);
+	vSealSlot(pstSlot);
+	pstSlot->dQueued = dRawWriterTime();
+	if (!bStartRecord(pstWriter, pstSlot))
+	{
+		pstWriter->bError = true;
+		return false;
+	}
+	pstSlot->bPending = true;
+	pstSlot->lState = REC_RAWSLOT_WRITING;
+
+	pstWriter->lNext = (pstWriter->lNext + 1) % pstWriter->lDepth;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bRawWriterDrain
+**************************************************************************
+*/
+
+bool bRawWriterDrain(ST_RAWWRITER* pstWriter)
+{
+	// the packers are done when no slot is queued, packed or in packing
+	if (pstWriter->pstPacker && pstWriter->pstPacker->lThreads)
+	{
+		ST_RAWPACKER* pstPacker = pstWriter->pstPacker;
+		std::unique_lock<std::mutex> oGuard(pstPacker->oLock);
+		pstPacker->oDone.wait(oGuard, [pstWriter]
+		{
+			for (int32_t i = 0; i < pstWriter->lDepth; i++)
+				if (pstWriter->pstSlots[i].lState != REC_RAWSLOT_FREE && pstWriter->pstSlots[i].lState != REC_RAWSLOT_WRITING)
+					return false;
+			return true;
+		});
+	}
+	if (pstWriter->pstSlots)
+		for (int32_t i = 0; i < pstWriter->lDepth; i++)
+		{
+			if (pstWriter->pstPacker)
+				vCompletePacked(pstWriter, &pstWriter->pstSlots[i]);
+			else
+				bComplete(pstWriter, &pstWriter->pstSlots[i], true);
+		}
+	return !pstWriter->bError;
+}
+
+
+
+/*
+**************************************************************************
+bWriteIndex: index and trailer behind the last block, the trailer in the
+last bytes of the file
+**************************************************************************
+*/
+
+static bool bWriteIndex(ST_RAWWRITER* pstWriter)
+{
+	ST_RAWTRAILER stTrailer;
+	uint64_t qwIndexLen = pstWriter->qwBlocks * sizeof(ST_RAWINDEX);
+	uint64_t qwLen = dwSectorRound(qwIndexLen + sizeof(stTrailer));
+
+	uint8_t* pbyIndex = (uint8_t*)pvRecAlignedAlloc((size_t)qwLen);
+	if (!pbyIndex)
+		return false;
+	memset(pbyIndex, 0, (size_t)qwLen);
+	if (qwIndexLen)
+		memcpy(pbyIndex, pstWriter->pstIndex, (size_t)qwIndexLen);
+	stTrailer.qwIndexOffset = (uint64_t)pstWriter->llOffset;
+	stTrailer.qwBlocks = pstWriter->qwBlocks;
+	stTrailer.qwRawLen = pstWriter->qwRawOffset;
+	memcpy(stTrailer.achMagic, REC_RAWINDEX_MAGIC, sizeof(stTrailer.achMagic));
+	memcpy(pbyIndex + qwLen - sizeof(stTrailer), &stTrailer, sizeof(stTrailer));
+
+	bool bOk = bWriteNow(pstWriter, pbyIndex, (uint32_t)qwLen);
+	vRecAlignedFree(pbyIndex);
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+vRawWriterClose
+**************************************************************************
+*/
+
+void vRawWriterClose(ST_RAWWRITER* pstWriter)
+{
+	bRawWriterDrain(pstWriter);
+	if (pstWriter->pstPacker)
+	{
+		{
+			std::lock_guard<std::mutex> oGuard(pstWriter->pstPacker->oLock);
+			pstWriter->pstPacker->bStop = true;
+		}
+		pstWriter->pstPacker->oWork.notify_all();
+		for (int32_t i = 0; i < pstWriter->pstPacker->lThreads; i++)
+			pstWriter->pstPacker->aoThread[i].join();
+
+		// the statistics stay for the caller
+		pstWriter->qwRawBytes = pstWriter->pstPacker->qwRawBytes;
+		pstWriter->qwPackedBytes = pstWriter->pstPacker->qwPackedBytes;
+		pstWriter->dPackBusy = pstWriter->pstPacker->dBusy;
+		delete pstWriter->pstPacker;
+		pstWriter->pstPacker = NULL;
+	}
+
+	// without the index the reader walks the blocks
+	if (pstWriter->llOffset && !pstWriter->bError && !bWriteIndex(pstWriter))
+		printf("Can't write the index of the raw capture\n");
+	if (pstWriter->pstSlots)
+		vCloseFile(pstWriter);
+
+	vRecLargeFree(pstWriter->pbyRing, (size_t)pstWriter->lDepth * pstWriter->dwRecordLen);
+	pstWriter->pbyRing = NULL;
+	if (pstWriter->pstSlots)
+		for (int32_t i = 0; i < pstWriter->lDepth; i++)
+			vRecAlignedFree(pstWriter->pstSlots[i].pbyPacked);
+	free(pstWriter->pstSlots);
+	pstWriter->pstSlots = NULL;
+	free(pstWriter->pstIndex);
+	pstWriter->pstIndex = NULL;
+}
@@ -0,0 +1,228 @@
+/*
+**************************************************************************
+
+rec_rawwriter.h
+
+**************************************************************************
+
+Asynchronous writer of the raw ADC data. A notify block is copied to the
+next slot of an aligned buffer ring and the write is queued, so the
+block can go back to the card at once and the disk latency is no longer
+part of the FIFO loop. Only if all lDepth slots are still in flight the
+writer waits for the oldest one.
+
+Windows uses overlapped I/O on an unbuffered handle, other systems POSIX
+AIO on an O_DIRECT file. The time from queueing to completion of each
+write is collected for the status output.
+
+The capture is self describing, all parts start at a multiple of
+REC_MEM_ALIGNMENT, so the unbuffered writes need no extra copy:
+
+	header      ST_RAWFILEHEAD, zeros up to REC_MEM_ALIGNMENT: the setup
+	            of the card (ST_RAWSETUP), the largest block and the
+	            start time
+	blocks      ST_RAWBLOCKHEAD with the block number, the raw offset,
+	            the wall clock and the fill levels of the card and the
+	            software buffer, dwStoredLen bytes of samples, zeros up
+	            to the next multiple of REC_MEM_ALIGNMENT
+	index       one ST_RAWINDEX per block, zeros and ST_RAWTRAILER in the
+	            last bytes of a multiple of REC_MEM_ALIGNMENT, written at
+	            the close
+
+The blocks are numbered and hold their raw offset, so a capture that
+was not closed is still read by walking the block heads (rec_rawreader).
+
+With packer threads the blocks are compressed before they go to disk,
+so the card can deliver more than the disk writes. Each queued slot is
+taken by the next free packer and the samples of the interleaved
+channels are coded (rec_codec), the block stays as is if the codec
+gains nothing. The packers start the writes in block order, a fast
+packer waits for the slow one before it.
+**************************************************************************
+*/
+
+#ifndef REC_RAWWRITER_H
+#define REC_RAWWRITER_H
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rec_cpu.h"
+
+#if defined(_WIN32)
+	#include <Windows.h>
+#else
+	#include <aio.h>
+#endif
+
+#define REC_RAWWRITER_DEPTH     4       // default slots in flight
+#define REC_RAWWRITER_MAX_PACKERS 8
+#define REC_RAWFILE_MAGIC       "RECRAW01"
+#define REC_RAWBLOCK_MAGIC      "RAWBLOCK"
+#define REC_RAWINDEX_MAGIC      "RAWINDEX"
+#define REC_RAWFILE_VERSION     1
+#define REC_RAWFILE_EXT         ".rcap"
+
+// ----- slot states -----
+#define REC_RAWSLOT_FREE        0
+#define REC_RAWSLOT_QUEUED      1       // waits for a packer
+#define REC_RAWSLOT_PACKING     2
+#define REC_RAWSLOT_PACKED      3       // waits for the writes of the blocks before
+#define REC_RAWSLOT_WRITING     4
+
+
+// ----- setup of the card, from the caller -----
+struct ST_RAWSETUP
+{
+	int64_t     llSamplingRate;         // samples per second and channel
+	uint64_t    qwChannelMask;
+	int32_t     lChannels;              // interleaved in the samples
+	int32_t     lBytesPerSample;
+	int32_t     lCardType;
+	int32_t     lSerialNumber;
+};
+
+struct ST_RAWFILEHEAD
+{
+	char        achMagic[8];            // REC_RAWFILE_MAGIC
+	uint32_t    dwVersion;
+	uint32_t    dwHeadLen;              // bytes in front of the first block
+	ST_RAWSETUP stSetup;
+	uint32_t    dwBlockLen;             // largest raw block
+	uint32_t    dwPackers;              // 0 if all blocks are stored as is
+	int64_t     llStartTimeUs;          // wall clock of the open
+};
+
+struct ST_RAWBLOCKHEAD
+{
+	char        achMagic[8];            // REC_RAWBLOCK_MAGIC
+	uint64_t    qwSequence;             // block number from 0 on
+	uint64_t    qwRawOffset;            // raw bytes of the blocks before
+	int64_t     llTimeUs;               // wall clock when the block came from the card
+	uint32_t    dwRawLen;
+	uint32_t    dwStoredLen;            // bytes after the head
+	uint32_t    dwRecordLen;            // head, data and padding
+	uint32_t    dwCodec;                // REC_CODEC_RICE or REC_CODEC_NONE
+	int32_t     lHwFill;                // promille of the card buffer, -1 if unknown
+	int32_t     lSwFill;                // promille of the software buffer, -1 if unknown
+	uint32_t    adwReserved[2];
+};
+
+struct ST_RAWINDEX
+{
+	uint64_t    qwFileOffset;           // of the block head
+	uint64_t    qwRawOffset;
+	int64_t     llTimeUs;
+	uint32_t    dwRawLen;
+	uint32_t    dwRecordLen;
+};
+
+struct ST_RAWTRAILER
+{
+	uint64_t    qwIndexOffset;
+	uint64_t    qwBlocks;
+	uint64_t    qwRawLen;
+	char        achMagic[8];            // REC_RAWINDEX_MAGIC
+};
+
+// ----- acquisition stamp of a queued block -----
+struct ST_RAWSTAMP
+{
+	int64_t     llTimeUs;               // 0 for the time of the queueing
+	int32_t     lHwFill;
+	int32_t     lSwFill;
+};
+
+
+struct ST_RAWSLOT
+{
+#if defined(_WIN32)
+	OVERLAPPED  stOverlapped;
+#else
+	struct aiocb stAio;
+#endif
+	uint8_t*    pbyRecord;              // head and samples of the block as is
+	uint8_t*    pbyData;                // samples behind the head
+	ST_RAWBLOCKHEAD stHead;             // set by the queueing, the lengths by the write
+	uint8_t*    pbyPacked;              // record of the packed block, NULL without packers
+	uint8_t*    pbyOut;                 // written from here, pbyRecord or pbyPacked
+	uint32_t    dwOutLen;
+	int32_t     lState;
+	bool        bPending;
+	double      dQueued;
+};
+
+// ----- packer threads, the slot states and the file offset are protected by oLock -----
+struct ST_RAWPACKER
+{
+	std::thread             aoThread[REC_RAWWRITER_MAX_PACKERS];
+	int32_t                 lThreads;
+	ST_CPUSET               stCpus;
+	std::mutex              oLock;
+	std::condition_variable oWork;
+	std::condition_variable oDone;
+	int32_t                 lNextPack;      // slot the next packer takes
+	int32_t                 lNextWrite;     // slot that is written next, keeps the block order
+	bool                    bStop;
+
+	// statistics
+	uint64_t                qwRawBytes;
+	uint64_t                qwPackedBytes;  // records with head and padding
+	double                  dBusy;          // seconds of all packers
+};
+
+struct ST_RAWWRITER
+{
+#if defined(_WIN32)
+	HANDLE      hFile;
+#else
+	int         hFile;
+#endif
+	ST_RAWSLOT* pstSlots;
+	uint8_t*    pbyRing;
+	bool        bLargePages;        // the ring is on large pages
+	int32_t     lDepth;
+	uint32_t    dwSlotLen;          // largest block
+	uint32_t    dwRecordLen;        // ring bytes of a slot, head and block
+	int32_t     lNext;              // slot of the next write
+	int64_t     llOffset;           // file offset of the next write
+	bool        bError;
+
+	// capture format, the index grows with every write that is started
+	ST_RAWFILEHEAD stFileHead;
+	uint64_t    qwSequence;         // of the next queued block
+	uint64_t    qwRawOffset;
+	ST_RAWINDEX* pstIndex;
+	uint64_t    qwBlocks;
+	uint64_t    qwIndexCap;
+
+	// completion latency of the writes in seconds
+	uint64_t    qwCompleted;
+	double      dLatencySum;
+	double      dLatencyMax;
+	double      dLatencyLast;
+	uint64_t    qwWaits;            // queue was full
+
+	// packing, the statistics are set at the close
+	ST_RAWPACKER* pstPacker;        // NULL without packing
+	uint64_t    qwRawBytes;
+	uint64_t    qwPackedBytes;
+	double      dPackBusy;          // seconds of all packers
+};
+
+
+// ----- creates the file with the header of pstSetup, dwSlotLen is the largest block that is queued; lPackers threads compress the int16 samples, pinned if pstCpus is set -----
+bool bRawWriterOpen(ST_RAWWRITER* pstWriter, const char* szFileName, uint32_t dwSlotLen, const ST_RAWSETUP* pstSetup, int32_t lDepth = REC_RAWWRITER_DEPTH, int32_t lPackers = 0, const ST_CPUSET* pstCpus = NULL);
+
+// ----- copies the block and queues the write, waits only if the ring is full; pstStamp NULL for the time of the queueing and unknown fill levels -----
+bool bRawWriterQueue(ST_RAWWRITER* pstWriter, const void* pvData, uint32_t dwLen, const ST_RAWSTAMP* pstStamp = NULL);
+
+// ----- waits for all queued writes -----
+bool bRawWriterDrain(ST_RAWWRITER* pstWriter);
+
+// ----- drains, stops the packers, writes the index and closes the file -----
+void vRawWriterClose(ST_RAWWRITER* pstWriter);
+
+#endif
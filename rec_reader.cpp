@@ -0,0 +1,349 @@
+/*
+**************************************************************************
+
+rec_reader.cpp
+
+**************************************************************************
+
+Random access reader of the stream container, see rec_reader.h
+
+**************************************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rec_codec.h"
+#include "rec_reader.h"
+
+#define HEADER_LEN      24          // magic, streams, chunk bytes, frame rate
+#define TRAILER_LEN     16          // index offset, chunks, "RIDX"
+
+
+
+// ----- 64 bit file offsets, long has 32 bits on Windows -----
+static bool bSeek(FILE* fp, int64_t llOffset, int lOrigin)
+{
+#if defined(_WIN32)
+	return _fseeki64(fp, llOffset, lOrigin) == 0;
+#else
+	return fseeko(fp, (off_t)llOffset, lOrigin) == 0;
+#endif
+}
+
+static int64_t llTell(FILE* fp)
+{
+#if defined(_WIN32)
+	return _ftelli64(fp);
+#else
+	return (int64_t)ftello(fp);
+#endif
+}
+
+// ----- chunk of the stream that fits into the file up to llEnd -----
+static bool bChunkValid(const ST_STREAMREADER* pstReader, const ST_WRITERCHUNK* pstChunk, int64_t llEnd)
+{
+	return pstChunk->dwStream < pstReader->dwStreams && pstChunk->dwLen > 0 && pstChunk->dwLen <= pstReader->dwChunkLen
+		&& (pstChunk->dwCodec == REC_CODEC_RICE || (pstChunk->dwCodec == REC_CODEC_NONE && pstChunk->dwStoredLen == pstChunk->dwLen))
+		&& pstChunk->dwStoredLen <= dwCodecBound(pstChunk->dwLen)
+		&& pstChunk->qwFileOffset + pstChunk->dwStoredLen <= (uint64_t)llEnd;
+}
+
+static int iCompareChunks(const void* pv1, const void* pv2)
+{
+	const ST_WRITERCHUNK* pst1 = (const ST_WRITERCHUNK*)pv1;
+	const ST_WRITERCHUNK* pst2 = (const ST_WRITERCHUNK*)pv2;
+	if (pst1->dwStream != pst2->dwStream)
+		return (pst1->dwStream < pst2->dwStream) ? -1 : 1;
+	return (pst1->qwStreamOffset < pst2->qwStreamOffset) ? -1 : (pst1->qwStreamOffset > pst2->qwStreamOffset) ? 1 : 0;
+}
+
+
+
+/*
+**************************************************************************
+bLoadIndex: index of the trailer if it is there and fits the file
+**************************************************************************
+*/
+
+static bool bLoadIndex(ST_STREAMREADER* pstReader, int64_t llFileLen)
+{
+	uint8_t abyTrailer[TRAILER_LEN];
+	uint64_t qwIndexOffset;
+	uint32_t dwChunks;
+
+	if (llFileLen < HEADER_LEN + TRAILER_LEN || !bSeek(pstReader->fp, llFileLen - TRAILER_LEN, SEEK_SET)
+		|| fread(abyTrailer, 1, TRAILER_LEN, pstReader->fp) != TRAILER_LEN || memcmp(abyTrailer + 12, "RIDX", 4))
+		return false;
+	memcpy(&qwIndexOffset, abyTrailer, sizeof(qwIndexOffset));
+	memcpy(&dwChunks, abyTrailer + 8, sizeof(dwChunks));
+	if (qwIndexOffset < HEADER_LEN || qwIndexOffset + (uint64_t)dwChunks * sizeof(ST_WRITERCHUNK) + TRAILER_LEN != (uint64_t)llFileLen)
+		return false;
+
+	pstReader->pstIndex = (ST_WRITERCHUNK*)malloc(((size_t)dwChunks + 1) * sizeof(ST_WRITERCHUNK));
+	if (!pstReader->pstIndex || !bSeek(pstReader->fp, (int64_t)qwIndexOffset, SEEK_SET)
+		|| fread(pstReader->pstIndex, sizeof(ST_WRITERCHUNK), dwChunks, pstReader->fp) != dwChunks)
+		return false;
+	for (uint32_t i = 0; i < dwChunks; i++)
+		if (!bChunkValid(pstReader, &pstReader->pstIndex[i], (int64_t)qwIndexOffset))
+			return false;
+	pstReader->dwChunks = dwChunks;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bWalkChunks: chunk headers from the start on, up to the first one that
+is cut or makes no sense
+**************************************************************************
+*/
+
+static bool bWalkChunks(ST_STREAMREADER* pstReader, int64_t llFileLen)
+{
+	uint32_t dwIndexLen = 0;
+	int64_t llOffset = HEADER_LEN;
+
+	free(pstReader->pstIndex);
+	pstReader->pstIndex = NULL;
+	pstReader->dwChunks = 0;
+
+	ST_WRITERCHUNK stChunk;
+	while (bSeek(pstReader->fp, llOffset, SEEK_SET) && fread(&stChunk, sizeof(stChunk), 1, pstReader->fp) == 1)
+	{
+		stChunk.qwFileOffset = (uint64_t)llOffset + sizeof(stChunk);
+		if (!bChunkValid(pstReader, &stChunk, llFileLen))
+			break;
+
+		if (pstReader->dwChunks == dwIndexLen)
+		{
+			uint32_t dwNewLen = dwIndexLen ? 2 * dwIndexLen : 1024;
+			ST_WRITERCHUNK* pstNew = (ST_WRITERCHUNK*)realloc(pstReader->pstIndex, dwNewLen * sizeof(ST_WRITERCHUNK));
+			if (!pstNew)
+				return false;
+			pstReader->pstIndex = pstNew;
+			dwIndexLen = dwNewLen;
+		}
+		pstReader->pstIndex[pstReader->dwChunks++] = stChunk;
+		llOffset = (int64_t)stChunk.qwFileOffset + stChunk.dwStoredLen;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bStreamReaderOpen
+**************************************************************************
+*/
+
+bool bStreamReaderOpen(ST_STREAMREADER* pstReader, const char* szFileName)
+{
+	memset(pstReader, 0, sizeof(*pstReader));
+	pstReader->llCached = -1;
+
+	pstReader->fp = fopen(szFileName, "rb");
+	if (!pstReader->fp)
+	{
+		printf("Can't open %s\n", szFileName);
+		return false;
+	}
+
+	uint8_t abyHeader[HEADER_LEN];
+	if (fread(abyHeader, 1, HEADER_LEN, pstReader->fp) != HEADER_LEN || memcmp(abyHeader, "RECSTRM2", 8))
+	{
+		printf("%s is no stream container\n", szFileName);
+		vStreamReaderClose(pstReader);
+		return false;
+	}
+	memcpy(&pstReader->dwStreams, abyHeader + 8, sizeof(uint32_t));
+	memcpy(&pstReader->dwChunkLen, abyHeader + 12, sizeof(uint32_t));
+	memcpy(&pstReader->dFrameRate, abyHeader + 16, sizeof(double));
+	if (pstReader->dwStreams == 0 || pstReader->dwStreams > REC_STREAM_NUM || pstReader->dwChunkLen == 0 || pstReader->dwChunkLen > 256 * 1024 * 1024)
+	{
+		printf("%s has an invalid header\n", szFileName);
+		vStreamReaderClose(pstReader);
+		return false;
+	}
+
+	bSeek(pstReader->fp, 0, SEEK_END);
+	int64_t llFileLen = llTell(pstReader->fp);
+	pstReader->bIndexed = bLoadIndex(pstReader, llFileLen);
+	if (!pstReader->bIndexed && !bWalkChunks(pstReader, llFileLen))
+	{
+		printf("No memory for the index of %s\n", szFileName);
+		vStreamReaderClose(pstReader);
+		return false;
+	}
+
+	pstReader->pbyStored = (uint8_t*)malloc(dwCodecBound(pstReader->dwChunkLen));
+	pstReader->pbyChunk = (uint8_t*)malloc(pstReader->dwChunkLen);
+	if (!pstReader->pbyStored || !pstReader->pbyChunk)
+	{
+		printf("No memory for the chunks of %s\n", szFileName);
+		vStreamReaderClose(pstReader);
+		return false;
+	}
+
+	// the writer stores the streams of a flush one after the other
+	if (pstReader->dwChunks)
+		qsort(pstReader->pstIndex, pstReader->dwChunks, sizeof(ST_WRITERCHUNK), iCompareChunks);
+	for (uint32_t i = 0; i < pstReader->dwChunks; i++)
+		pstReader->adwFirst[pstReader->pstIndex[i].dwStream + 1]++;
+	for (uint32_t i = 0; i < REC_STREAM_NUM; i++)
+		pstReader->adwFirst[i + 1] += pstReader->adwFirst[i];
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+qwStreamReaderLen: up to the first gap of the stream
+**************************************************************************
+*/
+
+uint64_t qwStreamReaderLen(const ST_STREAMREADER* pstReader, uint32_t dwStream)
+{
+	if (dwStream >= REC_STREAM_NUM)
+		return 0;
+	uint64_t qwLen = 0;
+	for (uint32_t i = pstReader->adwFirst[dwStream]; i < pstReader->adwFirst[dwStream + 1] && pstReader->pstIndex[i].qwStreamOffset == qwLen; i++)
+		qwLen += pstReader->pstIndex[i].dwLen;
+	return qwLen;
+}
+
+
+
+/*
+**************************************************************************
+llStreamReaderStartUs
+**************************************************************************
+*/
+
+int64_t llStreamReaderStartUs(const ST_STREAMREADER* pstReader, uint32_t dwStream)
+{
+	if (dwStream >= REC_STREAM_NUM || pstReader->adwFirst[dwStream] == pstReader->adwFirst[dwStream + 1])
+		return 0;
+	return pstReader->pstIndex[pstReader->adwFirst[dwStream]].llTimeUs;
+}
+
+
+
+/*
+**************************************************************************
+qwStreamReaderOffsetAt: last chunk that starts before the time, the rest
+from the frame rate
+**************************************************************************
+*/
+
+uint64_t qwStreamReaderOffsetAt(const ST_STREAMREADER* pstReader, uint32_t dwStream, int64_t llTimeUs)
+{
+	if (dwStream >= REC_STREAM_NUM)
+		return 0;
+	uint32_t dwLow = pstReader->adwFirst[dwStream];
+	uint32_t dwHigh = pstReader->adwFirst[dwStream + 1];
+	if (dwLow == dwHigh || llTimeUs <= pstReader->pstIndex[dwLow].llTimeUs)
+		return 0;
+
+	while (dwHigh - dwLow > 1)
+	{
+		uint32_t dwMid = (dwLow + dwHigh) / 2;
+		if (pstReader->pstIndex[dwMid].llTimeUs <= llTimeUs)
+			dwLow = dwMid;
+		else
+			dwHigh = dwMid;
+	}
+
+	const ST_WRITERCHUNK* pstChunk = &pstReader->pstIndex[dwLow];
+	double dBytes = (double)(llTimeUs - pstChunk->llTimeUs) * pstReader->dFrameRate / 1.0e6;
+	return pstChunk->qwStreamOffset + ((dBytes < pstChunk->dwLen) ? (uint64_t)dBytes : pstChunk->dwLen);
+}
+
+
+
+/*
+**************************************************************************
+dwStreamReaderRead
+**************************************************************************
+*/
+
+// ----- decodes chunk i to pbyChunk unless it is there already -----
+static bool bLoadChunk(ST_STREAMREADER* pstReader, uint32_t dwChunk)
+{
+	if (pstReader->llCached == (int64_t)dwChunk)
+		return true;
+	pstReader->llCached = -1;
+
+	const ST_WRITERCHUNK* pstChunk = &pstReader->pstIndex[dwChunk];
+	uint8_t* pbyStored = (pstChunk->dwCodec == REC_CODEC_NONE) ? pstReader->pbyChunk : pstReader->pbyStored;
+	if (!bSeek(pstReader->fp, (int64_t)pstChunk->qwFileOffset, SEEK_SET) || fread(pbyStored, 1, pstChunk->dwStoredLen, pstReader->fp) != pstChunk->dwStoredLen)
+		return false;
+	if (pstChunk->dwCodec == REC_CODEC_RICE && !bCodecDecode(pbyStored, pstChunk->dwStoredLen, pstReader->pbyChunk, pstChunk->dwLen))
+	{
+		printf("Chunk %u of stream %u is corrupt\n", dwChunk - pstReader->adwFirst[pstChunk->dwStream], pstChunk->dwStream);
+		return false;
+	}
+	pstReader->llCached = dwChunk;
+	return true;
+}
+
+uint32_t dwStreamReaderRead(ST_STREAMREADER* pstReader, uint32_t dwStream, uint64_t qwOffset, uint8_t* pbyData, uint32_t dwLen)
+{
+	if (dwStream >= REC_STREAM_NUM)
+		return 0;
+	uint32_t dwLow = pstReader->adwFirst[dwStream];
+	uint32_t dwHigh = pstReader->adwFirst[dwStream + 1];
+	if (dwLow == dwHigh || qwOffset < pstReader->pstIndex[dwLow].qwStreamOffset)
+		return 0;
+
+	// last chunk that starts at or before the offset
+	while (dwHigh - dwLow > 1)
+	{
+		uint32_t dwMid = (dwLow + dwHigh) / 2;
+		if (pstReader->pstIndex[dwMid].qwStreamOffset <= qwOffset)
+			dwLow = dwMid;
+		else
+			dwHigh = dwMid;
+	}
+
+	uint32_t dwDone = 0;
+	for (uint32_t i = dwLow; dwDone < dwLen && i < pstReader->adwFirst[dwStream + 1]; i++)
+	{
+		const ST_WRITERCHUNK* pstChunk = &pstReader->pstIndex[i];
+		uint64_t qwPos = qwOffset + dwDone;
+		if (qwPos < pstChunk->qwStreamOffset || qwPos >= pstChunk->qwStreamOffset + pstChunk->dwLen || !bLoadChunk(pstReader, i))
+			break;
+
+		uint32_t dwSkip = (uint32_t)(qwPos - pstChunk->qwStreamOffset);
+		uint32_t dwCopy = (pstChunk->dwLen - dwSkip < dwLen - dwDone) ? pstChunk->dwLen - dwSkip : dwLen - dwDone;
+		memcpy(pbyData + dwDone, pstReader->pbyChunk + dwSkip, dwCopy);
+		dwDone += dwCopy;
+	}
+	return dwDone;
+}
+
+
+
+/*
+**************************************************************************
+vStreamReaderClose
+**************************************************************************
+*/
+
+void vStreamReaderClose(ST_STREAMREADER* pstReader)
+{
+	if (pstReader->fp)
+		fclose(pstReader->fp);
+	pstReader->fp = NULL;
+	free(pstReader->pstIndex);
+	pstReader->pstIndex = NULL;
+	free(pstReader->pbyStored);
+	pstReader->pbyStored = NULL;
+	free(pstReader->pbyChunk);
+	pstReader->pbyChunk = NULL;
+	pstReader->dwChunks = 0;
+	pstReader->llCached = -1;
+}
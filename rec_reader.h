@@ -0,0 +1,67 @@
+/*
+**************************************************************************
+
+rec_reader.h
+
+**************************************************************************
+
+Random access reader of the stream container written by rec_writer.
+The index at the end of the file is loaded once and sorted by stream
+and stream offset, a read looks up the chunks of its range and decodes
+only those. Without the trailer (the recording was not closed) the
+chunks are found by walking the chunk headers from the start of the
+file up to the last complete chunk.
+
+Times are the wall clock of the chunks in microseconds since 1970, a
+time between two chunk starts is placed by the frame rate of the file.
+**************************************************************************
+*/
+
+#ifndef REC_READER_H
+#define REC_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "rec_writer.h"
+
+
+struct ST_STREAMREADER
+{
+	FILE*           fp;
+	uint32_t        dwStreams;
+	uint32_t        dwChunkLen;         // largest chunk
+	double          dFrameRate;         // 0 if unknown
+	bool            bIndexed;           // false if the chunks were walked
+
+	// index sorted by stream and offset, the chunks of stream i from adwFirst[i] on
+	ST_WRITERCHUNK* pstIndex;
+	uint32_t        dwChunks;
+	uint32_t        adwFirst[REC_STREAM_NUM + 1];
+
+	// last decoded chunk
+	uint8_t*        pbyStored;
+	uint8_t*        pbyChunk;
+	int64_t         llCached;           // index of the chunk in pbyChunk, -1 for none
+};
+
+
+// ----- loads the index of the container, false if it is no stream container or can't be read -----
+bool bStreamReaderOpen(ST_STREAMREADER* pstReader, const char* szFileName);
+
+// ----- bytes of a stream -----
+uint64_t qwStreamReaderLen(const ST_STREAMREADER* pstReader, uint32_t dwStream);
+
+// ----- time of the first byte of a stream, 0 if it is empty -----
+int64_t llStreamReaderStartUs(const ST_STREAMREADER* pstReader, uint32_t dwStream);
+
+// ----- stream offset of the byte at wall clock llTimeUs -----
+uint64_t qwStreamReaderOffsetAt(const ST_STREAMREADER* pstReader, uint32_t dwStream, int64_t llTimeUs);
+
+// ----- reads up to dwLen bytes of a stream from qwOffset on, returns the bytes read, 0 at the end or on error -----
+uint32_t dwStreamReaderRead(ST_STREAMREADER* pstReader, uint32_t dwStream, uint64_t qwOffset, uint8_t* pbyData, uint32_t dwLen);
+
+// ----- closes the file and frees the index -----
+void vStreamReaderClose(ST_STREAMREADER* pstReader);
+
+#endif
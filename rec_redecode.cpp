@@ -0,0 +1,851 @@
+/*
+**************************************************************************
+
+rec_redecode.cpp
+
+**************************************************************************
+
+Offline re-decoding of a long capture on all cores. The output is the
+same to the byte as the one of rec_replay with the same setup and the
+same notify size (-n), the blocks are cut the same way. This holds for
+the container (-container) too: both tools date a block by the start of
+the capture and its samples, and the writer cuts its chunks by these
+times (rec_writer).
+
+The slicer (symbol clock and threshold) takes nearly all the time and
+its state follows the signal, a slicer started somewhere later in the
+recording finds the same state again after a while. So the capture is
+cut into chunks of -chunk notify blocks and the worker threads slice
+the chunks at the same time, each starting -warm samples in front of
+its chunk from a fresh slicer (vDecoderSeek) and keeping the slicer
+state in front of each block (ST_SLICECARRY). The warm-up is rounded up
+to whole blocks, the threshold steps are counted from the block start.
+
+The chunks are stitched in order on the main thread: the true slicer
+state at the end of the last chunk is compared with the one the worker
+found in front of each block of the next chunk (bDecoderSameSlice), the
+blocks up to the first match are sliced again from the true state. Then
+preamble search, frame lock and demux (bDecoderFrames) run over the
+sliced blocks in order, they are cheap and carry the frame alignment, so
+they are not split. A slicer that never finds the true state again
+(the recovered clock of -sps can differ in the last bits) makes the
+chunk being sliced again block by block, the result is still right,
+only the speed is that of one core.
+
+The capture is read as in rec_replay: a raw capture of the FIFO loop
+(.rcap) through one rec_rawreader per thread with rate and channels
+from its header, -from and -len select a range in seconds; other files
+are plain samples. Each thread has its own reader, so the blocks are
+read at once where they are needed.
+
+usage: rec_redecode [-n notify kByte] [-s sampling rate MS/s] [-t threads] [-chunk blocks] [-warm kSamples] [-P preamble] [-e preamble errors] [-track] [-hyst counts] [-sps samples per symbol] [-sync frames] [-nowrite] [-container] [-c channels] [-from s] [-len s] [capture.rcap|capture.bin]
+**************************************************************************
+*/
+
+
+
+// ----- standard c include files -----
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <new>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// ----- decoding chain -----
+#include "rec_bits.h"
+#include "rec_cpu.h"
+#include "rec_multi.h"
+#include "rec_writer.h"
+#include "rec_rawreader.h"
+
+
+// ----- global setup for the run -----
+double  g_dSamplingRate = 20.0e6;
+int64_t g_llNotifySize = 1024 * 1024 * 16;
+int32_t g_lThreads = 0;                 // one per core
+int32_t g_lChunkBlocks = 4;
+int64_t g_llWarmSamples = 1024 * 1024;  // of one channel
+bool    g_bWriteFiles = true;
+bool    g_bContainer = false;
+int32_t g_lChannels = 1;
+const char* g_szPreamble = REC_PREAMBLE_DEFAULT;
+int32_t g_lPreambleErrors = 0;
+int32_t g_lThresholdMode = REC_THRESHOLD_WINDOW;
+double  g_dHysteresis = 0;
+double  g_dSamplesPerSymbol = 0;
+uint32_t g_dwSyncInterval = 0;
+double  g_dFrom = 0;
+double  g_dLen = -1;                    // to the end
+int64_t g_llStartTimeUs = 0;            // wall clock of the capture start, 0 for plain files
+uint64_t g_qwFirstSample = 0;           // of a channel, first one decoded
+
+#define FILENAME "500mVPP_500MHz_Squares"
+#define REDECODE_MAX_THREADS    64
+#define REDECODE_SLOTS          2       // chunks in flight per thread
+
+
+
+/*
+**************************************************************************
+Run data
+**************************************************************************
+*/
+
+// ----- capture of one thread: a raw capture with its own reader or a plain sample file -----
+struct ST_SOURCE
+{
+	bool            bRaw;
+	ST_RAWREADER    stReader;
+	FILE*           fp;
+	uint64_t        qwFirst;            // raw offset of the first block
+};
+
+// ----- one chunk: for each block and channel the sliced symbols and the slicer state in front of them -----
+struct ST_CHUNK
+{
+	int64_t         llFirstBlock;
+	int32_t         lBlocks;
+	ST_SLICEDBLOCK* pstSliced;          // [block * lChannels + channel]
+	uint64_t*       pqwBits;            // dwBlockWords for each entry of pstSliced
+	ST_SLICECARRY*  pstCarry;           // [block * lChannels + channel], block lBlocks is the state behind the chunk
+	bool            bDone;              // protected by oLock
+	bool            bOk;
+};
+
+// ----- slicer of a thread: one decoder per channel and the samples of a block -----
+struct ST_SLICER
+{
+	ST_DECODER      astDecoder[REC_MAX_ADC];
+	int32_t         lDecoders;
+	ST_SLICECARRY   stFresh;            // state after the setup
+	ST_SOURCE       stSource;
+	bool            bSource;
+	uint8_t*        pbyBlock;
+	int16_t*        pnChannel;
+};
+
+struct ST_REDECODE
+{
+	// blocks of the capture
+	int32_t         lChannels;
+	uint32_t        dwBlockBytes;
+	uint32_t        dwChannelSamples;   // samples of one channel in a block
+	uint32_t        dwBlockWords;       // packed symbols of one channel in a block
+	int64_t         llBlocks;
+	int64_t         llChunks;
+
+	// chunks in flight, chunk k in slot k % lSlots
+	ST_CHUNK        astChunk[REDECODE_MAX_THREADS * REDECODE_SLOTS];
+	int32_t         lSlots;
+
+	// workers
+	ST_SLICER       astSlicer[REDECODE_MAX_THREADS];
+	int32_t         lThreads;
+	std::thread     aoWorker[REDECODE_MAX_THREADS];
+	std::mutex      oLock;
+	std::condition_variable oWork;
+	std::condition_variable oDone;
+	int64_t         llNext;             // next chunk to slice, protected by oLock
+	int64_t         llStitched;         // chunks done with, protected by oLock
+	bool            bStop;              // protected by oLock
+
+	// stitching and frames on the main thread
+	ST_SLICER       stMain;
+	ST_SLICECARRY   astTrue[REC_MAX_ADC];
+	ST_DECODER      astFrames[REC_MAX_ADC];
+	int32_t         lFrames;
+	ST_STREAMWRITER astWriter[REC_MAX_ADC];
+	int32_t         lWriters;
+
+	// statistics
+	int64_t         llSeams;
+	int64_t         llSeamsMatched;
+	int64_t         llResliced;
+};
+
+static double dGetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ----- wall clock of the block that ends with sample qwEnd of a channel, as rec_replay dates it -----
+static int64_t llBlockTimeUs(uint64_t qwEnd)
+{
+	return g_llStartTimeUs + (int64_t)((g_qwFirstSample + qwEnd) * 1.0e6 / g_dSamplingRate);
+}
+
+// ----- frames per second, each stream gets one byte per frame; the sync words take their symbols too -----
+static double dFrameRate()
+{
+	double dSamplesPerSymbol = (g_dSamplesPerSymbol > 0) ? g_dSamplesPerSymbol : REC_DOWN_SAMPLING_RATE;
+	double dSymbols = REC_FRAME_SIZE + (g_dwSyncInterval ? (double)strlen(REC_LOCK_SYNC_DEFAULT) / g_dwSyncInterval : 0);
+	return g_dSamplingRate / (dSamplesPerSymbol * dSymbols);
+}
+
+// ----- 64 bit file offsets, long has 32 bits on Windows -----
+static bool bSeek(FILE* fp, int64_t llOffset)
+{
+#if defined(_WIN32)
+	return _fseeki64(fp, llOffset, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)llOffset, SEEK_SET) == 0;
+#endif
+}
+
+
+
+/*
+**************************************************************************
+bSourceOpen, bSourceRead, vSourceClose
+**************************************************************************
+*/
+
+static bool bSourceOpen(ST_SOURCE* pstSource, const char* szFileName, bool bRaw, uint64_t qwFirst)
+{
+	pstSource->bRaw = bRaw;
+	pstSource->fp = NULL;
+	pstSource->qwFirst = qwFirst;
+	if (bRaw)
+		return bRawReaderOpen(&pstSource->stReader, szFileName);
+
+	pstSource->fp = fopen(szFileName, "rb");
+	if (!pstSource->fp)
+		printf("Can't open %s\n", szFileName);
+	return pstSource->fp != NULL;
+}
+
+// ----- dwLen raw bytes from qwOffset on, counted from the first block -----
+static bool bSourceRead(ST_SOURCE* pstSource, uint64_t qwOffset, uint8_t* pbyData, uint32_t dwLen)
+{
+	if (pstSource->bRaw)
+		return dwRawReaderRead(&pstSource->stReader, pstSource->qwFirst + qwOffset, pbyData, dwLen) == dwLen;
+	return bSeek(pstSource->fp, (int64_t)(pstSource->qwFirst + qwOffset)) && fread(pbyData, 1, dwLen, pstSource->fp) == dwLen;
+}
+
+static void vSourceClose(ST_SOURCE* pstSource)
+{
+	if (pstSource->bRaw)
+		vRawReaderClose(&pstSource->stReader);
+	else if (pstSource->fp)
+		fclose(pstSource->fp);
+	pstSource->fp = NULL;
+}
+
+
+
+/*
+**************************************************************************
+bDecoderSetup: decoder of one channel with the setup of the run
+**************************************************************************
+*/
+
+static bool bDecoderSetup(ST_DECODER* pstDecoder, uint32_t dwSamples)
+{
+	if (!bDecoderInit(pstDecoder, dwSamples, g_szPreamble, g_lPreambleErrors))
+	{
+		printf("Invalid preamble setup or no memory for the decoder\n");
+		return false;
+	}
+	if (!bDecoderSetThreshold(pstDecoder, g_lThresholdMode, g_dHysteresis))
+	{
+		printf("Invalid slicer hysteresis %.1lf\n", g_dHysteresis);
+		return false;
+	}
+	if (g_dSamplesPerSymbol > 0 && !bDecoderSetTiming(pstDecoder, REC_TIMING_TRACK, g_dSamplesPerSymbol))
+	{
+		printf("Invalid symbol timing of %.2lf samples per symbol or no memory\n", g_dSamplesPerSymbol);
+		return false;
+	}
+	if (g_dwSyncInterval && !bDecoderSetLock(pstDecoder, g_dwSyncInterval))
+	{
+		printf("No memory for the frame lock\n");
+		return false;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bSlicerOpen, vSlicerClose
+**************************************************************************
+*/
+
+static bool bSlicerOpen(ST_SLICER* pstSlicer, const ST_REDECODE* pstRun, const char* szFileName, bool bRaw, uint64_t qwFirst)
+{
+	pstSlicer->lDecoders = 0;
+	pstSlicer->bSource = false;
+	pstSlicer->pbyBlock = NULL;
+	pstSlicer->pnChannel = NULL;
+
+	for (int32_t i = 0; i < pstRun->lChannels; i++)
+	{
+		if (!bDecoderSetup(&pstSlicer->astDecoder[i], pstRun->dwChannelSamples))
+			return false;
+		pstSlicer->lDecoders = i + 1;
+	}
+	vDecoderSaveSlice(&pstSlicer->astDecoder[0], &pstSlicer->stFresh);
+
+	if (!bSourceOpen(&pstSlicer->stSource, szFileName, bRaw, qwFirst))
+		return false;
+	pstSlicer->bSource = true;
+
+	pstSlicer->pbyBlock = (uint8_t*)malloc(pstRun->dwBlockBytes);
+	pstSlicer->pnChannel = (int16_t*)malloc((size_t)pstRun->dwChannelSamples * sizeof(int16_t));
+	if (!pstSlicer->pbyBlock || !pstSlicer->pnChannel)
+	{
+		printf("No memory for the blocks of the slicer\n");
+		return false;
+	}
+	return true;
+}
+
+static void vSlicerClose(ST_SLICER* pstSlicer)
+{
+	for (int32_t i = 0; i < pstSlicer->lDecoders; i++)
+		vDecoderClose(&pstSlicer->astDecoder[i]);
+	pstSlicer->lDecoders = 0;
+	if (pstSlicer->bSource)
+		vSourceClose(&pstSlicer->stSource);
+	pstSlicer->bSource = false;
+	free(pstSlicer->pbyBlock);
+	free(pstSlicer->pnChannel);
+	pstSlicer->pbyBlock = NULL;
+	pstSlicer->pnChannel = NULL;
+}
+
+
+
+/*
+**************************************************************************
+bReadSamples: dwSamples samples of each channel from sample qwSample of
+a channel on, pnChannelOf gives the samples of one channel
+**************************************************************************
+*/
+
+static bool bReadSamples(ST_SLICER* pstSlicer, const ST_REDECODE* pstRun, uint64_t qwSample, uint32_t dwSamples)
+{
+	uint64_t qwFrameLen = sizeof(int16_t) * pstRun->lChannels;
+	return bSourceRead(&pstSlicer->stSource, qwSample * qwFrameLen, pstSlicer->pbyBlock, (uint32_t)(dwSamples * qwFrameLen));
+}
+
+static const int16_t* pnChannelOf(ST_SLICER* pstSlicer, const ST_REDECODE* pstRun, uint32_t dwSamples, int32_t lChannel)
+{
+	if (pstRun->lChannels == 1)
+		return (const int16_t*)pstSlicer->pbyBlock;
+	vMultiDeinterleave((const int16_t*)pstSlicer->pbyBlock, dwSamples, pstRun->lChannels, lChannel, pstSlicer->pnChannel);
+	return pstSlicer->pnChannel;
+}
+
+// ----- decisions of one block to the chunk, they live in the arena of the decoder only up to the next block -----
+static void vKeepSliced(const ST_REDECODE* pstRun, ST_CHUNK* pstChunk, int32_t lEntry, const ST_SLICEDBLOCK* pstSliced)
+{
+	uint64_t* pqwBits = pstChunk->pqwBits + (size_t)lEntry * pstRun->dwBlockWords;
+	memcpy(pqwBits, pstSliced->pqwBits, REC_BITS_WORDS(pstSliced->dwSymbols) * sizeof(uint64_t));
+	pstChunk->pstSliced[lEntry] = *pstSliced;
+	pstChunk->pstSliced[lEntry].pqwBits = pqwBits;
+}
+
+
+
+/*
+**************************************************************************
+bSliceChunk: warm-up in front of the chunk from a fresh slicer, then the
+blocks of the chunk with the state in front of each
+**************************************************************************
+*/
+
+static bool bSliceChunk(ST_REDECODE* pstRun, ST_SLICER* pstSlicer, ST_CHUNK* pstChunk)
+{
+	int32_t lChannels = pstRun->lChannels;
+	ST_SLICEDBLOCK stSliced;
+
+	// the threshold steps are counted from the block start, so the warm-up is cut into the same blocks
+	int64_t llWarmBlocks = (g_llWarmSamples + pstRun->dwChannelSamples - 1) / pstRun->dwChannelSamples;
+	llWarmBlocks = (pstChunk->llFirstBlock < llWarmBlocks) ? pstChunk->llFirstBlock : llWarmBlocks;
+	uint64_t qwStart = (uint64_t)pstChunk->llFirstBlock * pstRun->dwChannelSamples;
+	uint64_t qwWarm = (uint64_t)llWarmBlocks * pstRun->dwChannelSamples;
+	for (int32_t c = 0; c < lChannels; c++)
+	{
+		vDecoderLoadSlice(&pstSlicer->astDecoder[c], &pstSlicer->stFresh);
+		vDecoderSeek(&pstSlicer->astDecoder[c], qwStart - qwWarm);
+	}
+
+	// the decisions of the warm-up are dropped
+	for (uint64_t qwPos = qwStart - qwWarm; qwPos < qwStart; qwPos += pstRun->dwChannelSamples)
+	{
+		if (!bReadSamples(pstSlicer, pstRun, qwPos, pstRun->dwChannelSamples))
+			return false;
+		for (int32_t c = 0; c < lChannels; c++)
+			if (!bDecoderSlice(&pstSlicer->astDecoder[c], pnChannelOf(pstSlicer, pstRun, pstRun->dwChannelSamples, c), pstRun->dwChannelSamples, &stSliced))
+				return false;
+	}
+
+	for (int32_t b = 0; b < pstChunk->lBlocks; b++)
+	{
+		if (!bReadSamples(pstSlicer, pstRun, qwStart + (uint64_t)b * pstRun->dwChannelSamples, pstRun->dwChannelSamples))
+			return false;
+		for (int32_t c = 0; c < lChannels; c++)
+		{
+			ST_DECODER* pstDecoder = &pstSlicer->astDecoder[c];
+			vDecoderSaveSlice(pstDecoder, &pstChunk->pstCarry[b * lChannels + c]);
+			if (!bDecoderSlice(pstDecoder, pnChannelOf(pstSlicer, pstRun, pstRun->dwChannelSamples, c), pstRun->dwChannelSamples, &stSliced))
+				return false;
+			vKeepSliced(pstRun, pstChunk, b * lChannels + c, &stSliced);
+		}
+	}
+	for (int32_t c = 0; c < lChannels; c++)
+		vDecoderSaveSlice(&pstSlicer->astDecoder[c], &pstChunk->pstCarry[pstChunk->lBlocks * lChannels + c]);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vWorker: slices the chunks in turn, at most lSlots ahead of the stitching
+**************************************************************************
+*/
+
+static void vWorker(ST_REDECODE* pstRun, int32_t lIndex)
+{
+	for (;;)
+	{
+		int64_t llChunk;
+		{
+			std::unique_lock<std::mutex> oGuard(pstRun->oLock);
+			pstRun->oWork.wait(oGuard, [pstRun] {
+				return pstRun->bStop || pstRun->llNext >= pstRun->llChunks || pstRun->llNext < pstRun->llStitched + pstRun->lSlots; });
+			if (pstRun->bStop || pstRun->llNext >= pstRun->llChunks)
+				return;
+			llChunk = pstRun->llNext++;
+		}
+
+		ST_CHUNK* pstChunk = &pstRun->astChunk[llChunk % pstRun->lSlots];
+		pstChunk->llFirstBlock = llChunk * g_lChunkBlocks;
+		pstChunk->lBlocks = (pstRun->llBlocks - pstChunk->llFirstBlock < g_lChunkBlocks) ? (int32_t)(pstRun->llBlocks - pstChunk->llFirstBlock) : g_lChunkBlocks;
+		pstChunk->bOk = bSliceChunk(pstRun, &pstRun->astSlicer[lIndex], pstChunk);
+
+		std::lock_guard<std::mutex> oGuard(pstRun->oLock);
+		pstChunk->bDone = true;
+		pstRun->oDone.notify_all();
+	}
+}
+
+
+
+/*
+**************************************************************************
+bStitchChunk: blocks up to the first slicer state that matches the true
+one are sliced again, the true state goes on to the end of the chunk
+**************************************************************************
+*/
+
+static bool bStitchChunk(ST_REDECODE* pstRun, ST_CHUNK* pstChunk)
+{
+	int32_t lChannels = pstRun->lChannels;
+	ST_SLICER* pstSlicer = &pstRun->stMain;
+	ST_SLICEDBLOCK stSliced;
+
+	for (int32_t c = 0; c < lChannels; c++)
+	{
+		ST_DECODER* pstDecoder = &pstSlicer->astDecoder[c];
+		int32_t b = 0;
+		for (; b < pstChunk->lBlocks && !bDecoderSameSlice(&pstRun->astTrue[c], &pstChunk->pstCarry[b * lChannels + c]); b++)
+		{
+			uint64_t qwSample = (uint64_t)(pstChunk->llFirstBlock + b) * pstRun->dwChannelSamples;
+			vDecoderLoadSlice(pstDecoder, &pstRun->astTrue[c]);
+			if (!bReadSamples(pstSlicer, pstRun, qwSample, pstRun->dwChannelSamples)
+				|| !bDecoderSlice(pstDecoder, pnChannelOf(pstSlicer, pstRun, pstRun->dwChannelSamples, c), pstRun->dwChannelSamples, &stSliced))
+				return false;
+			vKeepSliced(pstRun, pstChunk, b * lChannels + c, &stSliced);
+			vDecoderSaveSlice(pstDecoder, &pstRun->astTrue[c]);
+			pstRun->llResliced++;
+		}
+		if (b < pstChunk->lBlocks)
+			pstRun->astTrue[c] = pstChunk->pstCarry[pstChunk->lBlocks * lChannels + c];
+
+		pstRun->llSeams++;
+		if (b == 0)
+			pstRun->llSeamsMatched++;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bFramesChunk: preamble, lock and demux of the stitched blocks in order,
+the streams go out as in rec_replay
+**************************************************************************
+*/
+
+static bool bFramesChunk(ST_REDECODE* pstRun, const ST_CHUNK* pstChunk)
+{
+	for (int32_t b = 0; b < pstChunk->lBlocks; b++)
+	{
+		int64_t llTimeUs = llBlockTimeUs((uint64_t)(pstChunk->llFirstBlock + b + 1) * pstRun->dwChannelSamples);
+		for (int32_t c = 0; c < pstRun->lChannels; c++)
+		{
+			ST_DECODER* pstDecoder = &pstRun->astFrames[c];
+			vArenaReset(&pstDecoder->stArena);
+			if (!bDecoderFrames(pstDecoder, &pstChunk->pstSliced[b * pstRun->lChannels + c]))
+			{
+				printf("\nDecoder error\n");
+				return false;
+			}
+			if (c < pstRun->lWriters
+				&& ((pstDecoder->dwStreamLen && !bStreamWriterAppend(&pstRun->astWriter[c], pstDecoder->apbyStream, pstDecoder->dwStreamLen, llTimeUs))
+				|| !bStreamWriterLog(&pstRun->astWriter[c], pstDecoder->stLock.astEvent, pstDecoder->stLock.dwEvents, g_dSamplingRate)))
+			{
+				printf("\nStream write error\n");
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bRedecodeOpen: decoders, chunks, writers and the slicers of the workers
+**************************************************************************
+*/
+
+static bool bRedecodeOpen(ST_REDECODE* pstRun, const char* szFileName, bool bRaw, uint64_t qwFirst)
+{
+	for (int32_t i = 0; i < pstRun->lThreads; i++)
+		if (!bSlicerOpen(&pstRun->astSlicer[i], pstRun, szFileName, bRaw, qwFirst))
+			return false;
+	if (!bSlicerOpen(&pstRun->stMain, pstRun, szFileName, bRaw, qwFirst))
+		return false;
+	for (int32_t c = 0; c < pstRun->lChannels; c++)
+	{
+		pstRun->astTrue[c] = pstRun->stMain.stFresh;
+		if (!bDecoderSetup(&pstRun->astFrames[c], pstRun->dwChannelSamples))
+			return false;
+		pstRun->lFrames = c + 1;
+	}
+
+	// one chunk ahead for each thread while the last ones are stitched
+	pstRun->dwBlockWords = REC_BITS_WORDS(dwTimingMaxSymbols(&pstRun->astFrames[0].stTiming, pstRun->dwChannelSamples));
+	pstRun->lSlots = REDECODE_SLOTS * pstRun->lThreads;
+	for (int32_t i = 0; i < pstRun->lSlots; i++)
+	{
+		ST_CHUNK* pstChunk = &pstRun->astChunk[i];
+		size_t dwEntries = (size_t)g_lChunkBlocks * pstRun->lChannels;
+		pstChunk->pstSliced = (ST_SLICEDBLOCK*)malloc(dwEntries * sizeof(ST_SLICEDBLOCK));
+		pstChunk->pqwBits = (uint64_t*)malloc(dwEntries * pstRun->dwBlockWords * sizeof(uint64_t));
+		pstChunk->pstCarry = (ST_SLICECARRY*)malloc((dwEntries + pstRun->lChannels) * sizeof(ST_SLICECARRY));
+		pstChunk->bDone = false;
+		if (!pstChunk->pstSliced || !pstChunk->pqwBits || !pstChunk->pstCarry)
+		{
+			printf("No memory for %d chunks of %d blocks\n", pstRun->lSlots, g_lChunkBlocks);
+			return false;
+		}
+	}
+
+	if (g_bWriteFiles)
+		for (int32_t i = 0; i < pstRun->lChannels; i++)
+		{
+			char szPrefix[16] = "";
+			if (pstRun->lChannels > 1)
+				snprintf(szPrefix, sizeof(szPrefix), "adc%d_", i);
+			if (!bStreamWriterOpen(&pstRun->astWriter[i], g_bContainer, szPrefix, dFrameRate()))
+				return false;
+			pstRun->lWriters = i + 1;
+		}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vRedecodeClose
+**************************************************************************
+*/
+
+static void vRedecodeClose(ST_REDECODE* pstRun)
+{
+	for (int32_t i = 0; i < pstRun->lWriters; i++)
+		vStreamWriterClose(&pstRun->astWriter[i]);
+	for (int32_t i = 0; i < pstRun->lFrames; i++)
+		vDecoderClose(&pstRun->astFrames[i]);
+	for (int32_t i = 0; i < pstRun->lThreads; i++)
+		vSlicerClose(&pstRun->astSlicer[i]);
+	vSlicerClose(&pstRun->stMain);
+	for (int32_t i = 0; i < pstRun->lSlots; i++)
+	{
+		free(pstRun->astChunk[i].pstSliced);
+		free(pstRun->astChunk[i].pqwBits);
+		free(pstRun->astChunk[i].pstCarry);
+	}
+}
+
+
+
+/*
+**************************************************************************
+bRedecodeRun: workers slice ahead, the main thread stitches and demuxes
+the chunks in order
+**************************************************************************
+*/
+
+static bool bRedecodeRun(ST_REDECODE* pstRun)
+{
+	pstRun->llNext = 0;
+	pstRun->llStitched = 0;
+	pstRun->bStop = false;
+	for (int32_t i = 0; i < pstRun->lThreads; i++)
+		pstRun->aoWorker[i] = std::thread(vWorker, pstRun, i);
+
+	printf("\n");
+	printf("Decoded       Chunks    Average\n-------------------------------\n");
+
+	double dStart = dGetTime(), dLast = dStart;
+	bool bOk = true;
+	for (int64_t k = 0; bOk && k < pstRun->llChunks; k++)
+	{
+		ST_CHUNK* pstChunk = &pstRun->astChunk[k % pstRun->lSlots];
+		{
+			std::unique_lock<std::mutex> oGuard(pstRun->oLock);
+			pstRun->oDone.wait(oGuard, [pstChunk] { return pstChunk->bDone; });
+		}
+		if (!pstChunk->bOk)
+		{
+			printf("\nCan't read or slice the blocks from %lld on\n", (long long)pstChunk->llFirstBlock);
+			bOk = false;
+		}
+		else
+			bOk = bStitchChunk(pstRun, pstChunk) && bFramesChunk(pstRun, pstChunk);
+
+		// the slot is free for the chunk lSlots ahead
+		{
+			std::lock_guard<std::mutex> oGuard(pstRun->oLock);
+			pstChunk->bDone = false;
+			pstRun->llStitched = k + 1;
+			pstRun->oWork.notify_all();
+		}
+
+		double dNow = dGetTime();
+		if (dNow - dLast > 0.25)
+		{
+			double dDecoded = (double)(pstChunk->llFirstBlock + pstChunk->lBlocks) * pstRun->dwChannelSamples * pstRun->lChannels;
+			dLast = dNow;
+			printf("\r%8.1lf MS  %8lld   %6.1lf MS/s", dDecoded / 1.0e6, (long long)(k + 1), dDecoded / (dNow - dStart) / 1.0e6);
+			fflush(stdout);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> oGuard(pstRun->oLock);
+		pstRun->bStop = true;
+		pstRun->oWork.notify_all();
+	}
+	for (int32_t i = 0; i < pstRun->lThreads; i++)
+		pstRun->aoWorker[i].join();
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+vPrintReport
+**************************************************************************
+*/
+
+static void vPrintReport(ST_REDECODE* pstRun, double dTime)
+{
+	uint64_t qwStreamBytes = 0, qwStoredBytes = 0;
+	for (int32_t i = 0; i < pstRun->lWriters; i++)
+	{
+		qwStreamBytes += pstRun->astWriter[i].qwStreamBytes * REC_STREAM_NUM;
+		qwStoredBytes += pstRun->astWriter[i].qwStoredBytes;
+	}
+	double dSamples = (double)pstRun->llBlocks * pstRun->dwChannelSamples * pstRun->lChannels;
+	double dRate = (dTime > 0) ? dSamples / dTime : 0;
+	const ST_LOCK* pstLock = &pstRun->astFrames[0].stLock;
+
+	printf("\n\n");
+	printf("Blocks decoded:   %lld of %.0lf kByte in %lld chunks on %d threads\n", (long long)pstRun->llBlocks, (double)pstRun->dwBlockBytes / 1024,
+		(long long)pstRun->llChunks, pstRun->lThreads);
+	printf("Samples decoded:  %.1lf MS in %.3lf s\n", dSamples / 1.0e6, dTime);
+	printf("Sustained rate:   %.2lf MS/s, %.2lf x the recording\n", dRate / 1.0e6, dRate / (g_dSamplingRate * pstRun->lChannels));
+	printf("Seams:            %lld of %lld went on at once, %lld blocks sliced again\n", (long long)pstRun->llSeamsMatched, (long long)pstRun->llSeams,
+		(long long)pstRun->llResliced);
+	if (pstLock->dwInterval)
+		printf("Frame lock:       %llu sync words checked, %llu resyncs, %llu losses\n", (unsigned long long)pstLock->qwChecks, (unsigned long long)pstLock->qwResyncs, (unsigned long long)pstLock->qwLosses);
+	if (g_bContainer && qwStoredBytes)
+		printf("Container:        %.2lf of %.2lf MByte stream data, %.2lf x smaller\n", (double)qwStoredBytes / (1024 * 1024), (double)qwStreamBytes / (1024 * 1024), (double)qwStreamBytes / qwStoredBytes);
+}
+
+
+
+/*
+**************************************************************************
+main
+**************************************************************************
+*/
+
+int main(int argc, char** argv)
+{
+	const char*         szFileName = FILENAME REC_RAWFILE_EXT;
+	ST_RAWREADER        stReader;
+	bool                bRateSet = false, bChannelsSet = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			g_llNotifySize = (int64_t)(atof(argv[++i]) * 1024);
+		else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+		{
+			g_dSamplingRate = atof(argv[++i]) * 1.0e6;
+			bRateSet = true;
+		}
+		else if (!strcmp(argv[i], "-t") && (i + 1 < argc))
+			g_lThreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-chunk") && (i + 1 < argc))
+			g_lChunkBlocks = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-warm") && (i + 1 < argc))
+			g_llWarmSamples = (int64_t)(atof(argv[++i]) * 1024);
+		else if (!strcmp(argv[i], "-P") && (i + 1 < argc))
+			g_szPreamble = argv[++i];
+		else if (!strcmp(argv[i], "-e") && (i + 1 < argc))
+			g_lPreambleErrors = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-track"))
+			g_lThresholdMode = REC_THRESHOLD_TRACK;
+		else if (!strcmp(argv[i], "-hyst") && (i + 1 < argc))
+			g_dHysteresis = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-sps") && (i + 1 < argc))
+			g_dSamplesPerSymbol = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-sync") && (i + 1 < argc))
+			g_dwSyncInterval = (uint32_t)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-nowrite"))
+			g_bWriteFiles = false;
+		else if (!strcmp(argv[i], "-container"))
+			g_bContainer = true;
+		else if (!strcmp(argv[i], "-c") && (i + 1 < argc))
+		{
+			g_lChannels = atoi(argv[++i]);
+			bChannelsSet = true;
+		}
+		else if (!strcmp(argv[i], "-from") && (i + 1 < argc))
+			g_dFrom = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-len") && (i + 1 < argc))
+			g_dLen = atof(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			printf("usage: %s [-n notify kByte] [-s sampling rate MS/s] [-t threads] [-chunk blocks] [-warm kSamples] [-P preamble] [-e preamble errors] [-track] [-hyst counts] [-sps samples per symbol] [-sync frames] [-nowrite] [-container] [-c channels] [-from s] [-len s] [capture.rcap|capture.bin]\n", argv[0]);
+			return 1;
+		}
+		else
+			szFileName = argv[i];
+	}
+
+	// a raw capture knows its setup, the range is taken from it as in rec_replay
+	uint64_t qwFirst = 0, qwEnd = 0;
+	bool bRawCapture = bRawReaderProbe(szFileName);
+	if (bRawCapture)
+	{
+		if (!bRawReaderOpen(&stReader, szFileName))
+			return 1;
+		const ST_RAWSETUP* pstSetup = &stReader.stHead.stSetup;
+		if (!bRateSet && pstSetup->llSamplingRate > 0)
+			g_dSamplingRate = (double)pstSetup->llSamplingRate;
+		if (!bChannelsSet)
+			g_lChannels = pstSetup->lChannels;
+		qwFirst = qwRawReaderOffsetAt(&stReader, g_dFrom);
+		qwEnd = (g_dLen >= 0) ? qwRawReaderOffsetAt(&stReader, g_dFrom + g_dLen) : qwRawReaderLen(&stReader);
+		g_llStartTimeUs = stReader.stHead.llStartTimeUs;
+		vRawReaderClose(&stReader);
+	}
+	else if (g_dFrom > 0 || g_dLen >= 0)
+	{
+		printf("-from and -len need a raw capture with header\n");
+		return 1;
+	}
+	else
+	{
+		FILE* fp = fopen(szFileName, "rb");
+		if (!fp)
+		{
+			printf("Can't open %s\n", szFileName);
+			return 1;
+		}
+#if defined(_WIN32)
+		_fseeki64(fp, 0, SEEK_END);
+		qwEnd = (uint64_t)_ftelli64(fp);
+#else
+		fseeko(fp, 0, SEEK_END);
+		qwEnd = (uint64_t)ftello(fp);
+#endif
+		fclose(fp);
+	}
+
+	// notify blocks have to hold complete int16 samples of all channels
+	if (g_lChannels < 1 || g_lChannels > REC_MAX_ADC)
+	{
+		printf("Can decode 1 to %d channels\n", REC_MAX_ADC);
+		return 1;
+	}
+	g_llNotifySize -= g_llNotifySize % (int64_t)(sizeof(int16_t) * g_lChannels);
+	if (g_llNotifySize <= 0 || g_llNotifySize > 0x7fffffff || g_lChunkBlocks < 1 || g_llWarmSamples < 0)
+	{
+		printf("Invalid notify size, chunk or warm-up\n");
+		return 1;
+	}
+
+	// the card only delivers complete notify blocks
+	int64_t llBlocks = (int64_t)(qwEnd - qwFirst) / g_llNotifySize;
+	g_qwFirstSample = qwFirst / (sizeof(int16_t) * g_lChannels);
+	if (llBlocks == 0)
+	{
+		printf("%s is smaller than one notify block\n", szFileName);
+		return 1;
+	}
+
+	ST_REDECODE* pstRun = new (std::nothrow) ST_REDECODE();
+	if (!pstRun)
+	{
+		printf("No memory for the run\n");
+		return 1;
+	}
+	pstRun->lChannels = g_lChannels;
+	pstRun->dwBlockBytes = (uint32_t)g_llNotifySize;
+	pstRun->dwChannelSamples = (uint32_t)(g_llNotifySize / (sizeof(int16_t) * g_lChannels));
+	pstRun->llBlocks = llBlocks;
+	pstRun->llChunks = (llBlocks + g_lChunkBlocks - 1) / g_lChunkBlocks;
+
+	// a thread per core, no more than there are chunks
+	pstRun->lThreads = (g_lThreads > 0) ? g_lThreads : lRecCpuCount();
+	pstRun->lThreads = (pstRun->lThreads > REDECODE_MAX_THREADS) ? REDECODE_MAX_THREADS : (pstRun->lThreads < 1) ? 1 : pstRun->lThreads;
+	pstRun->lThreads = (pstRun->llChunks < pstRun->lThreads) ? (int32_t)pstRun->llChunks : pstRun->lThreads;
+
+	printf("%s: %lld blocks of %lld kByte, %lld chunks of %d blocks on %d threads, %.0lf kSamples warm-up\n", szFileName, (long long)llBlocks,
+		(long long)g_llNotifySize / 1024, (long long)pstRun->llChunks, g_lChunkBlocks, pstRun->lThreads, (double)g_llWarmSamples / 1024);
+
+	bool bOk = false;
+	double dTime = 0;
+	if (bRedecodeOpen(pstRun, szFileName, bRawCapture, qwFirst))
+	{
+		double dStart = dGetTime();
+		bOk = bRedecodeRun(pstRun);
+		dTime = dGetTime() - dStart;
+	}
+	vRedecodeClose(pstRun);
+	if (bOk)
+		vPrintReport(pstRun, dTime);
+	delete pstRun;
+
+	return bOk ? 0 : 1;
+}
@@ -0,0 +1,703 @@
+/*
+**************************************************************************
+
+rec_replay.cpp
+
+**************************************************************************
+
+Offline replay of a recorded raw capture (as written by rec_fifo_hd_speed)
+through the decoding chain. The capture is loaded to memory and handed to
+the work routine in notify sized blocks using a faked ST_BUFFERDATA, so
+the slicer, preamble search, demux and stream writing run as fast as the
+CPU allows. The sustained rate is compared against the sampling rate to
+show the headroom of the decoding.
+
+The slicer takes the window mean as its threshold as before, -track
+follows the threshold over the blocks (rec_threshold) with the
+hysteresis band of -hyst.
+With -sps the symbol clock is recovered from the signal (rec_timing)
+around the given samples per symbol, else a symbol is exactly
+REC_DOWN_SAMPLING_RATE samples. With -sync the headstage sends a sync
+word after every that many frames, the decoder checks the frame lock
+with it (rec_lock) and logs every resync to sync_log.csv. -container
+writes all streams compressed to one streams.rec (rec_writer), see
+rec_extract to read them back.
+
+A raw capture of the FIFO loop (.rcap, rec_rawwriter) is read with
+rec_rawreader, its header gives the sampling rate and the channels
+unless -s or -c are set, packed blocks are unpacked on loading. -from
+and -len select a range in seconds, only its blocks are read. Other
+files are taken as plain samples from the start to the end.
+
+With -pipe the blocks go through the threaded pipeline of the FIFO loop
+(rec_pipeline), the rate is then the one of the slowest stage. With -c
+the capture holds the samples of several analog channels interleaved,
+each channel is decoded to its own adcX_ streams (rec_multi). With
+-metrics the stage latencies and the block budget are dumped to the
+metrics files (rec_metrics) and summed up at the end. With -preview the
+envelope of every block goes to the live preview ring (rec_preview) for
+rec_view, as in the FIFO loop. With -check every block of every channel
+is sliced by the window slicer (vSlicerDo) and the original double
+precision slicer (vSlicerReference) before the replay, any difference
+fails the run. Blocks shorter than a threshold window are skipped, the
+reference can't slice them.
+
+Needs no card and no Windows, runs on any build machine.
+
+usage: rec_replay [-n notify kByte] [-s sampling rate MS/s] [-p passes] [-P preamble] [-e preamble errors] [-track] [-hyst counts] [-sps samples per symbol] [-sync frames] [-nowrite] [-container] [-pipe blocks] [-c channels] [-metrics] [-preview] [-check] [-from s] [-len s] [capture.rcap|capture.bin]
+**************************************************************************
+*/
+
+
+
+// ----- standard c include files -----
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+
+// ----- include of common example librarys -----
+#include "../common/spcm_lib_data.h"
+
+// ----- decoding chain -----
+#include "rec_multi.h"
+#include "rec_slicer.h"
+#include "rec_writer.h"
+#include "rec_pipeline.h"
+#include "rec_metrics.h"
+#include "rec_preview.h"
+#include "rec_rawreader.h"
+
+
+// ----- global setup for the run -----
+double  g_dSamplingRate = 20.0e6;
+int64_t g_llNotifySize = 1024 * 1024 * 16;
+int32_t g_lPasses = 1;
+bool    g_bWriteFiles = true;
+bool    g_bContainer = false;
+bool    g_bPipeline = false;
+int32_t g_lPipeBlocks = REC_PIPELINE_BLOCKS;
+int32_t g_lChannels = 1;
+bool    g_bMetrics = false;
+bool    g_bPreview = false;
+bool    g_bCheckSlicer = false;
+bool    g_bFailed = false;              // exit code 1
+const char* g_szPreamble = REC_PREAMBLE_DEFAULT;
+int32_t g_lPreambleErrors = 0;
+int32_t g_lThresholdMode = REC_THRESHOLD_WINDOW;
+double  g_dHysteresis = 0;
+double  g_dSamplesPerSymbol = 0;
+uint32_t g_dwSyncInterval = 0;
+double  g_dFrom = 0;
+double  g_dLen = -1;                    // to the end
+int64_t g_llStartTimeUs = 0;            // wall clock of the capture start, 0 for plain files
+uint64_t g_qwFirstSample = 0;           // of a channel, first one replayed
+
+#define FILENAME "500mVPP_500MHz_Squares"
+#define REPLAY_READ_BLOCK   (64 * 1024 * 1024)
+
+
+
+/*
+**************************************************************************
+Working routine data
+**************************************************************************
+*/
+
+struct ST_REPLAYDATA
+{
+	int64_t         llDecoded;
+	int64_t         llBlocks;
+	double          dStartTime;
+	double          dLastTime;
+	double          dDecodeTime;
+	ST_MULTIDECODER stDecoder;
+	ST_STREAMWRITER astWriter[REC_MAX_ADC];
+	int32_t         lWriters;
+	ST_PIPELINE     stPipe;
+	bool            bPipe;
+	ST_METRICS*     pstMetrics;
+	ST_PREVIEW      stPreview;
+	bool            bPreview;
+};
+
+static double dGetTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ----- wall clock of the block that ends with sample qwEnd of a channel, as rec_redecode dates it -----
+static int64_t llBlockTimeUs(uint64_t qwEnd)
+{
+	return g_llStartTimeUs + (int64_t)((g_qwFirstSample + qwEnd) * 1.0e6 / g_dSamplingRate);
+}
+
+// ----- frames per second, each stream gets one byte per frame; the sync words take their symbols too -----
+static double dFrameRate()
+{
+	double dSamplesPerSymbol = (g_dSamplesPerSymbol > 0) ? g_dSamplesPerSymbol : REC_DOWN_SAMPLING_RATE;
+	double dSymbols = REC_FRAME_SIZE + (g_dwSyncInterval ? (double)strlen(REC_LOCK_SYNC_DEFAULT) / g_dwSyncInterval : 0);
+	return g_dSamplingRate / (dSamplesPerSymbol * dSymbols);
+}
+
+
+
+/*
+**************************************************************************
+bReplayOutput: output stage of the pipeline
+**************************************************************************
+*/
+
+static bool bReplayOutput(void * pvWorkData, ST_PIPEBLOCK * pstBlock)
+{
+	ST_REPLAYDATA* pstWorkData = (ST_REPLAYDATA *)pvWorkData;
+
+	uint64_t qwTime = qwMetricsStart(pstWorkData->pstMetrics);
+	for (int32_t i = 0; i < pstWorkData->lWriters; i++)
+	{
+		ST_PIPESTREAMS* pstStreams = &pstBlock->astChannel[i];
+		if (pstStreams->dwStreamLen && !bStreamWriterAppend(&pstWorkData->astWriter[i], pstStreams->apbyStream, pstStreams->dwStreamLen, pstBlock->llTimeUs))
+			return false;
+		if (!bStreamWriterLog(&pstWorkData->astWriter[i], pstStreams->astEvent, pstStreams->dwEvents, g_dSamplingRate))
+			return false;
+	}
+	qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_STREAMS, qwTime);
+
+	if (pstWorkData->bPreview)
+	{
+		ST_PIPESTREAMS* pstStreams = &pstBlock->astChannel[0];
+		vPreviewPublish(&pstWorkData->stPreview, pstBlock->pnSamples, pstBlock->dwBytes / sizeof(int16_t),
+			pstStreams->bRecording ? pstStreams->apbyStream : NULL, pstStreams->dwStreamLen, pstBlock->llTimeUs);
+		qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_PREVIEW, qwTime);
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+Setup working routine
+**************************************************************************
+*/
+
+bool bReplayInit(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
+{
+	ST_REPLAYDATA* pstWorkData = (ST_REPLAYDATA *)pvWorkData;
+
+	pstWorkData->llDecoded = 0;
+	pstWorkData->llBlocks = 0;
+	pstWorkData->dDecodeTime = 0;
+	pstWorkData->dStartTime = pstWorkData->dLastTime = dGetTime();
+	pstWorkData->lWriters = 0;
+	pstWorkData->bPipe = false;
+	pstWorkData->pstMetrics = NULL;
+	pstWorkData->bPreview = false;
+
+	printf("\n");
+	printf("Decoded       Blocks    Average     Current\n-------------------------------------------\n");
+
+	if (!bMultiDecoderInit(&pstWorkData->stDecoder, g_lChannels, pstBufferData->dwDataNotify / sizeof(int16_t), g_szPreamble, g_lPreambleErrors))
+	{
+		printf("Invalid preamble setup or no memory for the decoder\n");
+		return false;
+	}
+	if (!bMultiDecoderSetThreshold(&pstWorkData->stDecoder, g_lThresholdMode, g_dHysteresis))
+	{
+		printf("Invalid slicer hysteresis %.1lf\n", g_dHysteresis);
+		return false;
+	}
+	if (g_dSamplesPerSymbol > 0 && !bMultiDecoderSetTiming(&pstWorkData->stDecoder, REC_TIMING_TRACK, g_dSamplesPerSymbol))
+	{
+		printf("Invalid symbol timing of %.2lf samples per symbol or no memory\n", g_dSamplesPerSymbol);
+		return false;
+	}
+	if (g_dwSyncInterval && !bMultiDecoderSetLock(&pstWorkData->stDecoder, g_dwSyncInterval))
+	{
+		printf("No memory for the frame lock\n");
+		return false;
+	}
+	// budget of a block is its time at the sampling rate
+	if (g_bMetrics)
+	{
+		pstWorkData->pstMetrics = pstMetricsStart("", REC_METRICS_PERIOD, pstBufferData->dwDataNotify / (sizeof(int16_t) * g_lChannels * g_dSamplingRate));
+		if (!pstWorkData->pstMetrics)
+			return false;
+		vMultiDecoderSetMetrics(&pstWorkData->stDecoder, pstWorkData->pstMetrics);
+	}
+	if (g_bWriteFiles)
+		for (int32_t i = 0; i < g_lChannels; i++)
+		{
+			char szPrefix[16];
+			if (!bStreamWriterOpen(&pstWorkData->astWriter[i], g_bContainer, pszMultiPrefix(&pstWorkData->stDecoder, i, szPrefix, sizeof(szPrefix)), dFrameRate()))
+				return false;
+			pstWorkData->lWriters = i + 1;
+		}
+	if (g_bPreview)
+	{
+		pstWorkData->bPreview = bPreviewOpen(&pstWorkData->stPreview, "", g_lChannels, g_dSamplingRate, dFrameRate());
+		if (!pstWorkData->bPreview)
+			printf("No shared memory for the live preview, going on without\n");
+	}
+
+	// decode and output on own threads, the replay loop only copies the blocks
+	if (g_bPipeline)
+	{
+		pstWorkData->bPipe = true;
+		if (!bPipelineStart(&pstWorkData->stPipe, &pstWorkData->stDecoder, bReplayOutput, pstWorkData, pstBufferData->dwDataNotify, g_lPipeBlocks))
+			return false;
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bReplayDo: decodes one block, same chain as bWorkDo of the FIFO loop
+**************************************************************************
+*/
+
+bool bReplayDo(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
+{
+	ST_REPLAYDATA* pstWorkData = (ST_REPLAYDATA *)pvWorkData;
+	uint32_t dwSamples = pstBufferData->dwDataNotify / sizeof(int16_t);
+	int64_t llTimeUs = llBlockTimeUs((uint64_t)(pstWorkData->llDecoded + dwSamples) / g_lChannels);
+
+	double dStart = dGetTime();
+	uint64_t qwBlockTime = qwMetricsStart(pstWorkData->pstMetrics);
+	if (pstWorkData->bPipe)
+	{
+		if (!bPipelinePush(&pstWorkData->stPipe, pstBufferData->pvDataCurrentBuf, pstBufferData->dwDataNotify, -1, -1, REC_GOVERN_FULL, llTimeUs))
+		{
+			printf("\nPipeline error\n");
+			return false;
+		}
+	}
+	else
+	{
+		if (!bMultiDecoderDo(&pstWorkData->stDecoder, (int16_t*)pstBufferData->pvDataCurrentBuf, dwSamples))
+		{
+			printf("\nDecoder error\n");
+			return false;
+		}
+		uint64_t qwTime = qwMetricsStart(pstWorkData->pstMetrics);
+		for (int32_t i = 0; i < pstWorkData->lWriters; i++)
+		{
+			ST_DECODER* pstDecoder = &pstWorkData->stDecoder.astDecoder[i];
+			if ((pstDecoder->dwStreamLen && !bStreamWriterAppend(&pstWorkData->astWriter[i], pstDecoder->apbyStream, pstDecoder->dwStreamLen, llTimeUs))
+				|| !bStreamWriterLog(&pstWorkData->astWriter[i], pstDecoder->stLock.astEvent, pstDecoder->stLock.dwEvents, g_dSamplingRate))
+			{
+				printf("\nStream write error\n");
+				return false;
+			}
+		}
+		qwTime = qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_STREAMS, qwTime);
+
+		if (pstWorkData->bPreview)
+		{
+			ST_DECODER* pstDecoder = &pstWorkData->stDecoder.astDecoder[0];
+			vPreviewPublish(&pstWorkData->stPreview, (int16_t*)pstBufferData->pvDataCurrentBuf, dwSamples,
+				pstDecoder->bRecording ? pstDecoder->apbyStream : NULL, pstDecoder->dwStreamLen, llTimeUs);
+			qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_PREVIEW, qwTime);
+		}
+	}
+	qwMetricsLap(pstWorkData->pstMetrics, REC_STAGE_BLOCK, qwBlockTime);
+	double dNow = dGetTime();
+
+	// the pipeline works while the blocks are pushed, so only the wall time counts
+	if (pstWorkData->bPipe)
+		pstWorkData->dDecodeTime = dNow - pstWorkData->dStartTime;
+	else
+		pstWorkData->dDecodeTime += dNow - dStart;
+	pstWorkData->llDecoded += dwSamples;
+	pstWorkData->llBlocks++;
+
+	// current status in MS/s
+	double dAverage = (double)pstWorkData->llDecoded / pstWorkData->dDecodeTime / 1.0e6;
+	double dCurrent = (double)dwSamples / (dNow - dStart) / 1.0e6;
+	if (dNow - pstWorkData->dLastTime > 0.25)
+	{
+		pstWorkData->dLastTime = dNow;
+		printf("\r%8.1lf MS  %8lld   %6.1lf MS/s   %6.1lf MS/s", (double)pstWorkData->llDecoded / 1.0e6, (long long)pstWorkData->llBlocks, dAverage, dCurrent);
+		fflush(stdout);
+	}
+
+	pstBufferData->llDataTransferred += pstBufferData->dwDataNotify;
+	pstBufferData->dwDataAvailBytes = pstBufferData->dwDataNotify;
+
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vReplayClose: final report
+**************************************************************************
+*/
+
+void vReplayClose(void * pvWorkData, ST_BUFFERDATA * pstBufferData)
+{
+	ST_REPLAYDATA* pstWorkData = (ST_REPLAYDATA *)pvWorkData;
+
+	// the blocks in the pipeline are decoded before the rate is taken
+	if (pstWorkData->bPipe)
+	{
+		if (!bPipelineStop(&pstWorkData->stPipe))
+			printf("\nPipeline error\n");
+		pstWorkData->dDecodeTime = dGetTime() - pstWorkData->dStartTime;
+	}
+	uint64_t qwStreamBytes = 0, qwStoredBytes = 0;
+	for (int32_t i = 0; i < pstWorkData->lWriters; i++)
+	{
+		vStreamWriterClose(&pstWorkData->astWriter[i]);
+		qwStreamBytes += pstWorkData->astWriter[i].qwStreamBytes * REC_STREAM_NUM;
+		qwStoredBytes += pstWorkData->astWriter[i].qwStoredBytes;
+	}
+	if (pstWorkData->pstMetrics)
+		vMetricsStop(pstWorkData->pstMetrics);
+	if (pstWorkData->bPreview)
+		vPreviewClose(&pstWorkData->stPreview);
+
+	size_t dwArenaUsed, dwArenaSize;
+	bool bArenaLocked;
+	vMultiDecoderArena(&pstWorkData->stDecoder, &dwArenaUsed, &dwArenaSize, &bArenaLocked);
+	ST_TIMING stTiming = pstWorkData->stDecoder.astDecoder[0].stTiming;
+	ST_LOCK stLock = pstWorkData->stDecoder.astDecoder[0].stLock;
+	vMultiDecoderClose(&pstWorkData->stDecoder);
+
+	if (pstWorkData->llBlocks == 0 || pstWorkData->dDecodeTime <= 0)
+	{
+		vMetricsFree(pstWorkData->pstMetrics);
+		return;
+	}
+
+	double dRate = (double)pstWorkData->llDecoded / pstWorkData->dDecodeTime;
+	printf("\n\n");
+	printf("Blocks decoded:   %lld of %.0lf kByte\n", (long long)pstWorkData->llBlocks, (double)pstBufferData->dwDataNotify / 1024);
+	printf("Samples decoded:  %.1lf MS in %.3lf s (wall %.3lf s)\n", (double)pstWorkData->llDecoded / 1.0e6, pstWorkData->dDecodeTime, dGetTime() - pstWorkData->dStartTime);
+	printf("Sustained rate:   %.2lf MS/s\n", dRate / 1.0e6);
+	printf("Headroom:         %.2lf x over %.2lf MS/s\n", dRate / g_dSamplingRate, g_dSamplingRate / 1.0e6);
+	if (pstWorkData->bPipe)
+		vPipelinePrintStats(&pstWorkData->stPipe, pstWorkData->dDecodeTime);
+	printf("Decoder arena:    %.2lf of %.2lf MByte used%s\n", (double)dwArenaUsed / (1024 * 1024), (double)dwArenaSize / (1024 * 1024), bArenaLocked ? ", locked" : "");
+	if (stTiming.lMode == REC_TIMING_TRACK && stTiming.qwTransitions)
+		printf("Symbol timing:    %.4lf samples per symbol (%+.1lf ppm), mean error %.3lf samples\n", stTiming.dPeriod, dTimingPpm(&stTiming), stTiming.dErrorSum / stTiming.qwTransitions);
+	if (stLock.dwInterval)
+		printf("Frame lock:       %llu sync words checked, %llu resyncs, %llu losses\n", (unsigned long long)stLock.qwChecks, (unsigned long long)stLock.qwResyncs, (unsigned long long)stLock.qwLosses);
+	if (g_bContainer && qwStoredBytes)
+		printf("Container:        %.2lf of %.2lf MByte stream data, %.2lf x smaller\n", (double)qwStoredBytes / (1024 * 1024), (double)qwStreamBytes / (1024 * 1024), (double)qwStreamBytes / qwStoredBytes);
+	if (pstWorkData->pstMetrics)
+	{
+		printf("\n");
+		vMetricsPrint(pstWorkData->pstMetrics);
+		vMetricsFree(pstWorkData->pstMetrics);
+	}
+}
+
+
+
+/*
+**************************************************************************
+pbyLoadCapture: whole capture in memory, disk speed doesn't count; a
+raw capture (rec_rawreader) from g_dFrom on, the blocks are unpacked
+**************************************************************************
+*/
+
+static uint8_t* pbyLoadCapture(const char* szFileName, ST_RAWREADER* pstReader, int64_t* pllLen)
+{
+	if (pstReader)
+	{
+		uint64_t qwFirst = qwRawReaderOffsetAt(pstReader, g_dFrom);
+		uint64_t qwEnd = (g_dLen >= 0) ? qwRawReaderOffsetAt(pstReader, g_dFrom + g_dLen) : qwRawReaderLen(pstReader);
+		g_llStartTimeUs = pstReader->stHead.llStartTimeUs;
+		g_qwFirstSample = qwFirst / (sizeof(int16_t) * g_lChannels);
+		*pllLen = (int64_t)(qwEnd - qwFirst);
+		uint8_t* pbyData = (uint8_t*)malloc((size_t)(*pllLen ? *pllLen : 1));
+		if (!pbyData)
+		{
+			printf("No memory for %.1lf MByte of %s\n", (double)*pllLen / (1024 * 1024), szFileName);
+			return NULL;
+		}
+		for (uint64_t qwPos = qwFirst; qwPos < qwEnd; )
+		{
+			uint32_t dwLen = (qwEnd - qwPos < REPLAY_READ_BLOCK) ? (uint32_t)(qwEnd - qwPos) : REPLAY_READ_BLOCK;
+			if (dwRawReaderRead(pstReader, qwPos, pbyData + (qwPos - qwFirst), dwLen) != dwLen)
+			{
+				free(pbyData);
+				return NULL;
+			}
+			qwPos += dwLen;
+		}
+		return pbyData;
+	}
+
+	FILE* fp = fopen(szFileName, "rb");
+	if (!fp)
+	{
+		printf("Can't open %s\n", szFileName);
+		return NULL;
+	}
+	// 64 bit file offsets, long has 32 bits on Windows
+#if defined(_WIN32)
+	_fseeki64(fp, 0, SEEK_END);
+	*pllLen = _ftelli64(fp);
+	_fseeki64(fp, 0, SEEK_SET);
+#else
+	fseeko(fp, 0, SEEK_END);
+	*pllLen = (int64_t)ftello(fp);
+	fseeko(fp, 0, SEEK_SET);
+#endif
+	if (*pllLen < 0)
+	{
+		printf("Can't get the length of %s\n", szFileName);
+		fclose(fp);
+		return NULL;
+	}
+
+	uint8_t* pbyData = (uint8_t*)malloc((size_t)(*pllLen ? *pllLen : 1));
+	if (!pbyData || fread(pbyData, 1, (size_t)*pllLen, fp) != (size_t)*pllLen)
+	{
+		printf("Can't load %.1lf MByte of %s\n", (double)*pllLen / (1024 * 1024), szFileName);
+		free(pbyData);
+		pbyData = NULL;
+	}
+	fclose(fp);
+	return pbyData;
+}
+
+
+
+/*
+**************************************************************************
+bCheckSlicer: window slicer against the reference slicer on each block
+of each channel, without the carry between the blocks
+**************************************************************************
+*/
+
+static bool bCheckSlicer(const uint8_t* pbyData, int64_t llBlocks)
+{
+	uint32_t dwBlockSamples = (uint32_t)(g_llNotifySize / (sizeof(int16_t) * g_lChannels));
+	uint32_t dwSymbols = dwBlockSamples / REC_DOWN_SAMPLING_RATE;
+	int16_t* pnChannel = (int16_t*)malloc(((size_t)dwBlockSamples + 1) * sizeof(int16_t));
+	int16_t* pnRef = (int16_t*)malloc(((size_t)dwSymbols + 1) * sizeof(int16_t));
+	uint64_t* pqwBits = (uint64_t*)malloc(REC_BITS_WORDS(dwSymbols) * sizeof(uint64_t));
+	if (!pnChannel || !pnRef || !pqwBits)
+	{
+		printf("No memory for the slicer check\n");
+		free(pnChannel);
+		free(pnRef);
+		free(pqwBits);
+		return false;
+	}
+
+	uint64_t qwDiffer = 0;
+	int64_t llBlocksDiffer = 0, llSkipped = 0;
+	for (int64_t llBlock = 0; llBlock < llBlocks; llBlock++)
+	{
+		const int16_t* pnBlock = (const int16_t*)(pbyData + llBlock * g_llNotifySize);
+		uint32_t dwBlockDiffer = 0;
+		for (int32_t c = 0; c < g_lChannels; c++)
+		{
+			uint32_t dwDiffer;
+			vMultiDeinterleave(pnBlock, dwBlockSamples, g_lChannels, c, pnChannel);
+			if (bSlicerCompare(pnChannel, dwSymbols, dwBlockSamples, pnRef, pqwBits, &dwDiffer))
+				dwBlockDiffer += dwDiffer;
+			else
+				llSkipped++;
+		}
+		if (dwBlockDiffer && llBlocksDiffer++ == 0)
+			printf("Slicer check: block %lld has %u symbols that differ from the reference slicer\n", (long long)llBlock, dwBlockDiffer);
+		qwDiffer += dwBlockDiffer;
+	}
+	free(pnChannel);
+	free(pnRef);
+	free(pqwBits);
+
+	uint64_t qwSymbols = (uint64_t)(llBlocks * g_lChannels - llSkipped) * dwSymbols;
+	if (llSkipped)
+		printf("Slicer check: %lld channel blocks skipped, their %u symbols are shorter than a threshold window of %d\n",
+			(long long)llSkipped, dwSymbols, REC_LOOKING_WINDOW_SIZE);
+	if (qwDiffer)
+	{
+		printf("Slicer check: %llu of %llu symbols in %lld blocks differ from the reference slicer\n",
+			(unsigned long long)qwDiffer, (unsigned long long)qwSymbols, (long long)llBlocksDiffer);
+		return false;
+	}
+	if (qwSymbols)
+		printf("Slicer check: %llu symbols, all match the reference slicer\n", (unsigned long long)qwSymbols);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vDoReplayLoop: feeds the capture block wise to the work routines
+**************************************************************************
+*/
+
+void vDoReplayLoop(
+	ST_BUFFERDATA*  pstBufferData,
+	void*           pvWorkData,
+	bool (*bWorkInit) (void*, ST_BUFFERDATA*),
+	bool (*bWorkDo) (void*, ST_BUFFERDATA*),
+	void (*vWorkClose) (void*, ST_BUFFERDATA*),
+	const char*     szFileName,
+	ST_RAWREADER*   pstReader)
+{
+	int64_t llRawLen;
+	uint8_t* pbyData = pbyLoadCapture(szFileName, pstReader, &llRawLen);
+	if (!pbyData)
+		return;
+
+	// the card only delivers complete notify blocks
+	int64_t llBlocks = llRawLen / (int64_t)g_llNotifySize;
+	if (llBlocks == 0)
+	{
+		printf("%s is smaller than one notify block\n", szFileName);
+		free(pbyData);
+		return;
+	}
+	int64_t llDataLen = llBlocks * g_llNotifySize;
+
+	printf("%s: %lld blocks of %lld kByte, %d pass(es)\n", szFileName, (long long)llBlocks, (long long)g_llNotifySize / 1024, g_lPasses);
+	if (g_bCheckSlicer && !bCheckSlicer(pbyData, llBlocks))
+		g_bFailed = true;
+
+	// the faked buffer is capped to whole notify blocks below 4 GByte like the card library buffer, the blocks come from the whole capture
+	int64_t llBufferMax = (int64_t)0xFFFFFFFF - (int64_t)0xFFFFFFFF % g_llNotifySize;
+	pstBufferData->dwDataBufLen = (uint32)((llDataLen < llBufferMax) ? llDataLen : llBufferMax);
+	pstBufferData->dwDataNotify = (uint32)g_llNotifySize;
+	if (bWorkInit(pvWorkData, pstBufferData))
+	{
+		bool bOk = true;
+		for (int32_t lPass = 0; bOk && lPass < g_lPasses; lPass++)
+			for (int64_t llBlock = 0; bOk && llBlock < llBlocks; llBlock++)
+			{
+				pstBufferData->pvDataCurrentBuf = pbyData + llBlock * g_llNotifySize;
+				bOk = bWorkDo(pvWorkData, pstBufferData);
+			}
+	}
+	vWorkClose(pvWorkData, pstBufferData);
+
+	free(pbyData);
+}
+
+
+
+/*
+**************************************************************************
+main
+**************************************************************************
+*/
+
+int main(int argc, char** argv)
+{
+	ST_BUFFERDATA       stBufferData;       // faked buffer definitions
+	ST_REPLAYDATA       stWorkData;         // work data for the working functions
+	const char*         szFileName = FILENAME REC_RAWFILE_EXT;
+	ST_RAWREADER        stReader;
+	bool                bRateSet = false, bChannelsSet = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			g_llNotifySize = (int64_t)(atof(argv[++i]) * 1024);
+		else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+		{
+			g_dSamplingRate = atof(argv[++i]) * 1.0e6;
+			bRateSet = true;
+		}
+		else if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+			g_lPasses = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-P") && (i + 1 < argc))
+			g_szPreamble = argv[++i];
+		else if (!strcmp(argv[i], "-e") && (i + 1 < argc))
+			g_lPreambleErrors = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-track"))
+			g_lThresholdMode = REC_THRESHOLD_TRACK;
+		else if (!strcmp(argv[i], "-hyst") && (i + 1 < argc))
+			g_dHysteresis = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-sps") && (i + 1 < argc))
+			g_dSamplesPerSymbol = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-sync") && (i + 1 < argc))
+			g_dwSyncInterval = (uint32_t)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-nowrite"))
+			g_bWriteFiles = false;
+		else if (!strcmp(argv[i], "-container"))
+			g_bContainer = true;
+		else if (!strcmp(argv[i], "-pipe") && (i + 1 < argc))
+		{
+			g_bPipeline = true;
+			g_lPipeBlocks = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-c") && (i + 1 < argc))
+		{
+			g_lChannels = atoi(argv[++i]);
+			bChannelsSet = true;
+		}
+		else if (!strcmp(argv[i], "-from") && (i + 1 < argc))
+			g_dFrom = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-len") && (i + 1 < argc))
+			g_dLen = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-metrics"))
+			g_bMetrics = true;
+		else if (!strcmp(argv[i], "-preview"))
+			g_bPreview = true;
+		else if (!strcmp(argv[i], "-check"))
+			g_bCheckSlicer = true;
+		else if (argv[i][0] == '-')
+		{
+			printf("usage: %s [-n notify kByte] [-s sampling rate MS/s] [-p passes] [-P preamble] [-e preamble errors] [-track] [-hyst counts] [-sps samples per symbol] [-sync frames] [-nowrite] [-container] [-pipe blocks] [-c channels] [-metrics] [-preview] [-check] [-from s] [-len s] [capture.rcap|capture.bin]\n", argv[0]);
+			return 1;
+		}
+		else
+			szFileName = argv[i];
+	}
+
+	// a raw capture knows its setup
+	bool bRawCapture = bRawReaderProbe(szFileName);
+	if (bRawCapture)
+	{
+		if (!bRawReaderOpen(&stReader, szFileName))
+			return 1;
+		const ST_RAWSETUP* pstSetup = &stReader.stHead.stSetup;
+		if (!bRateSet && pstSetup->llSamplingRate > 0)
+			g_dSamplingRate = (double)pstSetup->llSamplingRate;
+		if (!bChannelsSet)
+			g_lChannels = pstSetup->lChannels;
+		printf("%s: %.2lf MS/s, %d channel(s) of mask %llx, %llu blocks%s, %.1lf MByte raw\n", szFileName, (double)pstSetup->llSamplingRate / 1.0e6,
+			pstSetup->lChannels, (unsigned long long)pstSetup->qwChannelMask, (unsigned long long)stReader.qwBlocks,
+			stReader.bIndexed ? "" : " (no index, the recording was not closed)", (double)qwRawReaderLen(&stReader) / (1024 * 1024));
+	}
+	else if (g_dFrom > 0 || g_dLen >= 0)
+	{
+		printf("-from and -len need a raw capture with header\n");
+		return 1;
+	}
+
+	// notify blocks have to hold complete int16 samples of all channels
+	if (g_lChannels < 1 || g_lChannels > REC_MAX_ADC)
+	{
+		printf("Can decode 1 to %d channels\n", REC_MAX_ADC);
+		return 1;
+	}
+	g_llNotifySize -= g_llNotifySize % (int64_t)(sizeof(int16_t) * g_lChannels);
+	if (g_llNotifySize <= 0 || g_llNotifySize > 0x7fffffff || g_lPasses < 1)
+	{
+		printf("Invalid notify size or passes\n");
+		return 1;
+	}
+
+	memset(&stBufferData, 0, sizeof(stBufferData));
+	stBufferData.pstCard = NULL;
+
+	vDoReplayLoop(&stBufferData, &stWorkData, bReplayInit, bReplayDo, vReplayClose, szFileName, bRawCapture ? &stReader : NULL);
+	if (bRawCapture)
+		vRawReaderClose(&stReader);
+
+	return g_bFailed ? 1 : 0;
+}
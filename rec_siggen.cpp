@@ -0,0 +1,176 @@
+/*
+**************************************************************************
+
+rec_siggen.cpp
+
+**************************************************************************
+
+Synthetic ADC signal of the headstage line code, see rec_siggen.h
+
+**************************************************************************
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "rec_siggen.h"
+
+
+
+static inline uint64_t qwSplitMix(uint64_t qwValue)
+{
+	qwValue += 0x9e3779b97f4a7c15ULL;
+	qwValue = (qwValue ^ (qwValue >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	qwValue = (qwValue ^ (qwValue >> 27)) * 0x94d049bb133111ebULL;
+	return qwValue ^ (qwValue >> 31);
+}
+
+// ----- noise with unit rms: sum of 4 uniform numbers of 16 bit, rms of the sum is sqrt(4 / 12) -----
+static inline double dUnitNoise(uint64_t* pqwState)
+{
+	uint64_t qwRandom = qwSplitMix((*pqwState)++);
+	int32_t lSum = 0;
+	for (int32_t i = 0; i < 4; i++)
+		lSum += (int32_t)((qwRandom >> (16 * i)) & 0xffff) - 32768;
+	return (double)lSum / 65536.0 * 1.7320508075688772;
+}
+
+
+
+/*
+**************************************************************************
+vSigGenDefaultSetup
+**************************************************************************
+*/
+
+void vSigGenDefaultSetup(ST_SIGGENSETUP* pstSetup)
+{
+	pstSetup->dSamplesPerSymbol = REC_DOWN_SAMPLING_RATE;
+	pstSetup->dClockPpm = 0;
+	pstSetup->dAmplitude = 3000;
+	pstSetup->dNoise = 300;
+	pstSetup->dDriftAmplitude = 0;
+	pstSetup->dDriftPeriod = 1.0e6;
+	pstSetup->dwLeadSymbols = 1000;
+	pstSetup->szPreamble = REC_PREAMBLE_DEFAULT;
+	pstSetup->dwSyncInterval = 0;
+	pstSetup->szSync = REC_LOCK_SYNC_DEFAULT;
+	pstSetup->dwSlipPeriod = 0;
+	pstSetup->qwSeed = 1;
+}
+
+
+
+/*
+**************************************************************************
+bSigGenInit
+**************************************************************************
+*/
+
+bool bSigGenInit(ST_SIGGEN* pstGen, const ST_SIGGENSETUP* pstSetup)
+{
+	memset(pstGen, 0, sizeof(*pstGen));
+	pstGen->stSetup = *pstSetup;
+	if (pstSetup->dSamplesPerSymbol < 1.0 || pstSetup->dDriftPeriod <= 0)
+		return false;
+
+	for (const char* pc = pstSetup->szPreamble; *pc; pc++)
+	{
+		if ((*pc != '0' && *pc != '1') || pstGen->dwPreambleLen >= REC_PREAMBLE_MAX_BITS)
+			return false;
+		pstGen->abyPreamble[pstGen->dwPreambleLen++] = (uint8_t)(*pc - '0');
+	}
+	for (const char* pc = pstSetup->szSync; pstSetup->dwSyncInterval && *pc; pc++)
+	{
+		if ((*pc != '0' && *pc != '1') || pstGen->dwSyncLen >= REC_LOCK_MAX_BITS)
+			return false;
+		pstGen->abySync[pstGen->dwSyncLen++] = (uint8_t)(*pc - '0');
+	}
+
+	// integer symbols are cut exactly, the double path would round a few symbols to the neighbour
+	if (pstSetup->dClockPpm == 0 && pstSetup->dSamplesPerSymbol == floor(pstSetup->dSamplesPerSymbol))
+		pstGen->lIntSamplesPerSymbol = (int32_t)pstSetup->dSamplesPerSymbol;
+	pstGen->dSymbolsPerSample = (1.0 + pstSetup->dClockPpm * 1.0e-6) / pstSetup->dSamplesPerSymbol;
+	pstGen->qwNoiseState = qwSplitMix(pstSetup->qwSeed ^ 0x6e6f697365ULL);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bySigGenStreamByte, dwSigGenSymbol
+**************************************************************************
+*/
+
+uint8_t bySigGenStreamByte(uint64_t qwSeed, uint64_t qwFrame, int32_t lStream)
+{
+	return (uint8_t)qwSplitMix(qwSeed * 0x100000001b3ULL + qwFrame * REC_STREAM_NUM + lStream);
+}
+
+uint32_t dwSigGenSymbol(const ST_SIGGEN* pstGen, uint64_t qwSymbol)
+{
+	if (pstGen->stSetup.dwSlipPeriod)
+		qwSymbol += qwSymbol / pstGen->stSetup.dwSlipPeriod;
+	if (qwSymbol < pstGen->stSetup.dwLeadSymbols)
+		return (uint32_t)(qwSplitMix(pstGen->stSetup.qwSeed ^ (qwSymbol << 8)) & 1);
+	qwSymbol -= pstGen->stSetup.dwLeadSymbols;
+	if (qwSymbol < pstGen->dwPreambleLen)
+		return pstGen->abyPreamble[qwSymbol];
+	qwSymbol -= pstGen->dwPreambleLen;
+
+	// the sync word behind every dwSyncInterval frames
+	uint64_t qwFrame = qwSymbol / REC_FRAME_SIZE;
+	if (pstGen->dwSyncLen)
+	{
+		uint64_t qwFrames = (uint64_t)pstGen->stSetup.dwSyncInterval * REC_FRAME_SIZE;
+		uint64_t qwPos = qwSymbol % (qwFrames + pstGen->dwSyncLen);
+		if (qwPos >= qwFrames)
+			return pstGen->abySync[qwPos - qwFrames];
+		qwFrame = qwSymbol / (qwFrames + pstGen->dwSyncLen) * pstGen->stSetup.dwSyncInterval + qwPos / REC_FRAME_SIZE;
+		qwSymbol = qwPos;
+	}
+
+	// frame: channel by channel, bit by bit from the MSB, the rats interleaved
+	int32_t lPos = (int32_t)(qwSymbol % REC_FRAME_SIZE);
+	int32_t lChannel = lPos / REC_BITS_NUM;
+	int32_t lBit = (lPos % REC_BITS_NUM) / REC_SUBJECT_NUM;
+	int32_t lRat = lPos % REC_SUBJECT_NUM;
+	uint8_t byValue = bySigGenStreamByte(pstGen->stSetup.qwSeed, qwFrame, lChannel * REC_SUBJECT_NUM + lRat);
+	return (byValue >> (7 - lBit)) & 1;
+}
+
+
+
+/*
+**************************************************************************
+vSigGenDo
+**************************************************************************
+*/
+
+void vSigGenDo(ST_SIGGEN* pstGen, int16_t* pnOut, uint32_t dwSamples)
+{
+	const ST_SIGGENSETUP* pstSetup = &pstGen->stSetup;
+	const double dDriftStep = 2.0 * 3.14159265358979323846 / pstSetup->dDriftPeriod;
+
+	for (uint32_t i = 0; i < dwSamples; i++, pstGen->qwSample++)
+	{
+		uint64_t qwSymbol;
+		if (pstGen->lIntSamplesPerSymbol > 0)
+			qwSymbol = pstGen->qwSample / pstGen->lIntSamplesPerSymbol;
+		else
+			qwSymbol = (uint64_t)((double)pstGen->qwSample * pstGen->dSymbolsPerSample);
+
+		double dValue = dwSigGenSymbol(pstGen, qwSymbol) ? pstSetup->dAmplitude : -pstSetup->dAmplitude;
+		if (pstSetup->dDriftAmplitude != 0)
+			dValue += pstSetup->dDriftAmplitude * sin(dDriftStep * (double)pstGen->qwSample);
+		if (pstSetup->dNoise != 0)
+			dValue += pstSetup->dNoise * dUnitNoise(&pstGen->qwNoiseState);
+
+		if (dValue > 32767)
+			dValue = 32767;
+		if (dValue < -32768)
+			dValue = -32768;
+		pnOut[i] = (int16_t)lrint(dValue);
+	}
+}
@@ -0,0 +1,85 @@
+/*
+**************************************************************************
+
+rec_siggen.h
+
+**************************************************************************
+
+Synthetic ADC signal of the headstage line code, for benchmarks and
+for checking the decoder without a card:
+
+	lead        random symbols, the decoder has to find the preamble
+	preamble    REC_PREAMBLE_DEFAULT or any other pattern
+	frames      REC_FRAME_SIZE symbols each, the byte of stream s in
+	            frame f is bySigGenStreamByte(seed, f, s)
+	sync        with dwSyncInterval > 0 the sync word szSync follows
+	            every dwSyncInterval frames (rec_lock)
+
+Each symbol is dSamplesPerSymbol ADC samples of +-dAmplitude with a DC
+drift (sine of dDriftAmplitude and dDriftPeriod samples) and noise of
+dNoise rms. A symbol clock off by dClockPpm stretches or shrinks the
+symbols against the nominal rate.
+With dwSlipPeriod > 0 one symbol of the line is left out after every
+dwSlipPeriod symbols, every later frame is shifted as by a symbol the
+receiver missed.
+
+The output only depends on the setup and the seed: the random numbers
+are integer only (splitmix64) and the noise is the sum of four uniform
+numbers, so a run gives the same samples on every machine.
+**************************************************************************
+*/
+
+#ifndef REC_SIGGEN_H
+#define REC_SIGGEN_H
+
+#include <stdint.h>
+
+#include "rec_decoder.h"
+
+
+struct ST_SIGGENSETUP
+{
+	double      dSamplesPerSymbol;  // REC_DOWN_SAMPLING_RATE on the real line
+	double      dClockPpm;          // symbol clock offset
+	double      dAmplitude;         // of a symbol, ADC counts
+	double      dNoise;             // rms, ADC counts
+	double      dDriftAmplitude;    // DC drift, ADC counts
+	double      dDriftPeriod;       // DC drift, samples
+	uint32_t    dwLeadSymbols;      // random symbols before the preamble
+	const char* szPreamble;
+	uint32_t    dwSyncInterval;     // frames between the sync words, 0 for none
+	const char* szSync;
+	uint32_t    dwSlipPeriod;       // symbols between the left out ones, 0 for none
+	uint64_t    qwSeed;
+};
+
+struct ST_SIGGEN
+{
+	ST_SIGGENSETUP  stSetup;
+	uint8_t         abyPreamble[REC_PREAMBLE_MAX_BITS];
+	uint32_t        dwPreambleLen;
+	uint8_t         abySync[REC_LOCK_MAX_BITS];
+	uint32_t        dwSyncLen;
+	int32_t         lIntSamplesPerSymbol;   // > 0 if the symbols are exactly that long
+	double          dSymbolsPerSample;
+	uint64_t        qwSample;               // next sample
+	uint64_t        qwNoiseState;
+};
+
+
+// ----- setup of the real line: 10 samples per symbol, default preamble, no drift, no sync words -----
+void vSigGenDefaultSetup(ST_SIGGENSETUP* pstSetup);
+
+// ----- false if the setup is invalid -----
+bool bSigGenInit(ST_SIGGEN* pstGen, const ST_SIGGENSETUP* pstSetup);
+
+// ----- next dwSamples samples of the signal -----
+void vSigGenDo(ST_SIGGEN* pstGen, int16_t* pnOut, uint32_t dwSamples);
+
+// ----- the byte of a stream in a frame, what the decoder has to deliver -----
+uint8_t bySigGenStreamByte(uint64_t qwSeed, uint64_t qwFrame, int32_t lStream);
+
+// ----- symbol qwSymbol of the line: lead, preamble, frames and sync words -----
+uint32_t dwSigGenSymbol(const ST_SIGGEN* pstGen, uint64_t qwSymbol);
+
+#endif
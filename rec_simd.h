@@ -0,0 +1,35 @@
+/*
+**************************************************************************
+
+rec_simd.h
+
+**************************************************************************
+
+Instruction set selection for the decoding kernels. The kernels use AVX2
+if the compiler targets it (gcc/clang -mavx2, MSVC /arch:AVX2), else SSE2
+which every x64 CPU has, and a plain C version on anything else.
+**************************************************************************
+*/
+
+#ifndef REC_SIMD_H
+#define REC_SIMD_H
+
+#if defined(__AVX2__)
+	#define REC_SIMD_AVX2
+	#define REC_SIMD_SSE2
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define REC_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
+// ----- name of the compiled kernel set, for the status output -----
+#if defined(REC_SIMD_AVX2)
+	#define REC_SIMD_NAME "AVX2"
+#elif defined(REC_SIMD_SSE2)
+	#define REC_SIMD_NAME "SSE2"
+#else
+	#define REC_SIMD_NAME "scalar"
+#endif
+
+#endif
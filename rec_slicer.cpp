@@ -0,0 +1,495 @@
+/*
+**************************************************************************
+
+rec_slicer.cpp
+
+**************************************************************************
+
+Slicer of the decoder, see rec_slicer.h
+
+The decisions leave the slicer packed, 64 symbols per word (rec_bits.h).
+
+The threshold window starts at a symbol boundary and covers whole symbols,
+so its sum is the sum of the symbol sums. Each sample is read once: the
+symbol sums of one window go to a small buffer, the window sum is added
+up from it and then the symbols are decided against it.
+
+avg10 >= avg2000 of the reference slicer is exactly 200 * sum10 >= sum2000
+in integers: both doubles are correctly rounded and two different
+quotients are at least 1/2000 apart, far above the rounding error of
+values below 32768.
+**************************************************************************
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "rec_simd.h"
+#include "rec_slicer.h"
+
+#if (REC_DOWN_SAMPLING_RATE != 10)
+	#error the SIMD symbol sums are written for 10 samples per symbol
+#endif
+
+#define SUMS_BLOCK          8   // symbols per AVX2 step
+#define TRACK_GROUP         16  // symbols per threshold step of vSlicerTrack
+
+
+
+/*
+**************************************************************************
+vSlicerSymbolSums: int16 horizontal adds in SIMD, scalar fallback
+**************************************************************************
+*/
+
+void vSlicerSymbolSums(const int16_t* pnData, int32_t* plSums, uint32_t dwSymbols)
+{
+	uint32_t i = 0;
+
+#if defined(REC_SIMD_AVX2)
+	// one unaligned load per symbol, the madd mask keeps its 10 samples: pairs 0..3 in
+	// the low and pair 4 in the high 128 bit lane, two hadd levels reduce 4 symbols per lane
+	const __m256i mask = _mm256_setr_epi16(1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0);
+
+	// the load of the last symbol reaches 6 samples into the next one
+	for (; i + SUMS_BLOCK < dwSymbols; i += SUMS_BLOCK)
+	{
+		const int16_t* pnSrc = pnData + (size_t)i * REC_DOWN_SAMPLING_RATE;
+		__m256i v[SUMS_BLOCK];
+		for (int k = 0; k < SUMS_BLOCK; k++)
+			v[k] = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)(pnSrc + REC_DOWN_SAMPLING_RATE * k)), mask);
+
+		__m256i a = _mm256_hadd_epi32(_mm256_hadd_epi32(v[0], v[1]), _mm256_hadd_epi32(v[2], v[3]));
+		__m256i b = _mm256_hadd_epi32(_mm256_hadd_epi32(v[4], v[5]), _mm256_hadd_epi32(v[6], v[7]));
+		__m256i sums = _mm256_add_epi32(_mm256_permute2x128_si256(a, b, 0x20), _mm256_permute2x128_si256(a, b, 0x31));
+		_mm256_storeu_si256((__m256i*)(plSums + i), sums);
+	}
+#elif defined(REC_SIMD_SSE2)
+	// samples 0..7 and 8..9 of a symbol as two madd, a 4x4 transpose adds up 4 symbols
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i mask = _mm_setr_epi16(1, 1, 0, 0, 0, 0, 0, 0);
+
+	// the second load of the last symbol reaches 6 samples into the next one
+	for (; i + 4 < dwSymbols; i += 4)
+	{
+		const int16_t* pnSrc = pnData + (size_t)i * REC_DOWN_SAMPLING_RATE;
+		__m128i v[4];
+		for (int k = 0; k < 4; k++)
+			v[k] = _mm_add_epi32(
+				_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(pnSrc + REC_DOWN_SAMPLING_RATE * k)), ones),
+				_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(pnSrc + REC_DOWN_SAMPLING_RATE * k + 8)), mask));
+
+		__m128i u01 = _mm_add_epi32(_mm_unpacklo_epi32(v[0], v[1]), _mm_unpackhi_epi32(v[0], v[1]));
+		__m128i u23 = _mm_add_epi32(_mm_unpacklo_epi32(v[2], v[3]), _mm_unpackhi_epi32(v[2], v[3]));
+		_mm_storeu_si128((__m128i*)(plSums + i), _mm_add_epi32(_mm_unpacklo_epi64(u01, u23), _mm_unpackhi_epi64(u01, u23)));
+	}
+#endif
+
+	// scalar fallback and tail
+	for (; i < dwSymbols; i++)
+	{
+		const int16_t* pnSrc = pnData + (size_t)i * REC_DOWN_SAMPLING_RATE;
+		int32_t lSum = 0;
+		for (int m = 0; m < REC_DOWN_SAMPLING_RATE; m++)
+			lSum += pnSrc[m];
+		plSums[i] = lSum;
+	}
+}
+
+
+
+/*
+**************************************************************************
+bit writer for the packed decisions
+**************************************************************************
+*/
+
+struct ST_BITWRITER
+{
+	uint64_t*   pqwDst;
+	uint64_t    qwAcc;
+	int32_t     lAccBits;
+};
+
+// ----- appends up to 32 decisions, the first one in bit 0 -----
+static inline void vPutBits(ST_BITWRITER* pstWriter, uint64_t qwBits, int32_t lCount)
+{
+	pstWriter->qwAcc |= qwBits << pstWriter->lAccBits;
+	pstWriter->lAccBits += lCount;
+	if (pstWriter->lAccBits >= 64)
+	{
+		*pstWriter->pqwDst++ = pstWriter->qwAcc;
+		pstWriter->lAccBits -= 64;
+		pstWriter->qwAcc = pstWriter->lAccBits ? (qwBits >> (lCount - pstWriter->lAccBits)) : 0;
+	}
+}
+
+
+
+/*
+**************************************************************************
+vSlicerDecide: symbol sum >= threshold to packed bits
+**************************************************************************
+*/
+
+static void vSlicerDecide(const int32_t* plSums, int32_t lLen, int32_t lThreshold, ST_BITWRITER* pstWriter)
+{
+	int32_t k = 0;
+
+#if defined(REC_SIMD_AVX2)
+	const __m256i th = _mm256_set1_epi32(lThreshold - 1);
+	for (; k + 16 <= lLen; k += 16)
+	{
+		uint32_t dwLo = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(plSums + k)), th)));
+		uint32_t dwHi = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(plSums + k + 8)), th)));
+		vPutBits(pstWriter, dwLo | (dwHi << 8), 16);
+	}
+#elif defined(REC_SIMD_SSE2)
+	const __m128i th = _mm_set1_epi32(lThreshold - 1);
+	for (; k + 8 <= lLen; k += 8)
+	{
+		uint32_t dwLo = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(plSums + k)), th)));
+		uint32_t dwHi = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(plSums + k + 4)), th)));
+		vPutBits(pstWriter, dwLo | (dwHi << 4), 8);
+	}
+#endif
+
+	for (; k < lLen; k++)
+		vPutBits(pstWriter, plSums[k] >= lThreshold, 1);
+}
+
+
+
+/*
+**************************************************************************
+vInputSums: symbol sums of the stitched and the in place part, or the
+ones of the timing recovery
+**************************************************************************
+*/
+
+static void vInputSums(const ST_SLICERINPUT* pstInput, uint32_t dwFirst, int32_t* plSums, uint32_t dwSymbols)
+{
+	if (pstInput->plSums)
+	{
+		memcpy(plSums, pstInput->plSums + dwFirst, dwSymbols * sizeof(int32_t));
+		return;
+	}
+
+	uint32_t dwHead = 0;
+	if (dwFirst < pstInput->dwStitchSymbols)
+	{
+		dwHead = pstInput->dwStitchSymbols - dwFirst;
+		if (dwHead > dwSymbols)
+			dwHead = dwSymbols;
+		vSlicerSymbolSums(pstInput->pnStitch + (size_t)dwFirst * REC_DOWN_SAMPLING_RATE, plSums, dwHead);
+		dwFirst += dwHead;
+	}
+	if (dwSymbols > dwHead)
+		vSlicerSymbolSums(pstInput->pnBody + (size_t)(dwFirst - pstInput->dwStitchSymbols) * REC_DOWN_SAMPLING_RATE, plSums + dwHead, dwSymbols - dwHead);
+}
+
+
+
+/*
+**************************************************************************
+vSlicerDo: fused decimation and threshold, one pass over the samples
+**************************************************************************
+*/
+
+void vSlicerDo(const ST_SLICERINPUT* pstInput, uint32_t dwSymbols, uint32_t dwBlockSamples, uint64_t* pqwOut)
+{
+	const int64_t llWindow = REC_LOOKING_WINDOW_SIZE;
+	int32_t alSums[REC_LOOKING_WINDOW_SIZE];
+	ST_BITWRITER stWriter = { pqwOut, 0, 0 };
+
+	if (dwSymbols == 0)
+	{
+		pqwOut[0] = 0;
+		return;
+	}
+
+	// windows that would reach past the block use the last window of the block
+	int32_t lTailLen = (dwSymbols < REC_LOOKING_WINDOW_SIZE) ? (int32_t)dwSymbols : REC_LOOKING_WINDOW_SIZE;
+	int32_t lTailSum = 0;
+	vInputSums(pstInput, dwSymbols - lTailLen, alSums, lTailLen);
+	for (int32_t k = 0; k < lTailLen; k++)
+		lTailSum += alSums[k];
+
+	for (uint32_t i = 0; i < dwSymbols; i += REC_LOOKING_WINDOW_SIZE)
+	{
+		int32_t lLen = (dwSymbols - i < REC_LOOKING_WINDOW_SIZE) ? (int32_t)(dwSymbols - i) : REC_LOOKING_WINDOW_SIZE;
+		vInputSums(pstInput, i, alSums, lLen);
+
+		int32_t lWindowSum = lTailSum;
+		int32_t lWindowLen = lTailLen;
+		if ((int64_t)i * REC_DOWN_SAMPLING_RATE + 1 <= dwBlockSamples && ((int64_t)i + 1) * REC_DOWN_SAMPLING_RATE + REC_DOWN_SAMPLING_RATE * llWindow <= dwBlockSamples)
+		{
+			lWindowSum = 0;
+			for (int32_t k = 0; k < lLen; k++)
+				lWindowSum += alSums[k];
+			lWindowLen = lLen;
+		}
+
+		// sum / 10 >= window sum / (10 * window len)  <=>  sum >= ceil(window sum / window len)
+		int32_t lThreshold = (lWindowSum >= 0) ? (lWindowSum + lWindowLen - 1) / lWindowLen : lWindowSum / lWindowLen;
+		vSlicerDecide(alSums, lLen, lThreshold, &stWriter);
+	}
+
+	// last partial word and the padding word
+	if (stWriter.lAccBits)
+		*stWriter.pqwDst++ = stWriter.qwAcc;
+	*stWriter.pqwDst = 0;
+}
+
+
+
+/*
+**************************************************************************
+vTrackSetup: first levels from the mean of the first symbols and the
+means of the symbol sums on both sides of it
+**************************************************************************
+*/
+
+static void vTrackSetup(ST_THRESHOLD* pstThreshold, const int32_t* plSums, int32_t lLen)
+{
+	int64_t llSum = 0, llHigh = 0, llLow = 0;
+	int32_t lHighCount = 0;
+
+	for (int32_t k = 0; k < lLen; k++)
+		llSum += plSums[k];
+	for (int32_t k = 0; k < lLen; k++)
+	{
+		if ((int64_t)plSums[k] * lLen >= llSum)
+		{
+			llHigh += plSums[k];
+			lHighCount++;
+		}
+		else
+			llLow += plSums[k];
+	}
+
+	int64_t llMean = llSum * (1 << REC_THRESHOLD_FRAC) / lLen;
+	pstThreshold->lHigh = (int32_t)(lHighCount ? llHigh * (1 << REC_THRESHOLD_FRAC) / lHighCount : llMean);
+	pstThreshold->lLow = (int32_t)((lHighCount < lLen) ? llLow * (1 << REC_THRESHOLD_FRAC) / (lLen - lHighCount) : llMean);
+	pstThreshold->bValid = true;
+}
+
+
+
+/*
+**************************************************************************
+dwTrackGroup: decisions of a group against the two thresholds and the
+sums of all and of the one symbols, a group of symbol sums fits to int32
+**************************************************************************
+*/
+
+static inline uint32_t dwTrackGroup(const int32_t* plGroup, int32_t lCount, int32_t lAbove, int32_t lBelow, uint32_t* pdwKeep, int32_t* plSum, int32_t* plOnesSum)
+{
+#if defined(REC_SIMD_AVX2)
+	if (lCount == TRACK_GROUP)
+	{
+		const __m256i above = _mm256_set1_epi32(lAbove - 1);
+		const __m256i below = _mm256_set1_epi32(lBelow - 1);
+		__m256i a = _mm256_loadu_si256((const __m256i*)plGroup);
+		__m256i b = _mm256_loadu_si256((const __m256i*)(plGroup + 8));
+		__m256i oa = _mm256_cmpgt_epi32(a, above);
+		__m256i ob = _mm256_cmpgt_epi32(b, above);
+
+		uint32_t dwOnes = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(oa)) | ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(ob)) << 8);
+		*pdwKeep = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, below)))
+			| ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, below))) << 8);
+
+		// all in the even, ones in the odd lanes after the two hadd
+		__m256i t = _mm256_hadd_epi32(_mm256_add_epi32(a, b), _mm256_add_epi32(_mm256_and_si256(a, oa), _mm256_and_si256(b, ob)));
+		t = _mm256_hadd_epi32(t, t);
+		__m128i r = _mm_add_epi32(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+		*plSum = _mm_cvtsi128_si32(r);
+		*plOnesSum = _mm_cvtsi128_si32(_mm_shuffle_epi32(r, 1));
+		return dwOnes;
+	}
+#elif defined(REC_SIMD_SSE2)
+	if (lCount == TRACK_GROUP)
+	{
+		const __m128i above = _mm_set1_epi32(lAbove - 1);
+		const __m128i below = _mm_set1_epi32(lBelow - 1);
+		__m128i sum = _mm_setzero_si128(), ones = _mm_setzero_si128();
+		uint32_t dwOnes = 0, dwKeep = 0;
+		for (int32_t k = 0; k < TRACK_GROUP; k += 4)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(plGroup + k));
+			__m128i o = _mm_cmpgt_epi32(v, above);
+			dwOnes |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(o)) << k;
+			dwKeep |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, below))) << k;
+			sum = _mm_add_epi32(sum, v);
+			ones = _mm_add_epi32(ones, _mm_and_si128(v, o));
+		}
+
+		// sum in lane 0, ones in lane 2
+		__m128i r = _mm_add_epi32(_mm_unpacklo_epi32(sum, ones), _mm_unpackhi_epi32(sum, ones));
+		r = _mm_add_epi32(r, _mm_shuffle_epi32(r, 0x4E));
+		*pdwKeep = dwKeep;
+		*plSum = _mm_cvtsi128_si32(r);
+		*plOnesSum = _mm_cvtsi128_si32(_mm_shuffle_epi32(r, 1));
+		return dwOnes;
+	}
+#endif
+
+	uint32_t dwOnes = 0, dwKeep = 0;
+	int32_t lSum = 0, lOnesSum = 0;
+	for (int32_t k = 0; k < lCount; k++)
+	{
+		int32_t lBit = plGroup[k] >= lAbove;
+		dwOnes |= (uint32_t)lBit << k;
+		dwKeep |= (uint32_t)(plGroup[k] >= lBelow) << k;
+		lSum += plGroup[k];
+		lOnesSum += plGroup[k] & -lBit;
+	}
+	*pdwKeep = dwKeep;
+	*plSum = lSum;
+	*plOnesSum = lOnesSum;
+	return dwOnes;
+}
+
+
+
+/*
+**************************************************************************
+vSlicerTrack: decisions against the tracked threshold. The threshold is
+held for a group of TRACK_GROUP symbols and the levels are moved by the
+mean of the group afterwards, so only the groups depend on each other
+and the symbols of a group are decided independently.
+**************************************************************************
+*/
+
+void vSlicerTrack(const ST_SLICERINPUT* pstInput, uint32_t dwSymbols, ST_THRESHOLD* pstThreshold, uint64_t* pqwOut)
+{
+	int32_t alSums[REC_LOOKING_WINDOW_SIZE];
+	ST_BITWRITER stWriter = { pqwOut, 0, 0 };
+
+	for (uint32_t i = 0; i < dwSymbols; i += REC_LOOKING_WINDOW_SIZE)
+	{
+		int32_t lLen = (dwSymbols - i < REC_LOOKING_WINDOW_SIZE) ? (int32_t)(dwSymbols - i) : REC_LOOKING_WINDOW_SIZE;
+		vInputSums(pstInput, i, alSums, lLen);
+		if (!pstThreshold->bValid)
+			vTrackSetup(pstThreshold, alSums, lLen);
+
+		for (int32_t g = 0; g < lLen; g += TRACK_GROUP)
+		{
+			int32_t lCount = (lLen - g < TRACK_GROUP) ? lLen - g : TRACK_GROUP;
+			const int32_t* plGroup = alSums + g;
+
+			// thresholds in symbol sums: above is a one, below a zero, in between the last decision
+			int64_t llMid = ((int64_t)pstThreshold->lHigh + pstThreshold->lLow) >> 1;
+			int64_t llAbove = (llMid + pstThreshold->lHysteresis + (1 << REC_THRESHOLD_FRAC) - 1) >> REC_THRESHOLD_FRAC;
+			int64_t llBelow = (llMid - pstThreshold->lHysteresis + (1 << REC_THRESHOLD_FRAC) - 1) >> REC_THRESHOLD_FRAC;
+
+			uint32_t dwKeep;
+			int32_t lSum, lOnesSum;
+			uint32_t dwOnes = dwTrackGroup(plGroup, lCount, (int32_t)llAbove, (int32_t)llBelow, &dwKeep, &lSum, &lOnesSum);
+			int64_t llSum = lSum, llOnesSum = lOnesSum;
+
+			// symbols in the band take the decision before them, rare with a small band
+			dwKeep &= ~dwOnes;
+			while (dwKeep)
+			{
+				int32_t k = lLowestBit(dwKeep);
+				uint32_t dwPrev = k ? (dwOnes >> (k - 1)) & 1 : pstThreshold->dwLast;
+				dwOnes |= dwPrev << k;
+				if (dwPrev)
+					llOnesSum += plGroup[k];
+				dwKeep &= dwKeep - 1;
+			}
+
+			// run of equal decisions up to the last symbol of the group
+			uint32_t dwMask = (lCount < 32) ? (1u << lCount) - 1 : ~0u;
+			uint32_t dwLast = (dwOnes >> (lCount - 1)) & 1;
+			uint32_t dwDiff = (dwOnes ^ (dwLast ? dwMask : 0)) & dwMask;
+			if (dwDiff)
+				pstThreshold->dwRun = lCount - 1 - lHighestBit(dwDiff);
+			else
+				pstThreshold->dwRun = (dwLast == pstThreshold->dwLast) ? pstThreshold->dwRun + lCount : lCount;
+			pstThreshold->dwLast = dwLast;
+
+			// each level moves towards the mean of its symbols by count / 2^shift, a long run moves both
+			int32_t lOnes = lBitCount(dwOnes);
+			int64_t llOnesFix = llOnesSum * (1 << REC_THRESHOLD_FRAC), llZerosFix = (llSum - llOnesSum) * (1 << REC_THRESHOLD_FRAC);
+			if (pstThreshold->dwRun > REC_THRESHOLD_MAX_RUN)
+			{
+				llOnesFix = llZerosFix = llSum * (1 << REC_THRESHOLD_FRAC);
+				lOnes = lCount;
+			}
+			pstThreshold->lHigh += (int32_t)((llOnesFix - (int64_t)lOnes * pstThreshold->lHigh) >> pstThreshold->lShift);
+			pstThreshold->lLow += (int32_t)((llZerosFix - (int64_t)(lCount - lOnes) * pstThreshold->lLow) >> pstThreshold->lShift);
+
+			vPutBits(&stWriter, dwOnes, lCount);
+		}
+	}
+
+	// last partial word and the padding word
+	if (stWriter.lAccBits)
+		*stWriter.pqwDst++ = stWriter.qwAcc;
+	*stWriter.pqwDst = 0;
+}
+
+
+
+/*
+**************************************************************************
+vSlicerReference: the slicer as it was written in bWorkDo
+**************************************************************************
+*/
+
+void vSlicerReference(int16_t* pnInput, uint32_t dwSymbols, uint32_t dwBlockSamples, int16_t* pnOut)
+{
+	int16_t* input_signal = pnInput;
+	int16_t* out_signal = pnOut;
+	const int down_sampling_rate = REC_DOWN_SAMPLING_RATE;
+	const int looking_window_size = REC_LOOKING_WINDOW_SIZE;
+	const int number_of_samples = (int)dwBlockSamples;
+	const int processed_signal_size = (int)dwSymbols;
+	double th = 0;
+
+	for (int i = 0; i < processed_signal_size; i++) {
+		if (i % looking_window_size == 0) {
+			if (i*down_sampling_rate + 1 <= number_of_samples && (i + 1)*down_sampling_rate + down_sampling_rate*looking_window_size <= number_of_samples)
+				th = average(input_signal + i*down_sampling_rate, down_sampling_rate*looking_window_size);
+			else
+				th = average(input_signal + down_sampling_rate*(processed_signal_size - looking_window_size), down_sampling_rate*looking_window_size);
+		}
+
+		if (average(input_signal + down_sampling_rate*i, down_sampling_rate * 1) >= th)
+			out_signal[i] = 1;
+		else
+			out_signal[i] = 0;
+	}
+}
+
+
+
+/*
+**************************************************************************
+bSlicerCompare: vSlicerDo against vSlicerReference on one block without
+carry, pnRef takes dwSymbols and pqwBits REC_BITS_WORDS(dwSymbols); the
+reference takes the threshold of a short block from in front of it
+**************************************************************************
+*/
+
+bool bSlicerCompare(int16_t* pnBlock, uint32_t dwSymbols, uint32_t dwBlockSamples, int16_t* pnRef, uint64_t* pqwBits, uint32_t* pdwDiffer)
+{
+	*pdwDiffer = 0;
+	if (dwSymbols < REC_LOOKING_WINDOW_SIZE)
+		return false;
+
+	ST_SLICERINPUT stInput;
+	stInput.pnStitch = NULL;
+	stInput.dwStitchSymbols = 0;
+	stInput.pnBody = pnBlock;
+	stInput.plSums = NULL;
+	vSlicerDo(&stInput, dwSymbols, dwBlockSamples, pqwBits);
+	vSlicerReference(pnBlock, dwSymbols, dwBlockSamples, pnRef);
+
+	for (uint32_t i = 0; i < dwSymbols; i++)
+		if ((int16_t)((pqwBits[i / 64] >> (i % 64)) & 1) != pnRef[i])
+			(*pdwDiffer)++;
+	return true;
+}
@@ -0,0 +1,49 @@
+/*
+**************************************************************************
+
+rec_slicer.h
+
+**************************************************************************
+
+Slicer of the decoder: boxcar decimation by REC_DOWN_SAMPLING_RATE and
+decision against the mean of the next REC_LOOKING_WINDOW_SIZE symbols
+(vSlicerDo) or against the tracked threshold of rec_threshold.h
+(vSlicerTrack). With symbol timing recovery (rec_timing.h) the symbol
+sums come from there and the slicer only decides.
+**************************************************************************
+*/
+
+#ifndef REC_SLICER_H
+#define REC_SLICER_H
+
+#include <stdint.h>
+
+#include "rec_bits.h"
+#include "rec_decoder.h"
+
+// ----- symbols of a block: the stitched first symbols, then the rest in place -----
+struct ST_SLICERINPUT
+{
+	const int16_t*  pnStitch;           // dwStitchSymbols symbols with the samples carried from the last block
+	uint32_t        dwStitchSymbols;
+	const int16_t*  pnBody;             // symbol dwStitchSymbols and up
+	const int32_t*  plSums;             // symbol sums of all symbols (rec_timing), the samples are not read if set
+};
+
+
+// ----- sum of the REC_DOWN_SAMPLING_RATE samples of each symbol, reads no sample behind the last symbol -----
+void vSlicerSymbolSums(const int16_t* pnData, int32_t* plSums, uint32_t dwSymbols);
+
+// ----- packed decisions of dwSymbols symbols to REC_BITS_WORDS(dwSymbols) words, dwBlockSamples are the new samples of the block -----
+void vSlicerDo(const ST_SLICERINPUT* pstInput, uint32_t dwSymbols, uint32_t dwBlockSamples, uint64_t* pqwOut);
+
+// ----- packed decisions as vSlicerDo against the tracked threshold, the state goes on to the next block -----
+void vSlicerTrack(const ST_SLICERINPUT* pstInput, uint32_t dwSymbols, ST_THRESHOLD* pstThreshold, uint64_t* pqwOut);
+
+// ----- original double precision slicer with one 0/1 int16 per symbol, vSlicerDo must match it bit by bit -----
+void vSlicerReference(int16_t* pnInput, uint32_t dwSymbols, uint32_t dwBlockSamples, int16_t* pnOut);
+
+// ----- symbols of a block without carry where vSlicerDo and vSlicerReference differ, pnRef and pqwBits are scratch of dwSymbols symbols; false if the block is shorter than a threshold window -----
+bool bSlicerCompare(int16_t* pnBlock, uint32_t dwSymbols, uint32_t dwBlockSamples, int16_t* pnRef, uint64_t* pqwBits, uint32_t* pdwDiffer);
+
+#endif
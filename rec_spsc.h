@@ -0,0 +1,70 @@
+/*
+**************************************************************************
+
+rec_spsc.h
+
+**************************************************************************
+
+Bounded lock-free ring of pointers for exactly one producer and one
+consumer thread. Head and tail are only written by their own side and
+sit in separate cache lines.
+**************************************************************************
+*/
+
+#ifndef REC_SPSC_H
+#define REC_SPSC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+
+struct ST_SPSCRING
+{
+	void**                  ppvSlot;
+	uint32_t                dwSize;         // power of two
+	alignas(64) std::atomic<uint32_t> dwHead;   // written by the producer
+	alignas(64) std::atomic<uint32_t> dwTail;   // written by the consumer
+};
+
+
+// ----- room for at least dwEntries pointers -----
+static inline bool bSpscInit(ST_SPSCRING* pstRing, uint32_t dwEntries)
+{
+	pstRing->dwSize = 1;
+	while (pstRing->dwSize < dwEntries)
+		pstRing->dwSize *= 2;
+	pstRing->ppvSlot = (void**)calloc(pstRing->dwSize, sizeof(void*));
+	pstRing->dwHead.store(0);
+	pstRing->dwTail.store(0);
+	return pstRing->ppvSlot != NULL;
+}
+
+static inline void vSpscFree(ST_SPSCRING* pstRing)
+{
+	free(pstRing->ppvSlot);
+	pstRing->ppvSlot = NULL;
+}
+
+// ----- producer side, false if the ring is full -----
+static inline bool bSpscPush(ST_SPSCRING* pstRing, void* pvEntry)
+{
+	uint32_t dwHead = pstRing->dwHead.load(std::memory_order_relaxed);
+	if (dwHead - pstRing->dwTail.load(std::memory_order_acquire) >= pstRing->dwSize)
+		return false;
+	pstRing->ppvSlot[dwHead & (pstRing->dwSize - 1)] = pvEntry;
+	pstRing->dwHead.store(dwHead + 1, std::memory_order_release);
+	return true;
+}
+
+// ----- consumer side, NULL if the ring is empty -----
+static inline void* pvSpscPop(ST_SPSCRING* pstRing)
+{
+	uint32_t dwTail = pstRing->dwTail.load(std::memory_order_relaxed);
+	if (dwTail == pstRing->dwHead.load(std::memory_order_acquire))
+		return NULL;
+	void* pvEntry = pstRing->ppvSlot[dwTail & (pstRing->dwSize - 1)];
+	pstRing->dwTail.store(dwTail + 1, std::memory_order_release);
+	return pvEntry;
+}
+
+#endif
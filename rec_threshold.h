@@ -0,0 +1,82 @@
+/*
+**************************************************************************
+
+rec_threshold.h
+
+**************************************************************************
+
+Decision threshold of the slicer. REC_THRESHOLD_WINDOW is the original
+rule: the mean of the next REC_LOOKING_WINDOW_SIZE symbols, recomputed
+every window and taken from the last window of the block near its end.
+It stays the default of the decoder, REC_THRESHOLD_TRACK is chosen
+explicitly (bDecoderSetThreshold).
+
+REC_THRESHOLD_TRACK follows the signal and keeps its state from one
+notify block to the next: the levels of the ones and the zeros are
+exponential means of the symbol sums decided as such, the threshold is
+their midpoint. The slicer moves the levels once per group of a few
+symbols (vSlicerTrack), the cost per symbol is constant. A symbol
+inside the hysteresis band around the threshold keeps the last
+decision. After REC_THRESHOLD_MAX_RUN equal decisions the other level
+follows the signal as well, so a DC step larger than the eye does not
+leave the threshold on one side for good.
+
+The levels are symbol sums in fixed point with REC_THRESHOLD_FRAC bits.
+**************************************************************************
+*/
+
+#ifndef REC_THRESHOLD_H
+#define REC_THRESHOLD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define REC_THRESHOLD_WINDOW        0
+#define REC_THRESHOLD_TRACK         1
+
+#define REC_THRESHOLD_FRAC          8                       // fraction bits of the levels
+#define REC_THRESHOLD_SHIFT         6                       // levels follow with 1/64 per symbol
+#define REC_THRESHOLD_MAX_RUN       (4 * REC_FRAME_SIZE)    // longer runs are no line data
+
+
+struct ST_THRESHOLD
+{
+	// setup
+	int32_t     lMode;
+	int32_t     lHysteresis;    // half band, symbol sum in fixed point
+	int32_t     lShift;
+
+	// carried from block to block
+	bool        bValid;         // levels are set up from the first symbols
+	int32_t     lHigh;
+	int32_t     lLow;
+	uint32_t    dwLast;         // last decision
+	uint32_t    dwRun;          // equal decisions up to the last one
+};
+
+
+// ----- forgets the levels, they are set up again from the next symbols -----
+static inline void vThresholdReset(ST_THRESHOLD* pstThreshold)
+{
+	pstThreshold->bValid = false;
+	pstThreshold->lHigh = 0;
+	pstThreshold->lLow = 0;
+	pstThreshold->dwLast = 0;
+	pstThreshold->dwRun = 0;
+}
+
+// ----- dHysteresis is the half band in ADC counts, false for an unknown mode or a negative band -----
+static inline bool bThresholdInit(ST_THRESHOLD* pstThreshold, int32_t lMode, double dHysteresis = 0)
+{
+	memset(pstThreshold, 0, sizeof(*pstThreshold));
+	if ((lMode != REC_THRESHOLD_WINDOW && lMode != REC_THRESHOLD_TRACK) || dHysteresis < 0 || dHysteresis > 32767)
+		return false;
+
+	pstThreshold->lMode = lMode;
+	pstThreshold->lHysteresis = (int32_t)(dHysteresis * REC_DOWN_SAMPLING_RATE * (1 << REC_THRESHOLD_FRAC) + 0.5);
+	pstThreshold->lShift = REC_THRESHOLD_SHIFT;
+	vThresholdReset(pstThreshold);
+	return true;
+}
+
+#endif
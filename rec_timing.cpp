@@ -0,0 +1,265 @@
+/*
+**************************************************************************
+
+rec_timing.cpp
+
+**************************************************************************
+
+Symbol timing recovery of the decoder, see rec_timing.h
+
+**************************************************************************
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "rec_decoder.h"
+#include "rec_simd.h"
+#include "rec_timing.h"
+
+#define LEVEL_GAIN      (1.0 / 64)  // levels follow with 1/64 per symbol
+#define SETUP_SAMPLES   4096        // samples for the first levels
+#define EYE_UPDATE      32          // symbols between the updates of 1 / half eye
+
+// ----- 16 ones and 16 zeros, the 16 words from 16 - len keep the first len samples -----
+static const int16_t s_anMask[32] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+
+
+/*
+**************************************************************************
+bTimingInit
+**************************************************************************
+*/
+
+bool bTimingInit(ST_TIMING* pstTiming, int32_t lMode, double dSamplesPerSymbol)
+{
+	memset(pstTiming, 0, sizeof(*pstTiming));
+	if ((lMode != REC_TIMING_FIXED && lMode != REC_TIMING_TRACK) || dSamplesPerSymbol < REC_TIMING_MIN_SPS || dSamplesPerSymbol > REC_TIMING_MAX_SPS)
+		return false;
+	if (lMode == REC_TIMING_FIXED && dSamplesPerSymbol != REC_DOWN_SAMPLING_RATE)
+		return false;
+
+	pstTiming->lMode = lMode;
+	pstTiming->dSamplesPerSymbol = dSamplesPerSymbol;
+	pstTiming->dPhaseGain = REC_TIMING_PHASE_GAIN;
+	pstTiming->dRateGain = REC_TIMING_RATE_GAIN;
+	pstTiming->lEdge = (int32_t)(dSamplesPerSymbol / 2 + 0.5);
+	pstTiming->lEdge = (pstTiming->lEdge < 1) ? 1 : (pstTiming->lEdge > REC_TIMING_MAX_EDGE) ? REC_TIMING_MAX_EDGE : pstTiming->lEdge;
+	for (int32_t i = 1; i <= REC_TIMING_MAX_LEN; i++)
+		pstTiming->alScale[i] = (REC_DOWN_SAMPLING_RATE * 65536 + i / 2) / i;
+	vTimingReset(pstTiming);
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vTimingReset
+**************************************************************************
+*/
+
+void vTimingReset(ST_TIMING* pstTiming)
+{
+	pstTiming->bValid = false;
+	pstTiming->dPeriod = pstTiming->dSamplesPerSymbol;
+	pstTiming->dPos = 0;
+	pstTiming->dPending = 0;
+	pstTiming->dHigh = 0;
+	pstTiming->dLow = 0;
+	pstTiming->dwLast = 0;
+	pstTiming->lCarry = 0;
+	pstTiming->qwSymbols = 0;
+	pstTiming->qwTransitions = 0;
+	pstTiming->dErrorSum = 0;
+}
+
+
+
+/*
+**************************************************************************
+dwTimingMaxSymbols
+**************************************************************************
+*/
+
+uint32_t dwTimingMaxSymbols(const ST_TIMING* pstTiming, uint32_t dwSamples)
+{
+	if (pstTiming->lMode == REC_TIMING_FIXED)
+		return dwSamples / REC_DOWN_SAMPLING_RATE + 1;
+	return (uint32_t)((dwSamples + REC_TIMING_MAX_LEN + 2) / (pstTiming->dSamplesPerSymbol * (1.0 - REC_TIMING_MAX_DEVIATION))) + 1;
+}
+
+
+
+/*
+**************************************************************************
+vTimingSetup: first levels from the mean and the mean deviation of the
+first samples, a symbol is +-deviation around the mean
+**************************************************************************
+*/
+
+static void vTimingSetup(ST_TIMING* pstTiming, const int16_t* pnData, uint32_t dwSamples)
+{
+	uint32_t dwLen = (dwSamples < SETUP_SAMPLES) ? dwSamples : SETUP_SAMPLES;
+	double dMean = 0, dDeviation = 0;
+
+	for (uint32_t i = 0; i < dwLen; i++)
+		dMean += pnData[i];
+	dMean /= dwLen;
+	for (uint32_t i = 0; i < dwLen; i++)
+		dDeviation += fabs(pnData[i] - dMean);
+	dDeviation /= dwLen;
+
+	pstTiming->dHigh = (dMean + dDeviation) * REC_DOWN_SAMPLING_RATE;
+	pstTiming->dLow = (dMean - dDeviation) * REC_DOWN_SAMPLING_RATE;
+	pstTiming->bValid = true;
+}
+
+
+
+/*
+**************************************************************************
+dwTimingDo: one symbol after the other, the boundary of the next symbol
+depends on the decision of this one
+**************************************************************************
+*/
+
+static inline int32_t lSample(const ST_TIMING* pstTiming, const int16_t* pnData, int64_t llIdx)
+{
+	return (llIdx < pstTiming->lCarry) ? pstTiming->anCarry[llIdx] : pnData[llIdx - pstTiming->lCarry];
+}
+
+// ----- sum of lLen samples from llFirst on, the carried ones first -----
+static inline int32_t lSampleSum(const ST_TIMING* pstTiming, const int16_t* pnData, int64_t llFirst, int32_t lLen, int64_t llTotal)
+{
+	int32_t lSum = 0;
+#if defined(REC_SIMD_SSE2)
+	// up to 16 samples without a branch on the length, the loads stay in the block
+	if (lLen <= 16 && llFirst >= pstTiming->lCarry && llFirst + 16 <= llTotal)
+	{
+		const int16_t* pnSrc = pnData + (llFirst - pstTiming->lCarry);
+		const int16_t* pnMask = s_anMask + 16 - lLen;
+		__m128i sum = _mm_add_epi32(
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i*)pnSrc), _mm_loadu_si128((const __m128i*)pnMask)),
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(pnSrc + 8)), _mm_loadu_si128((const __m128i*)(pnMask + 8))));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+		return _mm_cvtsi128_si32(sum);
+	}
+#else
+	(void)llTotal;
+#endif
+	if (llFirst >= pstTiming->lCarry)
+	{
+		const int16_t* pnSrc = pnData + (llFirst - pstTiming->lCarry);
+		for (int32_t k = 0; k < lLen; k++)
+			lSum += pnSrc[k];
+	}
+	else
+		for (int64_t k = llFirst; k < llFirst + lLen; k++)
+			lSum += lSample(pstTiming, pnData, k);
+	return lSum;
+}
+
+uint32_t dwTimingDo(ST_TIMING* pstTiming, const int16_t* pnData, uint32_t dwSamples, int32_t* plSums)
+{
+	if (dwSamples == 0)
+		return 0;
+	if (!pstTiming->bValid)
+		vTimingSetup(pstTiming, pnData, dwSamples);
+
+	// positions and period in 32 bit fixed point, the error of a symbol is applied one symbol later,
+	// so the boundaries do not wait for the sum and the decision of the symbol before
+	const double dFix = 4294967296.0;
+	const int64_t llTotal = pstTiming->lCarry + (int64_t)dwSamples;
+	const int64_t llMinPeriod = (int64_t)(pstTiming->dSamplesPerSymbol * (1.0 - REC_TIMING_MAX_DEVIATION) * dFix);
+	const int64_t llMaxPeriod = (int64_t)(pstTiming->dSamplesPerSymbol * (1.0 + REC_TIMING_MAX_DEVIATION) * dFix);
+	int64_t llPos = (int64_t)(pstTiming->dPos * dFix);
+	int64_t llPeriod = (int64_t)(pstTiming->dPeriod * dFix);
+	double dPending = pstTiming->dPending;
+	double dHigh = pstTiming->dHigh;
+	double dLow = pstTiming->dLow;
+	double dErrorSum = 0;
+	double dInvHalfEye = 1.0 / ((dHigh - dLow > 2.0) ? 0.5 * (dHigh - dLow) : 1.0);
+	uint32_t dwLast = pstTiming->dwLast;
+	uint32_t dwTransitions = 0;
+	uint32_t dwSymbols = 0;
+	const int32_t lEdge = pstTiming->lEdge;
+	const double dEdgeScale = (double)REC_DOWN_SAMPLING_RATE / (2 * lEdge);
+
+	int64_t llStart = llPos >> 32;
+	for (;;)
+	{
+		int64_t llNewPeriod = llPeriod + (int64_t)(dPending * pstTiming->dRateGain * dFix);
+		llNewPeriod = (llNewPeriod < llMinPeriod) ? llMinPeriod : (llNewPeriod > llMaxPeriod) ? llMaxPeriod : llNewPeriod;
+		int64_t llNewPos = llPos + llNewPeriod + (int64_t)(dPending * pstTiming->dPhaseGain * dFix);
+		int64_t llEnd = llNewPos >> 32;
+		if (llEnd > llTotal)
+			break;
+		llPeriod = llNewPeriod;
+
+		// sum of the symbol, only the first symbols of a block reach into the carried samples
+		int32_t lLen = (int32_t)(llEnd - llStart);
+		int32_t lSum = lSampleSum(pstTiming, pnData, llStart, lLen, llTotal);
+		int32_t lValue = (int32_t)(((int64_t)lSum * pstTiming->alScale[lLen]) >> 16);
+		plSums[dwSymbols++] = lValue;
+
+		double dMid = 0.5 * (dHigh + dLow);
+		uint32_t dwBit = (uint32_t)(lValue >= dMid);
+		if ((dwSymbols & (EYE_UPDATE - 1)) == 0)
+			dInvHalfEye = 1.0 / ((dHigh - dLow > 2.0) ? 0.5 * (dHigh - dLow) : 1.0);
+
+		// timing error of the boundary in front of the symbol, positive if it is early; used at transitions only, without a branch
+		dPending = 0;
+		if (llStart >= lEdge)
+		{
+			double dEdge = (double)lSampleSum(pstTiming, pnData, llStart - lEdge, 2 * lEdge, llTotal) * dEdgeScale;
+			double dError = (dMid - dEdge) * dInvHalfEye * lEdge;
+			dError = (dError > lEdge) ? lEdge : (dError < -lEdge) ? -lEdge : dError;
+			dPending = dError * (double)((int32_t)(dwBit ^ dwLast) * (dwBit ? 1 : -1));
+			dwTransitions += dwBit ^ dwLast;
+			dErrorSum += fabs(dPending);
+		}
+
+		dHigh += (double)dwBit * (lValue - dHigh) * LEVEL_GAIN;
+		dLow += (double)(dwBit ^ 1) * (lValue - dLow) * LEVEL_GAIN;
+		dwLast = dwBit;
+
+		llPos = llNewPos;
+		llStart = llEnd;
+	}
+
+	// carry the samples in front of the next symbol and the rest of the block
+	int64_t llKeep = (llStart >= lEdge) ? llStart - lEdge : 0;
+	int16_t anCarry[REC_TIMING_MAX_LEN + REC_TIMING_MAX_EDGE + 2];
+	int32_t lCarry = (int32_t)(llTotal - llKeep);
+	for (int32_t i = 0; i < lCarry; i++)
+		anCarry[i] = (int16_t)lSample(pstTiming, pnData, llKeep + i);
+	memcpy(pstTiming->anCarry, anCarry, lCarry * sizeof(int16_t));
+	pstTiming->lCarry = lCarry;
+
+	pstTiming->dPos = (double)(llPos - (llKeep << 32)) / dFix;
+	pstTiming->dPeriod = (double)llPeriod / dFix;
+	pstTiming->dPending = dPending;
+	pstTiming->dHigh = dHigh;
+	pstTiming->dLow = dLow;
+	pstTiming->dwLast = dwLast;
+	pstTiming->qwSymbols += dwSymbols;
+	pstTiming->qwTransitions += dwTransitions;
+	pstTiming->dErrorSum += dErrorSum;
+	return dwSymbols;
+}
+
+
+
+/*
+**************************************************************************
+dTimingPpm
+**************************************************************************
+*/
+
+double dTimingPpm(const ST_TIMING* pstTiming)
+{
+	return (pstTiming->dSamplesPerSymbol / pstTiming->dPeriod - 1.0) * 1.0e6;
+}
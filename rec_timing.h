@@ -0,0 +1,89 @@
+/*
+**************************************************************************
+
+rec_timing.h
+
+**************************************************************************
+
+Symbol timing of the decoder. REC_TIMING_FIXED is the original
+decimation: exactly REC_DOWN_SAMPLING_RATE samples per symbol, aligned
+to the first sample of the recording.
+
+REC_TIMING_TRACK recovers the symbol clock from the signal: the symbol
+boundaries come from a phase accumulator that advances by the tracked
+period, so a symbol is floor or ceil of the period long. At every
+transition the half symbol on each side of the boundary is compared
+against the midpoint of the levels (Gardner style): on time its mean is
+the midpoint, every sample the boundary is early or late moves the mean
+by 1 / (half symbol) of the eye towards the level before or after the
+transition. A proportional and integral loop moves the phase and the
+period, the period stays within REC_TIMING_MAX_DEVIATION of the setup.
+
+The output are symbol sums scaled to REC_DOWN_SAMPLING_RATE samples, so
+the slicer and its threshold (rec_threshold.h) work on them unchanged.
+Phase, period and the samples of an unfinished symbol go on to the next
+notify block.
+**************************************************************************
+*/
+
+#ifndef REC_TIMING_H
+#define REC_TIMING_H
+
+#include <stdint.h>
+
+#define REC_TIMING_FIXED            0
+#define REC_TIMING_TRACK            1
+
+#define REC_TIMING_MIN_SPS          2.5         // samples per symbol of the setup
+#define REC_TIMING_MAX_SPS          32.0
+#define REC_TIMING_MAX_DEVIATION    0.02        // tracked period to setup
+#define REC_TIMING_MAX_LEN          34          // samples of a symbol at REC_TIMING_MAX_SPS and the deviation
+#define REC_TIMING_MAX_EDGE         8           // samples on each side of a boundary for the timing error
+#define REC_TIMING_PHASE_GAIN       0.1         // part of the timing error corrected at once
+#define REC_TIMING_RATE_GAIN        0.0001      // part of the timing error added to the period
+
+
+struct ST_TIMING
+{
+	// setup
+	int32_t     lMode;
+	double      dSamplesPerSymbol;
+	double      dPhaseGain;
+	double      dRateGain;
+	int32_t     lEdge;                              // samples on each side of a boundary, half a symbol
+	int32_t     alScale[REC_TIMING_MAX_LEN + 1];    // REC_DOWN_SAMPLING_RATE / len in 16 bit fixed point
+
+	// carried from block to block
+	bool        bValid;                             // levels are set up from the first samples
+	double      dPeriod;
+	double      dPos;                               // start of the next symbol, index in the carried samples
+	double      dPending;                           // timing error of the last symbol, applied to the next boundary
+	double      dHigh;                              // levels of the ones and the zeros, scaled symbol sums
+	double      dLow;
+	uint32_t    dwLast;                             // last decision
+	int16_t     anCarry[REC_TIMING_MAX_LEN + REC_TIMING_MAX_EDGE + 2];  // samples before the next symbol and the rest of the last block
+	int32_t     lCarry;
+
+	// statistics
+	uint64_t    qwSymbols;
+	uint64_t    qwTransitions;
+	double      dErrorSum;                          // |timing error| in samples, summed over the transitions
+};
+
+
+// ----- lMode and the nominal samples per symbol, false for an unknown mode or a rate out of range -----
+bool bTimingInit(ST_TIMING* pstTiming, int32_t lMode, double dSamplesPerSymbol = REC_DOWN_SAMPLING_RATE);
+
+// ----- forgets phase, period and levels -----
+void vTimingReset(ST_TIMING* pstTiming);
+
+// ----- most symbols dwSamples samples and the carried ones can give -----
+uint32_t dwTimingMaxSymbols(const ST_TIMING* pstTiming, uint32_t dwSamples);
+
+// ----- REC_TIMING_TRACK: scaled symbol sums of the carried samples and the block, returns the number of symbols -----
+uint32_t dwTimingDo(ST_TIMING* pstTiming, const int16_t* pnData, uint32_t dwSamples, int32_t* plSums);
+
+// ----- tracked symbol clock against the setup, positive if the symbols are shorter -----
+double dTimingPpm(const ST_TIMING* pstTiming);
+
+#endif
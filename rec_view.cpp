@@ -0,0 +1,197 @@
+/*
+**************************************************************************
+
+rec_view.cpp
+
+**************************************************************************
+
+Text viewer of the live preview (rec_preview) of a running recorder
+(the FIFO loop or rec_replay -preview). Attaches to the shared memory
+read only and prints the newest frames of a level, one line each: the
+raw range of an ADC channel and a strip of the bins of one stream. With
+-follow it polls for new frames until it is stopped and attaches again
+if the recorder starts a new run; frames it was too slow for are counted
+as skipped, the recorder never waits for the viewer. -tag selects the
+card (cardX_snY) if the recorder runs several.
+
+usage: rec_view [-tag name] [-level l] [-stream index] [-adc channel] [-frames n] [-follow ms]
+**************************************************************************
+*/
+
+
+
+// ----- standard c include files -----
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <chrono>
+#include <thread>
+
+// ----- preview ring -----
+#include "rec_preview.h"
+
+#define VIEW_RECONNECT_MS   2000        // attach again after this long without a new frame
+
+
+// ----- global setup for the run -----
+const char* g_szTag = "";
+int32_t  g_lLevel = 0;
+int32_t  g_lStream = 0;
+int32_t  g_lAdc = 0;
+int32_t  g_lFrames = 8;
+int32_t  g_lFollowMs = 0;               // 0: print once
+
+
+
+/*
+**************************************************************************
+vPrintFrame: one line of a frame
+**************************************************************************
+*/
+
+static void vPrintFrame(const ST_PREVIEWSHARED* pstShared, const ST_PREVIEWFRAME* pstFrame)
+{
+	static const char s_achShade[] = " .:-=+*#%@";
+
+	// bins of the stream by their middle, '?' where the stream has no bytes
+	char szStrip[REC_PREVIEW_BINS + 1];
+	for (int32_t b = 0; b < REC_PREVIEW_BINS; b++)
+	{
+		const ST_PREVIEWBIN8* pstBin = &pstFrame->aastStream[g_lStream][b];
+		if (pstBin->byMin > pstBin->byMax)
+			szStrip[b] = '?';
+		else
+			szStrip[b] = s_achShade[((pstBin->byMin + pstBin->byMax) / 2) * 10 / 256];
+	}
+	szStrip[REC_PREVIEW_BINS] = 0;
+
+	int32_t lMin = INT16_MAX, lMax = INT16_MIN;
+	for (int32_t b = 0; b < REC_PREVIEW_BINS; b++)
+	{
+		const ST_PREVIEWBIN16* pstBin = &pstFrame->aastRaw[g_lAdc][b];
+		if (pstBin->nMin < lMin) lMin = pstBin->nMin;
+		if (pstBin->nMax > lMax) lMax = pstBin->nMax;
+	}
+
+	double dSeconds = pstShared->dSamplingRate > 0 ? (double)pstFrame->qwFirstSample / pstShared->dSamplingRate : 0;
+	printf("L%d %8" PRIu64 "  %10.3lf s  %5u blk  %8u byte  adc%d [%6d .. %6d]  rat%d |%s|\n",
+		g_lLevel, pstFrame->qwFrame, dSeconds, pstFrame->dwBlocks, pstFrame->dwStreamLen,
+		g_lAdc, lMin > lMax ? 0 : lMin, lMin > lMax ? 0 : lMax, g_lStream, szStrip);
+}
+
+
+
+/*
+**************************************************************************
+main
+**************************************************************************
+*/
+
+int main(int argc, char** argv)
+{
+	ST_PREVIEWVIEW  stView;
+	ST_PREVIEWFRAME stFrame;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-tag") && (i + 1 < argc))
+			g_szTag = argv[++i];
+		else if (!strcmp(argv[i], "-level") && (i + 1 < argc))
+			g_lLevel = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-stream") && (i + 1 < argc))
+			g_lStream = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-adc") && (i + 1 < argc))
+			g_lAdc = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && (i + 1 < argc))
+			g_lFrames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-follow") && (i + 1 < argc))
+			g_lFollowMs = atoi(argv[++i]);
+		else
+		{
+			printf("usage: %s [-tag name] [-level l] [-stream index] [-adc channel] [-frames n] [-follow ms]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (g_lLevel < 0 || g_lLevel >= REC_PREVIEW_LEVELS || g_lStream < 0 || g_lStream >= REC_STREAM_NUM
+		|| g_lAdc < 0 || g_lAdc >= REC_MAX_ADC || g_lFrames < 1 || g_lFollowMs < 0)
+	{
+		printf("Invalid level, stream, channel or frame count\n");
+		return 1;
+	}
+
+	char szName[80];
+	if (!bPreviewAttach(&stView, g_szTag))
+	{
+		printf("No preview at %s, is the recorder running?\n", pszPreviewName(g_szTag, szName, sizeof(szName)));
+		return 1;
+	}
+	if (g_lAdc >= stView.pstShared->lChannels)
+	{
+		printf("The recorder has %d channels only\n", stView.pstShared->lChannels);
+		vPreviewDetach(&stView);
+		return 1;
+	}
+	printf("%s: %d channels, %.3lf MS/s, %.0lf frames/s\n", pszPreviewName(g_szTag, szName, sizeof(szName)),
+		stView.pstShared->lChannels, stView.pstShared->dSamplingRate / 1.0e6, stView.pstShared->dFrameRate);
+
+	// newest frames first, then everything new
+	uint64_t qwPublished = qwPreviewPublished(&stView, g_lLevel);
+	uint64_t qwNext = qwPublished > (uint64_t)g_lFrames ? qwPublished - g_lFrames : 0;
+	uint64_t qwSkipped = 0;
+	int32_t  lIdleMs = 0;
+	while (true)
+	{
+		for (; qwNext < qwPublished; qwNext++)
+		{
+			if (bPreviewRead(&stView, g_lLevel, qwNext, &stFrame))
+				vPrintFrame(stView.pstShared, &stFrame);
+			else
+				qwSkipped++;
+		}
+		if (!g_lFollowMs)
+			break;
+		fflush(stdout);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(g_lFollowMs));
+		uint64_t qwNow = qwPreviewPublished(&stView, g_lLevel);
+		if (qwNow != qwPublished)
+		{
+			// fallen behind more than the ring holds: go on with the newest
+			if (qwNow - qwNext > REC_PREVIEW_SLOTS)
+			{
+				qwSkipped += qwNow - qwNext - REC_PREVIEW_SLOTS / 2;
+				qwNext = qwNow - REC_PREVIEW_SLOTS / 2;
+			}
+			qwPublished = qwNow;
+			lIdleMs = 0;
+			continue;
+		}
+
+		// a stopped recorder has dropped the shared memory, a new run creates it again
+		lIdleMs += g_lFollowMs;
+		if (lIdleMs >= VIEW_RECONNECT_MS)
+		{
+			ST_PREVIEWVIEW stNew;
+			lIdleMs = 0;
+			if (bPreviewAttach(&stNew, g_szTag))
+			{
+				if (stNew.pstShared->llStartUs != stView.pstShared->llStartUs && g_lAdc < stNew.pstShared->lChannels)
+				{
+					vPreviewDetach(&stView);
+					stView = stNew;
+					qwNext = qwPublished = 0;
+					printf("-- new run --\n");
+				}
+				else
+					vPreviewDetach(&stNew);
+			}
+		}
+	}
+	if (qwSkipped)
+		printf("%" PRIu64 " frames skipped\n", qwSkipped);
+
+	vPreviewDetach(&stView);
+	return 0;
+}
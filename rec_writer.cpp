@@ -0,0 +1,425 @@
+/*
+**************************************************************************
+
+rec_writer.cpp
+
+**************************************************************************
+
+Writer of the decoded streams, see rec_writer.h
+
+**************************************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rec_codec.h"
+#include "rec_mem.h"
+#include "rec_writer.h"
+
+
+
+// ----- binary output, our own buffers replace the stdio buffer -----
+static FILE* fpOpenOutput(const char* szName)
+{
+	FILE* fp = fopen(szName, "wb");
+	if (fp)
+		setvbuf(fp, NULL, _IONBF, 0);
+	return fp;
+}
+
+
+
+/*
+**************************************************************************
+bWriteChunk: one container chunk, coded if that is shorter
+**************************************************************************
+*/
+
+static bool bWriteChunk(ST_STREAMWRITER* pstWriter, uint32_t dwStream, const uint8_t* pbyData, uint32_t dwLen, uint64_t qwStreamOffset, int64_t llTimeUs)
+{
+	if (pstWriter->dwChunks == pstWriter->dwIndexLen)
+	{
+		uint32_t dwNewLen = pstWriter->dwIndexLen ? 2 * pstWriter->dwIndexLen : 1024;
+		ST_WRITERCHUNK* pstNew = (ST_WRITERCHUNK*)realloc(pstWriter->pstIndex, dwNewLen * sizeof(ST_WRITERCHUNK));
+		if (!pstNew)
+			return false;
+		pstWriter->pstIndex = pstNew;
+		pstWriter->dwIndexLen = dwNewLen;
+	}
+
+	ST_WRITERCHUNK stChunk;
+	stChunk.qwFileOffset = 0;
+	stChunk.qwStreamOffset = qwStreamOffset;
+	stChunk.llTimeUs = llTimeUs;
+	stChunk.dwLen = dwLen;
+	stChunk.dwStream = dwStream;
+	stChunk.dwStoredLen = pstWriter->bJobStore ? dwLen : dwCodecEncode(pbyData, dwLen, pstWriter->pbyCoded);
+	stChunk.dwCodec = REC_CODEC_RICE;
+	const uint8_t* pbyStored = pstWriter->pbyCoded;
+	if (stChunk.dwStoredLen >= dwLen)
+	{
+		stChunk.dwStoredLen = dwLen;
+		stChunk.dwCodec = REC_CODEC_NONE;
+		pbyStored = pbyData;
+	}
+	if (fwrite(&stChunk, sizeof(stChunk), 1, pstWriter->fpContainer) != 1 || fwrite(pbyStored, 1, stChunk.dwStoredLen, pstWriter->fpContainer) != stChunk.dwStoredLen)
+		return false;
+
+	stChunk.qwFileOffset = pstWriter->qwFileOffset + sizeof(stChunk);
+	pstWriter->pstIndex[pstWriter->dwChunks++] = stChunk;
+	pstWriter->qwFileOffset += sizeof(stChunk) + stChunk.dwStoredLen;
+	pstWriter->qwStoredBytes += stChunk.dwStoredLen;
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+bWriteStreams: dwLen bytes of every stream to their files or as
+container chunks; llTimeUs is the time of the first byte
+**************************************************************************
+*/
+
+static bool bWriteStreams(ST_STREAMWRITER* pstWriter, const uint8_t* const* apbyStream, uint32_t dwLen, uint64_t qwStreamOffset, int64_t llTimeUs)
+{
+	bool bOk = true;
+	for (uint32_t i = 0; i < REC_STREAM_NUM; i++)
+	{
+		if (!pstWriter->bContainer)
+		{
+			bOk = (fwrite(apbyStream[i], 1, dwLen, pstWriter->afp[i]) == dwLen) && bOk;
+			continue;
+		}
+		for (uint32_t dwPos = 0; dwPos < dwLen; dwPos += REC_WRITER_CHUNK)
+		{
+			uint32_t dwChunk = (dwLen - dwPos < REC_WRITER_CHUNK) ? dwLen - dwPos : REC_WRITER_CHUNK;
+			int64_t llChunkUs = llTimeUs + ((pstWriter->dFrameRate > 0) ? (int64_t)(dwPos * 1.0e6 / pstWriter->dFrameRate) : 0);
+			bOk = bWriteChunk(pstWriter, i, apbyStream[i] + dwPos, dwChunk, qwStreamOffset + dwPos, llChunkUs) && bOk;
+		}
+	}
+	return bOk;
+}
+
+
+
+/*
+**************************************************************************
+vWorkerThread: compresses and writes the handed over buffers of the
+container
+**************************************************************************
+*/
+
+static void vWorkerThread(ST_STREAMWRITER* pstWriter)
+{
+	while (1)
+	{
+		{
+			std::unique_lock<std::mutex> oGuard(pstWriter->oLock);
+			pstWriter->oWork.wait(oGuard, [pstWriter] { return pstWriter->bStop || pstWriter->dwJobLen; });
+			if (!pstWriter->dwJobLen)
+				return;
+		}
+
+		const uint8_t* apbyStream[REC_STREAM_NUM];
+		for (uint32_t i = 0; i < REC_STREAM_NUM; i++)
+			apbyStream[i] = pstWriter->pbyJob + (size_t)i * pstWriter->dwBufLen;
+		bool bOk = bWriteStreams(pstWriter, apbyStream, pstWriter->dwJobLen, pstWriter->qwJobOffset, pstWriter->llJobTimeUs);
+
+		{
+			std::lock_guard<std::mutex> oGuard(pstWriter->oLock);
+			pstWriter->dwJobLen = 0;
+			pstWriter->bJobError = pstWriter->bJobError || !bOk;
+		}
+		pstWriter->oDone.notify_one();
+	}
+}
+
+// ----- waits until the thread is idle, takes over its error -----
+static void vWaitWorker(ST_STREAMWRITER* pstWriter)
+{
+	if (!pstWriter->oWorker.joinable())
+		return;
+	std::unique_lock<std::mutex> oGuard(pstWriter->oLock);
+	pstWriter->oDone.wait(oGuard, [pstWriter] { return pstWriter->dwJobLen == 0; });
+	pstWriter->bError = pstWriter->bError || pstWriter->bJobError;
+}
+
+
+
+/*
+**************************************************************************
+bStreamWriterOpen
+**************************************************************************
+*/
+
+bool bStreamWriterOpen(ST_STREAMWRITER* pstWriter, bool bContainer, const char* szPrefix, double dFrameRate, uint32_t dwBufLen, double dFlushTime)
+{
+	// a cut off name would write to another directory
+	char szName[REC_WRITER_PATH_MAX];
+	int32_t lPrefix = snprintf(szName, sizeof(szName), "%s", szPrefix);
+	if (lPrefix < 0 || lPrefix + REC_WRITER_NAME_LEN > (int32_t)sizeof(szName))
+	{
+		printf("Output prefix %s is too long for the stream files\n", szPrefix);
+		return false;
+	}
+
+	pstWriter->bContainer = bContainer;
+	memset(pstWriter->afp, 0, sizeof(pstWriter->afp));
+	pstWriter->fpContainer = NULL;
+	pstWriter->fpLog = NULL;
+	snprintf(pstWriter->szLogName, sizeof(pstWriter->szLogName), "%s%s", szPrefix, REC_WRITER_SYNCLOG);
+	pstWriter->dwBufLen = (dwBufLen + REC_MEM_ALIGNMENT - 1) & ~(uint32_t)(REC_MEM_ALIGNMENT - 1);
+	pstWriter->dwFill = 0;
+	pstWriter->llFillTimeUs = 0;
+	pstWriter->dFrameRate = dFrameRate;
+	pstWriter->dFlushTime = dFlushTime;
+	pstWriter->pbyJob = NULL;
+	pstWriter->dwJobLen = 0;
+	pstWriter->qwJobOffset = 0;
+	pstWriter->llJobTimeUs = 0;
+	pstWriter->bStop = false;
+	pstWriter->bJobError = false;
+	pstWriter->bStore = false;
+	pstWriter->bJobStore = false;
+	pstWriter->pbyCoded = NULL;
+	pstWriter->pstIndex = NULL;
+	pstWriter->dwChunks = pstWriter->dwIndexLen = 0;
+	pstWriter->qwFileOffset = 0;
+	pstWriter->qwStoredBytes = 0;
+	pstWriter->qwStreamBytes = 0;
+	pstWriter->qwFlushes = 0;
+	pstWriter->bError = false;
+
+	pstWriter->pbyBuffer = (uint8_t*)pvRecAlignedAlloc((size_t)REC_STREAM_NUM * pstWriter->dwBufLen);
+	if (!pstWriter->pbyBuffer)
+		return false;
+
+	if (bContainer)
+	{
+		pstWriter->pbyJob = (uint8_t*)pvRecAlignedAlloc((size_t)REC_STREAM_NUM * pstWriter->dwBufLen);
+		pstWriter->pbyCoded = (uint8_t*)malloc(dwCodecBound(REC_WRITER_CHUNK));
+		if (!pstWriter->pbyJob || !pstWriter->pbyCoded)
+		{
+			vStreamWriterClose(pstWriter);
+			return false;
+		}
+
+		uint32_t adwHeader[2] = { REC_STREAM_NUM, REC_WRITER_CHUNK };
+		snprintf(szName + lPrefix, sizeof(szName) - lPrefix, "%s", REC_WRITER_CONTAINER);
+		pstWriter->fpContainer = fpOpenOutput(szName);
+		if (!pstWriter->fpContainer || fwrite("RECSTRM2", 1, 8, pstWriter->fpContainer) != 8 || fwrite(adwHeader, sizeof(adwHeader), 1, pstWriter->fpContainer) != 1
+			|| fwrite(&dFrameRate, sizeof(dFrameRate), 1, pstWriter->fpContainer) != 1)
+		{
+			printf("Can't create %s\n", szName);
+			vStreamWriterClose(pstWriter);
+			return false;
+		}
+		pstWriter->qwFileOffset = 8 + sizeof(adwHeader) + sizeof(dFrameRate);
+		pstWriter->oWorker = std::thread(vWorkerThread, pstWriter);
+	}
+	else
+	{
+		for (int i = 0; i < REC_STREAM_NUM; i++)
+		{
+			pszDecoderStreamName(i, szName + lPrefix, sizeof(szName) - lPrefix);
+			pstWriter->afp[i] = fpOpenOutput(szName);
+			if (!pstWriter->afp[i])
+			{
+				printf("Can't create %s\n", szName);
+				vStreamWriterClose(pstWriter);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+
+/*
+**************************************************************************
+vStreamWriterStore: taken over by the next buffer that is handed over
+**************************************************************************
+*/
+
+void vStreamWriterStore(ST_STREAMWRITER* pstWriter, bool bStore)
+{
+	pstWriter->bStore = bStore;
+}
+
+
+
+/*
+**************************************************************************
+bStreamWriterFlush
+**************************************************************************
+*/
+
+bool bStreamWriterFlush(ST_STREAMWRITER* pstWriter)
+{
+	if (pstWriter->dwFill == 0)
+		return !pstWriter->bError;
+
+	if (pstWriter->bContainer)
+	{
+		// the thread gets the full buffer, the one it is done with is filled next
+		vWaitWorker(pstWriter);
+		{
+			std::lock_guard<std::mutex> oGuard(pstWriter->oLock);
+			uint8_t* pbyFull = pstWriter->pbyBuffer;
+			pstWriter->pbyBuffer = pstWriter->pbyJob;
+			pstWriter->pbyJob = pbyFull;
+			pstWriter->dwJobLen = pstWriter->dwFill;
+			pstWriter->qwJobOffset = pstWriter->qwStreamBytes;
+			pstWriter->llJobTimeUs = pstWriter->llFillTimeUs;
+			pstWriter->bJobStore = pstWriter->bStore;
+		}
+		pstWriter->oWork.notify_one();
+	}
+	else
+	{
+		const uint8_t* apbyStream[REC_STREAM_NUM];
+		for (uint32_t i = 0; i < REC_STREAM_NUM; i++)
+			apbyStream[i] = pstWriter->pbyBuffer + (size_t)i * pstWriter->dwBufLen;
+		if (!bWriteStreams(pstWriter, apbyStream, pstWriter->dwFill, pstWriter->qwStreamBytes, pstWriter->llFillTimeUs))
+			pstWriter->bError = true;
+	}
+
+	pstWriter->qwStreamBytes += pstWriter->dwFill;
+	pstWriter->dwFill = 0;
+	pstWriter->qwFlushes++;
+	return !pstWriter->bError;
+}
+
+
+
+/*
+**************************************************************************
+bStreamWriterAppend
+**************************************************************************
+*/
+
+bool bStreamWriterAppend(ST_STREAMWRITER* pstWriter, uint8_t* const* apbyStream, uint32_t dwLen, int64_t llTimeUs)
+{
+	if (pstWriter->dwFill + dwLen > pstWriter->dwBufLen)
+		bStreamWriterFlush(pstWriter);
+
+	// the bytes end with the block, the first one is older by their duration
+	int64_t llFirstUs = llTimeUs;
+	if (pstWriter->dFrameRate > 0)
+		llFirstUs -= (int64_t)(dwLen * 1.0e6 / pstWriter->dFrameRate);
+
+	// more than a buffer goes straight to disk, the container thread has to be idle for that
+	if (dwLen > pstWriter->dwBufLen)
+	{
+		vWaitWorker(pstWriter);
+		pstWriter->bJobStore = pstWriter->bStore;
+		if (!bWriteStreams(pstWriter, apbyStream, dwLen, pstWriter->qwStreamBytes, llFirstUs))
+			pstWriter->bError = true;
+		pstWriter->qwStreamBytes += dwLen;
+		pstWriter->qwFlushes++;
+		return !pstWriter->bError;
+	}
+
+	if (pstWriter->dwFill == 0)
+		pstWriter->llFillTimeUs = llFirstUs;
+	for (uint32_t i = 0; i < REC_STREAM_NUM; i++)
+		memcpy(pstWriter->pbyBuffer + (size_t)i * pstWriter->dwBufLen + pstWriter->dwFill, apbyStream[i], dwLen);
+	pstWriter->dwFill += dwLen;
+
+	// by the block times, the offline tools have to cut the same chunks
+	if (llTimeUs - pstWriter->llFillTimeUs >= (int64_t)(pstWriter->dFlushTime * 1.0e6))
+		bStreamWriterFlush(pstWriter);
+
+	return !pstWriter->bError;
+}
+
+
+
+/*
+**************************************************************************
+bStreamWriterLog: text lines, the stream files hold no place for them
+**************************************************************************
+*/
+
+bool bStreamWriterLog(ST_STREAMWRITER* pstWriter, const ST_LOCKEVENT* pstEvents, uint32_t dwEvents, double dSamplingRate)
+{
+	if (dwEvents == 0)
+		return true;
+	if (!pstWriter->fpLog)
+	{
+		pstWriter->fpLog = fopen(pstWriter->szLogName, "w");
+		if (!pstWriter->fpLog)
+		{
+			printf("Can't create %s\n", pstWriter->szLogName);
+			return false;
+		}
+		fprintf(pstWriter->fpLog, "event,symbol,sample,seconds,offset\n");
+	}
+
+	for (uint32_t i = 0; i < dwEvents; i++)
+		fprintf(pstWriter->fpLog, "%s,%llu,%llu,%.6lf,%d\n", pszLockEventName(pstEvents[i].lType),
+			(unsigned long long)pstEvents[i].qwSymbol, (unsigned long long)pstEvents[i].qwSample,
+			(double)pstEvents[i].qwSample / dSamplingRate, pstEvents[i].lOffset);
+	return fflush(pstWriter->fpLog) == 0;
+}
+
+
+
+/*
+**************************************************************************
+vStreamWriterClose
+**************************************************************************
+*/
+
+void vStreamWriterClose(ST_STREAMWRITER* pstWriter)
+{
+	if (pstWriter->pbyBuffer)
+		bStreamWriterFlush(pstWriter);
+	if (pstWriter->oWorker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> oGuard(pstWriter->oLock);
+			pstWriter->bStop = true;
+		}
+		pstWriter->oWork.notify_one();
+		pstWriter->oWorker.join();
+		pstWriter->bError = pstWriter->bError || pstWriter->bJobError;
+	}
+
+	if (pstWriter->fpContainer)
+	{
+		uint64_t qwIndexOffset = pstWriter->qwFileOffset;
+		if (pstWriter->dwChunks)
+			fwrite(pstWriter->pstIndex, sizeof(ST_WRITERCHUNK), pstWriter->dwChunks, pstWriter->fpContainer);
+		fwrite(&qwIndexOffset, sizeof(qwIndexOffset), 1, pstWriter->fpContainer);
+		fwrite(&pstWriter->dwChunks, sizeof(pstWriter->dwChunks), 1, pstWriter->fpContainer);
+		fwrite("RIDX", 1, 4, pstWriter->fpContainer);
+		fclose(pstWriter->fpContainer);
+		pstWriter->fpContainer = NULL;
+	}
+
+	for (int i = 0; i < REC_STREAM_NUM; i++)
+		if (pstWriter->afp[i])
+		{
+			fclose(pstWriter->afp[i]);
+			pstWriter->afp[i] = NULL;
+		}
+	if (pstWriter->fpLog)
+	{
+		fclose(pstWriter->fpLog);
+		pstWriter->fpLog = NULL;
+	}
+
+	vRecAlignedFree(pstWriter->pbyBuffer);
+	pstWriter->pbyBuffer = NULL;
+	vRecAlignedFree(pstWriter->pbyJob);
+	pstWriter->pbyJob = NULL;
+	free(pstWriter->pbyCoded);
+	pstWriter->pbyCoded = NULL;
+	free(pstWriter->pstIndex);
+	pstWriter->pstIndex = NULL;
+	pstWriter->dwChunks = pstWriter->dwIndexLen = 0;
+}
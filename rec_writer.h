@@ -0,0 +1,150 @@
+/*
+**************************************************************************
+
+rec_writer.h
+
+**************************************************************************
+
+Writer of the decoded streams. The outputs are opened once for the whole
+run and the streams of each block are only copied to large aligned
+buffers, one per stream. The buffers go to disk when they are full or
+hold more than the flush time of data by the block times, so the FIFO
+loop does no file system calls for most blocks. The block times and not
+the clock of the decoding decide, so the offline tools cut a capture
+into the same chunks and write the same container to the byte.
+
+Outputs are either the 16 ratX_chY.bin files or one compressed
+container file that holds all streams:
+
+	header      "RECSTRM2", uint32 streams, uint32 chunk bytes, double
+	            frames per second (bytes per second of each stream, 0 if
+	            unknown)
+	chunks      ST_WRITERCHUNK followed by dwStoredLen bytes, at most
+	            REC_WRITER_CHUNK bytes of one stream coded with dwCodec
+	            (rec_codec), stored as is if the codec gains nothing
+	index       one ST_WRITERCHUNK per chunk with qwFileOffset set
+	trailer     uint64 file offset of the index, uint32 chunks, "RIDX"
+
+All numbers are little endian. Every chunk carries its stream offset and
+the wall clock time of its first byte in microseconds since 1970, so a
+reader (rec_reader) finds a time range in the index and decodes only the
+chunks of the range. The time is the one the data was taken, not the one
+it was decoded: the caller hands the time of each block in, the FIFO
+loop the wall clock of its arrival and the offline tools the start of
+the capture plus the samples up to the block. The container is
+compressed and written by a thread of the writer: a full buffer is
+handed over and the next one is filled meanwhile, the caller only waits
+if the thread is still busy with the buffer before. Under overload the
+buffers can be stored without compression, the chunks say so. The stream
+files are written by the caller.
+
+Frame lock events of the decoder (rec_lock) go to the side log
+sync_log.csv next to the streams, one line per event with the line
+symbol, the sample and its time at the sampling rate. The log is
+created with the first event and flushed with every block of events.
+**************************************************************************
+*/
+
+#ifndef REC_WRITER_H
+#define REC_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rec_decoder.h"
+
+#define REC_WRITER_BUFFER       (4 * 1024 * 1024)   // default bytes per stream buffer
+#define REC_WRITER_FLUSH_TIME   2.0                 // default max seconds of data in the buffers
+#define REC_WRITER_CHUNK        (64 * 1024)         // max stream bytes of a container chunk
+#define REC_WRITER_CONTAINER    "streams.rec"
+#define REC_WRITER_SYNCLOG      "sync_log.csv"
+#define REC_WRITER_NAME_LEN     32                  // longest file name behind the prefix, with the terminating zero
+
+// ----- longest path of an output, the prefix has to leave REC_WRITER_NAME_LEN of it -----
+#if defined(_WIN32)
+	#define REC_WRITER_PATH_MAX 260                 // MAX_PATH
+#else
+	#define REC_WRITER_PATH_MAX PATH_MAX
+#endif
+
+
+struct ST_WRITERCHUNK
+{
+	uint64_t    qwFileOffset;       // of the chunk data, only set in the index
+	uint64_t    qwStreamOffset;     // of the first byte in the stream
+	int64_t     llTimeUs;           // wall clock of the first byte
+	uint32_t    dwLen;              // stream bytes
+	uint32_t    dwStoredLen;        // bytes in the file
+	uint32_t    dwStream;
+	uint32_t    dwCodec;            // REC_CODEC_NONE or REC_CODEC_RICE
+};
+
+struct ST_STREAMWRITER
+{
+	// outputs
+	bool            bContainer;
+	FILE*           afp[REC_STREAM_NUM];
+	FILE*           fpContainer;
+	FILE*           fpLog;
+	char            szLogName[REC_WRITER_PATH_MAX];
+
+	// REC_STREAM_NUM buffers of dwBufLen in one allocation, all streams have the same fill
+	uint8_t*        pbyBuffer;
+	uint32_t        dwBufLen;
+	uint32_t        dwFill;
+	int64_t         llFillTimeUs;       // wall clock of the first byte in the buffer
+	double          dFrameRate;
+	double          dFlushTime;
+
+	// container: compression thread and the buffer it works on
+	std::thread             oWorker;
+	std::mutex              oLock;
+	std::condition_variable oWork;
+	std::condition_variable oDone;
+	uint8_t*        pbyJob;             // second buffer, pbyBuffer and pbyJob are swapped at a flush
+	uint32_t        dwJobLen;           // bytes of each stream, 0 if the thread is idle; protected by oLock
+	uint64_t        qwJobOffset;
+	int64_t         llJobTimeUs;
+	bool            bStop;              // protected by oLock
+	bool            bJobError;          // protected by oLock
+	bool            bStore;             // the next buffers are stored without compression (overload, rec_governor)
+	bool            bJobStore;          // bStore of the buffer in work, protected by oLock
+	uint8_t*        pbyCoded;           // dwCodecBound(REC_WRITER_CHUNK) bytes of the thread
+
+	// container index, only used by the thread once it runs
+	ST_WRITERCHUNK* pstIndex;
+	uint32_t        dwChunks;
+	uint32_t        dwIndexLen;
+	uint64_t        qwFileOffset;
+	uint64_t        qwStoredBytes;      // chunk data of all streams in the container
+
+	// status
+	uint64_t        qwStreamBytes;      // written per stream
+	uint64_t        qwFlushes;
+	bool            bError;
+};
+
+
+// ----- opens the ratX_chY.bin files or the container with szPrefix in front of the names, dFrameRate in frames per second (0 if unknown) dates the chunks; false on error or a prefix longer than REC_WRITER_PATH_MAX allows -----
+bool bStreamWriterOpen(ST_STREAMWRITER* pstWriter, bool bContainer, const char* szPrefix = "", double dFrameRate = 0, uint32_t dwBufLen = REC_WRITER_BUFFER, double dFlushTime = REC_WRITER_FLUSH_TIME);
+
+// ----- appends dwLen bytes of each stream decoded from a block taken at wall clock llTimeUs (its last sample), flushes if the buffers are full or the flush time is over -----
+bool bStreamWriterAppend(ST_STREAMWRITER* pstWriter, uint8_t* const* apbyStream, uint32_t dwLen, int64_t llTimeUs);
+
+// ----- appends frame lock events to the side log, dSamplingRate in samples per second -----
+bool bStreamWriterLog(ST_STREAMWRITER* pstWriter, const ST_LOCKEVENT* pstEvents, uint32_t dwEvents, double dSamplingRate);
+
+// ----- the container stores the chunks of the following flushes as is, to take load off the thread; false compresses again -----
+void vStreamWriterStore(ST_STREAMWRITER* pstWriter, bool bStore);
+
+// ----- writes the buffered bytes, the container hands them to its thread -----
+bool bStreamWriterFlush(ST_STREAMWRITER* pstWriter);
+
+// ----- flushes, waits for the container thread, writes the index and closes all outputs -----
+void vStreamWriterClose(ST_STREAMWRITER* pstWriter);
+
+#endif